@@ -0,0 +1,54 @@
+/********************************************************************************************************
+ * @file     crc.h
+ *
+ * @brief    This file provides table driven CRC-8/16/32 calculation
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _CRC_H_
+#define _CRC_H_
+
+/*
+ * plain C types only, the host tools under script/ build this module too.
+ * every function continues a CRC over more data, so an image can be checked piece by piece:
+ * pass the value returned for the data before, or the start value for the first piece
+ */
+#define CRC_TABLE_NONE          0 //bit at a time, no table
+#define CRC_TABLE_BYTE          1 //a 256 entry table per CRC, one lookup per byte
+#define CRC_TABLE_SLICE4        4 //four 256 entry tables per CRC, four bytes per step
+
+#ifndef CRC_TABLE_MODE
+#define CRC_TABLE_MODE          CRC_TABLE_SLICE4 //tables take 6.25KB in slice-by-4, 1.75KB byte-wise
+#endif
+#ifndef CRC_IN_RAM
+#define CRC_IN_RAM              0 //1 runs the kernels from RAM and copies the tables there, no flash wait states but as much RAM
+#endif
+
+#define CRC8_INIT               0x00
+#define CRC16_INIT              0x0000
+#define CRC32_INIT              0x00000000
+
+//CRC-8/SMBUS: poly 0x07, not reflected
+unsigned char crc8_update(unsigned char crc, const void *data, unsigned int len);
+
+//CRC-16/KERMIT: poly 0x1021 reflected (0x8408), no final xor, what OTA and FW_UPDATE images carry
+unsigned short crc16_update(unsigned short crc, const void *data, unsigned int len);
+
+//CRC-32 of zlib and Ethernet: poly 0x04c11db7 reflected, the value passed and returned is final
+unsigned int crc32_update(unsigned int crc, const void *data, unsigned int len);
+
+#endif /* _CRC_H_ */
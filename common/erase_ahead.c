@@ -0,0 +1,67 @@
+/********************************************************************************************************
+ * @file     erase_ahead.c
+ *
+ * @brief    This file provides on demand sector erase of a flash area being written
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#include "erase_ahead.h"
+#include "../drivers/flash.h"
+
+void erase_ahead_init(erase_ahead_t *ea, u32 start_addr, u32 size)
+{
+    ea->next_addr = start_addr & ~(ERASE_AHEAD_SECTOR_SIZE - 1);
+    ea->end_addr = start_addr + size;
+}
+
+/* the sectors below addr were erased by an earlier session and hold its data */
+void erase_ahead_skip(erase_ahead_t *ea, u32 addr)
+{
+    addr = (addr + ERASE_AHEAD_SECTOR_SIZE - 1) & ~(ERASE_AHEAD_SECTOR_SIZE - 1);
+    if (addr > ea->next_addr) {
+        ea->next_addr = addr;
+    }
+}
+
+/* erase whatever [addr, addr+len) still needs, to be called before every write */
+void erase_ahead_ensure(erase_ahead_t *ea, u32 addr, u32 len)
+{
+    while (ea->next_addr < addr + len) {
+        flash_erase_sector(ea->next_addr);
+        ea->next_addr += ERASE_AHEAD_SECTOR_SIZE;
+    }
+}
+
+/* returns 1 when erase_ahead_idle() is going to erase, so a response can tell the peer before */
+int erase_ahead_due(const erase_ahead_t *ea, u32 write_addr)
+{
+    return (ea->next_addr < ea->end_addr) && (ea->next_addr <= write_addr + ERASE_AHEAD_SECTOR_SIZE);
+}
+
+/*
+ * called in an idle gap, erases the sector following the one write_addr is filling,
+ * at most one sector per call, returns 1 when it erased
+ */
+int erase_ahead_idle(erase_ahead_t *ea, u32 write_addr)
+{
+    if (!erase_ahead_due(ea, write_addr)) {
+        return 0;
+    }
+    flash_erase_sector(ea->next_addr);
+    ea->next_addr += ERASE_AHEAD_SECTOR_SIZE;
+    return 1;
+}
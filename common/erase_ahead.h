@@ -0,0 +1,53 @@
+/********************************************************************************************************
+ * @file     erase_ahead.h
+ *
+ * @brief    This file provides on demand sector erase of a flash area being written
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _ERASE_AHEAD_H_
+#define _ERASE_AHEAD_H_
+
+#include "types.h"
+
+#define ERASE_AHEAD_SECTOR_SIZE     0x1000
+
+/*
+ * worst case time of one sector erase in us, the largest Sector Erase Time(MAX) listed in flash.c,
+ * a build for a known flash part may lower it. A peer that has been told by erase_ahead_due() that
+ * an idle erase follows the response waits this long on top of the round trip
+ */
+#ifndef ERASE_AHEAD_SECTOR_ERASE_MAX_US
+#define ERASE_AHEAD_SECTOR_ERASE_MAX_US    500000
+#endif
+
+/*
+ * an area written from its start, sectors are erased right before data lands in them,
+ * erase_ahead_idle() moves the next erase into a gap where no frame can be missed
+ */
+typedef struct {
+    u32 next_addr;  //first sector not erased yet
+    u32 end_addr;   //end of the area that is going to be written
+} erase_ahead_t;
+
+void erase_ahead_init(erase_ahead_t *ea, u32 start_addr, u32 size);
+void erase_ahead_skip(erase_ahead_t *ea, u32 addr);
+void erase_ahead_ensure(erase_ahead_t *ea, u32 addr, u32 len);
+int erase_ahead_due(const erase_ahead_t *ea, u32 write_addr);
+int erase_ahead_idle(erase_ahead_t *ea, u32 write_addr);
+
+#endif /* _ERASE_AHEAD_H_ */
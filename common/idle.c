@@ -0,0 +1,155 @@
+/********************************************************************************************************
+ * @file     idle.c
+ *
+ * @brief    This is the source file for the tickless idle manager
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#include "idle.h"
+#include "timer_event.h"
+
+#define IDLE_US_TO_TICK(us)         ((us) * sys_tick_per_us)
+#define IDLE_BEFORE(a, b)           ((int)((u32)(a) - (u32)(b)) < 0)
+
+/*
+ * the deepest mode whose break-even time plus learned wakeup margin fits before the next deadline of
+ * timer_event.c is used, the pm library recovers the system timer from the 32k timer after suspend and
+ * deep retention, what it is off by is measured on every timer wakeup and folded into the margin
+ */
+static const u32 idle_min_us[IDLE_MODE_NUM] = {0, IDLE_STALL_MIN_US, IDLE_SUSPEND_MIN_US, IDLE_DEEP_RET_MIN_US};
+static const u8 idle_mode_en[IDLE_MODE_NUM] = {1, IDLE_STALL_EN, IDLE_SUSPEND_EN, IDLE_DEEP_RET_EN};
+
+_attribute_data_retention_ static idle_stats_t idle_stats[IDLE_MODE_NUM];
+_attribute_data_retention_ static u32 idle_margin[IDLE_MODE_NUM] = {0, IDLE_US_TO_TICK(IDLE_GUARD_US),
+                                                                     IDLE_US_TO_TICK(IDLE_GUARD_US),
+                                                                     IDLE_US_TO_TICK(IDLE_GUARD_US)}; //in system ticks
+_attribute_data_retention_ static u32 idle_ms_rest[IDLE_MODE_NUM]; //system ticks not yet counted in sleep_ms
+_attribute_data_retention_ static u32 idle_ret_start; //the deep retention sleep main() comes back from
+_attribute_data_retention_ static u32 idle_ret_deadline;
+_attribute_data_retention_ static u8 idle_ret_pending;
+static u32 idle_wakeup_src;
+static idle_mode_e idle_max_mode = IDLE_MODE_DEEP_RET;
+
+static void idle_account(idle_mode_e mode, u32 start, u32 deadline, int by_timer)
+{
+    idle_stats_t *s = &idle_stats[mode];
+    u32 now = clock_time();
+    int late = (int)(now - deadline);
+    int err;
+
+    idle_ms_rest[mode] += now - start;
+    s->sleep_ms += idle_ms_rest[mode] / IDLE_US_TO_TICK(1000);
+    idle_ms_rest[mode] %= IDLE_US_TO_TICK(1000);
+    if (!by_timer) {
+        return; //woken early by a pad or an interrupt, says nothing about the wakeup latency
+    }
+
+    if (late / sys_tick_per_us > s->late_us_max) {
+        s->late_us_max = late / sys_tick_per_us;
+    }
+    //steers the wakeup to IDLE_GUARD_US before the deadline, a quarter of the error per wakeup
+    err = late + IDLE_US_TO_TICK(IDLE_GUARD_US);
+    if (err < 0 && (u32)(-err / 4) > idle_margin[mode]) {
+        idle_margin[mode] = 0;
+    }
+    else {
+        idle_margin[mode] += err / 4;
+    }
+    if (idle_margin[mode] > IDLE_US_TO_TICK(idle_min_us[mode]) / 2) {
+        idle_margin[mode] = IDLE_US_TO_TICK(idle_min_us[mode]) / 2;
+    }
+    s->margin_us = idle_margin[mode] / sys_tick_per_us;
+}
+
+int idle_init(u32 wakeup_src)
+{
+    idle_wakeup_src = wakeup_src;
+    if (!idle_ret_pending) {
+        return 0;
+    }
+    idle_ret_pending = 0;
+    if (!pm_is_MCU_deepRetentionWakeup()) {
+        return 0;
+    }
+    idle_account(IDLE_MODE_DEEP_RET, idle_ret_start, idle_ret_deadline, pm_get_wakeup_src() & WAKEUP_STATUS_TIMER);
+    return 1;
+}
+
+void idle_set_max_mode(idle_mode_e mode)
+{
+    idle_max_mode = (mode < IDLE_MODE_NUM) ? mode : IDLE_MODE_DEEP_RET;
+}
+
+const idle_stats_t *idle_get_stats(idle_mode_e mode)
+{
+    return (mode < IDLE_MODE_NUM) ? &idle_stats[mode] : NULL;
+}
+
+idle_mode_e idle_enter(void)
+{
+    idle_mode_e mode;
+    u32 now, deadline, target;
+    int by_timer = 0;
+
+    //an interrupt starting a nearer timer after this point only runs once the sleep is over
+    u8 r = irq_disable();
+
+    now = clock_time();
+    if (!ev_next_timer(&deadline) || !IDLE_BEFORE(deadline, now + IDLE_US_TO_TICK(IDLE_SLEEP_MAX_US))) {
+        deadline = now + IDLE_US_TO_TICK(IDLE_SLEEP_MAX_US);
+    }
+    for (mode = idle_max_mode; mode > IDLE_MODE_RUN; mode--) {
+        if (idle_mode_en[mode] &&
+            !IDLE_BEFORE(deadline, now + IDLE_US_TO_TICK(idle_min_us[mode]) + idle_margin[mode])) {
+            break;
+        }
+    }
+    if (mode == IDLE_MODE_RUN) {
+        irq_restore(r);
+        return IDLE_MODE_RUN;
+    }
+
+    target = deadline - idle_margin[mode];
+    idle_stats[mode].entries++;
+    if (mode == IDLE_MODE_STALL) {
+        u32 irq_mask = reg_irq_mask;
+
+        stimer_set_capture_tick(target);
+        stimer_clr_irq_status();
+        stimer_enable();
+        cpu_stall_wakeup(FLD_IRQ_SYSTEM_TIMER | IDLE_STALL_IRQ_MASK);
+        by_timer = stimer_get_irq_status();
+        stimer_clr_irq_status();
+        stimer_disable();
+        reg_irq_mask = irq_mask;
+    }
+    else if (mode == IDLE_MODE_SUSPEND) {
+        by_timer = cpu_sleep_wakeup(SUSPEND_MODE, PM_WAKEUP_TIMER | idle_wakeup_src, target) & WAKEUP_STATUS_TIMER;
+    }
+    else {
+        //on a timer or pad wakeup main() starts over and idle_init() completes the accounting
+        idle_ret_start = now;
+        idle_ret_deadline = deadline;
+        idle_ret_pending = 1;
+        cpu_sleep_wakeup(DEEPSLEEP_MODE_RET_SRAM_LOW16K, PM_WAKEUP_TIMER | idle_wakeup_src, target);
+        idle_ret_pending = 0;
+    }
+    idle_account(mode, now, deadline, by_timer);
+
+    irq_restore(r);
+    return mode;
+}
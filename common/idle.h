@@ -0,0 +1,92 @@
+/********************************************************************************************************
+ * @file     idle.h
+ *
+ * @brief    This is the header file for the tickless idle manager
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _IDLE_H_
+#define _IDLE_H_
+
+#include "types.h"
+
+#ifndef IDLE_STALL_EN
+#define IDLE_STALL_EN               1 //stalls on the system timer compare, which idle_enter() then owns
+#endif
+#ifndef IDLE_SUSPEND_EN
+#define IDLE_SUSPEND_EN             1
+#endif
+#ifndef IDLE_DEEP_RET_EN
+#define IDLE_DEEP_RET_EN            0 //needs a main() that restarts through idle_init(), see there
+#endif
+#ifndef IDLE_STALL_MIN_US
+#define IDLE_STALL_MIN_US           20
+#endif
+#ifndef IDLE_SUSPEND_MIN_US
+#define IDLE_SUSPEND_MIN_US         3000 //shorter suspends cost more to enter and leave than they save
+#endif
+#ifndef IDLE_DEEP_RET_MIN_US
+#define IDLE_DEEP_RET_MIN_US        50000 //also pays for the restart through main()
+#endif
+#ifndef IDLE_SLEEP_MAX_US
+#define IDLE_SLEEP_MAX_US           (60 * 1000 * 1000) //with no timer pending
+#endif
+#ifndef IDLE_GUARD_US
+#define IDLE_GUARD_US               30 //wakeups are aimed this long before the deadline
+#endif
+#ifndef IDLE_STALL_IRQ_MASK
+#define IDLE_STALL_IRQ_MASK         0 //interrupts besides the system timer that end a stall, e.g. FLD_IRQ_UART_EN
+#endif
+
+typedef enum {
+    IDLE_MODE_RUN = 0, //the next deadline is too close, idle_enter() returned at once
+    IDLE_MODE_STALL,
+    IDLE_MODE_SUSPEND,
+    IDLE_MODE_DEEP_RET,
+    IDLE_MODE_NUM,
+} idle_mode_e;
+
+typedef struct {
+    u32 entries;
+    u32 sleep_ms;       //time spent in the mode
+    u32 margin_us;      //how long before a deadline the wakeup is aimed, learned from the measured wakeups
+    s32 late_us_max;    //latest timer wakeup measured relative to the deadline
+} idle_stats_t;
+
+/**
+ * @brief       sets up the idle manager, call it in main() before the timers are used
+ * @param[in]   wakeup_src - wakeup sources of suspend and deep retention besides the timer, e.g. PM_WAKEUP_PAD
+ * @return      1 if main() runs again after a deep retention sleep of idle_enter(): the timers of
+ *              timer_event.c are kept and must not be started again, the peripherals must be
+ */
+int idle_init(u32 wakeup_src);
+
+/**
+ * @brief       sleeps until the next timer deadline in the deepest mode that pays off,
+ *              call it at the end of the main loop once all work is done
+ * @return      the mode used, after IDLE_MODE_DEEP_RET it only returns if the chip refused to sleep
+ */
+idle_mode_e idle_enter(void);
+
+/**
+ * @brief       limits the modes idle_enter() may use, e.g. to IDLE_MODE_STALL while a UART transfer runs
+ */
+void idle_set_max_mode(idle_mode_e mode);
+
+const idle_stats_t *idle_get_stats(idle_mode_e mode);
+
+#endif /* _IDLE_H_ */
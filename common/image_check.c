@@ -0,0 +1,93 @@
+/********************************************************************************************************
+ * @file     image_check.c
+ *
+ * @brief    This file provides the boot time check of the running image
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#include "image_check.h"
+#include "crc.h"
+#include "string.h"
+#include "../drivers/flash.h"
+
+#if (IMAGE_CHECK_BURST < SLOT_FLAG_OFFSET + 4)
+#error "the first burst has to hold the boot flag"
+#endif
+
+static const u8 image_check_flag[4] = {0x4b, 0x4e, 0x4c, 0x54}; //what the bin carries where the boot flag goes
+
+/* size and CRC the image at addr was built with, 0 if the size field cannot belong to an image there */
+int image_check_read(u32 addr, u32 *size, u16 *crc)
+{
+    u32 bin_size;
+
+    flash_read_page(addr + IMAGE_CHECK_SIZE_OFFSET, sizeof(bin_size), (u8 *)&bin_size);
+    if ((bin_size <= IMAGE_CHECK_SIZE_OFFSET + sizeof(bin_size)) || (bin_size > IMAGE_CHECK_SIZE_MAX - IMAGE_CHECK_CRC_LEN)) {
+        return 0;
+    }
+    flash_read_page(addr + bin_size, IMAGE_CHECK_CRC_LEN, (u8 *)crc);
+    *size = bin_size + IMAGE_CHECK_CRC_LEN;
+    return 1;
+}
+
+/*
+ * the whole image is read in IMAGE_CHECK_BURST pieces through crc16_update(), the flag bytes
+ * are taken as the bin has them since the boot flag of a slot changes after the CRC was appended
+ */
+int image_check_full(u32 addr, u32 size, u16 crc)
+{
+    u8 buf[IMAGE_CHECK_BURST] __attribute__((aligned(4)));
+    u16 calc = CRC16_INIT;
+    u32 offset, len;
+
+    for (offset = 0; offset < size - IMAGE_CHECK_CRC_LEN; offset += len) {
+        len = size - IMAGE_CHECK_CRC_LEN - offset;
+        if (len > IMAGE_CHECK_BURST) {
+            len = IMAGE_CHECK_BURST;
+        }
+        flash_read_page(addr + offset, len, buf);
+        if (0 == offset) {
+            memcpy(&buf[SLOT_FLAG_OFFSET], image_check_flag, sizeof(image_check_flag));
+        }
+        calc = crc16_update(calc, buf, len);
+    }
+    return (calc == crc);
+}
+
+/*
+ * to be called right after slot_boot(), checks the running image against its appended CRC
+ * unless its slot record tells it passed before, so only the first boot of an image pays the full pass.
+ * an image that fails is rejected, the other slot boots if it holds an image, returns 1 for a good image
+ */
+int image_check_boot(void)
+{
+    u32 addr = slot_running();
+    u32 size;
+    u16 crc;
+
+    if (image_check_read(addr, &size, &crc)) {
+        if (slot_verified(addr, size, crc)) {
+            return 1;
+        }
+        if (image_check_full(addr, size, crc)) {
+            slot_set_verified(addr, size, crc);
+            return 1;
+        }
+    }
+    slot_reject();
+    return 0;
+}
@@ -0,0 +1,44 @@
+/********************************************************************************************************
+ * @file     image_check.h
+ *
+ * @brief    This file provides the boot time check of the running image
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _IMAGE_CHECK_H_
+#define _IMAGE_CHECK_H_
+
+#include "types.h"
+#include "slot.h"
+
+#define IMAGE_CHECK_SIZE_OFFSET     0x18 //the bin size is linked into the image there, the CRC of bin_crc_append follows the bin
+#define IMAGE_CHECK_CRC_LEN         2
+#ifndef IMAGE_CHECK_BURST
+#define IMAGE_CHECK_BURST           1024 //bytes per flash read, taken from the stack
+#endif
+#ifndef IMAGE_CHECK_SIZE_MAX
+#define IMAGE_CHECK_SIZE_MAX        (SLOT_B_ADDR - SLOT_A_ADDR)
+#endif
+
+/*
+ * sizes include the appended CRC, as the slot records and the update paths count them
+ */
+int image_check_read(u32 addr, u32 *size, u16 *crc);
+int image_check_full(u32 addr, u32 size, u16 crc);
+int image_check_boot(void);
+
+#endif /* _IMAGE_CHECK_H_ */
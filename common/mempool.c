@@ -1,6 +1,7 @@
 
 #include "mempool.h"
 #include "utility.h"
+#include "../drivers/irq.h"
 
 mem_pool_t* mempool_init(mem_pool_t* pool, void* mem, int itemsize, int itemcount)
 {
@@ -25,16 +26,120 @@ mem_block_t* mempool_header(char* pd){
 
 void* mempool_alloc(mem_pool_t* pool)
 {
-	if(!pool->free_list)
-		return 0;
+	u8 r = irq_disable();
 	mem_block_t* tmp = pool->free_list;
-	pool->free_list = tmp->next_block;
-	return &tmp->data;
+	if(tmp)
+		pool->free_list = tmp->next_block;
+	irq_restore(r);
+	return tmp ? &tmp->data : 0;
 }
 
 void mempool_free(mem_pool_t* pool, void* p)
 {
 	mem_block_t* tmp = mempool_header((char*)p);
+	u8 r = irq_disable();
 	tmp->next_block = pool->free_list;
 	pool->free_list = tmp;
+	irq_restore(r);
+}
+
+mem_class_t* mempool_class_init(mem_class_t* cls, void* mem, int itemsize, int itemcount)
+{
+	if (!cls || !mem || itemsize <= 0 || itemcount <= 0)
+		return (0);
+
+	cls->block_size = MEMPOOL_CLASS_BLOCKSIZE(itemsize);
+	cls->item_size = MEMPOOL_ITEMSIZE_2_BLOCKSIZE(itemsize);
+	cls->item_count = itemcount;
+	cls->mem_start = (u8*)mem;
+	cls->mem_end = (u8*)mem + cls->block_size * itemcount;
+	cls->in_use = 0;
+	cls->peak = 0;
+	cls->fail = 0;
+	cls->guard_err = 0;
+	mempool_init(&cls->pool, mem, cls->block_size, itemcount);
+	return cls;
+}
+
+/*
+ * takes a block of the smallest class holding size bytes, or of a larger one once that class is empty,
+ * classes must be sorted by item size, interrupts are masked only while a block is unlinked
+ */
+void* mempool_class_alloc(mem_class_t* classes, int class_cnt, int size)
+{
+	mem_class_t* fit = 0;
+	mem_block_t* tmp = 0;
+	int i;
+
+	for(i = 0; i < class_cnt; ++i){
+		if(classes[i].item_size < size)
+			continue;
+		if(!fit)
+			fit = &classes[i];
+		u8 r = irq_disable();
+		tmp = classes[i].pool.free_list;
+		if(tmp){
+			classes[i].pool.free_list = tmp->next_block;
+			if(++classes[i].in_use > classes[i].peak)
+				classes[i].peak = classes[i].in_use;
+		}
+		irq_restore(r);
+		if(tmp)
+			break;
+	}
+
+	if(!tmp){
+		if(!fit && class_cnt)
+			fit = &classes[class_cnt - 1];
+		if(fit && fit->fail != 0xffff){
+			u8 r = irq_disable();
+			++fit->fail;
+			irq_restore(r);
+		}
+		return 0;
+	}
+
+#if (MEMPOOL_GUARD_ENABLE)
+	tmp->next_block = (mem_block_t*)MEMPOOL_GUARD_HEAD;
+	*(u32*)(tmp->data + classes[i].item_size) = MEMPOOL_GUARD_TAIL;
+#endif
+	return &tmp->data;
+}
+
+/*
+ * returns a block to its class, MEMPOOL_OK or one of the MEMPOOL_ERR_ codes
+ */
+int mempool_class_free(mem_class_t* classes, int class_cnt, void* p)
+{
+	mem_block_t* tmp = mempool_header((char*)p);
+	mem_class_t* cls = 0;
+	int ret = MEMPOOL_OK;
+	int i;
+
+	for(i = 0; i < class_cnt; ++i){
+		if((u8*)tmp >= classes[i].mem_start && (u8*)tmp < classes[i].mem_end){
+			cls = &classes[i];
+			break;
+		}
+	}
+	if(!cls || ((u8*)tmp - cls->mem_start) % cls->block_size)
+		return MEMPOOL_ERR_FOREIGN;
+
+#if (MEMPOOL_GUARD_ENABLE)
+	if(tmp->next_block != (mem_block_t*)MEMPOOL_GUARD_HEAD)
+		ret = MEMPOOL_ERR_GUARD;
+	else if(*(u32*)(tmp->data + cls->item_size) != MEMPOOL_GUARD_TAIL)
+		ret = MEMPOOL_ERR_OVERRUN;
+#endif
+
+	u8 r = irq_disable();
+	if(ret != MEMPOOL_OK && cls->guard_err != 0xffff)
+		++cls->guard_err;
+	if(ret != MEMPOOL_ERR_GUARD){
+		tmp->next_block = cls->pool.free_list;
+		cls->pool.free_list = tmp;
+		--cls->in_use;
+	}
+	irq_restore(r);
+	return ret;
 }
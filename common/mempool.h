@@ -21,9 +21,53 @@ typedef struct mem_pool_t
 	mem_pool_t pool_name;											\
 	u8 pool_mem[MEMPOOL_ITEMSIZE_2_BLOCKSIZE(itemsize) * itemcount];
 
+#ifndef MEMPOOL_GUARD_ENABLE
+#define MEMPOOL_GUARD_ENABLE		0	// debug, guard words around every class block catch overruns and double frees
+#endif
+
+#define MEMPOOL_HEADER_SIZE			sizeof(mem_block_t*)
+#define MEMPOOL_GUARD_HEAD			0xa5c3e1f0	// replaces next_block while allocated
+#define MEMPOOL_GUARD_TAIL			0x0f1e3c5a	// word behind the item
+#if (MEMPOOL_GUARD_ENABLE)
+#define MEMPOOL_GUARD_SIZE			4
+#else
+#define MEMPOOL_GUARD_SIZE			0
+#endif
+
+// block of a size class: header, item rounded up to the alignment, tail guard in debug builds
+#define MEMPOOL_CLASS_BLOCKSIZE(s)	(MEMPOOL_HEADER_SIZE + MEMPOOL_ITEMSIZE_2_BLOCKSIZE(s) + MEMPOOL_GUARD_SIZE)
+
+#define MEMPOOL_CLASS_DECLARE(class_name, class_mem, itemsize, itemcount)	\
+	mem_class_t class_name;											\
+	u8 class_mem[MEMPOOL_CLASS_BLOCKSIZE(itemsize) * itemcount] __attribute__((aligned(MEMPOOL_ALIGNMENT)));
+
+#define MEMPOOL_OK					0
+#define MEMPOOL_ERR_FOREIGN			-1	// pointer of no class
+#define MEMPOOL_ERR_GUARD			-2	// head guard broken (double free or underrun), block kept out of the pool
+#define MEMPOOL_ERR_OVERRUN			-3	// tail guard broken, block freed
+
+// one size class, several of them sorted by item_size make up a size-classed pool
+typedef struct mem_class_t
+{
+	mem_pool_t		pool;
+	u8*				mem_start;
+	u8*				mem_end;
+	u16				item_size;		// bytes a caller may use
+	u16				block_size;
+	u16				item_count;
+	u16				in_use;
+	u16				peak;			// high-water mark of in_use
+	u16				fail;			// requests this class fitted but no class could serve, saturates
+	u16				guard_err;		// broken guards found on free, saturates
+}mem_class_t;
+
 mem_pool_t* mempool_init(mem_pool_t* pool, void* mem, int itemsize, int itemcount);
 void* mempool_alloc(mem_pool_t* pool);
 void mempool_free(mem_pool_t* pool, void* p);
 mem_block_t* mempool_header(char* pd);
 
+mem_class_t* mempool_class_init(mem_class_t* cls, void* mem, int itemsize, int itemcount);
+void* mempool_class_alloc(mem_class_t* classes, int class_cnt, int size);
+int mempool_class_free(mem_class_t* classes, int class_cnt, void* p);
+
 
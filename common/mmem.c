@@ -10,12 +10,13 @@
 
 #include "mmem.h"
 #include "list.h"
-
-#define		MMEM_SIZE	2048
+#include "string.h"
 
 LIST(mmemlist);
 unsigned int avail_memory;
 static char memory[MMEM_SIZE];
+static char *top;       /* End of the highest block, all free space above it. */
+static struct mmem_stats stats;
 
 /*---------------------------------------------------------------------------*/
 /**
@@ -30,6 +31,12 @@ static char memory[MMEM_SIZE];
  *             memory allocated with this function must be deallocated
  *             using the mmem_free() function.
  *
+ *             The smallest hole left by mmem_free() that holds the
+ *             block is used first, then the space above the highest
+ *             block. When only all free space together is large
+ *             enough, the memory is compacted in one go, see
+ *             MMEM_COMPACT_ON_ALLOC.
+ *
  *             \note This function does NOT return a pointer to the
  *             allocated memory, but a pointer to a structure that
  *             contains information about the managed memory. The
@@ -40,18 +47,54 @@ static char memory[MMEM_SIZE];
 int
 mmem_alloc(struct mmem *m, unsigned int size)
 {
+  struct mmem *n, *prev, *best_prev;
+  char *pos, *best;
+  unsigned int gap, best_gap;
+
   /* Check if we have enough memory left for this allocation. */
   if(avail_memory < size) {
+    stats.alloc_fails++;
     return 0;
   }
 
-  /* We had enough memory so we add this memory block to the end of
-     the list of allocated memory blocks. */
-  list_add(mmemlist, m);
+  /* Best fit among the holes, the list is kept in address order. */
+  best = 0;
+  best_prev = 0;
+  best_gap = 0;
+  prev = 0;
+  pos = memory;
+  for(n = list_head(mmemlist); n != 0; n = n->next) {
+    gap = (char *)n->ptr - pos;
+    if(gap >= size && (best == 0 || gap < best_gap)) {
+      best = pos;
+      best_prev = prev;
+      best_gap = gap;
+    }
+    pos = (char *)n->ptr + n->size;
+    prev = n;
+  }
 
-  /* Set up the pointer so that it points to the first available byte
-     in the memory block. */
-  m->ptr = &memory[MMEM_SIZE - avail_memory];
+  if(best != 0) {
+    list_insert(mmemlist, best_prev, m);
+    m->ptr = best;
+    stats.hole_bytes -= size;
+    stats.hole_fits++;
+  } else {
+    if((unsigned int)(&memory[MMEM_SIZE] - top) < size) {
+#if MMEM_COMPACT_ON_ALLOC
+      mmem_compact_step(0);
+      stats.full_compactions++;
+#else
+      stats.alloc_fails++;
+      return 0;
+#endif
+    }
+    /* Add this memory block to the end of the list of allocated
+       memory blocks. */
+    list_add(mmemlist, m);
+    m->ptr = top;
+    top += size;
+  }
 
   /* Remember the size of this memory block. */
   m->size = size;
@@ -70,32 +113,120 @@ mmem_alloc(struct mmem *m, unsigned int size)
  * \author     Adam Dunkels
  *
  *             This function deallocates a managed memory block that
- *             previously has been allocated with mmem_alloc().
+ *             previously has been allocated with mmem_alloc(). No
+ *             memory is moved, the block leaves a hole unless it was
+ *             the highest one.
  *
  */
-void *  memmove(void * dest, const void * src, unsigned int n);
 void
 mmem_free(struct mmem *m)
 {
-  struct mmem *n;
+  struct mmem *tail;
+
+  avail_memory += m->size;
 
   if(m->next != 0) {
-    /* Compact the memory after the allocation that is to be removed
-       by moving it downwards. */
-    memmove(m->ptr, m->next->ptr,
-	    &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr);
-
-    /* Update all the memory pointers that points to memory that is
-       after the allocation that is to be removed. */
-    for(n = m->next; n != 0; n = n->next) {
-      n->ptr = (void *)((char *)n->ptr - m->size);
-    }
+    stats.hole_bytes += m->size;
+    list_remove(mmemlist, m);
+    return;
   }
 
-  avail_memory += m->size;
-
-  /* Remove the memory block from the list. */
+  /* The highest block: the holes below it join the space on top. */
   list_remove(mmemlist, m);
+  tail = list_tail(mmemlist);
+  top = (tail != 0) ? (char *)tail->ptr + tail->size : memory;
+  stats.hole_bytes = avail_memory - (&memory[MMEM_SIZE] - top);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief           Move blocks down into the holes below them
+ * \param max_bytes Most bytes to move in this call, 0 for no limit
+ * \return          Number of bytes moved
+ *
+ *                  Called from the idle loop, typically with
+ *                  MMEM_COMPACT_STEP_BYTES. Only whole blocks are
+ *                  moved, a block larger than what is left of the
+ *                  budget stays in place and the blocks above it
+ *                  close the holes up to it. The time per call
+ *                  follows the bytes moved and the blocks walked,
+ *                  struct mmem_stats records the worst case.
+ *
+ */
+unsigned int
+mmem_compact_step(unsigned int max_bytes)
+{
+  struct mmem *n;
+  char *pos;
+  unsigned int moved;
+
+  moved = 0;
+  if(stats.hole_bytes == 0) {
+    return 0;
+  }
+
+  /* A moved block shifts the holes below it upwards, they only
+     join the free space on top once the highest block has moved. */
+  pos = memory;
+  for(n = list_head(mmemlist); n != 0; n = n->next) {
+    if((char *)n->ptr != pos) {
+      if(max_bytes != 0 && moved + n->size > max_bytes) {
+        /* Too large for this call, a block above may still fit. */
+        pos = (char *)n->ptr + n->size;
+        continue;
+      }
+      memmove(pos, n->ptr, n->size);
+      n->ptr = pos;
+      moved += n->size;
+      stats.moves++;
+    }
+    pos += n->size;
+    if(max_bytes != 0 && moved == max_bytes) {
+      n = n->next;
+      break;
+    }
+  }
+  if(n == 0) {
+    top = pos;
+  }
+  stats.hole_bytes = avail_memory - (&memory[MMEM_SIZE] - top);
+
+  stats.moved_bytes += moved;
+  if(moved > stats.max_step_bytes) {
+    stats.max_step_bytes = moved;
+  }
+  return moved;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief       Get the fragmentation and compaction figures
+ * \param s     Where the figures are copied to
+ *
+ *              Walks the block list for the hole count and the
+ *              largest free area.
+ *
+ */
+void
+mmem_stats(struct mmem_stats *s)
+{
+  struct mmem *n;
+  char *pos;
+  unsigned int gap;
+
+  *s = stats;
+  s->free_bytes = avail_memory;
+  s->largest_free = &memory[MMEM_SIZE] - top;
+  s->holes = 0;
+  pos = memory;
+  for(n = list_head(mmemlist); n != 0; n = n->next) {
+    gap = (char *)n->ptr - pos;
+    if(gap != 0) {
+      s->holes++;
+      if(gap > s->largest_free) {
+        s->largest_free = gap;
+      }
+    }
+    pos = (char *)n->ptr + n->size;
+  }
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -112,6 +243,8 @@ mmem_init(void)
 {
   list_init(mmemlist);
   avail_memory = MMEM_SIZE;
+  top = memory;
+  memset(&stats, 0, sizeof(stats));
 }
 /*---------------------------------------------------------------------------*/
 
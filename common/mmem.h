@@ -6,8 +6,9 @@
  * \defgroup mmem Managed memory allocator
  *
  * The managed memory allocator is a fragmentation-free memory
- * manager. It keeps the allocated memory free from fragmentation by
- * compacting the memory when blocks are freed. A program that uses
+ * manager. A freed block leaves a hole that later allocations reuse
+ * best fit, and mmem_compact_step() closes the holes a bounded
+ * number of bytes at a time from the idle loop. A program that uses
  * the managed memory module cannot be sure that allocated memory
  * stays in place. Therefore, a level of indirection is used: access
  * to allocated memory must always be done using a special macro.
@@ -47,9 +48,41 @@ struct mmem {
 /* XXX: tagga minne med "interrupt usage", vilke gr att man r
    speciellt varsam under free(). */
 
+#ifndef MMEM_SIZE
+#define MMEM_SIZE                 2048
+#endif
+
+/* Default budget in bytes for mmem_compact_step() from the idle loop. */
+#ifndef MMEM_COMPACT_STEP_BYTES
+#define MMEM_COMPACT_STEP_BYTES   256
+#endif
+
+/* Let mmem_alloc() compact the whole heap when only the holes
+   together are large enough, at the cost of an unbounded call.
+   Off by default, such an allocation fails until the idle loop
+   has closed the holes with mmem_compact_step(). */
+#ifndef MMEM_COMPACT_ON_ALLOC
+#define MMEM_COMPACT_ON_ALLOC     0
+#endif
+
+struct mmem_stats {
+  unsigned int free_bytes;       /* Free in total. */
+  unsigned int hole_bytes;       /* Free between blocks, reusable by best fit. */
+  unsigned int largest_free;     /* Largest request that fits without compaction. */
+  unsigned int holes;
+  unsigned int moves;            /* Blocks moved by compaction. */
+  unsigned int moved_bytes;
+  unsigned int max_step_bytes;   /* Worst case of one compaction call. */
+  unsigned int hole_fits;        /* Allocations served from a hole. */
+  unsigned int full_compactions; /* Unbounded compactions done by mmem_alloc(). */
+  unsigned int alloc_fails;
+};
+
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
 void mmem_init(void);
+unsigned int mmem_compact_step(unsigned int max_bytes);
+void mmem_stats(struct mmem_stats *stats);
 
 
 /** @} */
@@ -0,0 +1,151 @@
+/********************************************************************************************************
+ * @file     page_stage.c
+ *
+ * @brief    This file provides double-buffered page staging of flash writes
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#include "page_stage.h"
+#include "string.h"
+#include "../drivers/flash.h"
+
+static void page_stage_clear(page_stage_t *ps, u8 idx)
+{
+    memset(ps->buf[idx], 0xff, PAGE_STAGE_PAGE_SIZE);
+    ps->addr[idx] = PAGE_STAGE_NONE;
+    ps->lo[idx] = PAGE_STAGE_PAGE_SIZE;
+    ps->hi[idx] = 0;
+}
+
+static void page_stage_program(page_stage_t *ps, u8 idx)
+{
+    if (ps->addr[idx] != PAGE_STAGE_NONE) {
+        flash_write_page(ps->addr[idx] + ps->lo[idx], ps->hi[idx] - ps->lo[idx], &ps->buf[idx][ps->lo[idx]]);
+    }
+    page_stage_clear(ps, idx);
+}
+
+/* the active page is complete or left behind, it is programmed by the next flush */
+static void page_stage_retire(page_stage_t *ps)
+{
+    if (ps->pending) {
+        //no idle gap came since the last page, program it right away
+        page_stage_program(ps, ps->active ^ 1);
+    }
+    ps->pending = 1;
+    ps->active ^= 1;
+}
+
+void page_stage_init(page_stage_t *ps)
+{
+    page_stage_clear(ps, 0);
+    page_stage_clear(ps, 1);
+    ps->active = 0;
+    ps->pending = 0;
+}
+
+/* the area has to be erased already, the data goes to flash with a later flush */
+void page_stage_write(page_stage_t *ps, u32 addr, const u8 *data, u32 len)
+{
+    u32 page, off, n;
+    u8 idx;
+
+    while (len) {
+        page = addr & ~(PAGE_STAGE_PAGE_SIZE - 1);
+        off = addr - page;
+        n = PAGE_STAGE_PAGE_SIZE - off;
+        if (n > len) {
+            n = len;
+        }
+        idx = ps->active;
+        if (ps->pending && (ps->addr[idx ^ 1] == page)) {
+            //a late write to the page waiting for its flush
+            idx ^= 1;
+        }
+        else if (ps->addr[idx] != page) {
+            if (ps->addr[idx] != PAGE_STAGE_NONE) {
+                page_stage_retire(ps);
+                idx = ps->active;
+            }
+            ps->addr[idx] = page;
+        }
+        memcpy(&ps->buf[idx][off], data, n);
+        if (off < ps->lo[idx]) {
+            ps->lo[idx] = off;
+        }
+        if (off + n > ps->hi[idx]) {
+            ps->hi[idx] = off + n;
+        }
+        if ((idx == ps->active) && (off + n == PAGE_STAGE_PAGE_SIZE)) {
+            page_stage_retire(ps);
+        }
+        addr += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/* program the page waiting for an idle gap, returns 1 when there was one */
+int page_stage_flush_pending(page_stage_t *ps)
+{
+    if (!ps->pending) {
+        return 0;
+    }
+    page_stage_program(ps, ps->active ^ 1);
+    ps->pending = 0;
+    return 1;
+}
+
+/* everything written so far becomes durable */
+void page_stage_flush(page_stage_t *ps)
+{
+    page_stage_flush_pending(ps);
+    page_stage_program(ps, ps->active);
+}
+
+/* read as the flash reads once everything is flushed, programming only clears bits */
+void page_stage_read(page_stage_t *ps, u32 addr, u8 *buf, u32 len)
+{
+    u32 i;
+    u8 idx;
+
+    flash_read_page(addr, len, buf);
+    for (idx = 0; idx < 2; idx++) {
+        if (ps->addr[idx] == PAGE_STAGE_NONE) {
+            continue;
+        }
+        for (i = 0; i < len; i++) {
+            if ((addr + i >= ps->addr[idx]) && (addr + i < ps->addr[idx] + PAGE_STAGE_PAGE_SIZE)) {
+                buf[i] &= ps->buf[idx][addr + i - ps->addr[idx]];
+            }
+        }
+    }
+}
+
+/* lowest address not durable yet, PAGE_STAGE_NONE when everything is in flash */
+u32 page_stage_low_addr(page_stage_t *ps)
+{
+    u32 low = PAGE_STAGE_NONE;
+    u8 idx;
+
+    for (idx = 0; idx < 2; idx++) {
+        if ((ps->addr[idx] != PAGE_STAGE_NONE) && (ps->addr[idx] + ps->lo[idx] < low)) {
+            low = ps->addr[idx] + ps->lo[idx];
+        }
+    }
+    return low;
+}
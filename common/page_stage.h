@@ -0,0 +1,51 @@
+/********************************************************************************************************
+ * @file     page_stage.h
+ *
+ * @brief    This file provides double-buffered page staging of flash writes
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _PAGE_STAGE_H_
+#define _PAGE_STAGE_H_
+
+#include "types.h"
+
+#define PAGE_STAGE_PAGE_SIZE        256
+#define PAGE_STAGE_NONE             0xffffffff
+
+/*
+ * writes are collected into a flash page while the page before waits to be
+ * programmed in the next idle gap, unwritten bytes are kept 0xff so a page
+ * can be programmed again with more data, as long as the area is erased
+ */
+typedef struct {
+    u8 buf[2][PAGE_STAGE_PAGE_SIZE];
+    u32 addr[2];    //page held by a buffer, PAGE_STAGE_NONE when empty
+    u16 lo[2];      //written span of a buffer
+    u16 hi[2];
+    u8 active;      //buffer collecting the writes
+    u8 pending;     //the other buffer holds a page waiting to be programmed
+} page_stage_t;
+
+void page_stage_init(page_stage_t *ps);
+void page_stage_write(page_stage_t *ps, u32 addr, const u8 *data, u32 len);
+int page_stage_flush_pending(page_stage_t *ps);
+void page_stage_flush(page_stage_t *ps);
+void page_stage_read(page_stage_t *ps, u32 addr, u8 *buf, u32 len);
+u32 page_stage_low_addr(page_stage_t *ps);
+
+#endif /* _PAGE_STAGE_H_ */
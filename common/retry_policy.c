@@ -0,0 +1,86 @@
+/********************************************************************************************************
+ * @file     retry_policy.c
+ *
+ * @brief    This file provides the adaptive response timeout and retry budget of the update protocols
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#include "retry_policy.h"
+
+void retry_policy_init(retry_policy_t *rp, u32 rto_init, u32 rto_min, u32 rto_max, u16 budget, u8 backoff_max)
+{
+    rp->srtt = 0;
+    rp->rttvar = 0;
+    rp->rto = rto_init;
+    rp->rto_min = rto_min;
+    rp->rto_max = rto_max;
+    rp->budget = budget;
+    rp->backoff = 0;
+    rp->backoff_max = backoff_max;
+}
+
+/* how long to wait for the response of the frame about to be sent */
+u32 retry_policy_timeout(const retry_policy_t *rp)
+{
+    u32 t = rp->rto;
+    u8 i;
+
+    for (i = 0; (i < rp->backoff) && (t < rp->rto_max); i++) {
+        t <<= 1;
+    }
+    return (t > rp->rto_max) ? rp->rto_max : t;
+}
+
+/*
+ * the response arrived after rtt_us, 0 when unknown, a retried exchange is not
+ * sampled as the response may belong to any of its transmissions (Karn)
+ */
+void retry_policy_success(retry_policy_t *rp, u32 rtt_us)
+{
+    u32 err;
+
+    if (rtt_us && !rp->backoff) {
+        if (0 == rp->srtt) {
+            rp->srtt = rtt_us;
+            rp->rttvar = rtt_us >> 1;
+        }
+        else {
+            err = (rp->srtt > rtt_us) ? (rp->srtt - rtt_us) : (rtt_us - rp->srtt);
+            rp->rttvar = rp->rttvar - (rp->rttvar >> 2) + (err >> 2);
+            rp->srtt = rp->srtt - (rp->srtt >> 3) + (rtt_us >> 3);
+        }
+        rp->rto = rp->srtt + (rp->rttvar << 2);
+        if (rp->rto < rp->rto_min) {
+            rp->rto = rp->rto_min;
+        }
+        if (rp->rto > rp->rto_max) {
+            rp->rto = rp->rto_max;
+        }
+    }
+    rp->backoff = 0;
+}
+
+/* the response is missing or corrupted, returns 1 when the exchange may be retried */
+int retry_policy_failure(retry_policy_t *rp)
+{
+    if ((0 == rp->budget) || (rp->backoff >= rp->backoff_max)) {
+        return 0;
+    }
+    rp->budget--;
+    rp->backoff++;
+    return 1;
+}
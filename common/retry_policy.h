@@ -0,0 +1,48 @@
+/********************************************************************************************************
+ * @file     retry_policy.h
+ *
+ * @brief    This file provides the adaptive response timeout and retry budget of the update protocols
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _RETRY_POLICY_H_
+#define _RETRY_POLICY_H_
+
+#include "types.h"
+
+/*
+ * response timeout from the smoothed round trip time and its deviation (RFC 6298),
+ * doubled with every consecutive failure, failures of the whole session are paid
+ * from one budget so a burst of interference does not end it on its own
+ */
+typedef struct {
+    u32 srtt;           //smoothed round trip time in us, 0 until the first sample
+    u32 rttvar;         //mean deviation of the round trip time in us
+    u32 rto;            //timeout before backoff in us
+    u32 rto_min;
+    u32 rto_max;
+    u16 budget;         //failures the session may still take
+    u8 backoff;         //consecutive failures of the current exchange
+    u8 backoff_max;     //consecutive failures that end the session anyway
+} retry_policy_t;
+
+void retry_policy_init(retry_policy_t *rp, u32 rto_init, u32 rto_min, u32 rto_max, u16 budget, u8 backoff_max);
+u32 retry_policy_timeout(const retry_policy_t *rp);
+void retry_policy_success(retry_policy_t *rp, u32 rtt_us);
+int retry_policy_failure(retry_policy_t *rp);
+
+#endif /* _RETRY_POLICY_H_ */
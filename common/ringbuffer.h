@@ -33,7 +33,8 @@
 
 /* Includes: */
 #include "types.h"
-#include "../mcu/irq_i.h"
+#include "string.h"
+#include "../drivers/irq.h"
 
 /* Enable C linkage for C++ Compilers: */
 #if defined(__cplusplus)
@@ -208,6 +209,225 @@ static inline u8 ringbuffer_peek(ringbuffer_t* const buffer)
 	return *buffer->out;
 }
 
+/** \brief Lock-free single-producer/single-consumer ring buffer.
+ *
+ *  One execution thread writes and one reads, e.g. a UART ISR and the main loop, without any IRQ masking:
+ *  the writer only stores \c in and the reader only stores \c out. Both indices run freely and wrap at
+ *  2^32, their difference is the number of bytes stored, so the size has to be a power of two.
+ *  buffers should be initialized via a call to \ref ringbuffer_spsc_init() before use.
+ */
+typedef struct
+{
+	u8* buf; /**< Pointer to the buffer's underlying storage array. */
+	u32 size; /**< size of the storage array, a power of two. */
+	u32 mask; /**< size - 1. */
+	volatile u32 in; /**< Bytes written so far, only the writer stores it. */
+	volatile u32 out; /**< Bytes read so far, only the reader stores it. */
+} ringbuffer_spsc_t;
+
+/** Keeps the compiler from moving buffer accesses across an index access, a single core needs no more. */
+#define RINGBUFFER_BARRIER()	__asm__ __volatile__("" ::: "memory")
+
+/** Initializes an SPSC ring buffer ready for use, neither side may use it meanwhile.
+ *
+ *  \param[out] buffer   Pointer to a ring buffer structure to initialize.
+ *  \param[out] dataptr  Pointer to a global array that will hold the data stored into the ring buffer.
+ *  \param[in]  size     size of the array, a power of two.
+ *
+ *  \return Boolean \c false if the size is no power of two.
+ */
+static inline bool ringbuffer_spsc_init(ringbuffer_spsc_t* buffer, u8* const dataptr, const u32 size)
+{
+	if ((0 == size) || (size & (size - 1)))
+	  return false;
+
+	buffer->buf  = dataptr;
+	buffer->size = size;
+	buffer->mask = size - 1;
+	buffer->in   = 0;
+	buffer->out  = 0;
+
+	return true;
+}
+
+/** Retrieves the number of bytes stored. It is exact for the reader and the minimum for anyone else.
+ *
+ *  \param[in] buffer  Pointer to a ring buffer structure whose count is to be computed.
+ *
+ *  \return Number of bytes currently stored in the buffer.
+ */
+static inline u32 ringbuffer_spsc_get_count(ringbuffer_spsc_t* const buffer)
+{
+	return buffer->in - buffer->out;
+}
+
+/** Retrieves the free space. It is exact for the writer and the minimum for anyone else.
+ *
+ *  \param[in] buffer  Pointer to a ring buffer structure whose free count is to be computed.
+ *
+ *  \return Number of free bytes in the buffer.
+ */
+static inline u32 ringbuffer_spsc_get_free_count(ringbuffer_spsc_t* const buffer)
+{
+	return buffer->size - (buffer->in - buffer->out);
+}
+
+/** Gives the writer the contiguous free space at the write position, e.g. for a DMA to fill.
+ *  The data becomes visible to the reader with \ref ringbuffer_spsc_commit().
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to insert into.
+ *  \param[out]    ptr     Where the span starts.
+ *
+ *  \return Length of the span, it ends at the end of the storage array or at the free space.
+ */
+static inline u32 ringbuffer_spsc_write_span(ringbuffer_spsc_t* buffer, u8** ptr)
+{
+	u32 in    = buffer->in;
+	u32 space = buffer->size - (in - buffer->out);
+	u32 span  = buffer->size - (in & buffer->mask);
+
+	RINGBUFFER_BARRIER();
+	*ptr = &buffer->buf[in & buffer->mask];
+	return (space < span) ? space : span;
+}
+
+/** Hands bytes placed through \ref ringbuffer_spsc_write_span() over to the reader.
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to insert into.
+ *  \param[in]     len     Number of bytes written, at most the span length.
+ */
+static inline void ringbuffer_spsc_commit(ringbuffer_spsc_t* buffer, const u32 len)
+{
+	RINGBUFFER_BARRIER();
+	buffer->in += len;
+}
+
+/** Gives the reader the contiguous data at the read position, e.g. for a DMA to send.
+ *  The space is given back with \ref ringbuffer_spsc_consume().
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to retrieve from.
+ *  \param[out]    ptr     Where the span starts.
+ *
+ *  \return Length of the span, it ends at the end of the storage array or at the data stored.
+ */
+static inline u32 ringbuffer_spsc_read_span(ringbuffer_spsc_t* buffer, u8** ptr)
+{
+	u32 out   = buffer->out;
+	u32 count = buffer->in - out;
+	u32 span  = buffer->size - (out & buffer->mask);
+
+	RINGBUFFER_BARRIER();
+	*ptr = &buffer->buf[out & buffer->mask];
+	return (count < span) ? count : span;
+}
+
+/** Gives space read through \ref ringbuffer_spsc_read_span() back to the writer.
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to retrieve from.
+ *  \param[in]     len     Number of bytes read, at most the span length.
+ */
+static inline void ringbuffer_spsc_consume(ringbuffer_spsc_t* buffer, const u32 len)
+{
+	RINGBUFFER_BARRIER();
+	buffer->out += len;
+}
+
+/** Inserts as many bytes as fit, in at most two copies.
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to insert into.
+ *  \param[in]     data    Bytes to insert.
+ *  \param[in]     len     Number of bytes to insert.
+ *
+ *  \return Number of bytes inserted.
+ */
+static inline u32 ringbuffer_spsc_write(ringbuffer_spsc_t* buffer, const u8* data, u32 len)
+{
+	u32 in    = buffer->in;
+	u32 space = buffer->size - (in - buffer->out);
+	u32 idx   = in & buffer->mask;
+	u32 first = buffer->size - idx;
+
+	if (len > space)
+	  len = space;
+	if (first > len)
+	  first = len;
+
+	RINGBUFFER_BARRIER();
+	memcpy(&buffer->buf[idx], data, first);
+	memcpy(buffer->buf, data + first, len - first);
+	RINGBUFFER_BARRIER();
+
+	buffer->in = in + len;
+	return len;
+}
+
+/** Removes as many bytes as are stored, up to len, in at most two copies.
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to retrieve from.
+ *  \param[out]    data    Where the bytes go.
+ *  \param[in]     len     Maximum number of bytes to remove.
+ *
+ *  \return Number of bytes removed.
+ */
+static inline u32 ringbuffer_spsc_read(ringbuffer_spsc_t* buffer, u8* data, u32 len)
+{
+	u32 out   = buffer->out;
+	u32 count = buffer->in - out;
+	u32 idx   = out & buffer->mask;
+	u32 first = buffer->size - idx;
+
+	if (len > count)
+	  len = count;
+	if (first > len)
+	  first = len;
+
+	RINGBUFFER_BARRIER();
+	memcpy(data, &buffer->buf[idx], first);
+	memcpy(data + first, buffer->buf, len - first);
+	RINGBUFFER_BARRIER();
+
+	buffer->out = out + len;
+	return len;
+}
+
+/** Inserts one byte, a full buffer drops it.
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to insert into.
+ *  \param[in]     Data    Data element to insert into the buffer.
+ *
+ *  \return Boolean \c false if the buffer was full.
+ */
+static inline bool ringbuffer_spsc_insert(ringbuffer_spsc_t* buffer, const u8 Data)
+{
+	u32 in = buffer->in;
+
+	if (in - buffer->out == buffer->size)
+	  return false;
+
+	buffer->buf[in & buffer->mask] = Data;
+	RINGBUFFER_BARRIER();
+	buffer->in = in + 1;
+	return true;
+}
+
+/** Removes one byte, to be called only when \ref ringbuffer_spsc_get_count() is not 0.
+ *
+ *  \param[in,out] buffer  Pointer to a ring buffer structure to retrieve from.
+ *
+ *  \return Next data element stored in the buffer.
+ */
+static inline u8 ringbuffer_spsc_remove(ringbuffer_spsc_t* buffer)
+{
+	u32 out = buffer->out;
+	u8 Data;
+
+	RINGBUFFER_BARRIER();
+	Data = buffer->buf[out & buffer->mask];
+	RINGBUFFER_BARRIER();
+	buffer->out = out + 1;
+	return Data;
+}
+
 /* Disable C linkage for C++ Compilers: */
 #if defined(__cplusplus)
 }
@@ -0,0 +1,360 @@
+/********************************************************************************************************
+ * @file     slot.c
+ *
+ * @brief    This file provides A/B image slots with boot attempt rollback
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#include "slot.h"
+#include "string.h"
+#include "utility.h"
+#include "../drivers/flash.h"
+#include "../drivers/lib/include/pm.h"
+
+#define SLOT_SECTOR_SIZE            0x1000
+#define SLOT_PAGE_SIZE              256
+#define SLOT_RECORD_NUM             (SLOT_SECTOR_SIZE / sizeof(slot_record_t))
+#define SLOT_RECORD_ADDR(idx)       (SLOT_META_ADDR + (idx) * sizeof(slot_record_t))
+
+static const u8 slot_flag[4] = {0x4b, 0x4e, 0x4c, 0x54};
+static const u8 slot_flag_erased[4] = {0xff, 0xff, 0xff, 0xff};
+static u8 slot_page[SLOT_PAGE_SIZE];
+
+static u32 slot_other(u32 addr)
+{
+    return (SLOT_A_ADDR == addr) ? SLOT_B_ADDR : SLOT_A_ADDR;
+}
+
+/*
+ * a state write cut short by a power loss leaves some of its bits cleared: only the way to
+ * SLOT_STATE_BAD clears the low half, so any of those makes the image bad, the rest of the
+ * torn values can only come from a confirmation
+ */
+static u32 slot_state(u32 state)
+{
+    if (SLOT_STATE_TRIAL == state) {
+        return SLOT_STATE_TRIAL;
+    }
+    return ((state & 0xffff) != 0xffff) ? SLOT_STATE_BAD : SLOT_STATE_CONFIRMED;
+}
+
+/* latest record of the slot at addr, -1 if there is none; *free_idx gets where the next record goes */
+static int slot_find(slot_record_t *rec, u32 addr, u32 *free_idx)
+{
+    slot_record_t r;
+    int found = -1;
+    u32 i;
+
+    for (i = 0; i < SLOT_RECORD_NUM; i++) {
+        flash_read_page(SLOT_RECORD_ADDR(i), sizeof(r), (u8 *)&r);
+        //a record cut short by a power loss keeps its place, it has no magic
+        if (0xffffffff == r.addr) {
+            break;
+        }
+        if ((SLOT_RECORD_MAGIC == r.magic) && (addr == r.addr)) {
+            *rec = r;
+            rec->state = slot_state(r.state);
+            found = i;
+        }
+    }
+    if (free_idx) {
+        *free_idx = i;
+    }
+    return found;
+}
+
+static void slot_update(int idx, u32 offset, u32 value)
+{
+    flash_write_page(SLOT_RECORD_ADDR(idx) + offset, 4, (u8 *)&value);
+}
+
+static int slot_append(slot_record_t *rec)
+{
+    slot_record_t keep[2];
+    int keep_idx[2];
+    u32 free_idx;
+    int i;
+
+    slot_find(&keep[0], rec->addr, &free_idx);
+    if (free_idx >= SLOT_RECORD_NUM) {
+        //the sector is full, only the latest record of each slot is carried over,
+        //a power loss right here leaves both slots without records, as before the first switch
+        keep_idx[0] = slot_find(&keep[0], SLOT_A_ADDR, 0);
+        keep_idx[1] = slot_find(&keep[1], SLOT_B_ADDR, 0);
+        flash_erase_sector(SLOT_META_ADDR);
+        free_idx = 0;
+        for (i = 0; i < 2; i++) {
+            if ((keep_idx[i] >= 0) && (keep[i].addr != rec->addr)) {
+                flash_write_page(SLOT_RECORD_ADDR(free_idx) + 4, sizeof(slot_record_t) - 4, (u8 *)&keep[i] + 4);
+                flash_write_page(SLOT_RECORD_ADDR(free_idx), 4, (u8 *)&keep[i].magic);
+                free_idx++;
+            }
+        }
+    }
+    rec->magic = SLOT_RECORD_MAGIC;
+    flash_write_page(SLOT_RECORD_ADDR(free_idx) + 4, sizeof(slot_record_t) - 4, (u8 *)rec + 4);
+    flash_write_page(SLOT_RECORD_ADDR(free_idx), 4, (u8 *)&rec->magic);
+    return free_idx;
+}
+
+static int slot_flag_is(u32 addr, const u8 *flag)
+{
+    u8 buf[4];
+
+    flash_read_page(addr + SLOT_FLAG_OFFSET, 4, buf);
+    return (0 == memcmp(buf, flag, 4));
+}
+
+static int slot_flag_valid(u32 addr)
+{
+    return slot_flag_is(addr, slot_flag);
+}
+
+/* a cleared flag still reads "?NLT", an image that never completed has its flag bytes erased */
+static int slot_has_image(u32 addr)
+{
+    u8 buf[4];
+
+    flash_read_page(addr + SLOT_FLAG_OFFSET, 4, buf);
+    return (0 == memcmp(&buf[1], &slot_flag[1], 3));
+}
+
+static void slot_clear_flag(u32 addr)
+{
+    u8 tmp = 0x00;
+
+    flash_write_page(addr + SLOT_FLAG_OFFSET, 1, &tmp);
+}
+
+/*
+ * a cleared flag can only be set again by erasing the first sector of the slot,
+ * its content waits in the scratch sector meanwhile, the record of the image
+ * rolled back from tracks the copy so an interrupted restore is redone from it
+ */
+static void slot_restore_flag(u32 addr, int idx, slot_record_t *rec)
+{
+    u32 i;
+
+    if (SLOT_PROGRESS_NONE == rec->progress) {
+        flash_erase_sector(SLOT_SCRATCH_ADDR);
+        for (i = 0; i < SLOT_SECTOR_SIZE; i += SLOT_PAGE_SIZE) {
+            flash_read_page(addr + i, SLOT_PAGE_SIZE, slot_page);
+            flash_write_page(SLOT_SCRATCH_ADDR + i, SLOT_PAGE_SIZE, slot_page);
+        }
+        rec->progress = SLOT_PROGRESS_COPIED;
+        slot_update(idx, OFFSETOF(slot_record_t, progress), rec->progress);
+    }
+    flash_erase_sector(addr);
+    for (i = 0; i < SLOT_SECTOR_SIZE; i += SLOT_PAGE_SIZE) {
+        flash_read_page(SLOT_SCRATCH_ADDR + i, SLOT_PAGE_SIZE, slot_page);
+        if (0 == i) {
+            memcpy(&slot_page[SLOT_FLAG_OFFSET], slot_flag_erased, sizeof(slot_flag_erased));
+        }
+        flash_write_page(addr + i, SLOT_PAGE_SIZE, slot_page);
+    }
+    //the flag goes last, a page cut short after it would boot a sector restored in part
+    flash_write_page(addr + SLOT_FLAG_OFFSET, sizeof(slot_flag), (u8 *)slot_flag);
+}
+
+/* the previous slot gets its flag back before the one of the failed image is cleared */
+static void slot_rollback(u32 addr, int idx, slot_record_t *rec)
+{
+    u32 prev = slot_other(addr);
+
+    if (!slot_flag_valid(prev)) {
+        slot_restore_flag(prev, idx, rec);
+    }
+    slot_clear_flag(addr);
+    start_reboot();
+    while (1);
+}
+
+int slot_load(slot_record_t *rec, u32 addr)
+{
+    return (slot_find(rec, addr, 0) >= 0);
+}
+
+/* only one slot keeps a valid flag once slot_boot() returned */
+u32 slot_running(void)
+{
+    return slot_flag_valid(SLOT_A_ADDR) ? SLOT_A_ADDR : SLOT_B_ADDR;
+}
+
+/*
+ * to be called once the new image in the slot at addr is complete and verified,
+ * it boots on trial from the next reboot on
+ */
+void slot_switch(u32 addr, u16 version, u16 crc, u32 size)
+{
+    slot_record_t rec;
+
+    memset(&rec, 0xff, sizeof(rec));
+    rec.addr = addr;
+    rec.size = size;
+    rec.version = version;
+    rec.crc = crc;
+    slot_append(&rec);
+
+    //for a moment both flags are valid, slot_boot() sorts that out by the records
+    if (!slot_flag_valid(addr)) {
+        flash_write_page(addr + SLOT_FLAG_OFFSET, sizeof(slot_flag), (u8 *)slot_flag);
+    }
+    slot_clear_flag(slot_other(addr));
+}
+
+/*
+ * to be called early after every boot, finishes a switch or rollback a power loss
+ * cut short and counts the boots of an image on trial, an image that used up
+ * SLOT_BOOT_ATTEMPTS_MAX of them without slot_confirm() is rolled back from,
+ * both reboot right away, otherwise the running slot is returned
+ */
+u32 slot_boot(void)
+{
+    slot_record_t rec[2];
+    int idx[2];
+    u32 addr[2] = {SLOT_A_ADDR, SLOT_B_ADDR};
+    u32 running, attempts, bits;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        idx[i] = slot_find(&rec[i], addr[i], 0);
+        if (idx[i] < 0) {
+            //an image without a record counts as confirmed
+            rec[i].state = SLOT_STATE_CONFIRMED;
+        }
+    }
+
+    //a switch to a slot on trial stopped before or between its flag writes
+    for (i = 0; i < 2; i++) {
+        if ((SLOT_STATE_TRIAL == rec[i].state) && slot_flag_valid(addr[i ^ 1])) {
+            if (slot_flag_is(addr[i], slot_flag_erased)) {
+                flash_write_page(addr[i] + SLOT_FLAG_OFFSET, sizeof(slot_flag), (u8 *)slot_flag);
+            }
+            if (slot_flag_valid(addr[i])) {
+                slot_clear_flag(addr[i ^ 1]);
+                start_reboot();
+                while (1);
+            }
+        }
+    }
+
+    //a rollback stopped between restoring the previous flag and clearing the failed one
+    for (i = 0; i < 2; i++) {
+        if ((SLOT_STATE_BAD == rec[i].state) && slot_flag_valid(addr[i]) && slot_flag_valid(addr[i ^ 1])) {
+            slot_clear_flag(addr[i]);
+            start_reboot();
+            while (1);
+        }
+    }
+
+    running = slot_running();
+    i = (SLOT_A_ADDR == running) ? 0 : 1;
+    if (idx[i] < 0) {
+        return running;
+    }
+    //a rollback stopped before the flag of the failed image was cleared
+    if (SLOT_STATE_BAD == rec[i].state) {
+        slot_rollback(running, idx[i], &rec[i]);
+    }
+    if (SLOT_STATE_TRIAL == rec[i].state) {
+        for (attempts = 0, bits = ~rec[i].attempts; bits; bits &= bits - 1) {
+            attempts++;
+        }
+        if (attempts < SLOT_BOOT_ATTEMPTS_MAX) {
+            slot_update(idx[i], OFFSETOF(slot_record_t, attempts), rec[i].attempts << 1);
+        }
+        else if (slot_has_image(addr[i ^ 1]) && (SLOT_STATE_BAD != rec[i ^ 1].state)) {
+            rec[i].state = SLOT_STATE_BAD;
+            slot_update(idx[i], OFFSETOF(slot_record_t, state), rec[i].state);
+            slot_rollback(running, idx[i], &rec[i]);
+        }
+        //with nothing to roll back to, the image keeps running on trial
+    }
+    return running;
+}
+
+/* the running image declares itself good, it is not rolled back from any more */
+void slot_confirm(void)
+{
+    slot_record_t rec;
+    int idx = slot_find(&rec, slot_running(), 0);
+
+    if ((idx >= 0) && (SLOT_STATE_TRIAL == rec.state)) {
+        slot_update(idx, OFFSETOF(slot_record_t, state), SLOT_STATE_CONFIRMED);
+    }
+}
+
+/*
+ * the running image failed a check, the other slot is booted again if it holds an image
+ * that was not rejected itself, with none to go to it returns and the image keeps running
+ */
+void slot_reject(void)
+{
+    slot_record_t rec, other;
+    u32 running = slot_running();
+    int idx = slot_find(&rec, running, 0);
+
+    if (!slot_has_image(slot_other(running)) ||
+        (slot_load(&other, slot_other(running)) && (SLOT_STATE_BAD == other.state))) {
+        return;
+    }
+    if (idx < 0) {
+        memset(&rec, 0xff, sizeof(rec));
+        rec.addr = running;
+        rec.version = SLOT_VERSION_UNKNOWN;
+        rec.state = SLOT_STATE_BAD;
+        idx = slot_append(&rec);
+    }
+    else {
+        rec.state = SLOT_STATE_BAD;
+        slot_update(idx, OFFSETOF(slot_record_t, state), rec.state);
+    }
+    slot_rollback(running, idx, &rec);
+}
+
+/* the image of that size and CRC in the slot at addr passed a full check before */
+int slot_verified(u32 addr, u32 size, u16 crc)
+{
+    slot_record_t rec;
+
+    return slot_load(&rec, addr) && (SLOT_VERIFIED_OK == rec.verified) && (size == rec.size) && (crc == rec.crc);
+}
+
+/*
+ * notes the full check the image passed, in its record if that describes the same image,
+ * otherwise in a new one, the factory image gets a confirmed record this way
+ */
+void slot_set_verified(u32 addr, u32 size, u16 crc)
+{
+    slot_record_t rec;
+    int idx = slot_find(&rec, addr, 0);
+
+    if ((idx >= 0) && (size == rec.size) && (crc == rec.crc)) {
+        slot_update(idx, OFFSETOF(slot_record_t, verified), SLOT_VERIFIED_OK);
+        return;
+    }
+    if (idx < 0) {
+        memset(&rec, 0xff, sizeof(rec));
+        rec.addr = addr;
+        rec.version = SLOT_VERSION_UNKNOWN;
+        rec.state = SLOT_STATE_CONFIRMED;
+    }
+    rec.size = size;
+    rec.crc = crc;
+    rec.verified = SLOT_VERIFIED_OK;
+    slot_append(&rec);
+}
@@ -0,0 +1,81 @@
+/********************************************************************************************************
+ * @file     slot.h
+ *
+ * @brief    This file provides A/B image slots with boot attempt rollback
+ *
+ * @author   2.4G Group
+ * @date     2019
+ *
+ * @par      Copyright (c) 2016, Telink Semiconductor (Shanghai) Co., Ltd.
+ *           All rights reserved.
+ *
+ *           The information contained herein is confidential property of Telink
+ *           Semiconductor (Shanghai) Co., Ltd. and is available under the terms
+ *           of Commercial License Agreement between Telink Semiconductor (Shanghai)
+ *           Co., Ltd. and the licensee or the terms described here-in. This heading
+ *           MUST NOT be removed from this file.
+ *
+ *           Licensees are granted free, non-transferable use of the information in this
+ *           file under Mutual Non-Disclosure Agreement. NO WARRENTY of ANY KIND is provided.
+ *
+ *******************************************************************************************************/
+#ifndef _SLOT_H_
+#define _SLOT_H_
+
+#include "types.h"
+
+#define SLOT_A_ADDR                 0x00000
+#ifndef SLOT_B_ADDR
+#define SLOT_B_ADDR                 0x20000 //has to be the area OTA/FW_UPDATE receive into while slot A runs
+#endif
+#ifndef SLOT_META_ADDR
+#define SLOT_META_ADDR              0x7b000 //one reserved sector holding the slot records
+#endif
+#ifndef SLOT_SCRATCH_ADDR
+#define SLOT_SCRATCH_ADDR           0x7a000 //one reserved sector, keeps the first sector of a slot while its boot flag is restored
+#endif
+#ifndef SLOT_BOOT_ATTEMPTS_MAX
+#define SLOT_BOOT_ATTEMPTS_MAX      3 //boots a new image gets to confirm itself before the previous slot is booted again
+#endif
+#define SLOT_FLAG_OFFSET            8
+#define SLOT_RECORD_MAGIC           0x544f4c53
+#define SLOT_VERSION_UNKNOWN        0xffff
+
+//states only move on by clearing bits, a record is updated in place
+#define SLOT_STATE_TRIAL            0xffffffff
+#define SLOT_STATE_CONFIRMED        0x0000ffff
+#define SLOT_STATE_BAD              0x00000000
+
+#define SLOT_PROGRESS_NONE          0xffffffff
+#define SLOT_PROGRESS_COPIED        0x00000000 //the scratch sector holds the first sector of the slot rolled back to
+
+#define SLOT_VERIFIED_NONE          0xffffffff
+#define SLOT_VERIFIED_OK            0x00000000 //the image passed a full check against its CRC, see image_check.h
+
+/*
+ * the latest record of a slot describes the image in it, slot_switch() appends one
+ * for every new image before its boot flag is set, so an image without a record
+ * (the factory one) is taken as confirmed
+ */
+typedef struct {
+    u32 magic;      //written last, a record without it is ignored
+    u32 addr;       //slot the record belongs to
+    u32 size;
+    u16 version;    //SLOT_VERSION_UNKNOWN when the transfer does not carry it
+    u16 crc;
+    u32 state;      //SLOT_STATE_*
+    u32 attempts;   //a bit is cleared on every boot while the image is on trial
+    u32 progress;   //rollback progress, SLOT_PROGRESS_*
+    u32 verified;   //SLOT_VERIFIED_*, a new image starts unverified
+} slot_record_t;
+
+int slot_load(slot_record_t *rec, u32 addr);
+u32 slot_running(void);
+void slot_switch(u32 addr, u16 version, u16 crc, u32 size);
+u32 slot_boot(void);
+void slot_confirm(void);
+void slot_reject(void);
+int slot_verified(u32 addr, u32 size, u16 crc);
+void slot_set_verified(u32 addr, u32 size, u16 crc);
+
+#endif /* _SLOT_H_ */
@@ -22,14 +22,74 @@
 #include "timer_event.h"
 #include "common.h"
 
-ev_time_event_t timer_list[10];
+#define TIMER_HEAP_NIL          0xffff
+#define TIMER_BEFORE(a, b)      ((int)((u32)(a) - (u32)(b)) < 0)
 
-static int inline ev_is_timer_expired(ev_time_event_t *e, u32 now)
+/*
+ * pending timers form a binary min-heap on their deadline, so the next deadline is at the root,
+ * start and cancel are O(log n) and ev_process_timer() only looks at timers that expired,
+ * the state is retained so timers survive the deep retention sleeps of idle.c
+ */
+_attribute_data_retention_ ev_time_event_t timer_list[TIMER_EVENT_NUM];
+_attribute_data_retention_ static ev_time_event_t *timer_heap[TIMER_EVENT_NUM];
+_attribute_data_retention_ static u16 timer_heap_cnt;
+_attribute_data_retention_ static ev_time_event_t *timer_free[TIMER_EVENT_NUM]; //cancelled slots, then the never used ones from timer_fresh on
+_attribute_data_retention_ static u16 timer_free_cnt;
+_attribute_data_retention_ static u16 timer_fresh;
+static ev_time_event_t *timer_running; //its callback may cancel it or even reuse the slot
+static u8 timer_running_cancelled;
+_attribute_data_retention_ static u32 timer_overflow_cnt;
+
+__attribute__((section(".ram_code")))static void ev_heap_place(ev_time_event_t *e, u16 i)
 {
-    assert(e);
-    return ((u32)(now - e->t) < (TIMER_SAFE_MARGIN_US*sys_tick_per_us));
+    timer_heap[i] = e;
+    e->heap_idx = i;
 }
 
+__attribute__((section(".ram_code")))static void ev_heap_sift(ev_time_event_t *e, u16 i)
+{
+    u16 child;
+
+    while (i > 0 && TIMER_BEFORE(e->t, timer_heap[(i - 1) / 2]->t)) {
+        ev_heap_place(timer_heap[(i - 1) / 2], i);
+        i = (i - 1) / 2;
+    }
+    while ((child = 2 * i + 1) < timer_heap_cnt) {
+        if (child + 1 < timer_heap_cnt && TIMER_BEFORE(timer_heap[child + 1]->t, timer_heap[child]->t)) {
+            child++;
+        }
+        if (!TIMER_BEFORE(timer_heap[child]->t, e->t)) {
+            break;
+        }
+        ev_heap_place(timer_heap[child], i);
+        i = child;
+    }
+    ev_heap_place(e, i);
+}
+
+__attribute__((section(".ram_code")))static void ev_heap_insert(ev_time_event_t *e)
+{
+    ev_heap_sift(e, timer_heap_cnt++);
+}
+
+__attribute__((section(".ram_code")))static void ev_heap_remove(ev_time_event_t *e)
+{
+    u16 i = e->heap_idx;
+
+    e->heap_idx = TIMER_HEAP_NIL;
+    if (i != --timer_heap_cnt) {
+        ev_heap_sift(timer_heap[timer_heap_cnt], i);
+    }
+}
+
+__attribute__((section(".ram_code")))static void ev_release_timer(ev_time_event_t *e)
+{
+    e->valid = 0;
+    if (e->busy) {
+        e->busy = 0;
+        timer_free[timer_free_cnt++] = e;
+    }
+}
 
 __attribute__((section(".ram_code")))void ev_start_timer(ev_time_event_t * e)
 {  
@@ -38,10 +98,16 @@ __attribute__((section(".ram_code")))void ev_start_timer(ev_time_event_t * e)
     u8 r = irq_disable();
 
     u32 now = ClockTime();
-    u32 t = now + e->interval;    // becare of overflow
+    u32 t = now + e->interval;    // wraps, deadlines compare by signed distance
 
     e->t = t;
     e->valid = 1;
+    if (e->heap_idx == TIMER_HEAP_NIL) {
+        ev_heap_insert(e);
+    }
+    else {
+        ev_heap_sift(e, e->heap_idx);
+    }
    
     irq_restore(r);
 }
@@ -51,30 +117,41 @@ __attribute__((section(".ram_code")))void ev_cancel_timer(ev_time_event_t * e)
     assert(e);
 
     u8 r = irq_disable();
-    e->valid = 0;
-    e->busy = 0;
+    if (e->heap_idx != TIMER_HEAP_NIL) {
+        ev_heap_remove(e);
+    }
+    if (e == timer_running) {
+        timer_running_cancelled = 1;
+    }
+    ev_release_timer(e);
     irq_restore(r);
 }
 
 __attribute__((section(".ram_code")))ev_time_event_t *ev_on_timer(ev_timer_callback_t cb, void *data, u32 t_us)
 {
-    int i;
     ev_time_event_t *e = NULL;
 
     assert(cb);
 
-    for (i = 0; i < LengthOfArray(timer_list); i++)
-    {
-        if (timer_list[i].busy == 0)
-        {
-            timer_list[i].busy = 1;
-            e = timer_list + i;
-            break;
-        }
+    u8 r = irq_disable();
+    if (t_us > TIMER_EVENT_MAX_US) {
+        e = NULL;
+    }
+    else if (timer_free_cnt) {
+        e = timer_free[--timer_free_cnt];
+    }
+    else if (timer_fresh < TIMER_EVENT_NUM) {
+        e = &timer_list[timer_fresh++];
     }
     if (e == NULL) {
-        while(1);
+        timer_overflow_cnt++;
+        irq_restore(r);
+        return NULL;
     }
+    e->busy = 1;
+    e->heap_idx = TIMER_HEAP_NIL;
+    irq_restore(r);
+
     e->interval = t_us * sys_tick_per_us;
     e->cb = cb;
     e->data = data;
@@ -84,8 +161,11 @@ __attribute__((section(".ram_code")))ev_time_event_t *ev_on_timer(ev_timer_callb
 
 __attribute__((section(".ram_code")))void ev_unon_timer(ev_time_event_t ** e)
 {
-    assert(e && (*e));
-    
+    assert(e);
+
+    if (*e == NULL) {
+        return;
+    }
     ev_cancel_timer(*e);
     *e = NULL;
 }
@@ -96,25 +176,54 @@ __attribute__((section(".ram_code")))void ev_process_timer()
 {
     u32 now = ClockTime();
     ev_time_event_t *te;
-    for (te = timer_list; te < timer_list + LengthOfArray(timer_list); te++) {
-        if ((!is_timer_expired(te)) && ev_is_timer_expired(te, now))
-        {
-            int t;
-            if ((unsigned int)(te->cb) < 0x100 || (unsigned int)(te->cb) > 0x20000) {
-                while(1);
+    u8 r;
+
+    while (1) {
+        r = irq_disable();
+        if (timer_heap_cnt == 0 || TIMER_BEFORE(now, timer_heap[0]->t)) {
+            irq_restore(r);
+            break;
+        }
+        te = timer_heap[0];
+        ev_heap_remove(te);
+        timer_running = te;
+        timer_running_cancelled = 0;
+        irq_restore(r);
+
+        int t;
+#if (TIMER_EVENT_CB_CHECK)
+        if ((unsigned int)(te->cb) < 0x100 || (unsigned int)(te->cb) > 0x20000) {
+            while(1);
+        }
+#endif
+        t = te->cb(te->data);
+
+        r = irq_disable();
+        timer_running = NULL;
+        if (timer_running_cancelled) {
+            //cancelled by its callback, the slot may already belong to a new timer
+        }
+        else if (t < 0) {
+            if (te->heap_idx != TIMER_HEAP_NIL) {
+                ev_heap_remove(te);
             }
-            t = te->cb(te->data);
-            if(t < 0) {
-                ev_cancel_timer(te);        // delete timer
+            ev_release_timer(te);        // delete timer
+        }
+        else if (te->heap_idx == TIMER_HEAP_NIL) { //not restarted by its callback
+            if (t > 0) {
+                te->interval = ((u32)t > TIMER_EVENT_MAX_US ? TIMER_EVENT_MAX_US : t) * sys_tick_per_us;
             }
-            else if(0 == t) {
-                te->t = now + te->interval;    // becare of overflow
+            if (te->interval == 0) {
+                te->interval = 1;
             }
-            else {
-                te->interval = t * sys_tick_per_us;
-                te->t = now + te->interval;    // becare of overflow
+            // from the last deadline so periods do not drift, periods missed altogether are skipped
+            te->t += te->interval;
+            if (!TIMER_BEFORE(now, te->t)) {
+                te->t += te->interval * ((now - te->t) / te->interval + 1);
             }
+            ev_heap_insert(te);
         }
+        irq_restore(r);
     }
 }
 
@@ -130,3 +239,21 @@ __attribute__((section(".ram_code")))int is_timer_expired(ev_time_event_t *e)
         return TRUE;
     }
 }
+
+__attribute__((section(".ram_code")))int ev_next_timer(u32 *t)
+{
+    int pending;
+
+    u8 r = irq_disable();
+    pending = (timer_heap_cnt != 0);
+    if (pending) {
+        *t = timer_heap[0]->t;
+    }
+    irq_restore(r);
+    return pending;
+}
+
+u32 ev_timer_overflows(void)
+{
+    return timer_overflow_cnt;
+}
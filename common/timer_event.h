@@ -26,8 +26,24 @@
 #include "driver.h"
 
 #define LengthOfArray(arr_name) (sizeof(arr_name)/sizeof(arr_name[0]))
-#define TIMER_SAFE_MARGIN_US (4000000) //please fix me
 
+#ifndef TIMER_EVENT_NUM
+#define TIMER_EVENT_NUM         10 //timers pending at the same time, at most 0xfffe
+#endif
+
+#ifndef TIMER_EVENT_CB_CHECK
+#define TIMER_EVENT_CB_CHECK    1 //a callback outside the flash image halts, 0 for host builds
+#endif
+
+//deadlines are compared by signed distance, the other half of the tick range is slack for late processing
+#define TIMER_EVENT_MAX_US      (0x40000000 / sys_tick_per_us)
+
+/**
+ *  @brief  Timer callback, the return value decides what happens next:
+ *          < 0 the timer is deleted (one-shot),
+ *          0 it fires again one interval after its last deadline (periodic, no drift),
+ *          > 0 it fires again that many us after its last deadline.
+ */
 typedef int (*ev_timer_callback_t)(void *data);
 
 
@@ -41,11 +57,31 @@ typedef struct ev_time_event_t {
     void                    *data;         //!< Callback function arguments.
     u32                     valid;
     u32                     busy;
+    u16                     heap_idx;      //!< Used internal, position in the deadline heap
 } ev_time_event_t;
 
+/**
+ * @brief       starts a timer
+ * @param[in]   cb   - callback, see ev_timer_callback_t
+ * @param[in]   data - argument of the callback
+ * @param[in]   t_us - time to the first expiry in us, at most TIMER_EVENT_MAX_US
+ * @return      the timer, NULL if all TIMER_EVENT_NUM are pending or t_us is too large
+ */
 extern ev_time_event_t *ev_on_timer(ev_timer_callback_t cb,void *data, u32 t_us);
 extern void ev_unon_timer(ev_time_event_t **e);//ok
 extern void ev_process_timer();
 extern int is_timer_expired(ev_time_event_t *e);//ok
 
+/**
+ * @brief       gets the nearest deadline
+ * @param[out]  t - system tick the first pending timer expires at
+ * @return      0 if no timer is pending
+ */
+extern int ev_next_timer(u32 *t);
+
+/**
+ * @brief       counts the ev_on_timer() calls refused since power on
+ */
+extern u32 ev_timer_overflows(void);
+
 #endif /* _TIMER_EVENT_H_ */
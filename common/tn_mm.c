@@ -1,42 +1,74 @@
 #include "tn_mm.h"
 #include "string.h"
+#include "../drivers/irq.h"
 
 void tn_mem_init(struct mem_desc *m)
 {
+    unsigned char r = irq_disable();
+
     memset(m->count, 0, m->num);
     memset(m->mem, 0, m->size*m->num);
+    memset(m->next, 0, m->num * sizeof(m->next[0]));
+    m->free_head = 0;
+    m->num_free = m->num;
+    m->used_max = 0;
+    m->fail_cnt = 0;
+
+    irq_restore(r);
 }
 
 void *tn_mem_alloc(struct mem_desc *m)
 {
-    int i;
+    unsigned short i;
+    unsigned char r = irq_disable();
 
-    for(i = 0; i < m->num; ++i) {
-        if(m->count[i] == 0) {
-            ++(m->count[i]);
-            return (void *)((char *)m->mem + (i * m->size));
+    i = m->free_head;
+    if (i >= m->num) {
+        if (m->fail_cnt != 0xffff) {
+            ++(m->fail_cnt);
         }
+        irq_restore(r);
+        return 0;
+    }
+    m->free_head = i + 1 + m->next[i];
+    m->count[i] = 1;
+    --(m->num_free);
+    if (m->num - m->num_free > m->used_max) {
+        m->used_max = m->num - m->num_free;
     }
 
-    return 0;
+    irq_restore(r);
+    return (void *)((char *)m->mem + (i * m->size));
 }
 
+/*
+ * returns 0 once the block is free, -1 if ptr is not the start of a block of this pool
+ */
 char tn_mem_free(struct mem_desc *m, void *ptr)
 {
-    int i;
-    char *ptr2;
-
-    ptr2 = (char *)m->mem;
-    for (i = 0; i < m->num; ++i) {
-        if (ptr2 == (char *)ptr) {
-            if (m->count[i] > 0) {
-                --(m->count[i]);
-            }
-            return m->count[i];
-        }
-        ptr2 += m->size;
+    unsigned int offset;
+    unsigned short i;
+    unsigned char r;
+
+    if (!tn_mem_inmemb(m, ptr)) {
+        return -1;
     }
-    return -1;
+    offset = (char *)ptr - (char *)m->mem;
+    i = offset / m->size;
+    if (i * m->size != offset) {
+        return -1;
+    }
+
+    r = irq_disable();
+    if (m->count[i] > 0) { //freeing a free block leaves the list intact
+        --(m->count[i]);
+        m->next[i] = m->free_head - (i + 1);
+        m->free_head = i;
+        ++(m->num_free);
+    }
+    irq_restore(r);
+
+    return 0;
 }
 
 int tn_mem_inmemb(struct mem_desc *m, void *ptr)
@@ -47,14 +79,5 @@ int tn_mem_inmemb(struct mem_desc *m, void *ptr)
 
 int tn_mem_numfree(struct mem_desc *m)
 {
-    int i;
-    int num_free = 0;
-
-    for(i = 0; i < m->num; ++i) {
-        if(m->count[i] == 0) {
-            ++num_free;
-        }
-    }
-
-    return num_free;
+    return m->num_free;
 }
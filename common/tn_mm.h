@@ -5,16 +5,29 @@
 
 #define TN_MEM_DEF(name, type, num) \
         static char STR_CONCAT(name,_memb_count)[num]; \
+        static unsigned short STR_CONCAT(name,_memb_next)[num]; \
         static type STR_CONCAT(name,_memb_mem)[num]; \
         static struct mem_desc name = {sizeof(type), num, \
                                    STR_CONCAT(name,_memb_count), \
-                                   (void *)STR_CONCAT(name,_memb_mem)}
+                                   (void *)STR_CONCAT(name,_memb_mem), \
+                                   STR_CONCAT(name,_memb_next), 0, num}
 
+/*
+ * free blocks are chained by index through next[], count[] marks the allocated ones,
+ * so alloc, free and numfree take constant time and a double free is caught.
+ * next[i] holds the distance to i + 1 and index num ends the list, so a pool
+ * left all zero by TN_MEM_DEF is ready to use before tn_mem_init()
+ */
 struct mem_desc {
     unsigned short size;
     unsigned short num;
     char *count;
     void *mem;
+    unsigned short *next;
+    unsigned short free_head; //num when no block is free
+    unsigned short num_free;
+    unsigned short used_max; //high-water mark of allocated blocks
+    unsigned short fail_cnt; //allocations refused since init, saturates
 };
 
 void tn_mem_init(struct mem_desc *m);
@@ -216,6 +216,18 @@ void uart_init_baudrate(unsigned int Baudrate,unsigned int System_clock , UART_P
 	reg_uart_ctrl1 = ((reg_uart_ctrl1 & (~FLD_UART_CTRL1_STOP_BIT)) | StopBit);
 }
 
+/**
+ * @brief      This function returns the baud rate uart_init_baudrate() generates for the requested one.
+ * @param[in]  Baudrate  	- requested uart baud rate
+ * @param[in]  System_clock - clock of system
+ * @return     the baud rate given by the chosen bwpc and clock divider
+ */
+unsigned int uart_get_actual_baudrate(unsigned int Baudrate,unsigned int System_clock)
+{
+	GetBetterBwpc(Baudrate,System_clock); //the same choice uart_init_baudrate() makes
+	return System_clock / ((g_uart_div + 1) * (g_bwpc + 1));
+}
+
 /**
  * @brief     enable uart DMA mode, in dma mode, rx_dma_en and tx_dma_en must set 1
  *                                  in no dma mode, rx_dma_en and tx_dma_en must set 0
@@ -157,6 +157,14 @@ extern void uart_init(unsigned short g_uart_div, unsigned char g_bwpc, UART_Pari
  */
 extern void uart_init_baudrate(unsigned int Baudrate,unsigned int System_clock , UART_ParityTypeDef Parity, UART_StopBitTypeDef StopBit);
 
+/**
+ * @brief      This function returns the baud rate uart_init_baudrate() generates for the requested one.
+ * @param[in]  Baudrate  	- requested uart baud rate
+ * @param[in]  System_clock - clock of system
+ * @return     the baud rate given by the chosen bwpc and clock divider
+ */
+extern unsigned int uart_get_actual_baudrate(unsigned int Baudrate,unsigned int System_clock);
+
 /**
  * @brief     enable uart DMA mode, in dma mode, rx_dma_en and tx_dma_en must set 1
  *                                  in no dma mode, rx_dma_en and tx_dma_en must set 0
@@ -47,6 +47,12 @@
 #include "fw_update_phy.h"
 #include "common.h"
 #include "driver.h"
+#include "erase_ahead.h"
+#include "page_stage.h"
+#include "retry_policy.h"
+#include "crc.h"
+#include "slot.h"
+#include "image_check.h"
 
 //#define FW_UPDATE_MASTER_EN                 0
 #define MSG_QUEUE_LEN                       4
@@ -56,6 +62,14 @@
 #define FW_UPDATE_REBOOT_WAIT               (100 * 1000) //in us
 #define FW_UPDATE_BOOT_FLAG_OFFSET          8
 
+#if !defined(FW_UPDATE_MASTER_EN) && (FW_UPDATE_SLAVE_BIN_ADDR != SLOT_B_ADDR)
+#error "SLOT_B_ADDR has to be the FW_UPDATE area"
+#endif
+
+#if (FW_UPDATE_WINDOW_SIZE < 1) || (FW_UPDATE_WINDOW_SIZE > FW_UPDATE_WINDOW_SIZE_MAX)
+#error "FW_UPDATE_WINDOW_SIZE must be within 1 and FW_UPDATE_WINDOW_SIZE_MAX"
+#endif
+
 #define GREEN_LED_PIN                       GPIO_PA5
 #define WHITE_LED_PIN                       GPIO_PA6
 #define RED_LED_PIN                         GPIO_PA7
@@ -108,28 +122,117 @@ static int FW_UPDATE_rspWaitTimerCb(void* arg)
     return -1;
 }
 
-static unsigned char FW_UPDATE_CalculateCheckSum(const unsigned char *Buf, unsigned short Len)
+enum {
+    FW_UPDATE_FRAMING_LEGACY = 0, //XOR checksum header only
+    FW_UPDATE_FRAMING_OFFERED, //the slave sends the CRC-16 header and takes both until the master does too
+    FW_UPDATE_FRAMING_CRC16, //CRC-16 header only
+};
+static unsigned char FW_UPDATE_Framing = FW_UPDATE_FRAMING_LEGACY;
+
+/* a CRC rather than an XOR of the bytes, two bit errors in the same column cancel out in an XOR */
+static unsigned short FW_UPDATE_CalculateCheckSum(const unsigned char *Buf, unsigned short Len)
+{
+    return crc16_update(CRC16_INIT, Buf, Len);
+}
+
+/* the checksum of the legacy framing */
+static unsigned char FW_UPDATE_CalculateXorSum(const unsigned char *Buf, unsigned short Len)
 {
-    unsigned char CheckSum = *Buf;
+    unsigned char CheckSum = 0;
     unsigned short i;
-    for (i = 1; i < Len; i++) {
+
+    for (i = 0; i < Len; i++) {
         CheckSum ^= Buf[i];
     }
     return CheckSum;
 }
 
-static int FW_UPDATE_IsCheckSumRight(unsigned char *Data)
+/*
+ * length on the line of the frame starting at Data if its checksum is right, 0 otherwise.
+ * RxLen bounds the frame, a damaged Len field must not take the checksum past the received bytes.
+ * Len sits at the same offset in both framings
+ */
+static int FW_UPDATE_CheckFrame(const unsigned char *Data, unsigned int RxLen)
 {
-    unsigned short PayloadLen = Data[3];
+    unsigned short PayloadLen;
+
+    if (RxLen < FW_UPDATE_LEGACY_HEAD_LEN) {
+        return 0;
+    }
+    PayloadLen = Data[3];
     PayloadLen <<= 8;
     PayloadLen += Data[2];
+    if (PayloadLen > FW_UPDATE_FRAME_PAYLOAD_MAX) {
+        return 0;
+    }
+    if ((FW_UPDATE_FRAME_HEAD_LEN + PayloadLen <= RxLen) &&
+        ((Data[0] | (Data[1] << 8)) == FW_UPDATE_CalculateCheckSum(&Data[2], 3 + PayloadLen))) {
+        return FW_UPDATE_FRAME_HEAD_LEN + PayloadLen;
+    }
+    if ((FW_UPDATE_FRAMING_CRC16 != FW_UPDATE_Framing) && (FW_UPDATE_LEGACY_HEAD_LEN + PayloadLen <= RxLen) &&
+        (Data[0] == FW_UPDATE_CalculateXorSum(&Data[1], 3 + PayloadLen))) {
+        return FW_UPDATE_LEGACY_HEAD_LEN + PayloadLen;
+    }
+    return 0;
+}
 
-    if (Data[0] == FW_UPDATE_CalculateCheckSum(&Data[1], 3 + PayloadLen)) {
-        return 1;
+/*
+ * length of the first frame in Data whose checksum is right, Skip tells where it starts. Damaged bytes
+ * ahead of it are only skipped under the CRC-16 framing, an XOR checksum matches noise too often
+ */
+static int FW_UPDATE_FindFrame(const unsigned char *Data, unsigned int RxLen, unsigned int *Skip)
+{
+    int Len = FW_UPDATE_CheckFrame(Data, RxLen);
+
+    *Skip = 0;
+    while (!Len && (FW_UPDATE_FRAMING_CRC16 == FW_UPDATE_Framing) && (++*Skip < RxLen)) {
+        Len = FW_UPDATE_CheckFrame(&Data[*Skip], RxLen - *Skip);
     }
-    else {
+    return Len;
+}
+
+/* copy the first frame found in Data into Frame whatever its framing, returns the bytes up to its end or 0 */
+static int FW_UPDATE_ParseFrame(FW_UPDATE_FrameTypeDef *Frame, const unsigned char *Data, unsigned int RxLen)
+{
+    unsigned int Skip;
+    int Len = FW_UPDATE_FindFrame(Data, RxLen, &Skip);
+
+    if (0 == Len) {
         return 0;
     }
+    Data += Skip;
+    memcpy(&Frame->Len, &Data[2], sizeof(Frame->Len));
+    if (FW_UPDATE_FRAME_HEAD_LEN + Frame->Len == Len) {
+        Frame->Type = Data[4];
+        //the first CRC-16 frame of the master settles the framing the slave offered
+        if (FW_UPDATE_FRAMING_OFFERED == FW_UPDATE_Framing) {
+            FW_UPDATE_Framing = FW_UPDATE_FRAMING_CRC16;
+        }
+    }
+    else {
+        Frame->Type = Data[1];
+    }
+    memcpy(Frame->Payload, &Data[Len - Frame->Len], Frame->Len);
+    return Skip + Len;
+}
+
+/*
+ * fill in the checksum of a built frame and return its length on the line. A legacy frame is laid out
+ * over the struct, the payload moves down a byte behind the XOR checksum, Type and Len
+ */
+static int FW_UPDATE_SealFrame(FW_UPDATE_FrameTypeDef *Frame)
+{
+    unsigned char *Buf = (unsigned char *)Frame;
+    unsigned char Type = Frame->Type;
+
+    if (FW_UPDATE_FRAMING_LEGACY != FW_UPDATE_Framing) {
+        Frame->CheckSum = FW_UPDATE_CalculateCheckSum((unsigned char *)&Frame->Len, 3 + Frame->Len);
+        return FW_UPDATE_FRAME_HEAD_LEN + Frame->Len;
+    }
+    memmove(&Buf[FW_UPDATE_LEGACY_HEAD_LEN], Frame->Payload, Frame->Len);
+    Buf[1] = Type;
+    Buf[0] = FW_UPDATE_CalculateXorSum(&Buf[1], 3 + Frame->Len);
+    return FW_UPDATE_LEGACY_HEAD_LEN + Frame->Len;
 }
 
 static int FW_UPDATE_BuildCmdFrame(FW_UPDATE_FrameTypeDef *Frame, const unsigned char CmdId, const unsigned char *Value, unsigned short Len)
@@ -140,9 +243,8 @@ static int FW_UPDATE_BuildCmdFrame(FW_UPDATE_FrameTypeDef *Frame, const unsigned
     if (Value) {
         memcpy(&Frame->Payload[1], Value, Len);
     }
-    Frame->CheckSum = FW_UPDATE_CalculateCheckSum(&Frame->Type, 3 + Frame->Len);
 
-    return (4 + Frame->Len);
+    return FW_UPDATE_SealFrame(Frame);
 }
 
 unsigned char aaa = 0;
@@ -152,7 +254,8 @@ void FW_UPDATE_RxIrq(unsigned char *Data)
         FW_UPDATE_MsgQueuePush(NULL, FW_UPDATE_MSG_TYPE_INVALID_DATA, &MsgQueue);
     }
     else {
-        if (FW_UPDATE_IsCheckSumRight(Data)) {
+        unsigned int Skip;
+        if (FW_UPDATE_FindFrame(Data, FW_UPDATE_PHY_RxLen(Data), &Skip)) {
             FW_UPDATE_MsgQueuePush(Data, FW_UPDATE_MSG_TYPE_DATA, &MsgQueue);
         }
         else {
@@ -161,63 +264,186 @@ void FW_UPDATE_RxIrq(unsigned char *Data)
     }
 }
 
-static unsigned short FW_CRC16_Cal(unsigned short crc, unsigned char* pd, int len)
+/*
+ * the rate capabilities follow the fields older peers read in VERSION_REQ/VERSION_RSP:
+ * the system clock and the fastest rate offered
+ */
+static int FW_UPDATE_PutBaudCaps(unsigned char *Buf)
 {
-    // unsigned short       crc16_poly[2] = { 0, 0xa001 }; //0x8005 <==> 0xa001
-    unsigned short      crc16_poly[2] = { 0, 0x8408 }; //0x1021 <==> 0x8408
-    //unsigned short        crc16_poly[2] = { 0, 0x0811 }; //0x0811 <==> 0x8810
-    //unsigned short        crc = 0xffff;
-    int i, j;
+    unsigned int SysClk = FW_UPDATE_PHY_SysClock();
+    unsigned int MaxBaud = FW_UPDATE_BAUD_MAX;
 
-    for (j = len; j > 0; j--)
-    {
-        unsigned char ds = *pd++;
-        for (i = 0; i < 8; i++)
-        {
-            crc = (crc >> 1) ^ crc16_poly[(crc ^ ds) & 1];
-            ds = ds >> 1;
-        }
-    }
+    memcpy(Buf, &SysClk, sizeof(SysClk));
+    memcpy(Buf + sizeof(SysClk), &MaxBaud, sizeof(MaxBaud));
+    return sizeof(SysClk) + sizeof(MaxBaud);
+}
 
-    return crc;
+/* the rate a chip clocked at SysClk really runs when asked for Baud, 0 if that is out of reach or too far off */
+static unsigned int FW_UPDATE_BaudActual(unsigned int Baud, unsigned int SysClk, unsigned int MaxBaud)
+{
+    unsigned int Actual, Diff;
+
+    //GetBetterBwpc() needs 8 clocks per bit at least to find a divider
+    if ((Baud > MaxBaud) || (Baud > SysClk / 8)) {
+        return 0;
+    }
+    Actual = uart_get_actual_baudrate(Baud, SysClk);
+    Diff = (Actual > Baud) ? (Actual - Baud) : (Baud - Actual);
+    return (Diff * 100 <= Baud * FW_UPDATE_BAUD_TOLERANCE) ? Actual : 0;
 }
 
 #ifdef FW_UPDATE_MASTER_EN
 
 static FW_UPDATE_CtrlTypeDef MasterCtrl = {0};
+static retry_policy_t MasterRetry;
+static unsigned int MasterSendTick; //when the frame soliciting the awaited response went out
+static unsigned short MasterSent; //last block of the burst in flight, MasterCtrl.BlockNum is the cumulative ACK point
+static unsigned char MasterSacked; //blocks the slave holds past the ACK point, bit 0 is MasterCtrl.BlockNum + 2
+static unsigned char MasterBurst[FW_UPDATE_WINDOW_SIZE_MAX * FW_UPDATE_FRAME_LEN_MAX];
+static const unsigned int MasterBaudLadder[] = FW_UPDATE_BAUD_LADDER;
+static unsigned char MasterBaudIdx; //next ladder rate to try
+static unsigned int MasterBaud; //rate tried or agreed, 0 while at FW_UPDATE_PHY_BAUDRATE
+static unsigned int MasterPeerSysClk; //capabilities of the slave, 0 for a slave without any
+static unsigned int MasterPeerMaxBaud;
+static unsigned char MasterPattern[FW_UPDATE_BAUD_PATTERN_LEN]; //sent at a trial rate, TxFrame holds it in whatever framing
+static unsigned char MasterCaps; //agreed in VERSION_REQ/VERSION_RSP
+static unsigned char MasterBusy; //the slave is busy past the next frame, see FW_UPDATE_MasterRspTimer()
+static unsigned char MasterSampled; //the awaited response makes a round trip sample
+
+/*
+ * the response wait of the TxLen bytes just handed to the UART follows the measured round trip time,
+ * counted once they are out. A slave that announced an erase or has the image to check gets
+ * FW_UPDATE_BUSY_WAIT on top, and that response is no round trip sample. A slave that cannot
+ * announce its erases gets it every time
+ */
+static ev_time_event_t *FW_UPDATE_MasterRspTimer(int TxLen)
+{
+    unsigned int Baud = MasterBaud ? MasterBaud : FW_UPDATE_PHY_BAUDRATE;
+    unsigned int TxUs = TxLen * 10 * 1000 / (Baud / 1000);
+    unsigned int Wait = TxUs + retry_policy_timeout(&MasterRetry);
+
+    MasterSendTick = clock_time() + TxUs * sys_tick_per_us;
+    MasterSampled = !MasterBusy;
+    if (MasterBusy || !(MasterCaps & FW_UPDATE_CAP_BUSY)) {
+        Wait += FW_UPDATE_BUSY_WAIT;
+        MasterBusy = 0;
+    }
+    return ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, Wait);
+}
+
+/* the slave ends its START_RSP and ACKs in a flags byte once FW_UPDATE_CAP_BUSY is agreed */
+static unsigned char FW_UPDATE_MasterBusyFlag(void)
+{
+    return (MasterCaps & FW_UPDATE_CAP_BUSY) && (RxFrame.Payload[RxFrame.Len - 1] & FW_UPDATE_FLAG_BUSY);
+}
 
-static int FW_UPDATE_IsBlockNumMatch(unsigned char *Payload)
+/* the round trip time of the response just received, 0 when it is no sample */
+static unsigned int FW_UPDATE_MasterRtt(void)
 {
-    unsigned short BlockNum = Payload[1];
-    BlockNum <<= 8;
-    BlockNum += Payload[0];
+    unsigned int Ticks = clock_time() - MasterSendTick;
 
-    if (BlockNum == MasterCtrl.BlockNum) {
-        return 1;
-    }
-    else {
-        return 0;
-    }
+    return (MasterSampled && !(Ticks & 0x80000000)) ? (Ticks / sys_tick_per_us) : 0;
 }
 
-static int FW_UPDATE_BuildDataFrame(FW_UPDATE_FrameTypeDef *Frame)
+static int FW_UPDATE_BuildDataFrame(FW_UPDATE_FrameTypeDef *Frame, unsigned short BlockNum)
 {
+    unsigned int Offset = (BlockNum - 1) * (FW_UPDATE_FRAME_PAYLOAD_MAX-2);
+
     Frame->Type = FW_UPDATE_FRAME_TYPE_DATA;
-    if ((MasterCtrl.TotalBinSize - MasterCtrl.BlockNum*(FW_UPDATE_FRAME_PAYLOAD_MAX-2)) > (FW_UPDATE_FRAME_PAYLOAD_MAX-2)) {
+    if ((MasterCtrl.TotalBinSize - Offset) > (FW_UPDATE_FRAME_PAYLOAD_MAX-2)) {
         Frame->Len = FW_UPDATE_FRAME_PAYLOAD_MAX;
     }
     else {
         //the last data block comes
-        Frame->Len = MasterCtrl.TotalBinSize - MasterCtrl.BlockNum*(FW_UPDATE_FRAME_PAYLOAD_MAX-2) + 2;
-        MasterCtrl.FinishFlag = 1;
+        Frame->Len = MasterCtrl.TotalBinSize - Offset + 2;
     }
-    MasterCtrl.BlockNum++;
-    memcpy(Frame->Payload, &MasterCtrl.BlockNum, 2);
-    flash_read_page(MasterCtrl.FlashAddr, Frame->Len-2, &Frame->Payload[2]);
-    MasterCtrl.FlashAddr += Frame->Len-2;
-    Frame->CheckSum = FW_UPDATE_CalculateCheckSum(&Frame->Type, 3 + Frame->Len);
+    Frame->Payload[0] = BlockNum & 0xff;
+    Frame->Payload[1] = BlockNum >> 8;
+    flash_read_page(MasterCtrl.FlashAddr + Offset, Frame->Len-2, &Frame->Payload[2]);
 
-    return (4 + Frame->Len);
+    return FW_UPDATE_SealFrame(Frame);
+}
+
+/*
+ * the blocks after the acknowledged ones go out back to back in one DMA transfer, up to the agreed window,
+ * and the slave answers the whole burst with one cumulative ACK. With FW_UPDATE_CAP_SACK those it holds
+ * already are left out and the missing ones are repeated to fill the window, a burst down to a single
+ * frame would be lost as often as that frame is
+ */
+static int FW_UPDATE_SendBurst(void)
+{
+    unsigned short BlockNum;
+    int BurstLen = 0;
+    int Frames = 0;
+
+    MasterSent = MasterCtrl.BlockNum + MasterCtrl.WindowSize;
+    if (MasterSent > MasterCtrl.MaxBlockNum) {
+        MasterSent = MasterCtrl.MaxBlockNum;
+    }
+    do {
+        for (BlockNum = MasterCtrl.BlockNum + 1; (BlockNum <= MasterSent) && (Frames < MasterCtrl.WindowSize); BlockNum++) {
+            if ((BlockNum > MasterCtrl.BlockNum + 1) && (MasterSacked & (1 << (BlockNum - MasterCtrl.BlockNum - 2)))) {
+                continue;
+            }
+            int Len = FW_UPDATE_BuildDataFrame(&TxFrame, BlockNum);
+            memcpy(&MasterBurst[BurstLen], &TxFrame, Len);
+            BurstLen += Len;
+            Frames++;
+        }
+    } while ((MasterCaps & FW_UPDATE_CAP_SACK) && (Frames < MasterCtrl.WindowSize));
+    FW_UPDATE_PHY_SendData(MasterBurst, BurstLen);
+    return BurstLen;
+}
+
+/* bit edges at every bit, long runs of 0 and 1 and a walking one, whatever a marginal rate trips over */
+static void FW_UPDATE_BaudPattern(unsigned char *Buf)
+{
+    int i;
+
+    for (i = 0; i < FW_UPDATE_BAUD_PATTERN_LEN; i++) {
+        switch (i & 3) {
+        case 0:
+            Buf[i] = 0x55;
+            break;
+        case 1:
+            Buf[i] = 0xaa;
+            break;
+        case 2:
+            Buf[i] = (i & 4) ? 0xff : 0x00;
+            break;
+        default:
+            Buf[i] = 1 << ((i >> 2) & 7);
+            break;
+        }
+    }
+}
+
+static int FW_UPDATE_MasterStartReq(void)
+{
+    //the block count is followed by the window the master proposes and the version of the image
+    unsigned char Param[5];
+    Param[0] = MasterCtrl.MaxBlockNum & 0xff;
+    Param[1] = MasterCtrl.MaxBlockNum >> 8;
+    Param[2] = FW_UPDATE_WINDOW_SIZE;
+    Param[3] = MasterCtrl.FwVersion & 0xff;
+    Param[4] = MasterCtrl.FwVersion >> 8;
+    MasterCtrl.State = FW_UPDATE_MASTER_STATE_START_RSP_WAIT;
+    return FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_START_REQ, Param, sizeof(Param));
+}
+
+/* asks for the next ladder rate both sides generate closely enough, the session starts once none is left */
+static int FW_UPDATE_MasterNextBaud(void)
+{
+    while (MasterPeerSysClk && (MasterBaudIdx < sizeof(MasterBaudLadder) / sizeof(MasterBaudLadder[0]))) {
+        MasterBaud = MasterBaudLadder[MasterBaudIdx++];
+        if (FW_UPDATE_BaudActual(MasterBaud, FW_UPDATE_PHY_SysClock(), FW_UPDATE_BAUD_MAX) &&
+            FW_UPDATE_BaudActual(MasterBaud, MasterPeerSysClk, MasterPeerMaxBaud)) {
+            MasterCtrl.State = FW_UPDATE_MASTER_STATE_BAUD_RSP_WAIT;
+            return FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_BAUD_REQ, (unsigned char *)&MasterBaud, sizeof(MasterBaud));
+        }
+    }
+    MasterBaud = 0;
+    return FW_UPDATE_MasterStartReq();
 }
 
 void FW_UPDATE_MasterInit(unsigned int FWBinAddr, unsigned short FwVer)
@@ -232,6 +458,15 @@ void FW_UPDATE_MasterInit(unsigned int FWBinAddr, unsigned short FwVer)
     MasterCtrl.State = FW_UPDATE_MASTER_STATE_IDLE;
     MasterCtrl.RetryTimes = 0;
     MasterCtrl.FinishFlag = 0;
+    MasterCtrl.WindowSize = FW_UPDATE_WINDOW_SIZE;
+    MasterBaud = 0;
+    MasterCaps = 0;
+    MasterBusy = 0;
+    MasterSacked = 0;
+    FW_UPDATE_Framing = FW_UPDATE_FRAMING_LEGACY;
+    //a burst that loses every frame is a failure, a larger image goes through more of them
+    retry_policy_init(&MasterRetry, FW_UPDATE_RTO_INIT, FW_UPDATE_RTO_MIN, FW_UPDATE_RTO_MAX,
+                      FW_UPDATE_RETRY_BUDGET + MasterCtrl.MaxBlockNum, FW_UPDATE_RETRY_BURST_MAX);
 }
 
 void FW_UPDATE_MasterStart(void)
@@ -240,40 +475,54 @@ void FW_UPDATE_MasterStart(void)
     static int Len = 0;
 
     if (FW_UPDATE_MASTER_STATE_IDLE == MasterCtrl.State) {
-        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_VERSION_REQ, 0, 0);
+        unsigned char Param[8 + 1];
+        Len = FW_UPDATE_PutBaudCaps(Param);
+        Param[Len++] = FW_UPDATE_CAPS;
+        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_VERSION_REQ, Param, Len);
         FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
         MasterCtrl.State = FW_UPDATE_MASTER_STATE_FW_VER_WAIT;
         /* Start the response wait timer*/
         if (FW_UPDATE_rspWaitTimer) {
             ev_unon_timer(&FW_UPDATE_rspWaitTimer);
         }
-        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+        FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
     }
     else if (FW_UPDATE_MASTER_STATE_FW_VER_WAIT == MasterCtrl.State) {
         if (Msg) {
             //if receive a valid uart packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
                 //if receive the valid FW version response
                 if ((FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) &&
                 (FW_UPDATE_CMD_ID_VERSION_RSP == RxFrame.Payload[0])) {
                     MasterCtrl.RetryTimes = 0;
+                    retry_policy_success(&MasterRetry, FW_UPDATE_MasterRtt());
                     /* Cancel the response wait timer*/
                     if (FW_UPDATE_rspWaitTimer) {
                         ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                     }
+                    //a slave taking the CRC-16 header sent this response with it already, the master follows
+                    MasterCaps = (RxFrame.Len >= 12) ? (RxFrame.Payload[11] & FW_UPDATE_CAPS) : 0;
+                    if (MasterCaps & FW_UPDATE_CAP_CRC16) {
+                        FW_UPDATE_Framing = FW_UPDATE_FRAMING_CRC16;
+                    }
                     //compare the received version with that of FW_UPDATE_bin
                     unsigned short Version = RxFrame.Payload[2];
                     Version <<= 8;
                     Version += RxFrame.Payload[1];
 
                     if (Version < MasterCtrl.FwVersion) {
-                        MasterCtrl.State = FW_UPDATE_MASTER_STATE_START_RSP_WAIT;
-                        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_START_REQ, (unsigned char *)&MasterCtrl.MaxBlockNum, sizeof(MasterCtrl.MaxBlockNum));
+                        //a slave that sends no rate capabilities stays at the start rate
+                        MasterPeerSysClk = 0;
+                        MasterPeerMaxBaud = 0;
+                        if (RxFrame.Len >= 11) {
+                            memcpy(&MasterPeerSysClk, &RxFrame.Payload[3], sizeof(MasterPeerSysClk));
+                            memcpy(&MasterPeerMaxBaud, &RxFrame.Payload[7], sizeof(MasterPeerMaxBaud));
+                        }
+                        MasterBaudIdx = 0;
+                        Len = FW_UPDATE_MasterNextBaud();
                         FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
                         /* Start the response wait timer*/
-                        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                        FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
                     }
                     else {
                         MasterCtrl.State = FW_UPDATE_MASTER_STATE_ERROR;
@@ -282,7 +531,7 @@ void FW_UPDATE_MasterStart(void)
                 }
             }
 
-            if (MasterCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            if (!retry_policy_failure(&MasterRetry)) {
                 MasterCtrl.State = FW_UPDATE_MASTER_STATE_ERROR;
                 return;
             }
@@ -292,99 +541,196 @@ void FW_UPDATE_MasterStart(void)
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
             }
-            FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+            FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
+        }
+    }
+    else if (FW_UPDATE_MASTER_STATE_BAUD_RSP_WAIT == MasterCtrl.State) {
+        if (Msg) {
+            //if receive a valid uart packet
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
+                //if receive the rate response, 0 refuses the rate asked for
+                if ((FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) &&
+                (FW_UPDATE_CMD_ID_BAUD_RSP == RxFrame.Payload[0])) {
+                    unsigned int Baud = 0;
+                    memcpy(&Baud, &RxFrame.Payload[1], sizeof(Baud));
+                    MasterCtrl.RetryTimes = 0;
+                    retry_policy_success(&MasterRetry, FW_UPDATE_MasterRtt());
+                    /* Cancel the response wait timer*/
+                    if (FW_UPDATE_rspWaitTimer) {
+                        ev_unon_timer(&FW_UPDATE_rspWaitTimer);
+                    }
+                    if (Baud == MasterBaud) {
+                        //the slave switched right after its response, the test pattern goes out at the new rate
+                        FW_UPDATE_BaudPattern(MasterPattern);
+                        FW_UPDATE_PHY_SetBaudrate(MasterBaud);
+                        MasterCtrl.State = FW_UPDATE_MASTER_STATE_BAUD_TEST_WAIT;
+                        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_BAUD_TEST_REQ, MasterPattern, sizeof(MasterPattern));
+                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        /* Start the response wait timer*/
+                        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, 2 * FW_UPDATE_BAUD_SETTLE);
+                    }
+                    else {
+                        Len = FW_UPDATE_MasterNextBaud();
+                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        /* Start the response wait timer*/
+                        FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
+                    }
+                    return;
+                }
+            }
+
+            if (!retry_policy_failure(&MasterRetry)) {
+                MasterCtrl.State = FW_UPDATE_MASTER_STATE_ERROR;
+                return;
+            }
+            MasterCtrl.RetryTimes++;
+            FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+            /* Start the response wait timer again*/
+            if (FW_UPDATE_rspWaitTimer) {
+                ev_unon_timer(&FW_UPDATE_rspWaitTimer);
+            }
+            FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
+        }
+    }
+    else if (FW_UPDATE_MASTER_STATE_BAUD_TEST_WAIT == MasterCtrl.State) {
+        if (Msg) {
+            //if receive a valid uart packet
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
+                //if receive the test pattern back unharmed, the session goes on at the new rate
+                if ((FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) &&
+                (FW_UPDATE_CMD_ID_BAUD_TEST_RSP == RxFrame.Payload[0]) &&
+                (1 + FW_UPDATE_BAUD_PATTERN_LEN == RxFrame.Len) &&
+                (0 == memcmp(&RxFrame.Payload[1], MasterPattern, FW_UPDATE_BAUD_PATTERN_LEN))) {
+                    MasterCtrl.RetryTimes = 0;
+                    /* Cancel the response wait timer*/
+                    if (FW_UPDATE_rspWaitTimer) {
+                        ev_unon_timer(&FW_UPDATE_rspWaitTimer);
+                    }
+                    Len = FW_UPDATE_MasterStartReq();
+                    FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                    /* Start the response wait timer*/
+                    FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
+                    return;
+                }
+            }
+            //a damaged echo is left to the timeout, the slave is back at the start rate by then
+            if (Msg->Type == FW_UPDATE_MSG_TYPE_TIMEOUT) {
+                FW_UPDATE_PHY_SetBaudrate(FW_UPDATE_PHY_BAUDRATE);
+                Len = FW_UPDATE_MasterNextBaud();
+                FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                /* Start the response wait timer*/
+                FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
+            }
         }
     }
     else if (FW_UPDATE_MASTER_STATE_START_RSP_WAIT == MasterCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
                 //if receive the valid FW version response
                 if ((FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) &&
                 (FW_UPDATE_CMD_ID_START_RSP == RxFrame.Payload[0])) {
                     MasterCtrl.RetryTimes = 0;
+                    retry_policy_success(&MasterRetry, FW_UPDATE_MasterRtt());
                     /* Cancel the response wait timer*/
                     if (FW_UPDATE_rspWaitTimer) {
                         ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                     }
-                    //read FW_UPDATE_bin from flash and packet it in FW_UPDATE data frame
+                    //a slave without window support answers without parameters and takes one frame at a time
+                    MasterCtrl.WindowSize = 1;
+                    if ((RxFrame.Len >= 2) && (RxFrame.Payload[1] > 1)) {
+                        MasterCtrl.WindowSize = (RxFrame.Payload[1] < FW_UPDATE_WINDOW_SIZE) ? RxFrame.Payload[1] : FW_UPDATE_WINDOW_SIZE;
+                    }
+                    MasterBusy = FW_UPDATE_MasterBusyFlag();
+                    //read FW_UPDATE_bin from flash and packet it in FW_UPDATE data frames
                     MasterCtrl.State = FW_UPDATE_MASTER_STATE_DATA_ACK_WAIT;
-                    Len = FW_UPDATE_BuildDataFrame(&TxFrame);
-                    FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                    Len = FW_UPDATE_SendBurst();
                     /* Start the response wait timer*/
-                    FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                    FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
                     return;
                 }
             }
 
-            if (MasterCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            if (!retry_policy_failure(&MasterRetry)) {
                 MasterCtrl.State = FW_UPDATE_MASTER_STATE_ERROR;
                 return;
             }
             MasterCtrl.RetryTimes++;
+            //the slave gives an agreed rate up after a silent FW_UPDATE_RESPONSE_WAIT_TIME, follow it down
+            if (MasterBaud && (MasterCtrl.RetryTimes >= FW_UPDATE_RETRY_MAX)) {
+                MasterBaud = 0;
+                FW_UPDATE_PHY_SetBaudrate(FW_UPDATE_PHY_BAUDRATE);
+            }
             FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
             /* Start the response wait timer again*/
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
             }
-            FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+            FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
         }
     }
     else if (FW_UPDATE_MASTER_STATE_DATA_ACK_WAIT == MasterCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
-                //if receive the valid FW_UPDATE data ack
-                if ((FW_UPDATE_FRAME_TYPE_ACK == RxFrame.Type) && FW_UPDATE_IsBlockNumMatch(RxFrame.Payload)) {
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
+                //the ACK counts once it moves past the blocks acknowledged so far or the slave holds more of them
+                unsigned short AckNum = RxFrame.Payload[1];
+                unsigned char Sacked = 0;
+                AckNum <<= 8;
+                AckNum += RxFrame.Payload[0];
+                if ((MasterCaps & FW_UPDATE_CAP_SACK) && (RxFrame.Len >= 3)) {
+                    Sacked = RxFrame.Payload[2];
+                }
+                if ((FW_UPDATE_FRAME_TYPE_ACK == RxFrame.Type) && (AckNum <= MasterSent) &&
+                    ((AckNum > MasterCtrl.BlockNum) || ((AckNum == MasterCtrl.BlockNum) && (Sacked & ~MasterSacked)))) {
                     MasterCtrl.RetryTimes = 0;
+                    retry_policy_success(&MasterRetry, FW_UPDATE_MasterRtt());
                     /* Cancel the response wait timer*/
                     if (FW_UPDATE_rspWaitTimer) {
                         ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                     }
 
-                    if (MasterCtrl.FinishFlag) {
+                    MasterCtrl.BlockNum = AckNum;
+                    MasterSacked = Sacked;
+                    MasterBusy = FW_UPDATE_MasterBusyFlag();
+                    if (MasterCtrl.BlockNum == MasterCtrl.MaxBlockNum) {
                         MasterCtrl.State = FW_UPDATE_MASTER_STATE_END_RSP_WAIT;
                         Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_END_REQ, (unsigned char *)&MasterCtrl.TotalBinSize, sizeof(MasterCtrl.TotalBinSize));
                         FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        //the slave programs what it staged and reads the whole image back before it answers
+                        MasterBusy = 1;
                     }
                     else {
-                        //read FW_UPDATE_bin from flash and packet it in FW_UPDATE data frame
-                        Len = FW_UPDATE_BuildDataFrame(&TxFrame);
-                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        //a partial ACK goes back to the first block the slave is missing, and only to the missing ones
+                        Len = FW_UPDATE_SendBurst();
                     }
                     /* Start the response wait timer*/
-                    FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                    FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
                     return;
                 }
             }
 
-            if (MasterCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            if (!retry_policy_failure(&MasterRetry)) {
                 MasterCtrl.State = FW_UPDATE_MASTER_STATE_ERROR;
                 return;
             }
             MasterCtrl.RetryTimes++;
-            FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
             /* Start the response wait timer again*/
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
             }
-            FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+            FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(FW_UPDATE_SendBurst());
         }
     }
     else if (FW_UPDATE_MASTER_STATE_END_RSP_WAIT == MasterCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
                 //if receive the valid END response
                 if ((FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) &&
                     (FW_UPDATE_CMD_ID_END_RSP == RxFrame.Payload[0])) {
                     MasterCtrl.RetryTimes = 0;
+                    retry_policy_success(&MasterRetry, FW_UPDATE_MasterRtt());
                     MasterCtrl.State = FW_UPDATE_MASTER_STATE_END;
                     /* Cancel the response wait timer*/
                     if (FW_UPDATE_rspWaitTimer) {
@@ -394,17 +740,18 @@ void FW_UPDATE_MasterStart(void)
                 }
             }
 
-            if (MasterCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            if (!retry_policy_failure(&MasterRetry)) {
                 MasterCtrl.State = FW_UPDATE_MASTER_STATE_ERROR;
                 return;
             }
             MasterCtrl.RetryTimes++;
             FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+            MasterBusy = 1;
             /* Start the response wait timer*/
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
             }
-            FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+            FW_UPDATE_rspWaitTimer = FW_UPDATE_MasterRspTimer(Len);
         }
     }
     else if (FW_UPDATE_MASTER_STATE_END == MasterCtrl.State) {
@@ -437,30 +784,140 @@ void FW_UPDATE_MasterStart(void)
 #define FW_UPDATE_MASTER_LISTENING_DURATION    (5*1000*1000) //in us
 
 static FW_UPDATE_CtrlTypeDef SlaveCtrl = {0};
+static erase_ahead_t SlaveErase; //the FW_UPDATE area is erased on demand, right ahead of the writes
+static page_stage_t SlaveStage; //received data waits here for the next idle gap to be programmed
+static retry_policy_t SlaveRetry; //the slave only listens, its timeout stays fixed
+static unsigned char SlaveBaudTrial; //the rate asked for in the last BAUD_REQ is on trial until the START_REQ
+static unsigned int SlavePeerSysClk; //capabilities of the master, 0 for a master without any
+static unsigned int SlavePeerMaxBaud;
+static unsigned char SlaveCaps; //agreed in VERSION_REQ/VERSION_RSP
+static unsigned short SlaveNewVersion; //announced by START_REQ, SLOT_VERSION_UNKNOWN from a legacy master
+//blocks past a lost one wait here with FW_UPDATE_CAP_SACK, block n in slot n % FW_UPDATE_WINDOW_SIZE_MAX
+static unsigned char SlaveHeld[FW_UPDATE_WINDOW_SIZE_MAX][FW_UPDATE_FRAME_PAYLOAD_MAX - 2];
+static unsigned char SlaveHeldLen[FW_UPDATE_WINDOW_SIZE_MAX];
+static unsigned short SlaveHeldNum[FW_UPDATE_WINDOW_SIZE_MAX]; //0 for a free slot
 volatile unsigned char debug_step = 0;
 
+/* with FW_UPDATE_CAP_BUSY agreed the master is told whether a sector erase follows the response */
+static unsigned char FW_UPDATE_SlaveFlags(void)
+{
+    return erase_ahead_due(&SlaveErase, SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize) ? FW_UPDATE_FLAG_BUSY : 0;
+}
+
+/* the blocks held past the cumulative ACK point, bit 0 is the one after the block missing */
+static unsigned char FW_UPDATE_SlaveSacked(void)
+{
+    unsigned char Sacked = 0;
+    unsigned short BlockNum;
+    int i;
+
+    for (i = 0; i < FW_UPDATE_WINDOW_SIZE_MAX - 1; i++) {
+        BlockNum = SlaveCtrl.BlockNum + 2 + i;
+        if (SlaveHeldNum[BlockNum % FW_UPDATE_WINDOW_SIZE_MAX] == BlockNum) {
+            Sacked |= 1 << i;
+        }
+    }
+    return Sacked;
+}
+
 static int FW_UPDATE_BuildAckFrame(FW_UPDATE_FrameTypeDef *Frame, unsigned short BlockNum)
 {
     Frame->Type = FW_UPDATE_FRAME_TYPE_ACK;
     Frame->Len = 2;
     Frame->Payload[0] = BlockNum & 0xff;
     Frame->Payload[1] = BlockNum >> 8;
+    if (SlaveCaps & FW_UPDATE_CAP_SACK) {
+        Frame->Payload[Frame->Len++] = FW_UPDATE_SlaveSacked();
+    }
+    if (SlaveCaps & FW_UPDATE_CAP_BUSY) {
+        Frame->Payload[Frame->Len++] = FW_UPDATE_SlaveFlags();
+    }
+
+    return FW_UPDATE_SealFrame(Frame);
+}
 
-    Frame->CheckSum = FW_UPDATE_CalculateCheckSum(&Frame->Type, 3 + Frame->Len);
+/*
+ * write received data to flash,
+ * and avoid first block data writing boot flag as head of time.
+ */
+static void FW_UPDATE_SlaveWriteBlock(unsigned short BlockNum, const unsigned char *Data, unsigned short Len)
+{
+    erase_ahead_ensure(&SlaveErase, SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize, Len);
+    if (1 == BlockNum)
+    {
+        // unfill boot flag in ota procedure
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr, Data, 8);
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr + 12, &Data[12], Len - 12);
+    }
+    else
+    {
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize, Data, Len);
+    }
+
+    SlaveCtrl.BlockNum = BlockNum;
+    SlaveCtrl.TotalBinSize += Len;
 
-    return (4 + Frame->Len);
+    if (SlaveCtrl.MaxBlockNum == BlockNum) {
+        SlaveCtrl.PktCRC = crc16_update(SlaveCtrl.PktCRC, Data, Len - FW_APPEND_INFO_LEN);
+    } else {
+        SlaveCtrl.PktCRC = crc16_update(SlaveCtrl.PktCRC, Data, Len);
+    }
 }
 
-static void FW_UPDATE_FlashErase(void)
+/*
+ * the data frames of a burst are taken in order up to the first damaged or out-of-order one,
+ * whatever follows is sent again after the cumulative ACK. With FW_UPDATE_CAP_SACK the frames past
+ * a damaged one are held until it comes again, and only the missing ones are sent again
+ */
+static void FW_UPDATE_SlaveTakeBurst(const unsigned char *Data, unsigned int RxLen)
 {
-    int SectorAddr = SlaveCtrl.FlashAddr;
-    int i = 0;
-    for (i = 0; i < 15; i++) {
-        flash_erase_sector(SectorAddr);
-        SectorAddr += 0x1000;
+    unsigned int Offset = 0;
+    unsigned short BlockNum;
+    unsigned char Slot;
+    int FrameLen;
+
+    while ((SlaveCtrl.BlockNum < SlaveCtrl.MaxBlockNum) && (FrameLen = FW_UPDATE_ParseFrame(&RxFrame, &Data[Offset], RxLen - Offset))) {
+        if ((FW_UPDATE_FRAME_TYPE_DATA != RxFrame.Type) || (RxFrame.Len < 2)) {
+            break;
+        }
+        BlockNum = RxFrame.Payload[1];
+        BlockNum <<= 8;
+        BlockNum += RxFrame.Payload[0];
+        if (BlockNum > SlaveCtrl.BlockNum + 1) {
+            if (!(SlaveCaps & FW_UPDATE_CAP_SACK)) {
+                break;
+            }
+            if ((BlockNum <= SlaveCtrl.BlockNum + SlaveCtrl.WindowSize) && (BlockNum <= SlaveCtrl.MaxBlockNum)) {
+                Slot = BlockNum % FW_UPDATE_WINDOW_SIZE_MAX;
+                memcpy(SlaveHeld[Slot], &RxFrame.Payload[2], RxFrame.Len - 2);
+                SlaveHeldLen[Slot] = RxFrame.Len - 2;
+                SlaveHeldNum[Slot] = BlockNum;
+            }
+        }
+        //blocks already written are skipped, a lost ACK makes the master send them again
+        if (BlockNum == SlaveCtrl.BlockNum + 1) {
+            FW_UPDATE_SlaveWriteBlock(BlockNum, &RxFrame.Payload[2], RxFrame.Len - 2);
+            //the blocks held past it follow in order
+            while (SlaveHeldNum[(SlaveCtrl.BlockNum + 1) % FW_UPDATE_WINDOW_SIZE_MAX] == SlaveCtrl.BlockNum + 1) {
+                Slot = (SlaveCtrl.BlockNum + 1) % FW_UPDATE_WINDOW_SIZE_MAX;
+                SlaveHeldNum[Slot] = 0;
+                FW_UPDATE_SlaveWriteBlock(SlaveCtrl.BlockNum + 1, SlaveHeld[Slot], SlaveHeldLen[Slot]);
+            }
+        }
+        Offset += FrameLen;
     }
 }
 
+/* read the received image back, returns 1 if it matches the frames received and the CRC it carries */
+static int FW_UPDATE_SlaveCheckImage(void)
+{
+    flash_read_page((unsigned long)SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize - FW_APPEND_INFO_LEN,
+                    FW_APPEND_INFO_LEN, (unsigned char *)&SlaveCtrl.TargetFwCRC);
+    SlaveCtrl.FwCRC = SlaveCtrl.TargetFwCRC;
+    return (SlaveCtrl.PktCRC == SlaveCtrl.TargetFwCRC) &&
+           image_check_full(SlaveCtrl.FlashAddr, SlaveCtrl.TotalBinSize, SlaveCtrl.TargetFwCRC);
+}
+
 void FW_UPDATE_SlaveInit(unsigned int FWBinAddr, unsigned short FwVer)
 {
     SlaveCtrl.FlashAddr = FWBinAddr;
@@ -472,8 +929,9 @@ void FW_UPDATE_SlaveInit(unsigned int FWBinAddr, unsigned short FwVer)
     SlaveCtrl.FwCRC = 0;
     SlaveCtrl.PktCRC = 0;
     SlaveCtrl.TargetFwCRC = 0;
-    //erase the FW_UPDATE write area
-    FW_UPDATE_FlashErase();
+    FW_UPDATE_Framing = FW_UPDATE_FRAMING_LEGACY;
+    page_stage_init(&SlaveStage);
+    //the FW_UPDATE write area is erased once the START_REQ tells how much of it is needed
 }
 
 void FW_UPDATE_SlaveStart(void)
@@ -492,21 +950,41 @@ void FW_UPDATE_SlaveStart(void)
     else if (FW_UPDATE_SLAVE_STATE_FW_VERSION_READY == SlaveCtrl.State) {
         if (Msg) {
             //if receive a valid uart packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
                 //if receive the valid FW version request
                 if ((FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) &&
                 (FW_UPDATE_CMD_ID_VERSION_REQ == RxFrame.Payload[0])) {
 
                     SlaveCtrl.RetryTimes = 0;
+                    //failures are paid from the session budget from here on
+                    retry_policy_init(&SlaveRetry, FW_UPDATE_RESPONSE_WAIT_TIME, FW_UPDATE_RESPONSE_WAIT_TIME,
+                                      FW_UPDATE_RESPONSE_WAIT_TIME, FW_UPDATE_RETRY_BUDGET * 2, FW_UPDATE_RETRY_BURST_MAX);
                     /* Cancel the response wait timer*/
                     if (FW_UPDATE_rspWaitTimer) {
                         ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                     }
-                    //send the FW version response to master
+                    SlavePeerSysClk = 0;
+                    SlavePeerMaxBaud = 0;
+                    if (RxFrame.Len >= 9) {
+                        memcpy(&SlavePeerSysClk, &RxFrame.Payload[1], sizeof(SlavePeerSysClk));
+                        memcpy(&SlavePeerMaxBaud, &RxFrame.Payload[5], sizeof(SlavePeerMaxBaud));
+                    }
+                    //a legacy master offers nothing and gets the legacy framing back
+                    SlaveCaps = (RxFrame.Len >= 10) ? (RxFrame.Payload[9] & FW_UPDATE_CAPS) : 0;
+                    //the slave resyncs on the frames past a damaged one by their CRC-16
+                    if (!(SlaveCaps & FW_UPDATE_CAP_CRC16)) {
+                        SlaveCaps &= ~FW_UPDATE_CAP_SACK;
+                    }
+                    if (SlaveCaps & FW_UPDATE_CAP_CRC16) {
+                        FW_UPDATE_Framing = FW_UPDATE_FRAMING_OFFERED;
+                    }
+                    //send the FW version response to master, the rate capabilities and the agreed ones follow the version
+                    unsigned char Param[2 + 8 + 1];
+                    memcpy(Param, &SlaveCtrl.FwVersion, sizeof(SlaveCtrl.FwVersion));
+                    Len = 2 + FW_UPDATE_PutBaudCaps(&Param[2]);
+                    Param[Len++] = SlaveCaps;
                     SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_START_READY;
-                    Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_VERSION_RSP, (unsigned char *)&SlaveCtrl.FwVersion, sizeof(SlaveCtrl.FwVersion));
+                    Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_VERSION_RSP, Param, Len);
 
                     FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
                     /* Start the response wait timer*/
@@ -531,15 +1009,13 @@ void FW_UPDATE_SlaveStart(void)
     else if (FW_UPDATE_SLAVE_STATE_START_READY == SlaveCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
             	debug_step = 1;
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
                 if (FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) {
                 	debug_step = 2;
                     //if receive the FW version request again
                     if (FW_UPDATE_CMD_ID_VERSION_REQ == RxFrame.Payload[0]) {
-                        SlaveCtrl.RetryTimes = 0;
+                        retry_policy_success(&SlaveRetry, 0);
                         /* Cancel the response wait timer*/
                         if (FW_UPDATE_rspWaitTimer) {
                             ev_unon_timer(&FW_UPDATE_rspWaitTimer);
@@ -550,19 +1026,75 @@ void FW_UPDATE_SlaveStart(void)
                         FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
                         return;
                     }
+                    //if receive a rate to switch to, 0 in the response refuses it
+                    if (FW_UPDATE_CMD_ID_BAUD_REQ == RxFrame.Payload[0]) {
+                        unsigned int Baud = 0;
+                        memcpy(&Baud, &RxFrame.Payload[1], sizeof(Baud));
+                        retry_policy_success(&SlaveRetry, 0);
+                        /* Cancel the response wait timer*/
+                        if (FW_UPDATE_rspWaitTimer) {
+                            ev_unon_timer(&FW_UPDATE_rspWaitTimer);
+                        }
+                        if (!FW_UPDATE_BaudActual(Baud, FW_UPDATE_PHY_SysClock(), FW_UPDATE_BAUD_MAX) ||
+                            (SlavePeerSysClk && !FW_UPDATE_BaudActual(Baud, SlavePeerSysClk, SlavePeerMaxBaud))) {
+                            Baud = 0;
+                        }
+                        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_BAUD_RSP, (unsigned char *)&Baud, sizeof(Baud));
+                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        if (Baud) {
+                            //the response still goes out at the old rate, the test pattern comes at the new one
+                            FW_UPDATE_PHY_SetBaudrate(Baud);
+                            SlaveBaudTrial = 1;
+                            FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_BAUD_SETTLE);
+                        }
+                        else {
+                            FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                        }
+                        return;
+                    }
+                    //if receive the test pattern at the trial rate, echo it
+                    if ((FW_UPDATE_CMD_ID_BAUD_TEST_REQ == RxFrame.Payload[0]) && SlaveBaudTrial) {
+                        retry_policy_success(&SlaveRetry, 0);
+                        /* Cancel the response wait timer*/
+                        if (FW_UPDATE_rspWaitTimer) {
+                            ev_unon_timer(&FW_UPDATE_rspWaitTimer);
+                        }
+                        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_BAUD_TEST_RSP, &RxFrame.Payload[1], RxFrame.Len - 1);
+                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        /* Start the response wait timer, the START_REQ at the trial rate settles it*/
+                        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                        return;
+                    }
                     //if receive the FW_UPDATE start request
                     if (FW_UPDATE_CMD_ID_START_REQ == RxFrame.Payload[0]) {
                     	debug_step = 3;
-                        SlaveCtrl.RetryTimes = 0;
+                        SlaveBaudTrial = 0;
+                        retry_policy_success(&SlaveRetry, 0);
                         /* Cancel the response wait timer*/
                         if (FW_UPDATE_rspWaitTimer) {
                             ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                         }
                         memcpy(&SlaveCtrl.MaxBlockNum, &RxFrame.Payload[1], sizeof(SlaveCtrl.MaxBlockNum));
-                        //send the FW_UPDATE start response to master
+                        //a master proposing no window only runs stop-and-wait
+                        SlaveCtrl.WindowSize = 1;
+                        if ((RxFrame.Len >= 4) && (RxFrame.Payload[3] > 1)) {
+                            SlaveCtrl.WindowSize = (RxFrame.Payload[3] < FW_UPDATE_WINDOW_SIZE_MAX) ? RxFrame.Payload[3] : FW_UPDATE_WINDOW_SIZE_MAX;
+                        }
+                        SlaveNewVersion = (RxFrame.Len >= 6) ? (RxFrame.Payload[4] | (RxFrame.Payload[5] << 8)) : SLOT_VERSION_UNKNOWN;
+                        erase_ahead_init(&SlaveErase, SlaveCtrl.FlashAddr, SlaveCtrl.MaxBlockNum * (FW_UPDATE_FRAME_PAYLOAD_MAX - 2));
+                        memset(SlaveHeldNum, 0, sizeof(SlaveHeldNum));
+                        //the budget grows with the image as the master's does
+                        retry_policy_init(&SlaveRetry, FW_UPDATE_RESPONSE_WAIT_TIME, FW_UPDATE_RESPONSE_WAIT_TIME, FW_UPDATE_RESPONSE_WAIT_TIME,
+                                          (FW_UPDATE_RETRY_BUDGET + SlaveCtrl.MaxBlockNum) * 2, FW_UPDATE_RETRY_BURST_MAX);
+                        //send the FW_UPDATE start response to master, the agreed window and the flags
+                        unsigned char Param[2];
+                        Param[0] = SlaveCtrl.WindowSize;
+                        Param[1] = FW_UPDATE_SlaveFlags();
                         SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_DATA_READY;
-                        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_START_RSP, 0, 0);
+                        Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_START_RSP, Param, (SlaveCaps & FW_UPDATE_CAP_BUSY) ? 2 : 1);
                         FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                        //the first sector is needed right away, erase it while the response is on its way
+                        erase_ahead_idle(&SlaveErase, SlaveCtrl.FlashAddr);
                         /* Start the response wait timer*/
                         FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
                         return;
@@ -570,11 +1102,19 @@ void FW_UPDATE_SlaveStart(void)
                 }
             }
 
-            if (SlaveCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            //noise at the trial rate is ignored, silence drops it and the master steps down its ladder
+            if (SlaveBaudTrial) {
+                if (FW_UPDATE_MSG_TYPE_TIMEOUT == Msg->Type) {
+                    SlaveBaudTrial = 0;
+                    FW_UPDATE_PHY_SetBaudrate(FW_UPDATE_PHY_BAUDRATE);
+                    FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                }
+                return;
+            }
+            if (!retry_policy_failure(&SlaveRetry)) {
                 SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_ERROR;
                 return;
             }
-            SlaveCtrl.RetryTimes++;
             /* Start the response wait timer again*/
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
@@ -585,13 +1125,11 @@ void FW_UPDATE_SlaveStart(void)
     else if (FW_UPDATE_SLAVE_STATE_DATA_READY == SlaveCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
                 //if receive the FW_UPDATE start request again
                 if (FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) {
                     if (FW_UPDATE_CMD_ID_START_REQ == RxFrame.Payload[0]) {
-                        SlaveCtrl.RetryTimes = 0;
+                        retry_policy_success(&SlaveRetry, 0);
                         /* Cancel the response wait timer*/
                         if (FW_UPDATE_rspWaitTimer) {
                             ev_unon_timer(&FW_UPDATE_rspWaitTimer);
@@ -603,75 +1141,34 @@ void FW_UPDATE_SlaveStart(void)
                         return;
                     }
                 }
-                //if receive the FW_UPDATE data frame
+                //if receive a burst of FW_UPDATE data frames, respond with the cumulative ACK
                 if (FW_UPDATE_FRAME_TYPE_DATA == RxFrame.Type) {
-                    //check the block number included in the incoming frame
-                    unsigned short BlockNum = RxFrame.Payload[1];
-                    BlockNum <<= 8;
-                    BlockNum += RxFrame.Payload[0];
-                    //if receive the same FW_UPDATE data frame again, just respond with the same ACK
-                    if (BlockNum == SlaveCtrl.BlockNum) {
-                        SlaveCtrl.RetryTimes = 0;
-                        /* Cancel the response wait timer*/
-                        if (FW_UPDATE_rspWaitTimer) {
-                            ev_unon_timer(&FW_UPDATE_rspWaitTimer);
-                        }
-                        //send the FW_UPDATE data ack again to master
-                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
-                        /* Start the response wait timer*/
-                        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
-                        return;
+                    retry_policy_success(&SlaveRetry, 0);
+                    /* Cancel the response wait timer*/
+                    if (FW_UPDATE_rspWaitTimer) {
+                        ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                     }
-                    //if receive the next FW_UPDATE data frame, just respond with an ACK
-                    if (BlockNum == SlaveCtrl.BlockNum + 1) {
-                        SlaveCtrl.RetryTimes = 0;
-                        /* Cancel the response wait timer*/
-                        if (FW_UPDATE_rspWaitTimer) {
-                            ev_unon_timer(&FW_UPDATE_rspWaitTimer);
-                        }
-//                        printf("block_num:%d, len:%d, PktCRC:%2x\r\n", BlockNum, RxFrame.Len - 2, SlaveCtrl.PktCRC);
-
-                        /*
-                         * write received data to flash,
-                         * and avoid first block data writing boot flag as head of time.
-                         */
-
-                        if (1 == BlockNum)
-                        {
-                            // unfill boot flag in ota procedure
-                            flash_write_page(SlaveCtrl.FlashAddr, 8, &RxFrame.Payload[2]);
-                            flash_write_page(SlaveCtrl.FlashAddr + 12, RxFrame.Len - 2 - 12, &RxFrame.Payload[2 + 12]);
-                        }
-                        else
-                        {
-                            flash_write_page(SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize, RxFrame.Len - 2, &RxFrame.Payload[2]);
-                        }
-
-                        SlaveCtrl.BlockNum = BlockNum;
-                        SlaveCtrl.TotalBinSize += (RxFrame.Len - 2);
-
-                        if (SlaveCtrl.MaxBlockNum == BlockNum) {
-                        	SlaveCtrl.PktCRC = FW_CRC16_Cal(SlaveCtrl.PktCRC, &RxFrame.Payload[2], RxFrame.Len - 2 - FW_APPEND_INFO_LEN);
-                            SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_END_READY;
-                        } else {
-                        	SlaveCtrl.PktCRC = FW_CRC16_Cal(SlaveCtrl.PktCRC, &RxFrame.Payload[2], RxFrame.Len - 2);
-                        }
-
-                        //send the FW_UPDATE data ack to master
-                        Len = FW_UPDATE_BuildAckFrame(&TxFrame, BlockNum);
-                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
-                        /* Start the response wait timer again*/
-                        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
-                        return;
+                    FW_UPDATE_SlaveTakeBurst(Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data));
+                    if (SlaveCtrl.MaxBlockNum == SlaveCtrl.BlockNum) {
+                        SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_END_READY;
                     }
+
+                    //send the FW_UPDATE data ack to master
+                    Len = FW_UPDATE_BuildAckFrame(&TxFrame, SlaveCtrl.BlockNum);
+                    FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                    //erase ahead and program the staged page while the next burst is on its way
+                    erase_ahead_idle(&SlaveErase, SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize);
+                    page_stage_flush_pending(&SlaveStage);
+                    /* Start the response wait timer again*/
+                    FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                    return;
                 }
             }
 
-            if (SlaveCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            if (!retry_policy_failure(&SlaveRetry)) {
                 SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_ERROR;
                 return;
             }
-            SlaveCtrl.RetryTimes++;
             /* Start the response wait timer again*/
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
@@ -682,33 +1179,24 @@ void FW_UPDATE_SlaveStart(void)
     else if (FW_UPDATE_SLAVE_STATE_END_READY == SlaveCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
-            if (Msg->Type == FW_UPDATE_MSG_TYPE_DATA) {
-                memcpy(&RxFrame, Msg->Data, 4);
-                memcpy(RxFrame.Payload, Msg->Data + 4, RxFrame.Len);
-                //if receive the last FW_UPDATE data frame again
+            if ((Msg->Type == FW_UPDATE_MSG_TYPE_DATA) && FW_UPDATE_ParseFrame(&RxFrame, Msg->Data, FW_UPDATE_PHY_RxLen(Msg->Data))) {
+                //if receive the last FW_UPDATE data burst again, every block is in and the same ACK is due
                 if (FW_UPDATE_FRAME_TYPE_DATA == RxFrame.Type) {
-                    //check the block number included in the incoming frame
-                    unsigned short BlockNum = RxFrame.Payload[1];
-                    BlockNum <<= 8;
-                    BlockNum += RxFrame.Payload[0];
-                    //if receive the same FW_UPDATE data frame again, just respond with the same ACK
-                    if (BlockNum == SlaveCtrl.BlockNum) {
-                        SlaveCtrl.RetryTimes = 0;
-                        /* Cancel the response wait timer */
-                        if (FW_UPDATE_rspWaitTimer) {
-                            ev_unon_timer(&FW_UPDATE_rspWaitTimer);
-                        }
-                        //send the FW_UPDATE data ack again to master
-                        FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
-                        /* Start the response wait timer */
-                        FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
-                        return;
+                    retry_policy_success(&SlaveRetry, 0);
+                    /* Cancel the response wait timer */
+                    if (FW_UPDATE_rspWaitTimer) {
+                        ev_unon_timer(&FW_UPDATE_rspWaitTimer);
                     }
+                    //send the FW_UPDATE data ack again to master
+                    FW_UPDATE_PHY_SendData((unsigned char *)&TxFrame, Len);
+                    /* Start the response wait timer */
+                    FW_UPDATE_rspWaitTimer = ev_on_timer(FW_UPDATE_rspWaitTimerCb, NULL, FW_UPDATE_RESPONSE_WAIT_TIME);
+                    return;
                 }
                 //if receive the FW_UPDATE end request
                 if (FW_UPDATE_FRAME_TYPE_CMD == RxFrame.Type) {
                     if (FW_UPDATE_CMD_ID_END_REQ == RxFrame.Payload[0]) {
-                        SlaveCtrl.RetryTimes = 0;
+                        retry_policy_success(&SlaveRetry, 0);
                         /* Cancel the response wait timer */
                         if (FW_UPDATE_rspWaitTimer) {
                             ev_unon_timer(&FW_UPDATE_rspWaitTimer);
@@ -719,7 +1207,13 @@ void FW_UPDATE_SlaveStart(void)
                             SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_ERROR;
                             return;
                         }
-
+                        //the END_RSP is only sent once the whole image is durable and checked,
+                        //a master that gets none reports the update as failed
+                        page_stage_flush(&SlaveStage);
+                        if (!FW_UPDATE_SlaveCheckImage()) {
+                            SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_ERROR;
+                            return;
+                        }
                         SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_END;
                         //send the FW_UPDATE end response to master
                         Len = FW_UPDATE_BuildCmdFrame(&TxFrame, FW_UPDATE_CMD_ID_END_RSP, 0, 0);
@@ -730,11 +1224,10 @@ void FW_UPDATE_SlaveStart(void)
                 }
             }
 
-            if (SlaveCtrl.RetryTimes == FW_UPDATE_RETRY_MAX) {
+            if (!retry_policy_failure(&SlaveRetry)) {
                 SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_ERROR;
                 return;
             }
-            SlaveCtrl.RetryTimes++;
             /* Start the response wait timer again*/
             if (FW_UPDATE_rspWaitTimer) {
                 ev_unon_timer(&FW_UPDATE_rspWaitTimer);
@@ -743,63 +1236,8 @@ void FW_UPDATE_SlaveStart(void)
         }
     }
     else if (FW_UPDATE_SLAVE_STATE_END == SlaveCtrl.State) {
-
-        // 1. todo FW crc check
-        unsigned char bin_buf[64] = {0};
-        int block_idx = 0;
-        int len = 0;
-//        SlaveCtrl.TotalBinSize -= FW_APPEND_INFO_LEN;
-        flash_read_page((unsigned long)SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize - FW_APPEND_INFO_LEN,
-                2, &SlaveCtrl.TargetFwCRC);
-        while (1)
-        {
-            if (SlaveCtrl.TotalBinSize - block_idx * (FW_UPDATE_FRAME_PAYLOAD_MAX -2) > (FW_UPDATE_FRAME_PAYLOAD_MAX - 2))
-            {
-                len = FW_UPDATE_FRAME_PAYLOAD_MAX - 2;
-                flash_read_page((unsigned long)SlaveCtrl.FlashAddr + block_idx * (FW_UPDATE_FRAME_PAYLOAD_MAX - 2),
-                        len, &bin_buf[0]);
-                if (0 == block_idx)
-                {
-                    // fill the boot flag mannually
-                    bin_buf[8] = 0x4b;
-                    bin_buf[9] = 0x4e;
-                    bin_buf[10] = 0x4c;
-                    bin_buf[11] = 0x54;
-                }
-                SlaveCtrl.FwCRC = FW_CRC16_Cal(SlaveCtrl.FwCRC, &bin_buf[0], len);
-            }
-            else
-            {
-                len = SlaveCtrl.TotalBinSize - (block_idx * (FW_UPDATE_FRAME_PAYLOAD_MAX - 2)) - FW_APPEND_INFO_LEN;
-                flash_read_page((unsigned long)SlaveCtrl.FlashAddr + block_idx * (FW_UPDATE_FRAME_PAYLOAD_MAX - 2),
-                          len, &bin_buf[0]);
-                  SlaveCtrl.FwCRC = FW_CRC16_Cal(SlaveCtrl.FwCRC, &bin_buf[0], len);
-                  break;
-            }
-            block_idx++;
-//            printf("fw block idx:%d, len:%d, FwCRC:%2x\r\n", block_idx, len, SlaveCtrl.FwCRC);
-        }
-//        printf("fw block idx:%d, len:%d, FwCRC:%2x  \r\n", block_idx + 1, len, SlaveCtrl.FwCRC);
-//        printf("pkt_crc:%2x, fw_crc:%2x, target_fw_crc:%2x\r\n", SlaveCtrl.PktCRC, SlaveCtrl.FwCRC, SlaveCtrl.TargetFwCRC);
-        if (SlaveCtrl.FwCRC != SlaveCtrl.PktCRC || SlaveCtrl.TargetFwCRC != SlaveCtrl.FwCRC)
-        {
-//            printf("Crc Check Error\r\n");
-            SlaveCtrl.State = FW_UPDATE_SLAVE_STATE_ERROR;
-            return;
-        }
-
-        // 2. set next boot flag
-        unsigned int utmp = 0x544C4E4B;
-        flash_write_page(SlaveCtrl.FlashAddr + 8, 4, (unsigned char *)&utmp);
-
-        // 3. clear current boot flag
-        unsigned char tmp = 0x00;
-#if (FW_UPDATE_SLAVE_BIN_ADDR == FW_UPDATE_SLAVE_BIN_ADDR_20000)
-        flash_write_page(SlaveCtrl.FlashAddr ? 0x08 : 0x20008, 1, &tmp);
-#else
-        flash_write_page(0x20008, 1, &tmp);
-        flash_write_page(SlaveCtrl.FlashAddr ? 0x08 : 0x40008, 1, &tmp);
-#endif
+        //boot the new image on trial, the current one is booted again if it never confirms itself
+        slot_switch(SlaveCtrl.FlashAddr, SlaveNewVersion, SlaveCtrl.FwCRC, SlaveCtrl.TotalBinSize);
         if (SlaveCtrl.FlashAddr == 0x00)
         {
 //            printf("cur_boot_addr:%4x, next_boot_addr:%4x\r\n", FW_UPDATE_SLAVE_BIN_ADDR, 0x0000);
@@ -830,8 +1268,7 @@ void FW_UPDATE_SlaveStart(void)
         while(1);
     }
     else if (FW_UPDATE_SLAVE_STATE_ERROR == SlaveCtrl.State) {
-        //erase the FW_UPDATE write area
-        FW_UPDATE_FlashErase();
+        //the data left in the FW_UPDATE area is erased on demand by the next session
         //reboot
         irq_disable();
         gpio_set_output_en(RED_LED_PIN, 1); //enable output
@@ -848,4 +1285,11 @@ void FW_UPDATE_SlaveStart(void)
     }
 }
 
+/* 1 once the slave answered a master, the running image has shown its UART works */
+int FW_UPDATE_SlaveExchanged(void)
+{
+    return (FW_UPDATE_SLAVE_STATE_IDLE != SlaveCtrl.State) && (FW_UPDATE_SLAVE_STATE_FW_VERSION_READY != SlaveCtrl.State) &&
+           (FW_UPDATE_SLAVE_STATE_ERROR != SlaveCtrl.State);
+}
+
 #endif /*FW_UPDATE_MASTER_EN*/
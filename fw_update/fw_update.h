@@ -56,9 +56,40 @@
 #define FW_UPDATE_CMD_ID_END_RSP        0x04
 #define FW_UPDATE_CMD_ID_VERSION_REQ    0x05
 #define FW_UPDATE_CMD_ID_VERSION_RSP    0x06
+#define FW_UPDATE_CMD_ID_BAUD_REQ       0x07
+#define FW_UPDATE_CMD_ID_BAUD_RSP       0x08
+#define FW_UPDATE_CMD_ID_BAUD_TEST_REQ  0x09
+#define FW_UPDATE_CMD_ID_BAUD_TEST_RSP  0x0a
 
 #define FW_UPDATE_FRAME_PAYLOAD_MAX     (2+64)
+#define FW_UPDATE_FRAME_HEAD_LEN        5 //CheckSum, Len and Type ahead of the payload
+#define FW_UPDATE_LEGACY_HEAD_LEN       4 //8-bit XOR checksum, Type and Len, the framing of peers without FW_UPDATE_CAP_CRC16
+#define FW_UPDATE_FRAME_LEN_MAX         (FW_UPDATE_FRAME_HEAD_LEN+FW_UPDATE_FRAME_PAYLOAD_MAX)
+#define FW_UPDATE_WINDOW_SIZE_MAX       8 //data frames of one burst, the DMA buffers of fw_update_phy.c hold that many
+#ifndef FW_UPDATE_WINDOW_SIZE
+#define FW_UPDATE_WINDOW_SIZE           FW_UPDATE_WINDOW_SIZE_MAX //window proposed by the master, 1 means stop-and-wait
+#endif
+#define FW_UPDATE_CAP_CRC16             0x01 //the frames after VERSION_RSP carry the CRC-16 header
+#define FW_UPDATE_CAP_BUSY              0x02 //START_RSP and the ACKs end in a flags byte
+#define FW_UPDATE_CAP_SACK              0x04 //the ACKs carry the blocks held past the cumulative ACK point, needs FW_UPDATE_CAP_CRC16
+#define FW_UPDATE_CAPS                  (FW_UPDATE_CAP_CRC16 | FW_UPDATE_CAP_BUSY | FW_UPDATE_CAP_SACK) //offered after the rate capabilities in VERSION_REQ/VERSION_RSP
+#define FW_UPDATE_FLAG_BUSY             0x01 //the slave erases a sector right after this response
 #define FW_UPDATE_RETRY_MAX             3
+#ifndef FW_UPDATE_RETRY_BUDGET
+#define FW_UPDATE_RETRY_BUDGET          128 //failures a session may take on top of one per block, see retry_policy.h
+#endif
+#define FW_UPDATE_RETRY_BURST_MAX       8   //consecutive failures that end a session, each doubles the timeout
+#define FW_UPDATE_RTO_INIT              (1000 * 1000) //in us, response timeout until the round trip time is measured
+#define FW_UPDATE_RTO_MIN               (20 * 1000) //in us, the slave programs a staged page after an ACK
+#define FW_UPDATE_BUSY_WAIT             (ERASE_AHEAD_SECTOR_ERASE_MAX_US + 20 * 1000) //in us, on top of the response wait after FW_UPDATE_FLAG_BUSY, see erase_ahead.h
+#define FW_UPDATE_RTO_MAX               (2000 * 1000) //in us
+#ifndef FW_UPDATE_BAUD_MAX
+#define FW_UPDATE_BAUD_MAX              2000000 //in bps, the fastest rate this side offers, e.g. what the fixture wiring carries
+#endif
+#define FW_UPDATE_BAUD_LADDER           {2000000, 1500000, 1000000, 921600, 460800, 230400} //tried from the top down
+#define FW_UPDATE_BAUD_TOLERANCE        2 //in percent, how far the rate one side generates may be off the ladder rate
+#define FW_UPDATE_BAUD_SETTLE           (50 * 1000) //in us, a trial rate that passes no test pattern for so long is dropped
+#define FW_UPDATE_BAUD_PATTERN_LEN      64
 #define FW_APPEND_INFO_LEN              2 // FW_CRC 2 BYTE
 #define FW_BOOT_ADDR                    0x7f000
 
@@ -78,18 +109,26 @@ typedef struct {
     unsigned char State;
     unsigned char RetryTimes;
     unsigned char FinishFlag;
+    unsigned char WindowSize; //agreed in START_REQ/START_RSP, legacy peers only take 1
 } FW_UPDATE_CtrlTypeDef;
 
+/*
+ * both sides start with the framing of legacy peers, {XOR checksum, Type, Len, payload}, and the master offers
+ * FW_UPDATE_CAP_CRC16 in VERSION_REQ. A slave taking it answers with this header from VERSION_RSP on, and the master
+ * sends it from then on too. Legacy frames are only taken until the CRC-16 header is agreed
+ */
 typedef struct {
-    unsigned char CheckSum;
-    unsigned char Type;
+    unsigned short CheckSum; //CRC-16/KERMIT of Len, Type and the payload
     unsigned short Len;
+    unsigned char Type;
     unsigned char Payload[FW_UPDATE_FRAME_PAYLOAD_MAX];
 } FW_UPDATE_FrameTypeDef;
 
 enum {
     FW_UPDATE_MASTER_STATE_IDLE = 0,
     FW_UPDATE_MASTER_STATE_FW_VER_WAIT,
+    FW_UPDATE_MASTER_STATE_BAUD_RSP_WAIT,
+    FW_UPDATE_MASTER_STATE_BAUD_TEST_WAIT,
     FW_UPDATE_MASTER_STATE_START_RSP_WAIT,
     FW_UPDATE_MASTER_STATE_DATA_ACK_WAIT,
     FW_UPDATE_MASTER_STATE_END_RSP_WAIT,
@@ -118,6 +157,7 @@ extern void FW_UPDATE_MasterStart(void);
 
 extern void FW_UPDATE_SlaveInit(unsigned int FWBinAddr, unsigned short FwVer);
 extern void FW_UPDATE_SlaveStart(void);
+extern int FW_UPDATE_SlaveExchanged(void);
 
 extern void FW_UPDATE_RxIrq(unsigned char *Data);
 
@@ -49,14 +49,16 @@
 #include "common.h"
 
 
-#define PHY_TX_BUF_LEN          96
-#define PHY_RX_BUF_LEN          96
+//a whole burst of data frames arrives as one DMA transfer, the buffer length is counted in 16 bytes
+#define PHY_BUF_LEN             ((4 + FW_UPDATE_WINDOW_SIZE_MAX*FW_UPDATE_FRAME_LEN_MAX + 15) / 16 * 16)
+#define PHY_TX_BUF_LEN          PHY_BUF_LEN
+#define PHY_RX_BUF_LEN          PHY_BUF_LEN
 #define PHY_RX_BUF_NUM          3
 
 #define CLOCK_SYS_CLOCK_HZ      24000000
 #define UART_TX_PIN_PD0         GPIO_PD0
 #define UART_RX_PIN_PC6         GPIO_PC6
-#define UART_DATA_LEN    		(96-4)      //data max (UART_DATA_LEN+4) must 16 byte aligned
+#define UART_DATA_LEN    		(PHY_BUF_LEN-4)      //data max (UART_DATA_LEN+4) must 16 byte aligned
 typedef struct{
     unsigned int dma_len;        // dma len must be 4 byte
     unsigned char data[UART_DATA_LEN];
@@ -66,7 +68,8 @@ typedef struct{
 
 
 PHY_Cb_t PHYRxCb = NULL;
-static volatile unsigned char PHY_TxFinished = 0;
+static volatile unsigned char PHY_TxBusy = 0; //the DMA still reads PHY_TxBuf
+static unsigned char PHY_TxUsed = 0; //the TX_DONE flag only tells something once a frame went out
 
 static uart_data_t PHY_TxBuf __attribute__ ((aligned (4))) = {};
 
@@ -88,7 +91,7 @@ void FW_UPDATE_PHY_Init(const PHY_Cb_t RxCb)
 
     uart_reset();  //will reset uart digital registers from 0x90 ~ 0x9f, so uart setting must set after this reset
 
-    uart_init_baudrate(115200, CLOCK_SYS_CLOCK_HZ, PARITY_NONE, STOP_BIT_ONE);
+    uart_init_baudrate(FW_UPDATE_PHY_BAUDRATE, CLOCK_SYS_CLOCK_HZ, PARITY_NONE, STOP_BIT_ONE);
 
     uart_dma_enable(1, 1);     //uart data in hardware buffer moved by dma, so we need enable them first
 
@@ -100,22 +103,50 @@ void FW_UPDATE_PHY_Init(const PHY_Cb_t RxCb)
 
 }
 
+/* returns once the DMA took over, only the next call waits for it to finish with the buffer */
 int FW_UPDATE_PHY_SendData(const unsigned char *Payload, const int PayloadLen)
 {
+    if (PayloadLen > UART_DATA_LEN) {
+        return 0;
+    }
+    while (PHY_TxBusy);
+
     //set UART DMA length
-	PHY_TxBuf.dma_len = PayloadLen;
+    PHY_TxBuf.dma_len = PayloadLen;
 
     //fill the contents of UART transmission
     memcpy(&PHY_TxBuf.data, Payload, PayloadLen);
 
+    PHY_TxBusy = 1;
+    PHY_TxUsed = 1;
 //    uart_dma_send((unsigned char*)&PHY_TxBuf);
     uart_send_dma((unsigned char*)&PHY_TxBuf);
-    while(!PHY_TxFinished);
-    PHY_TxFinished = 0;
 
     return PayloadLen;
 }
 
+/* the frame on the line is finished at the old rate before the divider changes */
+void FW_UPDATE_PHY_SetBaudrate(unsigned int Baudrate)
+{
+    while (PHY_TxBusy);
+    while (PHY_TxUsed && uart_tx_is_busy());
+
+    uart_init_baudrate(Baudrate, CLOCK_SYS_CLOCK_HZ, PARITY_NONE, STOP_BIT_ONE);
+}
+
+unsigned int FW_UPDATE_PHY_SysClock(void)
+{
+    return CLOCK_SYS_CLOCK_HZ;
+}
+
+/* bytes the DMA moved into the rx buffer Data was handed to PHYRxCb with */
+unsigned int FW_UPDATE_PHY_RxLen(const unsigned char *Data)
+{
+    const uart_data_t *RxBuf = (const uart_data_t *)(Data - sizeof(RxBuf->dma_len));
+
+    return (RxBuf->dma_len > UART_DATA_LEN) ? UART_DATA_LEN : RxBuf->dma_len;
+}
+
 void FW_UPDATE_PHY_RxIrqHandler(void)
 {
     //set next rx_buf
@@ -129,5 +160,5 @@ void FW_UPDATE_PHY_RxIrqHandler(void)
 
 void FW_UPDATE_PHY_TxIrqHandler(void)
 {
-    PHY_TxFinished = 1;
+    PHY_TxBusy = 0;
 }
@@ -46,12 +46,22 @@
 #ifndef _FW_UPDATE_PHY_H_
 #define _FW_UPDATE_PHY_H_
 
+#ifndef FW_UPDATE_PHY_BAUDRATE
+#define FW_UPDATE_PHY_BAUDRATE  115200 //in bps, every session starts at this rate before a faster one is agreed
+#endif
+
 typedef void (*PHY_Cb_t)(unsigned char *Data);
 
 extern void FW_UPDATE_PHY_Init(const PHY_Cb_t RxCb);
 
 extern int FW_UPDATE_PHY_SendData(const unsigned char *Payload, const int PayloadLen);
 
+extern unsigned int FW_UPDATE_PHY_RxLen(const unsigned char *Data);
+
+extern void FW_UPDATE_PHY_SetBaudrate(unsigned int Baudrate);
+
+extern unsigned int FW_UPDATE_PHY_SysClock(void);
+
 extern void FW_UPDATE_PHY_RxIrqHandler(void);
 
 extern void FW_UPDATE_PHY_TxIrqHandler(void);
@@ -45,16 +45,22 @@
  *******************************************************************************************************/
 
 #include "mac.h"
+#include "ota_telemetry.h"
 #include "driver.h"
 #include "common.h"
 #include "genfsk_ll.h"
 
-#define MAC_TX_BUF_LEN                64
-#define MAC_RX_BUF_LEN                64
-#define MAC_RX_BUF_NUM                4
+#if (MAC_TRANSPORT == MAC_TRANSPORT_GEN_FSK)
+
+#define MAC_TX_BUF_LEN                240
+#define MAC_RX_BUF_LEN                240 //upper limit of gen_fsk_rx_buffer_set()
+#ifndef MAC_RX_BUF_NUM
+#define MAC_RX_BUF_NUM                4 //slots of the rx ring, one is always owned by the radio
+#endif
 #define MAC_STX_WAIT                  30 //in us
 #define MAC_SRX_WAIT                  5  //in us
-#define MAC_RX_WAIT                   200000 //in us
+#define MAC_RX_WAIT                   200000 //in us, until MAC_SetRxWait() tells otherwise
+#define MAC_TX_DONE_WAIT              2000 //in us
 
 #define MAC_RX_PACKET_LENGTH_OK(p)    (p[0] == p[12]+13)
 #define MAC_RX_PACKET_CRC_OK(p)       ((p[p[0]+3] & 0x51) == 0x10)
@@ -70,7 +76,10 @@ MAC_InfoTypeDef mac_Info = {0, 0, 0};
 
 static unsigned char mac_TxBuf[MAC_TX_BUF_LEN] __attribute__ ((aligned (4))) = {};
 static unsigned char mac_RxBuf[MAC_RX_BUF_LEN*MAC_RX_BUF_NUM] __attribute__ ((aligned (4))) = {};
-static unsigned char mac_RxPtr = 0;
+static unsigned char mac_RxPtr = 0; //slot the radio receives into
+static volatile unsigned char mac_RxHeld[MAC_RX_BUF_NUM] = {}; //slot handed to RxCb, until MAC_RxRelease()
+static volatile unsigned char mac_TxDone = 1;
+static unsigned int mac_RxWait = MAC_RX_WAIT;
 
 
 void MAC_Init(const unsigned short Channel,
@@ -94,6 +103,7 @@ void MAC_Init(const unsigned short Channel,
     gen_fsk_packet_format_set(GEN_FSK_PACKET_FORMAT_VARIABLE_PAYLOAD, 8);
     gen_fsk_radio_power_set(GEN_FSK_RADIO_POWER_N0p22dBm);
 
+    memset((unsigned char *)mac_RxHeld, 0, sizeof(mac_RxHeld));
     gen_fsk_rx_buffer_set(mac_RxBuf + mac_RxPtr*MAC_RX_BUF_LEN , MAC_RX_BUF_LEN);
     gen_fsk_channel_set(Channel);
 
@@ -111,13 +121,53 @@ void MAC_Init(const unsigned short Channel,
 void MAC_SendData(const unsigned char *Payload,
                  const int PayloadLen)
 {
-    gen_fsk_stx2rx_start(mac_TxBuf, clock_time()+MAC_STX_WAIT*16, MAC_RX_WAIT);
+    gen_fsk_stx2rx_start(mac_TxBuf, clock_time()+MAC_STX_WAIT*16, mac_RxWait);
+    memcpy(&mac_TxBuf[5], Payload, PayloadLen); //payload
+    mac_TxBuf[0] = PayloadLen + 1;
+    mac_TxBuf[1] = 0x00;
+    mac_TxBuf[2] = 0x00;
+    mac_TxBuf[3] = 0x00;
+    mac_TxBuf[4] = PayloadLen;
+    OTA_Telemetry.TxFrames++;
+}
+
+/* send without switching to RX afterwards, returns once the packet is on air, 0 if it never got there */
+int MAC_SendDataNoAck(const unsigned char *Payload,
+                       const int PayloadLen)
+{
+    unsigned int StartTick;
+
     memcpy(&mac_TxBuf[5], Payload, PayloadLen); //payload
     mac_TxBuf[0] = PayloadLen + 1;
     mac_TxBuf[1] = 0x00;
     mac_TxBuf[2] = 0x00;
     mac_TxBuf[3] = 0x00;
     mac_TxBuf[4] = PayloadLen;
+
+    mac_TxDone = 0;
+    OTA_Telemetry.TxFrames++;
+    StartTick = clock_time();
+    gen_fsk_stx_start(mac_TxBuf, StartTick+MAC_STX_WAIT*16);
+    while (!mac_TxDone && !clock_time_exceed(StartTick, MAC_TX_DONE_WAIT));
+    return mac_TxDone;
+}
+
+/* how long MAC_SendData() listens for the response */
+void MAC_SetRxWait(unsigned int TimeUs)
+{
+    mac_RxWait = TimeUs;
+}
+
+/* takes effect with the next frame sent or listened for */
+void MAC_SetChannel(unsigned short Channel)
+{
+    mac_Info.Channel = Channel;
+    gen_fsk_channel_set(Channel);
+}
+
+unsigned short MAC_GetChannel(void)
+{
+    return mac_Info.Channel;
 }
 
 void MAC_RecvData(unsigned int TimeUs)
@@ -125,32 +175,84 @@ void MAC_RecvData(unsigned int TimeUs)
 	gen_fsk_srx_start(clock_time()+MAC_SRX_WAIT*16, TimeUs);
 }
 
+/* hand a payload passed to RxCb back to the rx ring */
+void MAC_RxRelease(const unsigned char *Data)
+{
+    if (Data) {
+        mac_RxHeld[(Data - mac_RxBuf) / MAC_RX_BUF_LEN] = 0;
+    }
+}
+
+/* next slot not held by the upper layer, -1 if all of them are */
+static int MAC_RxNextFree(void)
+{
+    int i;
+    int Slot = mac_RxPtr;
+
+    for (i = 1; i < MAC_RX_BUF_NUM; i++) {
+        Slot = (Slot + 1) % MAC_RX_BUF_NUM;
+        if (!mac_RxHeld[Slot]) {
+            return Slot;
+        }
+    }
+    return -1;
+}
+
 unsigned char type_debug,rec_flag_debug;
 void MAC_RxIrqHandler(void)
 {
-    //set next rx_buf
     unsigned char *RxPacket = mac_RxBuf + mac_RxPtr*MAC_RX_BUF_LEN;
-    mac_RxPtr = (mac_RxPtr + 1) % MAC_RX_BUF_NUM;
-    gen_fsk_rx_buffer_set(mac_RxBuf + mac_RxPtr*MAC_RX_BUF_LEN , MAC_RX_BUF_LEN);
+    int Next;
 
     /* clear the interrupt flag */
     reg_rf_irq_status = FLD_RF_IRQ_RX;
 
+    //a corrupted packet leaves the slot with the radio
     if (!MAC_RX_PACKET_CRC_OK(RxPacket)) {
+        OTA_Telemetry.CrcErrors++;
         if (mac_Info.RxCb) {
             mac_Info.RxCb(NULL);
         }
         return;
     }
+
+    //every other slot is still held, drop the packet rather than overwrite one of them
+    Next = MAC_RxNextFree();
+    if (Next < 0) {
+        OTA_Telemetry.RxOverruns++;
+        if (mac_Info.RxCb) {
+            mac_Info.RxCb(NULL);
+        }
+        return;
+    }
+
+    //the filled slot goes to the upper layer, the radio moves on to a free one
+    mac_RxHeld[mac_RxPtr] = 1;
+    mac_RxPtr = Next;
+    gen_fsk_rx_buffer_set(mac_RxBuf + mac_RxPtr*MAC_RX_BUF_LEN , MAC_RX_BUF_LEN);
+
+    OTA_Telemetry.RxFrames++;
     if (mac_Info.RxCb) {
         mac_Info.RxCb(&RxPacket[4]);
     }
+    else {
+        MAC_RxRelease(&RxPacket[4]);
+    }
+}
+
+void MAC_TxIrqHandler(void)
+{
+    /* clear the interrupt flag */
+    reg_rf_irq_status = FLD_RF_IRQ_TX;
+
+    mac_TxDone = 1;
 }
 
 void MAC_RxTimeOutHandler(void)
 {
     /* clear the interrupt flag */
 	reg_rf_irq_status = FLD_RF_IRQ_RX_TIMEOUT;
+    OTA_Telemetry.Timeouts++;
 
     if (mac_Info.RxTimeoutCb) {
         mac_Info.RxTimeoutCb(NULL);
@@ -161,8 +263,35 @@ void MAC_RxFirstTimeOutHandler(void)
 {
     /* clear the interrupt flag */
 	reg_rf_irq_status = FLD_RF_IRQ_FIRST_TIMEOUT;
+    OTA_Telemetry.Timeouts++;
 
     if (mac_Info.RxFirstTimeoutCb) {
         mac_Info.RxFirstTimeoutCb(NULL);
     }
 }
+
+/* the rx windows of gen_fsk are closed by the radio, nothing to time in software */
+void MAC_Poll(void)
+{
+}
+
+/* dispatch the rf irq sources of the transport, called from irq_handler() */
+void MAC_IrqHandler(void)
+{
+    unsigned short Src = rf_irq_src_get();
+
+    if (Src & FLD_RF_IRQ_RX) {
+        MAC_RxIrqHandler();
+    }
+    if (Src & FLD_RF_IRQ_RX_TIMEOUT) {
+        MAC_RxTimeOutHandler();
+    }
+    if (Src & FLD_RF_IRQ_FIRST_TIMEOUT) {
+        MAC_RxFirstTimeOutHandler();
+    }
+    if (Src & FLD_RF_IRQ_TX) {
+        MAC_TxIrqHandler();
+    }
+}
+
+#endif /*MAC_TRANSPORT*/
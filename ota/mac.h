@@ -47,6 +47,30 @@
 #ifndef _MAC_H_
 #define _MAC_H_
 
+/*
+ * transport beneath the OTA protocol, picked at build time, both implement this header
+ * gen_fsk: STX2RX/SRX, every response is a frame of its own, see mac.c
+ * TPLL: PTX on the master and PRX on the slave, every frame is acknowledged by the link
+ * layer and the responses of the slave ride in ACK payloads, see mac_tpll.c
+ */
+#define MAC_TRANSPORT_GEN_FSK         0
+#define MAC_TRANSPORT_TPLL            1
+#ifndef MAC_TRANSPORT
+#define MAC_TRANSPORT                 MAC_TRANSPORT_GEN_FSK
+#endif
+
+#if (MAC_TRANSPORT == MAC_TRANSPORT_TPLL)
+#define MAC_LINK_ACK                  1  //a frame sent is a frame in the rx ring of the peer
+#define MAC_PAYLOAD_MAX               63 //6-bit length field of a TPLL packet
+#else
+#define MAC_LINK_ACK                  0
+#define MAC_PAYLOAD_MAX               235 //240-byte tx buffer minus the DMA and length header
+#endif
+
+/*
+ * RxCb gets the payload in place in a slot of the rx ring, the slot is not
+ * received into again until the payload is handed back with MAC_RxRelease()
+ */
 typedef void (*MAC_Cb)(unsigned char *Data);
 
 extern void MAC_Init(const unsigned short Channel,
@@ -57,9 +81,22 @@ extern void MAC_Init(const unsigned short Channel,
 extern void MAC_SendData(const unsigned char *Payload,
                         const int PayloadLen);
 
+//0 when the frame did not get through: never on air, or given up by the link layer with MAC_LINK_ACK
+extern int MAC_SendDataNoAck(const unsigned char *Payload,
+                             const int PayloadLen);
+
+extern void MAC_SetRxWait(unsigned int TimeUs);
+extern void MAC_SetChannel(unsigned short Channel);
+extern unsigned short MAC_GetChannel(void);
 extern void MAC_RecvData(unsigned int TimeUs);
+extern void MAC_RxRelease(const unsigned char *Data);
+extern void MAC_Poll(void);
+extern void MAC_IrqHandler(void);
+#if (MAC_TRANSPORT == MAC_TRANSPORT_GEN_FSK)
 extern void MAC_RxIrqHandler(void);
+extern void MAC_TxIrqHandler(void);
 extern void MAC_RxTimeOutHandler(void);
 extern void MAC_RxFirstTimeOutHandler(void);
+#endif
 
 #endif /* _MAC_H_ */
@@ -0,0 +1,404 @@
+/********************************************************************************************************
+ * @file	mac_tpll.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+#include "mac.h"
+#include "ota_telemetry.h"
+#include "driver.h"
+#include "common.h"
+#include "tpll.h"
+
+#if (MAC_TRANSPORT == MAC_TRANSPORT_TPLL)
+
+#define MAC_RX_BUF_LEN                (MAC_PAYLOAD_MAX+1) //length byte plus the payload
+#ifndef MAC_RX_BUF_NUM
+#define MAC_RX_BUF_NUM                4
+#endif
+#define MAC_RX_WAIT                   200000 //in us, until MAC_SetRxWait() tells otherwise
+#define MAC_TX_DONE_WAIT              8000 //in us, covers every link layer retransmission
+#define MAC_POLL_INTERVAL             300 //in us, from the request to the first poll for its response
+#define MAC_POLL_INTERVAL_MAX         5000 //in us, every poll that comes back empty doubles the interval up to this
+#define MAC_AUTO_RETRY_NUM            15
+#define MAC_AUTO_RETRY_DELAY          150 //in us
+#define MAC_POLL_FRAME                0x00 //one-byte frame only sent to fetch the pending ACK payload
+#ifndef MAC_TPLL_PHY_INIT
+#define MAC_TPLL_PHY_INIT             1 //0 keeps the bitrate, address and channel the application configured
+#endif
+
+typedef struct {
+    unsigned short Channel;
+    MAC_Cb RxCb;
+    MAC_Cb RxTimeoutCb;
+    MAC_Cb RxFirstTimeoutCb;
+} MAC_InfoTypeDef;
+
+static MAC_InfoTypeDef mac_Info = {0, 0, 0};
+
+static unsigned char mac_RxBuf[MAC_RX_BUF_LEN*MAC_RX_BUF_NUM] __attribute__ ((aligned (4))) = {};
+static volatile unsigned char mac_RxHeld[MAC_RX_BUF_NUM] = {}; //slot handed to RxCb, until MAC_RxRelease()
+static volatile unsigned char mac_Waiting = 0; //a frame of the peer is expected within mac_WaitUs
+static unsigned int mac_WaitTick = 0;
+static unsigned int mac_WaitUs = 0;
+static unsigned int mac_RxWait = MAC_RX_WAIT;
+#ifdef OTA_MASTER_EN
+//what the frame on air is, its ACK payload is only taken from a poll or a streamed frame
+#define MAC_TX_REQUEST                0 //MAC_SendData(), a response is waited for
+#define MAC_TX_POLL                   1
+#define MAC_TX_STREAM                 2 //MAC_SendDataNoAck(), the ACK payload is whatever the slave has to say by now
+
+static const unsigned char mac_PollFrame[1] = {MAC_POLL_FRAME};
+static volatile unsigned char mac_TxBusy = 0; //until TX_DS or RETRY_HIT
+static volatile unsigned char mac_TxAcked = 0; //the last frame got TX_DS
+static volatile unsigned char mac_TxKind = MAC_TX_REQUEST;
+static unsigned int mac_PollTick = 0;
+static unsigned int mac_PollGap = MAC_POLL_INTERVAL;
+#else
+static volatile unsigned char mac_RxStopped = 0; //no slot was left, frames are not acknowledged
+#endif
+
+void MAC_Init(const unsigned short Channel,
+              const MAC_Cb RxCb,
+              const MAC_Cb RxTimeoutCb,
+              const MAC_Cb RxFirstTimeoutCb)
+{
+    mac_Info.Channel = Channel;
+    mac_Info.RxCb = RxCb;
+    mac_Info.RxTimeoutCb = RxTimeoutCb;
+    mac_Info.RxFirstTimeoutCb = RxFirstTimeoutCb;
+    memset((unsigned char *)mac_RxHeld, 0, sizeof(mac_RxHeld));
+    mac_Waiting = 0;
+
+#if (MAC_TPLL_PHY_INIT)
+    unsigned char Address[5] = {0xe7, 0xe7, 0xe7, 0xe7, 0xe7};
+    TPLL_Init(TPLL_BITRATE_2MBPS);
+    TPLL_SetOutputPower(TPLL_RF_POWER_N0p22dBm);
+    TPLL_SetAddressWidth(ADDRESS_WIDTH_5BYTES);
+    TPLL_ClosePipe(TPLL_PIPE_ALL);
+    TPLL_SetAddress(TPLL_PIPE0, Address);
+    TPLL_OpenPipe(TPLL_PIPE0);
+    TPLL_SetRFChannel(Channel);
+#endif
+
+#ifdef OTA_MASTER_EN
+    TPLL_SetTXPipe(TPLL_PIPE0);
+    TPLL_ModeSet(TPLL_MODE_PTX);
+    //the link layer repeats a frame until it is acknowledged, OTA only retries a lost link
+    TPLL_SetAutoRetry(MAC_AUTO_RETRY_NUM, MAC_AUTO_RETRY_DELAY);
+    TPLL_RxTimeoutSet(500);
+    mac_TxBusy = 0;
+#else
+    TPLL_ModeSet(TPLL_MODE_PRX);
+    mac_RxStopped = 0;
+#endif
+    TPLL_RxSettleSet(80);
+    TPLL_TxSettleSet(149);
+    WaitUs(150);
+
+    //irq configuration
+    irq_clr_src();
+    rf_irq_clr_src(FLD_RF_IRQ_ALL);
+    irq_enable_type(FLD_IRQ_ZB_RT_EN); //enable RF irq
+    rf_irq_disable(FLD_RF_IRQ_ALL);
+    rf_irq_enable(FLD_RF_IRQ_TX | FLD_RF_IRQ_TX_DS | FLD_RF_IRQ_RETRY_HIT | FLD_RF_IRQ_RX_DR);
+    irq_enable(); //enable general irq
+
+#ifndef OTA_MASTER_EN
+    TPLL_PRXTrig();
+#endif
+}
+
+/* any slot not held by the upper layer, -1 if all of them are */
+static int MAC_RxAlloc(void)
+{
+    int i;
+
+    for (i = 0; i < MAC_RX_BUF_NUM; i++) {
+        if (!mac_RxHeld[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void MAC_WaitStart(unsigned int TimeUs)
+{
+    mac_WaitTick = clock_time();
+    mac_WaitUs = TimeUs;
+    mac_Waiting = 1;
+}
+
+#ifdef OTA_MASTER_EN
+static void MAC_Transmit(const unsigned char *Payload, const int PayloadLen, unsigned char Kind)
+{
+    TPLL_FlushTx(TPLL_PIPE0);
+    mac_TxKind = Kind;
+    mac_TxAcked = 0;
+    mac_TxBusy = 1;
+    if (TPLL_WriteTxPayload(TPLL_PIPE0, Payload, PayloadLen)) {
+        TPLL_PTXTrig();
+    }
+    else {
+        mac_TxBusy = 0;
+    }
+    OTA_Telemetry.TxFrames++;
+}
+
+/* the response is polled for once the request is acknowledged, see MAC_Poll() */
+void MAC_SendData(const unsigned char *Payload,
+                 const int PayloadLen)
+{
+    mac_Waiting = 0;
+    MAC_Transmit(Payload, PayloadLen, MAC_TX_REQUEST);
+    MAC_WaitStart(mac_RxWait);
+    mac_PollTick = clock_time();
+    mac_PollGap = MAC_POLL_INTERVAL;
+}
+
+/*
+ * returns once the frame is acknowledged by the link layer or given up on, an ACK payload
+ * coming back with it goes to RxCb: the slave loads what it has to say after every frame,
+ * so a stream gets its responses without a poll
+ */
+int MAC_SendDataNoAck(const unsigned char *Payload,
+                      const int PayloadLen)
+{
+    unsigned int StartTick = clock_time();
+
+    MAC_Transmit(Payload, PayloadLen, MAC_TX_STREAM);
+    while (mac_TxBusy && !clock_time_exceed(StartTick, MAC_TX_DONE_WAIT));
+    return mac_TxAcked;
+}
+
+void MAC_RecvData(unsigned int TimeUs)
+{
+    MAC_WaitStart(TimeUs);
+    mac_PollTick = clock_time();
+    mac_PollGap = MAC_POLL_INTERVAL;
+}
+#else
+/* a PRX only answers in ACK payloads, the master fetches this one with its next frame */
+void MAC_SendData(const unsigned char *Payload,
+                 const int PayloadLen)
+{
+    TPLL_FlushTx(TPLL_PIPE0); //a response the master never fetched is stale by now
+    TPLL_WriteAckPayload(TPLL_PIPE0, Payload, PayloadLen);
+    OTA_Telemetry.TxFrames++;
+    MAC_WaitStart(mac_RxWait);
+}
+
+/* replaces what the master gets with its next frame, without waiting for one */
+int MAC_SendDataNoAck(const unsigned char *Payload,
+                      const int PayloadLen)
+{
+    TPLL_FlushTx(TPLL_PIPE0);
+    TPLL_WriteAckPayload(TPLL_PIPE0, Payload, PayloadLen);
+    OTA_Telemetry.TxFrames++;
+    return 1;
+}
+
+void MAC_RecvData(unsigned int TimeUs)
+{
+    MAC_WaitStart(TimeUs);
+}
+#endif
+
+/* takes effect with the next frame sent or acknowledged */
+void MAC_SetChannel(unsigned short Channel)
+{
+    mac_Info.Channel = Channel;
+    TPLL_SetNewRFChannel(Channel);
+}
+
+unsigned short MAC_GetChannel(void)
+{
+    return mac_Info.Channel;
+}
+
+/* how long the peer is waited for after MAC_SendData() */
+void MAC_SetRxWait(unsigned int TimeUs)
+{
+    mac_RxWait = TimeUs;
+}
+
+/* hand a payload passed to RxCb back to the rx ring */
+void MAC_RxRelease(const unsigned char *Data)
+{
+    unsigned char r;
+
+    if (Data) {
+        r = irq_disable();
+        mac_RxHeld[(Data - mac_RxBuf) / MAC_RX_BUF_LEN] = 0;
+#ifndef OTA_MASTER_EN
+        if (mac_RxStopped) {
+            mac_RxStopped = 0;
+            TPLL_PRXTrig();
+        }
+#endif
+        irq_restore(r);
+    }
+}
+
+/*
+ * times the wait for the peer and polls for a response, called from the main loop. A slave
+ * busy with the flash has nothing to say and may not even acknowledge, the polls back off
+ * meanwhile and only the wait ends the exchange
+ */
+void MAC_Poll(void)
+{
+    unsigned char r;
+
+    if (!mac_Waiting) {
+        return;
+    }
+    if (clock_time_exceed(mac_WaitTick, mac_WaitUs)) {
+        r = irq_disable();
+        if (mac_Waiting) {
+            mac_Waiting = 0;
+            OTA_Telemetry.Timeouts++;
+            if (mac_Info.RxTimeoutCb) {
+                mac_Info.RxTimeoutCb(NULL);
+            }
+        }
+        irq_restore(r);
+        return;
+    }
+#ifdef OTA_MASTER_EN
+    if (!mac_TxBusy && clock_time_exceed(mac_PollTick, mac_PollGap)) {
+        MAC_Transmit(mac_PollFrame, sizeof(mac_PollFrame), MAC_TX_POLL);
+    }
+#endif
+}
+
+static void MAC_RxIrqHandler(void)
+{
+    int Slot = MAC_RxAlloc();
+    unsigned char *RxPacket;
+    unsigned char Len;
+
+    if (Slot < 0) {
+        //only a PTX gets here, a PRX stops acknowledging before its last slot is taken
+        TPLL_FlushRx();
+        OTA_Telemetry.RxOverruns++;
+        return;
+    }
+    RxPacket = mac_RxBuf + Slot*MAC_RX_BUF_LEN;
+    Len = TPLL_ReadRxPayload(&RxPacket[1]) & 0xff;
+    if ((0 == Len) || (Len > MAC_PAYLOAD_MAX) || (MAC_POLL_FRAME == RxPacket[1])) {
+        return;
+    }
+#ifdef OTA_MASTER_EN
+    //the ACK payload of a request was queued before the slave saw it, unless an earlier copy got
+    //through and only its ACK was lost. That of a stream is the running state of the slave and
+    //the upper layer tells whether it moved on
+    if (((MAC_TX_STREAM != mac_TxKind) && !mac_Waiting) ||
+        ((MAC_TX_REQUEST == mac_TxKind) && !TPLL_GetTransmitAttempts())) {
+        return;
+    }
+#endif
+    mac_Waiting = 0;
+    RxPacket[0] = Len;
+    mac_RxHeld[Slot] = 1;
+    OTA_Telemetry.RxFrames++;
+#ifndef OTA_MASTER_EN
+    //leave the master's frames unacknowledged until a slot is released
+    if (MAC_RxAlloc() < 0) {
+        TPLL_ModeStop();
+        mac_RxStopped = 1;
+    }
+#endif
+
+    if (mac_Info.RxCb) {
+        mac_Info.RxCb(RxPacket);
+    }
+    else {
+        MAC_RxRelease(RxPacket);
+    }
+}
+
+/* dispatch the rf irq sources of the transport, called from irq_handler() */
+void MAC_IrqHandler(void)
+{
+    unsigned short Src = rf_irq_src_get();
+
+    if (Src & FLD_RF_IRQ_RX_DR) {
+        rf_irq_clr_src(FLD_RF_IRQ_RX_DR);
+        MAC_RxIrqHandler();
+    }
+    if (Src & FLD_RF_IRQ_TX_DS) {
+        rf_irq_clr_src(FLD_RF_IRQ_TX_DS);
+#ifdef OTA_MASTER_EN
+        //acknowledged, a poll without the response is repeated after a longer interval
+        if ((MAC_TX_POLL == mac_TxKind) && mac_Waiting && (mac_PollGap < MAC_POLL_INTERVAL_MAX)) {
+            mac_PollGap <<= 1;
+        }
+        mac_TxAcked = 1;
+        mac_TxBusy = 0;
+        mac_PollTick = clock_time();
+#endif
+    }
+#ifdef OTA_MASTER_EN
+    if (Src & FLD_RF_IRQ_RETRY_HIT) {
+        rf_irq_clr_src(FLD_RF_IRQ_RETRY_HIT);
+        TPLL_UpdateTXFifoRptr(TPLL_PIPE0);
+        mac_TxBusy = 0;
+        mac_PollTick = clock_time();
+        if ((MAC_TX_POLL == mac_TxKind) && (mac_PollGap < MAC_POLL_INTERVAL_MAX)) {
+            mac_PollGap <<= 1;
+        }
+        //the request never got through, no need to wait for a response
+        if ((MAC_TX_REQUEST == mac_TxKind) && mac_Waiting) {
+            mac_Waiting = 0;
+            OTA_Telemetry.Timeouts++;
+            if (mac_Info.RxTimeoutCb) {
+                mac_Info.RxTimeoutCb(NULL);
+            }
+        }
+    }
+#endif
+    if (Src & FLD_RF_IRQ_TX) {
+        rf_irq_clr_src(FLD_RF_IRQ_TX);
+    }
+}
+
+#endif /*MAC_TRANSPORT*/
@@ -48,6 +48,16 @@
 #include "common.h"
 #include "driver.h"
 #include "mac.h"
+#include "ota_resume.h"
+#include "ota_lz.h"
+#include "ota_delta.h"
+#include "erase_ahead.h"
+#include "page_stage.h"
+#include "retry_policy.h"
+#include "crc.h"
+#include "ota_telemetry.h"
+#include "slot.h"
+#include "image_check.h"
 #include "genfsk_ll.h"
 
 #define BLUE_LED_PIN            GPIO_PA4
@@ -60,8 +70,37 @@
 #define OTA_BIN_SIZE_OFFSET    0x18
 
 #define OTA_REBOOT_WAIT        (1000 * 1000) //in us
+#if (MAC_LINK_ACK)
+#define OTA_STREAM_FRAME_GAP   0   //every streamed frame is acknowledged by the link layer
+#else
+#define OTA_STREAM_FRAME_GAP   300 //in us, lets the slave re-arm RX between streamed frames
+#endif
+//largest block of 48 * 2^n a DATA frame carries over the transport, Type and block number take 3 bytes
+#define OTA_BLOCK_SIZE_LINK_MAX   ((MAC_PAYLOAD_MAX >= OTA_BLOCK_SIZE_MAX+3) ? OTA_BLOCK_SIZE_MAX : \
+                                   (MAC_PAYLOAD_MAX >= OTA_BLOCK_SIZE_MAX/2+3) ? OTA_BLOCK_SIZE_MAX/2 : OTA_BLOCK_SIZE_MIN)
 #define OTA_BOOT_FLAG_OFFSET   8
 
+#if !defined(OTA_MASTER_EN) && (OTA_SLAVE_BIN_ADDR != SLOT_B_ADDR)
+#error "SLOT_B_ADDR has to be the OTA area"
+#endif
+#define OTA_LINK_EVAL_NUM      32 //data exchanges per link quality period
+#define OTA_LINK_ERR_PERCENT   25 //failure rate of a period that makes the master halve the block size
+#define OTA_HOP_SILENCE        (1*1000*1000) //in us, the slave hops once it heard nothing for this long
+#define OTA_HOP_DWELL          (OTA_HOP_SILENCE*3/2) //in us, the master stays until a silent slave followed
+
+#define OTA_MCAST_ANNOUNCE_NUM        10   //MCAST_START/MCAST_END are repeated as nobody acknowledges them
+#define OTA_MCAST_ANNOUNCE_INTERVAL   100  //in ms
+#define OTA_MCAST_PREPARE_WAIT        2000 //in ms, lets the slaves erase their OTA area
+#define OTA_MCAST_BLOCK_GAP           1000 //in us, covers the page program of the slaves
+#define OTA_MCAST_SLOT_US             600  //one NACK frame plus the tx settle time
+#define OTA_MCAST_SLOT_MIN            4
+#define OTA_MCAST_SLOT_MAX            64
+#define OTA_MCAST_QUIET_ROUNDS        2    //rounds without any report before the session ends
+#define OTA_MCAST_ROUND_MAX           64
+#define OTA_MCAST_MAP_LEN             384  //missing-block map of the master, covers 128KB in 48-byte blocks
+#define OTA_MCAST_NACK_MAP_LEN        32   //bytes of the missing-block bitmap in one NACK
+#define OTA_MCAST_RX_DURATION         (1*1000*1000) //in us
+
 typedef struct {
     unsigned int Type;
     unsigned char *Data; //content of msg
@@ -75,8 +114,9 @@ typedef struct {
 OTA_MsgQueueTypeDef MsgQueue;
 
 OTA_FrameTypeDef TxFrame;
-OTA_FrameTypeDef RxFrame;
+OTA_FrameTypeDef *RxFrame; //points into the rx slot of the message being handled
 
+/* called in the rf irq */
 static int OTA_MsgQueuePush(const unsigned char *Data, const unsigned int Type, OTA_MsgQueueTypeDef *Queue)
 {
     if (Queue->Cnt < MSG_QUEUE_LEN) {
@@ -89,15 +129,19 @@ static int OTA_MsgQueuePush(const unsigned char *Data, const unsigned int Type,
     return 0;
 }
 
-static OTA_MsgTypeDef *OTA_MsgQueuePop(OTA_MsgQueueTypeDef *Queue)
+/* copies the msg out, its entry may be refilled by the rf irq as soon as it is popped */
+static int OTA_MsgQueuePop(OTA_MsgTypeDef *Msg, OTA_MsgQueueTypeDef *Queue)
 {
-    OTA_MsgTypeDef *ret = NULL;
+    int ret = 0;
+    unsigned char r = irq_disable();
 
     if (Queue->Cnt > 0) {
-        ret = &(Queue->Msg[Queue->ReadPtr]);
+        *Msg = Queue->Msg[Queue->ReadPtr];
         Queue->ReadPtr = (Queue->ReadPtr + 1) % MSG_QUEUE_LEN;
         Queue->Cnt--;
+        ret = 1;
     }
+    irq_restore(r);
 
     return ret;
 }
@@ -113,6 +157,13 @@ static int OTA_BuildCmdFrame(OTA_FrameTypeDef *Frame, const unsigned char CmdId,
     return fram_length;
 }
 
+/* point *Frame at the Type+Payload of a received rf payload in place, returns their length */
+static int OTA_ParseFrame(OTA_FrameTypeDef **Frame, const unsigned char *Data)
+{
+    *Frame = (OTA_FrameTypeDef *)(Data+1);
+    return (int)Data[0];
+}
+
 void OTA_RxIrq(unsigned char *Data)
 {
     if (NULL == Data) {
@@ -120,9 +171,14 @@ void OTA_RxIrq(unsigned char *Data)
     }
     else {
         if (Data[0]) { // Data[0]为 payload首字节
-            OTA_MsgQueuePush(Data, OTA_MSG_TYPE_DATA, &MsgQueue);
+            //the rx slot stays held while queued, a full queue is an overrun as well
+            if (!OTA_MsgQueuePush(Data, OTA_MSG_TYPE_DATA, &MsgQueue)) {
+                OTA_Telemetry.RxOverruns++;
+                MAC_RxRelease(Data);
+            }
         }
         else {
+            MAC_RxRelease(Data);
             OTA_MsgQueuePush(NULL, OTA_MSG_TYPE_INVALID_DATA, &MsgQueue);
         }
     }
@@ -133,31 +189,144 @@ void OTA_RxTimeoutIrq(unsigned char *Data)
     OTA_MsgQueuePush(NULL, OTA_MSG_TYPE_TIMEOUT, &MsgQueue);
 }
 
-static unsigned short OTA_CRC16_Cal(unsigned short crc, unsigned char* pd, int len)
+
+/*
+ * both ends walk the hop list in the same order: the master hops when its responses go missing
+ * or arrive corrupted, the slave when it has not heard the master for OTA_HOP_SILENCE, the
+ * master dwells long enough for the slave to follow, block numbers resynchronise the transfer
+ */
+typedef struct {
+    unsigned char Channel[OTA_HOP_NUM_MAX]; //Channel[0] is the one the session started on
+    unsigned char Num; //0 when the session does not hop
+    unsigned char Idx;
+    unsigned char Timeouts; //master: consecutive, slave: 1 once it hopped without hearing the master since
+    unsigned short CrcHistory; //bit n set: the n-th last response was corrupted, master only
+    unsigned char Agreed; //the slave accepted the hop list in a START_RSP, master only
+    unsigned int Tick; //when the current channel was taken
+} OTA_HopTypeDef;
+
+/* move on to the next channel of the hop list */
+static void OTA_Hop(OTA_HopTypeDef *Hop)
 {
-    // unsigned short       crc16_poly[2] = { 0, 0xa001 }; //0x8005 <==> 0xa001
-    unsigned short      crc16_poly[2] = { 0, 0x8408 }; //0x1021 <==> 0x8408
-    //unsigned short        crc16_poly[2] = { 0, 0x0811 }; //0x0811 <==> 0x8810
-    //unsigned short        crc = 0xffff;
-    int i, j;
+    Hop->Idx = (Hop->Idx + 1) % Hop->Num;
+    Hop->Timeouts = 0;
+    Hop->CrcHistory = 0;
+    Hop->Tick = clock_time();
+    MAC_SetChannel(Hop->Channel[Hop->Idx]);
+    OTA_Telemetry.Hops++;
+}
 
-    for (j = len; j > 0; j--)
-    {
-        unsigned char ds = *pd++;
-        for (i = 0; i < 8; i++)
-        {
-            crc = (crc >> 1) ^ crc16_poly[(crc ^ ds) & 1];
-            ds = ds >> 1;
-        }
+#ifdef OTA_MASTER_EN
+
+static OTA_CtrlTypeDef MasterCtrl = {0};
+static retry_policy_t MasterRetry;
+static unsigned int MasterSendTick; //when the frame soliciting the awaited response went out
+static unsigned char MasterSampled; //the awaited response makes a round trip sample
+static unsigned char MasterPaused; //the slave announced flash work, the next frame waits, see OTA_MasterSend()
+static int MasterPausedLen; //length of the frame held back in TxFrame, 0 for a window
+#if (MAC_LINK_ACK)
+static unsigned short MasterNext; //first block of the window the link layer did not take yet
+#endif
+static OTA_HopTypeDef MasterHop;
+static const unsigned char MasterHopChannels[] = OTA_HOP_CHANNELS;
+
+/*
+ * send a frame that solicits a response, the wait for it follows the measured round trip time.
+ * The slave answers START_REQ and END_REQ after its flash work, their wait gets OTA_BUSY_WAIT
+ * on top and makes no sample, every wait does with a slave that cannot announce the work.
+ * While paused the frame is only held back until the slave repeats its response
+ */
+static void OTA_MasterSend(OTA_FrameTypeDef *Frame, int Len)
+{
+    unsigned int Wait = retry_policy_timeout(&MasterRetry);
+
+    if (MasterPaused) {
+        MasterPausedLen = Len;
+        MAC_RecvData(OTA_BUSY_WAIT);
+        return;
+    }
+    MasterSampled = !((OTA_FRAME_TYPE_CMD == Frame->Type) &&
+                      ((OTA_CMD_ID_START_REQ == Frame->Payload[0]) || (OTA_CMD_ID_END_REQ == Frame->Payload[0])));
+    if (!MasterSampled || !(MasterCtrl.Caps & OTA_CAP_BUSY)) {
+        Wait += OTA_BUSY_WAIT;
     }
+    MAC_SetRxWait(Wait);
+    MasterSendTick = clock_time();
+    MAC_SendData((unsigned char*)Frame, Len);
+}
 
-    return crc;
+/* the slave ends START_RSP and its ACKs in a flags byte once OTA_CAP_BUSY is agreed */
+static int OTA_MasterBusyFlag(int RxLen)
+{
+    return (MasterCtrl.Caps & OTA_CAP_BUSY) && (RxLen >= 2) && (RxFrame->Payload[RxLen - 2] & OTA_RSP_FLAG_BUSY);
 }
 
+/* the awaited response arrived */
+static void OTA_MasterResponse(void)
+{
+    unsigned int RttUs = (clock_time() - MasterSendTick) / sys_tick_per_us;
 
-#ifdef OTA_MASTER_EN
+    OTA_TelemetryRtt(RttUs);
+    retry_policy_success(&MasterRetry, MasterSampled ? RttUs : 0);
+    MasterHop.Timeouts = 0;
+    MasterHop.CrcHistory <<= 1;
+}
 
-static OTA_CtrlTypeDef MasterCtrl = {0};
+/* session channel first, then the configured ones, the slave gets the list in START_REQ */
+static void OTA_MasterHopInit(void)
+{
+    unsigned int i;
+
+    MasterHop.Num = 0;
+    MasterHop.Idx = 0;
+    MasterHop.Channel[MasterHop.Num++] = MAC_GetChannel();
+    for (i = 0; (i < sizeof(MasterHopChannels)) && (MasterHop.Num < OTA_HOP_NUM_MAX); i++) {
+        if (MasterHopChannels[i] != MasterHop.Channel[0]) {
+            MasterHop.Channel[MasterHop.Num++] = MasterHopChannels[i];
+        }
+    }
+    MasterHop.Timeouts = 0;
+    MasterHop.CrcHistory = 0;
+    MasterHop.Agreed = 0;
+    MasterHop.Tick = clock_time();
+}
+
+/* account a failed exchange, hops once the channel looks jammed and the slave had time to follow */
+static void OTA_MasterHopCheck(const OTA_MsgTypeDef *Msg)
+{
+    unsigned short History;
+    int CrcErrors = 0;
+
+    if (!(MasterCtrl.Caps & OTA_CAP_HOP) || !MasterHop.Agreed) {
+        return;
+    }
+    if (OTA_MSG_TYPE_TIMEOUT == Msg->Type) {
+        MasterHop.Timeouts++;
+    }
+    else if (OTA_MSG_TYPE_INVALID_DATA == Msg->Type) {
+        MasterHop.CrcHistory = (MasterHop.CrcHistory << 1) | 1;
+    }
+    for (History = MasterHop.CrcHistory; History; History &= History - 1) {
+        CrcErrors++;
+    }
+    if (((MasterHop.Timeouts >= OTA_HOP_TIMEOUT_MAX) || (CrcErrors >= OTA_HOP_CRC_MAX)) &&
+        clock_time_exceed(MasterHop.Tick, OTA_HOP_DWELL)) {
+        OTA_Hop(&MasterHop);
+        //a new channel is a new link, it starts without the backoff of the old one
+        retry_policy_success(&MasterRetry, 0);
+    }
+}
+
+/* the awaited response is missing or corrupted, returns 0 when the session has to give up */
+static int OTA_MasterRetry(const OTA_MsgTypeDef *Msg)
+{
+    OTA_TelemetryRetry(MasterCtrl.State);
+    if (!retry_policy_failure(&MasterRetry)) {
+        return 0;
+    }
+    OTA_MasterHopCheck(Msg);
+    return 1;
+}
 
 static int OTA_IsBlockNumMatch(unsigned char *Payload)
 {
@@ -173,67 +342,440 @@ static int OTA_IsBlockNumMatch(unsigned char *Payload)
     }
 }
 
-static int OTA_BuildDataFrame(OTA_FrameTypeDef *Frame)
+static int OTA_BuildDataFrame(OTA_FrameTypeDef *Frame, const unsigned char Type, unsigned short BlockNum)
 {
-	unsigned int fram_length;
-    Frame->Type = OTA_FRAME_TYPE_DATA;
-    if ((MasterCtrl.TotalBinSize - MasterCtrl.BlockNum*(OTA_FRAME_PAYLOAD_MAX-2)) > (OTA_FRAME_PAYLOAD_MAX-2)) {
-    	fram_length = OTA_FRAME_PAYLOAD_MAX;
+    unsigned int Offset = (BlockNum - 1) * MasterCtrl.BlockSize;
+    unsigned int DataLen = MasterCtrl.TotalBinSize - Offset;
+
+    if (DataLen > MasterCtrl.BlockSize) {
+        DataLen = MasterCtrl.BlockSize;
+    }
+    Frame->Type = Type;
+    Frame->Payload[0] = BlockNum & 0xff;
+    Frame->Payload[1] = BlockNum >> 8;
+    flash_read_page(MasterCtrl.FlashAddr + Offset, DataLen, &Frame->Payload[2]);
+    return (1 + 2 + DataLen);
+}
+
+#if (MAC_LINK_ACK)
+/*
+ * stream the window on, every block the link layer takes is in the rx ring of the slave and
+ * its selective ACK comes back in the ACK payloads of the frames after it. The stream stops as
+ * soon as one did, the ACK moves the window on, and the slave is only polled for it once the
+ * window is out or the link gave a frame up
+ */
+static int OTA_SendWindow(OTA_FrameTypeDef *Frame)
+{
+    unsigned short Last = MasterCtrl.BlockNum + MasterCtrl.WindowSize;
+    int Len = 0;
+
+    //the slave announced flash work in its ACK, its receiver is full until it is done
+    if (MasterPaused) {
+        MasterPausedLen = 0;
+        MAC_RecvData(OTA_BUSY_WAIT);
+        return 0;
+    }
+    if (Last > MasterCtrl.MaxBlockNum) {
+        Last = MasterCtrl.MaxBlockNum;
+    }
+    if (MasterNext <= MasterCtrl.BlockNum) {
+        MasterNext = MasterCtrl.BlockNum + 1;
+    }
+    while (MasterNext <= Last) {
+        if (!(MasterCtrl.AckBitmap & (1 << (MasterNext - MasterCtrl.BlockNum - 1)))) {
+            Len = OTA_BuildDataFrame(Frame, OTA_FRAME_TYPE_STREAM, MasterNext);
+            if (!MAC_SendDataNoAck((unsigned char*)Frame, Len)) {
+                break;
+            }
+        }
+        MasterNext++;
+        if (MsgQueue.Cnt) {
+            return Len;
+        }
+    }
+    //the ACKs come back while the slave works through its rx ring, no round trip to sample
+    MasterSampled = 0;
+    MasterSendTick = clock_time();
+    MAC_RecvData(retry_policy_timeout(&MasterRetry));
+    return Len;
+}
+#else
+/*
+ * send every block of the current window that the slave has not reported yet,
+ * only the last one of the burst solicits a selective ACK
+ */
+static int OTA_SendWindow(OTA_FrameTypeDef *Frame)
+{
+    unsigned short Last = MasterCtrl.BlockNum + MasterCtrl.WindowSize;
+    unsigned short BlockNum;
+    int Len = 0;
+
+    //the streamed frames would be lost while the slave is busy with the flash
+    if (MasterPaused) {
+        MasterPausedLen = 0;
+        MAC_RecvData(OTA_BUSY_WAIT);
+        return 0;
+    }
+    if (Last > MasterCtrl.MaxBlockNum) {
+        Last = MasterCtrl.MaxBlockNum;
+    }
+    while ((Last > MasterCtrl.BlockNum + 1) && (MasterCtrl.AckBitmap & (1 << (Last - MasterCtrl.BlockNum - 1)))) {
+        Last--;
+    }
+    for (BlockNum = MasterCtrl.BlockNum + 1; BlockNum < Last; BlockNum++) {
+        if (MasterCtrl.AckBitmap & (1 << (BlockNum - MasterCtrl.BlockNum - 1))) {
+            continue;
+        }
+        Len = OTA_BuildDataFrame(Frame, OTA_FRAME_TYPE_STREAM, BlockNum);
+        MAC_SendDataNoAck((unsigned char*)Frame, Len);
+        WaitUs(OTA_STREAM_FRAME_GAP);
+    }
+    Len = OTA_BuildDataFrame(Frame, OTA_FRAME_TYPE_DATA, Last);
+    OTA_MasterSend(Frame, Len);
+    return Len;
+}
+#endif
+
+static int OTA_BuildStartReqFrame(OTA_FrameTypeDef *Frame)
+{
+    //MaxBlockNum in legacy block units followed by the proposed capabilities, the image identity
+    //and the proposed block size, legacy slaves only read MaxBlockNum
+    unsigned short LegacyBlockNum = (MasterCtrl.TotalBinSize + OTA_BLOCK_SIZE_MIN - 1) / OTA_BLOCK_SIZE_MIN;
+    unsigned char Param[21 + 1 + OTA_HOP_NUM_MAX + 2];
+    int ParamLen = 11;
+    Param[0] = LegacyBlockNum & 0xff;
+    Param[1] = LegacyBlockNum >> 8;
+    Param[2] = MasterCtrl.Caps;
+    Param[3] = MasterCtrl.WindowSize;
+    Param[4] = MasterCtrl.TargetFwCRC & 0xff;
+    Param[5] = MasterCtrl.TargetFwCRC >> 8;
+    memcpy(&Param[6], &MasterCtrl.TotalBinSize, 4);
+    Param[10] = MasterCtrl.BlockSize;
+    //a compressed image also announces its decoded size
+    if (MasterCtrl.Caps & OTA_CAP_COMPRESS) {
+        memcpy(&Param[11], &MasterCtrl.RawSize, 4);
+        ParamLen = 15;
+    }
+    //a delta image its rebuilt size and the identity of the image it applies to
+    else if (MasterCtrl.Caps & OTA_CAP_DELTA) {
+        OTA_DeltaHeaderTypeDef DeltaHeader;
+        flash_read_page((unsigned long)MasterCtrl.FlashAddr - OTA_DELTA_HEADER_LEN, sizeof(DeltaHeader), (unsigned char *)&DeltaHeader);
+        memcpy(&Param[11], &MasterCtrl.RawSize, 4);
+        memcpy(&Param[15], &DeltaHeader.OldSize, 4);
+        Param[19] = DeltaHeader.OldCRC & 0xff;
+        Param[20] = DeltaHeader.OldCRC >> 8;
+        ParamLen = 21;
+    }
+    //the hop list trails whatever the capabilities above added
+    if (MasterCtrl.Caps & OTA_CAP_HOP) {
+        Param[ParamLen] = MasterHop.Num;
+        memcpy(&Param[ParamLen + 1], MasterHop.Channel, MasterHop.Num);
+        ParamLen += 1 + MasterHop.Num;
+    }
+    //last, where a slave that does not know it never looks
+    if (MasterCtrl.Caps & OTA_CAP_VERSION) {
+        Param[ParamLen] = MasterCtrl.FwVersion & 0xff;
+        Param[ParamLen + 1] = MasterCtrl.FwVersion >> 8;
+        ParamLen += 2;
+    }
+    return OTA_BuildCmdFrame(Frame, OTA_CMD_ID_START_REQ, Param, ParamLen);
+}
+
+static void OTA_MasterSetBlockSize(unsigned short BlockSize)
+{
+    MasterCtrl.BlockSize = BlockSize;
+    MasterCtrl.MaxBlockNum = (MasterCtrl.TotalBinSize + BlockSize - 1) / BlockSize;
+}
+
+/*
+ * account one data exchange, returns 1 when the link got bad enough to go on
+ * with half the block size: shorter frames are less likely to be hit by an error
+ */
+static int OTA_MasterLinkDegraded(int Failed)
+{
+    int Degraded = 0;
+
+    MasterCtrl.TxCnt++;
+    if (Failed) {
+        MasterCtrl.ErrCnt++;
+    }
+    if (MasterCtrl.TxCnt >= OTA_LINK_EVAL_NUM) {
+        Degraded = (MasterCtrl.ErrCnt * 100 >= MasterCtrl.TxCnt * OTA_LINK_ERR_PERCENT);
+        MasterCtrl.TxCnt = 0;
+        MasterCtrl.ErrCnt = 0;
+    }
+    return Degraded && (MasterCtrl.BlockSize > OTA_BLOCK_SIZE_MIN);
+}
+
+/*
+ * propose half the current block size, the slave answers with a START_RSP
+ * that carries its progress counted in the new block size
+ */
+static int OTA_MasterFallback(OTA_FrameTypeDef *Frame)
+{
+    int Len;
+
+    MasterCtrl.BlockSize >>= 1;
+    MasterCtrl.AckBitmap = 0;
+    MasterCtrl.RetryTimes = 0;
+    MasterCtrl.TxCnt = 0;
+    MasterCtrl.ErrCnt = 0;
+    MasterCtrl.State = OTA_MASTER_STATE_START_RSP_WAIT;
+    Len = OTA_BuildStartReqFrame(Frame);
+    OTA_MasterSend(Frame, Len);
+    return Len;
+}
+
+typedef struct {
+    unsigned int RoundTick; //start of the current collection round
+    unsigned int RoundUs; //length of the current collection round
+    unsigned int PaceTick; //the next broadcast frame goes out PaceUs after it, the main loop runs meanwhile
+    unsigned int PaceUs;
+    unsigned char Round;
+    unsigned char QuietRounds;
+    unsigned char SlotNum;
+    unsigned char NackCnt; //reports received in the current round
+    unsigned char ErrCnt; //corrupted frames in the current round, mostly reports in the same slot
+    unsigned char Missing[OTA_MCAST_MAP_LEN]; //union of the reported missing blocks, bit n <=> block n+1
+} OTA_McastTypeDef;
+
+static OTA_McastTypeDef McastCtrl;
+
+static void OTA_McastPoll(void)
+{
+    unsigned char Param[4];
+    int Len;
+
+    memset(McastCtrl.Missing, 0, sizeof(McastCtrl.Missing));
+    McastCtrl.NackCnt = 0;
+    McastCtrl.ErrCnt = 0;
+    Param[0] = McastCtrl.Round;
+    Param[1] = McastCtrl.SlotNum;
+    Param[2] = OTA_MCAST_SLOT_US & 0xff;
+    Param[3] = OTA_MCAST_SLOT_US >> 8;
+    Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_MCAST_POLL, Param, sizeof(Param));
+    MAC_SendDataNoAck((unsigned char*)&TxFrame, Len);
+    McastCtrl.RoundUs = McastCtrl.SlotNum * OTA_MCAST_SLOT_US + OTA_MCAST_SLOT_US;
+    McastCtrl.RoundTick = clock_time();
+    MasterCtrl.State = OTA_MASTER_STATE_MCAST_COLLECT;
+    MAC_RecvData(McastCtrl.RoundUs);
+}
+
+static void OTA_McastMergeNack(const unsigned char *Param, int ParamLen)
+{
+    unsigned short BaseNum = Param[0] | (Param[1] << 8);
+    unsigned int Offset = (BaseNum - 1) >> 3;
+    int i;
+
+    if ((ParamLen < 3) || (0 == BaseNum) || ((BaseNum - 1) & 0x07)) {
+        return;
+    }
+    for (i = 0; (i < ParamLen - 2) && (Offset + i < OTA_MCAST_MAP_LEN); i++) {
+        McastCtrl.Missing[Offset + i] |= Param[2 + i];
+    }
+    McastCtrl.NackCnt++;
+}
+
+static int OTA_McastIsMissing(unsigned short BlockNum)
+{
+    return McastCtrl.Missing[(BlockNum - 1) >> 3] & (1 << ((BlockNum - 1) & 0x07));
+}
+
+/* the slots of a round are over, repair the reported blocks or finish the session */
+static void OTA_McastEndRound(void)
+{
+    unsigned short BlockNum;
+    int Missing = 0;
+
+    //more slots when reports collided, fewer when hardly anybody is left to report
+    if ((McastCtrl.NackCnt + McastCtrl.ErrCnt) * 2 >= McastCtrl.SlotNum) {
+        if (McastCtrl.SlotNum < OTA_MCAST_SLOT_MAX) {
+            McastCtrl.SlotNum <<= 1;
+        }
+    }
+    else if ((McastCtrl.NackCnt + McastCtrl.ErrCnt) * 8 < McastCtrl.SlotNum) {
+        if (McastCtrl.SlotNum > OTA_MCAST_SLOT_MIN) {
+            McastCtrl.SlotNum >>= 1;
+        }
+    }
+    McastCtrl.Round++;
+
+    for (BlockNum = 1; BlockNum <= MasterCtrl.MaxBlockNum; BlockNum++) {
+        if (OTA_McastIsMissing(BlockNum)) {
+            Missing = 1;
+            break;
+        }
+    }
+    if (Missing) {
+        McastCtrl.QuietRounds = 0;
+    }
+    else if (0 == McastCtrl.ErrCnt) {
+        McastCtrl.QuietRounds++;
+    }
+
+    if ((McastCtrl.QuietRounds >= OTA_MCAST_QUIET_ROUNDS) || (McastCtrl.Round >= OTA_MCAST_ROUND_MAX)) {
+        MasterCtrl.RetryTimes = 0;
+        MasterCtrl.State = OTA_MASTER_STATE_MCAST_END;
+    }
+    else if (Missing) {
+        MasterCtrl.BlockNum = 0;
+        MasterCtrl.State = OTA_MASTER_STATE_MCAST_REPAIR;
     }
     else {
-    	fram_length = MasterCtrl.TotalBinSize - MasterCtrl.BlockNum*(OTA_FRAME_PAYLOAD_MAX-2) + 2;
-        MasterCtrl.FinishFlag = 1;
+        OTA_McastPoll();
     }
-    MasterCtrl.BlockNum++;
-    memcpy(Frame->Payload, &MasterCtrl.BlockNum, 2);
-    flash_read_page(MasterCtrl.FlashAddr,fram_length-2, &Frame->Payload[2]);
-    MasterCtrl.FlashAddr += fram_length-2;
-    return (1 + fram_length);
+}
+
+/* nobody answers a broadcast, the frames are spaced out by time alone */
+static int OTA_McastPaced(void)
+{
+    return clock_time_exceed(McastCtrl.PaceTick, McastCtrl.PaceUs);
+}
+
+static void OTA_McastPace(unsigned int TimeUs)
+{
+    McastCtrl.PaceTick = clock_time();
+    McastCtrl.PaceUs = TimeUs;
+}
+
+static void OTA_McastSendBlock(unsigned short BlockNum)
+{
+    int Len = OTA_BuildDataFrame(&TxFrame, OTA_FRAME_TYPE_STREAM, BlockNum);
+    MAC_SendDataNoAck((unsigned char*)&TxFrame, Len);
+    OTA_McastPace(OTA_MCAST_BLOCK_GAP);
 }
 
 void OTA_MasterInit(unsigned int OTABinAddr, unsigned short FwVer)
 {
+    unsigned short BlockSize = OTA_BLOCK_SIZE_MIN;
+    OTA_LzHeaderTypeDef LzHeader;
+    OTA_DeltaHeaderTypeDef DeltaHeader;
+
     MasterCtrl.FlashAddr = OTABinAddr;
-    //read the size of OTA_bin file
-    flash_read_page((unsigned long)MasterCtrl.FlashAddr + OTA_BIN_SIZE_OFFSET, 4, ( unsigned char *)&MasterCtrl.TotalBinSize);
-    MasterCtrl.TotalBinSize += OTA_APPEND_INFO_LEN; // APPEND CRC INFO IN BIN TAIL
-    MasterCtrl.MaxBlockNum = (MasterCtrl.TotalBinSize + (OTA_FRAME_PAYLOAD_MAX - 2) - 1) / (OTA_FRAME_PAYLOAD_MAX - 2);
+    MasterCtrl.RawSize = 0;
+    MasterCtrl.Caps = OTA_CAP_RESUME;
+    flash_read_page((unsigned long)MasterCtrl.FlashAddr, sizeof(LzHeader), (unsigned char *)&LzHeader);
+    if (OTA_LZ_MAGIC == LzHeader.Magic) {
+        //a compressed image made by script/ota_compress, only the stream is sent
+        MasterCtrl.FlashAddr += OTA_LZ_HEADER_LEN;
+        MasterCtrl.TotalBinSize = LzHeader.StreamSize;
+        MasterCtrl.RawSize = LzHeader.RawSize;
+        MasterCtrl.TargetFwCRC = LzHeader.RawCRC;
+        MasterCtrl.Caps = OTA_CAP_COMPRESS;
+    }
+    else if (OTA_DELTA_MAGIC == LzHeader.Magic) {
+        //a patch made by script/ota_delta against the image the slave is running
+        flash_read_page((unsigned long)MasterCtrl.FlashAddr, sizeof(DeltaHeader), (unsigned char *)&DeltaHeader);
+        MasterCtrl.FlashAddr += OTA_DELTA_HEADER_LEN;
+        MasterCtrl.TotalBinSize = DeltaHeader.PatchSize;
+        MasterCtrl.RawSize = DeltaHeader.NewSize;
+        MasterCtrl.TargetFwCRC = DeltaHeader.NewCRC;
+        MasterCtrl.Caps = OTA_CAP_DELTA;
+    }
+    else {
+        //read the size of OTA_bin file
+        flash_read_page((unsigned long)MasterCtrl.FlashAddr + OTA_BIN_SIZE_OFFSET, 4, ( unsigned char *)&MasterCtrl.TotalBinSize);
+        MasterCtrl.TotalBinSize += OTA_APPEND_INFO_LEN; // APPEND CRC INFO IN BIN TAIL
+        //the appended CRC identifies the image when the slave resumes a session
+        flash_read_page((unsigned long)MasterCtrl.FlashAddr + MasterCtrl.TotalBinSize - OTA_APPEND_INFO_LEN, 2, (unsigned char *)&MasterCtrl.TargetFwCRC);
+    }
+    //only 48 * 2^n can be halved down to the legacy block size
+    while ((BlockSize << 1) <= OTA_BLOCK_SIZE && (BlockSize << 1) <= OTA_BLOCK_SIZE_LINK_MAX) {
+        BlockSize <<= 1;
+    }
+    OTA_MasterSetBlockSize(BlockSize);
     MasterCtrl.BlockNum = 0;
+    MasterCtrl.TxCnt = 0;
+    MasterCtrl.ErrCnt = 0;
+    MasterCtrl.AckBitmap = 0;
     MasterCtrl.FwVersion = FwVer;
     MasterCtrl.State = OTA_MASTER_STATE_IDLE;
     MasterCtrl.RetryTimes = 0;
+    MasterPaused = 0;
+    //every block is an exchange of its own without a window, a larger image may take more failures
+    retry_policy_init(&MasterRetry, OTA_RTO_INIT, OTA_RTO_MIN, OTA_RTO_MAX,
+                      OTA_RETRY_BUDGET + MasterCtrl.MaxBlockNum, OTA_RETRY_BURST_MAX);
+    OTA_TelemetryStart(0);
     MasterCtrl.FinishFlag = 0;
+    MasterCtrl.WindowSize = (OTA_WINDOW_SIZE > OTA_WINDOW_SIZE_MAX) ? OTA_WINDOW_SIZE_MAX : OTA_WINDOW_SIZE;
+#if (MAC_LINK_ACK)
+    //the selective ACK rides in the ACK payloads of the stream, a block waits for no exchange of its own
+    MasterCtrl.WindowSize = OTA_WINDOW_SIZE_MAX;
+#endif
+    if (MasterCtrl.WindowSize > 1) {
+        MasterCtrl.Caps |= OTA_CAP_WINDOW;
+    }
+    OTA_MasterHopInit();
+    if (OTA_HOP_EN && (MasterHop.Num > 1)) {
+        MasterCtrl.Caps |= OTA_CAP_HOP;
+    }
+    MasterCtrl.Caps |= OTA_CAP_BUSY | OTA_CAP_VERSION;
 }
-void OTA_MasterStart(void)
+/*
+ * update every listening slave at once: the image is broadcast, then collection rounds
+ * gather the missing blocks of all slaves and only their union is broadcast again
+ */
+void OTA_MasterMulticastInit(unsigned int OTABinAddr, unsigned short FwVer)
+{
+    OTA_MasterInit(OTABinAddr, FwVer);
+    MasterCtrl.Caps = OTA_CAP_MCAST;
+    McastCtrl.Round = 0;
+    McastCtrl.QuietRounds = 0;
+    McastCtrl.SlotNum = OTA_MCAST_SLOT_MIN;
+    OTA_McastPace(0);
+    MasterCtrl.State = OTA_MASTER_STATE_MCAST_ANNOUNCE;
+    //the slaves write the blocks in any order, a compressed or delta stream has to come in order
+    //and the link layer ACKs of several slaves would collide
+    if (MasterCtrl.RawSize || (MasterCtrl.MaxBlockNum > OTA_MCAST_MAP_LEN * 8) || MAC_LINK_ACK) {
+        MasterCtrl.State = OTA_MASTER_STATE_ERROR;
+    }
+}
+
+static void OTA_MasterRun(const OTA_MsgTypeDef *Msg)
 {
-    OTA_MsgTypeDef *Msg = OTA_MsgQueuePop(&MsgQueue);
     static int Len = 0;
+    static unsigned char LastState = OTA_MASTER_STATE_IDLE; //the state a failure happened in
+    int RxLen = 0;
+
+    if (OTA_MASTER_STATE_ERROR != MasterCtrl.State) {
+        LastState = MasterCtrl.State;
+    }
+    //the repeated response, or the time it takes, ends the flash work of the slave
+    if (MasterPaused && Msg) {
+        MasterPaused = 0;
+        if (MasterPausedLen) {
+            OTA_MasterSend(&TxFrame, MasterPausedLen);
+        }
+        else {
+            OTA_SendWindow(&TxFrame);
+        }
+        return;
+    }
 
     if (OTA_MASTER_STATE_IDLE == MasterCtrl.State) {
         Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_VERSION_REQ, 0, 0);
-        MAC_SendData((unsigned char*)&TxFrame, Len);
+        OTA_MasterSend(&TxFrame, Len);
         MasterCtrl.State = OTA_MASTER_STATE_FW_VER_WAIT;
     }
     else if (OTA_MASTER_STATE_FW_VER_WAIT == MasterCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-            	Len = (int)Msg->Data[0];
-            	RxFrame.Type = Msg->Data[1];
-            	memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
                 //if receive the valid FW version response
-                if ((OTA_FRAME_TYPE_CMD == RxFrame.Type) &&
-                (OTA_CMD_ID_VERSION_RSP == RxFrame.Payload[0])) {
+                if ((OTA_FRAME_TYPE_CMD == RxFrame->Type) &&
+                (OTA_CMD_ID_VERSION_RSP == RxFrame->Payload[0])) {
                     MasterCtrl.RetryTimes = 0;
+                    OTA_MasterResponse();
                     //compare the received version with that of OTA_bin
-                    unsigned short Version = RxFrame.Payload[2];
+                    unsigned short Version = RxFrame->Payload[2];
                     Version <<= 8;
-                    Version += RxFrame.Payload[1];
+                    Version += RxFrame->Payload[1];
 
                     if (Version < MasterCtrl.FwVersion) {
                         MasterCtrl.State = OTA_MASTER_STATE_START_RSP_WAIT;
-                        Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_START_REQ, (unsigned char *)&MasterCtrl.MaxBlockNum, sizeof(MasterCtrl.MaxBlockNum));
-                        MAC_SendData((unsigned char*)&TxFrame, Len);
+                        Len = OTA_BuildStartReqFrame(&TxFrame);
+                        OTA_MasterSend(&TxFrame, Len);
                     }
                     else {
                         MasterCtrl.State = OTA_MASTER_STATE_ERROR;
@@ -242,39 +784,93 @@ void OTA_MasterStart(void)
                 }
             }
 
-            if (MasterCtrl.RetryTimes == OTA_RETRY_MAX) {
+            if (!OTA_MasterRetry(Msg)) {
                 MasterCtrl.State = OTA_MASTER_STATE_ERROR;
                 return;
             }
             MasterCtrl.RetryTimes++;
-            MAC_SendData((unsigned char*)&TxFrame, Len);
+            OTA_MasterSend(&TxFrame, Len);
         }
     }
     else if (OTA_MASTER_STATE_START_RSP_WAIT == MasterCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-            	Len = (int)Msg->Data[0];
-            	RxFrame.Type = Msg->Data[1];
-            	memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
                 //if receive the valid FW version response
-                if ((OTA_FRAME_TYPE_CMD == RxFrame.Type) &&
-                (OTA_CMD_ID_START_RSP == RxFrame.Payload[0])) {
+                if ((OTA_FRAME_TYPE_CMD == RxFrame->Type) &&
+                (OTA_CMD_ID_START_RSP == RxFrame->Payload[0])) {
                     MasterCtrl.RetryTimes = 0;
+                    OTA_MasterResponse();
+                    //a legacy slave answers without the accepted capabilities
+                    if (RxLen >= 4) {
+                        MasterCtrl.Caps &= RxFrame->Payload[1];
+                        if (RxFrame->Payload[2] < MasterCtrl.WindowSize) {
+                            MasterCtrl.WindowSize = RxFrame->Payload[2];
+                        }
+                    }
+                    else {
+                        MasterCtrl.Caps = 0;
+                    }
+                    if (MasterCtrl.WindowSize < 2) {
+                        MasterCtrl.Caps &= ~OTA_CAP_WINDOW;
+                    }
+                    MasterPaused = OTA_MasterBusyFlag(RxLen);
+                    //the dwell on the session channel starts with the agreed session,
+                    //the slave stays on it until then and a hop before would lose it
+                    MasterHop.Tick = clock_time();
+                    MasterHop.Agreed = 1;
+                    //the slave has to rebuild a compressed or delta image, there is no plain one to fall back to
+                    if (MasterCtrl.RawSize && !(MasterCtrl.Caps & OTA_CAP_REBUILD)) {
+                        MasterCtrl.State = OTA_MASTER_STATE_ERROR;
+                        return;
+                    }
+                    //the accepted block size, slaves without it only take legacy blocks
+                    if ((RxLen >= 7) && (RxFrame->Payload[5] >= OTA_BLOCK_SIZE_MIN) && (RxFrame->Payload[5] <= MasterCtrl.BlockSize)) {
+                        OTA_MasterSetBlockSize(RxFrame->Payload[5]);
+                    }
+                    else {
+                        OTA_MasterSetBlockSize(OTA_BLOCK_SIZE_MIN);
+                    }
+                    MasterCtrl.AckBitmap = 0;
+                    //skip the blocks the slave already holds from an interrupted session,
+                    //after a block size change its progress is always reported
+                    if (((MasterCtrl.Caps & OTA_CAP_RESUME) && (RxLen >= 6)) || (RxLen >= 7)) {
+                        unsigned short ResumeNum = RxFrame->Payload[3] | (RxFrame->Payload[4] << 8);
+                        if (ResumeNum <= MasterCtrl.MaxBlockNum) {
+                            MasterCtrl.BlockNum = ResumeNum;
+                        }
+                    }
+#if (MAC_LINK_ACK)
+                    MasterNext = MasterCtrl.BlockNum + 1;
+#endif
+                    if (MasterCtrl.BlockNum == MasterCtrl.MaxBlockNum) {
+                        MasterCtrl.State = OTA_MASTER_STATE_END_RSP_WAIT;
+                        Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_END_REQ, (unsigned char *)&MasterCtrl.TotalBinSize, sizeof(MasterCtrl.TotalBinSize));
+                        OTA_MasterSend(&TxFrame, Len);
+                        return;
+                    }
                     //read OTA_bin from flash and packet it in OTA data frame
                     MasterCtrl.State = OTA_MASTER_STATE_DATA_ACK_WAIT;
-                    Len = OTA_BuildDataFrame(&TxFrame);
-                    MAC_SendData((unsigned char*)&TxFrame, Len);
+                    if (MasterCtrl.Caps & OTA_CAP_WINDOW) {
+                        Len = OTA_SendWindow(&TxFrame);
+                    }
+                    else {
+                        MasterCtrl.BlockNum++;
+                        MasterCtrl.FinishFlag = (MasterCtrl.BlockNum == MasterCtrl.MaxBlockNum);
+                        Len = OTA_BuildDataFrame(&TxFrame, OTA_FRAME_TYPE_DATA, MasterCtrl.BlockNum);
+                        OTA_MasterSend(&TxFrame, Len);
+                    }
                     return;
                 }
             }
 
-            if (MasterCtrl.RetryTimes == OTA_RETRY_MAX) {
+            if (!OTA_MasterRetry(Msg)) {
                 MasterCtrl.State = OTA_MASTER_STATE_ERROR;
                 return;
             }
             MasterCtrl.RetryTimes++;
-            MAC_SendData((unsigned char*)&TxFrame, Len);
+            OTA_MasterSend(&TxFrame, Len);
         }
     }
 
@@ -282,32 +878,88 @@ void OTA_MasterStart(void)
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-            	Len = (int)Msg->Data[0];
-            	RxFrame.Type = Msg->Data[1];
-            	memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
+                //if receive the selective ACK of the current window
+                if ((MasterCtrl.Caps & OTA_CAP_WINDOW) && (OTA_FRAME_TYPE_ACK == RxFrame->Type) && (RxLen >= 5)) {
+                    unsigned short AckNum = RxFrame->Payload[0] | (RxFrame->Payload[1] << 8);
+                    unsigned short Bitmap = RxFrame->Payload[2] | (RxFrame->Payload[3] << 8);
+                    //the window, or what is missing of it, waits for the flash work either way
+                    MasterPaused = OTA_MasterBusyFlag(RxLen);
+                    if ((AckNum >= MasterCtrl.BlockNum) && (AckNum <= MasterCtrl.MaxBlockNum) &&
+                        ((AckNum != MasterCtrl.BlockNum) || (Bitmap != MasterCtrl.AckBitmap))) {
+                        MasterCtrl.RetryTimes = 0;
+                        OTA_MasterResponse();
+                        MasterCtrl.BlockNum = AckNum;
+                        MasterCtrl.AckBitmap = Bitmap;
+                        if (MasterCtrl.BlockNum == MasterCtrl.MaxBlockNum) {
+                            MasterCtrl.State = OTA_MASTER_STATE_END_RSP_WAIT;
+                            Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_END_REQ, (unsigned char *)&MasterCtrl.TotalBinSize, sizeof(MasterCtrl.TotalBinSize));
+                            OTA_MasterSend(&TxFrame, Len);
+                            return;
+                        }
+                        if (OTA_MasterLinkDegraded(0)) {
+                            Len = OTA_MasterFallback(&TxFrame);
+                            return;
+                        }
+                        Len = OTA_SendWindow(&TxFrame);
+                        return;
+                    }
+#if (MAC_LINK_ACK)
+                    //the slave has not got to the blocks after it yet, stream on
+                    if ((AckNum >= MasterCtrl.BlockNum) && (AckNum <= MasterCtrl.MaxBlockNum)) {
+                        Len = OTA_SendWindow(&TxFrame);
+                        return;
+                    }
+#endif
+                    //an ACK that moves nothing means the whole window got lost again, it counts as a retry below
+                }
                 //if receive the valid OTA data ack
-                if ((OTA_FRAME_TYPE_ACK == RxFrame.Type) && OTA_IsBlockNumMatch(RxFrame.Payload)) {
+                else if (!(MasterCtrl.Caps & OTA_CAP_WINDOW) && (OTA_FRAME_TYPE_ACK == RxFrame->Type) && OTA_IsBlockNumMatch(RxFrame->Payload)) {
                     MasterCtrl.RetryTimes = 0;
+                    OTA_MasterResponse();
+                    MasterPaused = OTA_MasterBusyFlag(RxLen);
                     if (MasterCtrl.FinishFlag) {
                         MasterCtrl.State = OTA_MASTER_STATE_END_RSP_WAIT;
                         Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_END_REQ, (unsigned char *)&MasterCtrl.TotalBinSize, sizeof(MasterCtrl.TotalBinSize));
-                        MAC_SendData((unsigned char*)&TxFrame, Len);
+                        OTA_MasterSend(&TxFrame, Len);
+                    }
+                    else if (OTA_MasterLinkDegraded(0)) {
+                        Len = OTA_MasterFallback(&TxFrame);
                     }
                     else {
                         //read OTA_bin from flash and packet it in OTA data frame
-                        Len = OTA_BuildDataFrame(&TxFrame);
-                        MAC_SendData((unsigned char*)&TxFrame, Len);
+                        MasterCtrl.BlockNum++;
+                        MasterCtrl.FinishFlag = (MasterCtrl.BlockNum == MasterCtrl.MaxBlockNum);
+                        Len = OTA_BuildDataFrame(&TxFrame, OTA_FRAME_TYPE_DATA, MasterCtrl.BlockNum);
+                        OTA_MasterSend(&TxFrame, Len);
                     }
                     return;
                 }
             }
 
-            if (MasterCtrl.RetryTimes == OTA_RETRY_MAX) {
+            //a lost or corrupted frame, the session ends once its retry budget is spent
+            if (!OTA_MasterRetry(Msg)) {
                 MasterCtrl.State = OTA_MASTER_STATE_ERROR;
                 return;
             }
+            //give up the block size before giving up the session
+            if (OTA_MasterLinkDegraded(1) ||
+                ((MasterCtrl.RetryTimes >= OTA_RETRY_MAX) && (MasterCtrl.BlockSize > OTA_BLOCK_SIZE_MIN))) {
+                Len = OTA_MasterFallback(&TxFrame);
+                return;
+            }
             MasterCtrl.RetryTimes++;
-            MAC_SendData((unsigned char*)&TxFrame, Len);
+            if (MasterCtrl.Caps & OTA_CAP_WINDOW) {
+#if (MAC_LINK_ACK)
+                //the slave never got to some of the blocks the link layer took, a reboot or a lost rx slot
+                MasterNext = MasterCtrl.BlockNum + 1;
+#endif
+                //resend whatever the slave is still missing from the window
+                Len = OTA_SendWindow(&TxFrame);
+            }
+            else {
+                OTA_MasterSend(&TxFrame, Len);
+            }
         }
     }
 
@@ -315,26 +967,108 @@ void OTA_MasterStart(void)
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-            	Len = (int)Msg->Data[0];
-            	RxFrame.Type = Msg->Data[1];
-            	memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
                 //if receive the valid FW version response
-                if ((OTA_FRAME_TYPE_CMD == RxFrame.Type) &&
-                    (OTA_CMD_ID_END_RSP == RxFrame.Payload[0])) {
+                if ((OTA_FRAME_TYPE_CMD == RxFrame->Type) &&
+                    (OTA_CMD_ID_END_RSP == RxFrame->Payload[0])) {
                     MasterCtrl.RetryTimes = 0;
+                    OTA_MasterResponse();
                     MasterCtrl.State = OTA_MASTER_STATE_END;
                     return;
                 }
             }
-            if (MasterCtrl.RetryTimes == OTA_RETRY_MAX) {
+            if (!OTA_MasterRetry(Msg)) {
                 MasterCtrl.State = OTA_MASTER_STATE_ERROR;
                 return;
             }
             MasterCtrl.RetryTimes++;
-            MAC_SendData((unsigned char*)&TxFrame, Len);
+            OTA_MasterSend(&TxFrame, Len);
+        }
+    }
+    else if (OTA_MASTER_STATE_MCAST_ANNOUNCE == MasterCtrl.State) {
+        unsigned char Param[11];
+        if (!OTA_McastPaced()) {
+            return;
+        }
+        Param[0] = MasterCtrl.MaxBlockNum & 0xff;
+        Param[1] = MasterCtrl.MaxBlockNum >> 8;
+        Param[2] = MasterCtrl.BlockSize;
+        Param[3] = MasterCtrl.TargetFwCRC & 0xff;
+        Param[4] = MasterCtrl.TargetFwCRC >> 8;
+        memcpy(&Param[5], &MasterCtrl.TotalBinSize, 4);
+        Param[9] = MasterCtrl.FwVersion & 0xff;
+        Param[10] = MasterCtrl.FwVersion >> 8;
+        Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_MCAST_START, Param, sizeof(Param));
+        MAC_SendDataNoAck((unsigned char*)&TxFrame, Len);
+        OTA_McastPace(OTA_MCAST_ANNOUNCE_INTERVAL * 1000);
+        if (++MasterCtrl.RetryTimes == OTA_MCAST_ANNOUNCE_NUM) {
+            OTA_McastPace((OTA_MCAST_ANNOUNCE_INTERVAL + OTA_MCAST_PREPARE_WAIT) * 1000);
+            MasterCtrl.RetryTimes = 0;
+            MasterCtrl.BlockNum = 0;
+            MasterCtrl.State = OTA_MASTER_STATE_MCAST_DATA;
         }
     }
+    else if (OTA_MASTER_STATE_MCAST_DATA == MasterCtrl.State) {
+        //the first pass over the whole image, nobody answers
+        if (!OTA_McastPaced()) {
+            return;
+        }
+        if (MasterCtrl.BlockNum == MasterCtrl.MaxBlockNum) {
+            OTA_McastPoll();
+            return;
+        }
+        MasterCtrl.BlockNum++;
+        OTA_McastSendBlock(MasterCtrl.BlockNum);
+    }
+    else if (OTA_MASTER_STATE_MCAST_COLLECT == MasterCtrl.State) {
+        if (Msg) {
+            if (Msg->Type == OTA_MSG_TYPE_DATA) {
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
+                if ((OTA_FRAME_TYPE_CMD == RxFrame->Type) && (OTA_CMD_ID_MCAST_NACK == RxFrame->Payload[0])) {
+                    OTA_McastMergeNack(&RxFrame->Payload[1], RxLen - 2);
+                }
+            }
+            else if (Msg->Type == OTA_MSG_TYPE_INVALID_DATA) {
+                McastCtrl.ErrCnt++;
+            }
+            //every reception ends the rx, keep listening until the last slot is over
+            if (!clock_time_exceed(McastCtrl.RoundTick, McastCtrl.RoundUs)) {
+                MAC_RecvData(McastCtrl.RoundUs - (clock_time() - McastCtrl.RoundTick) / sys_tick_per_us);
+                return;
+            }
+            OTA_McastEndRound();
+        }
+    }
+    else if (OTA_MASTER_STATE_MCAST_REPAIR == MasterCtrl.State) {
+        //one reported block per call, then the next round
+        if (!OTA_McastPaced()) {
+            return;
+        }
+        do {
+            MasterCtrl.BlockNum++;
+        } while ((MasterCtrl.BlockNum <= MasterCtrl.MaxBlockNum) && !OTA_McastIsMissing(MasterCtrl.BlockNum));
+        if (MasterCtrl.BlockNum > MasterCtrl.MaxBlockNum) {
+            OTA_McastPoll();
+            return;
+        }
+        OTA_McastSendBlock(MasterCtrl.BlockNum);
+    }
+    else if (OTA_MASTER_STATE_MCAST_END == MasterCtrl.State) {
+        if (!OTA_McastPaced()) {
+            return;
+        }
+        if (MasterCtrl.RetryTimes == OTA_MCAST_ANNOUNCE_NUM) {
+            MasterCtrl.State = OTA_MASTER_STATE_END;
+            return;
+        }
+        Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_MCAST_END, (unsigned char *)&MasterCtrl.TotalBinSize, sizeof(MasterCtrl.TotalBinSize));
+        MAC_SendDataNoAck((unsigned char*)&TxFrame, Len);
+        OTA_McastPace(OTA_MCAST_ANNOUNCE_INTERVAL * 1000);
+        MasterCtrl.RetryTimes++;
+    }
     else if (OTA_MASTER_STATE_END == MasterCtrl.State) {
+            OTA_TelemetryFinish(OTA_MASTER_STATE_END, MasterCtrl.TotalBinSize, MasterCtrl.BlockSize);
+            OTA_TelemetryReport(&OTA_Telemetry);
             gpio_set_func(WHITE_LED_PIN, AS_GPIO);
             gpio_set_output_en(WHITE_LED_PIN, 1);
             gpio_write(WHITE_LED_PIN, 1);
@@ -348,6 +1082,11 @@ void OTA_MasterStart(void)
             start_reboot();
     }
     else if (OTA_MASTER_STATE_ERROR == MasterCtrl.State) {
+        unsigned int Bytes = MasterCtrl.BlockNum * MasterCtrl.BlockSize;
+        //keep what went wrong for the field, the reboot wipes everything else
+        OTA_TelemetryFinish(LastState, (Bytes < MasterCtrl.TotalBinSize) ? Bytes : MasterCtrl.TotalBinSize, MasterCtrl.BlockSize);
+        OTA_TelemetrySave();
+        OTA_TelemetryReport(&OTA_Telemetry);
     	gpio_set_func(RED_LED_PIN, AS_GPIO);
 		gpio_set_output_en(RED_LED_PIN, 1);
 		gpio_write(RED_LED_PIN, 1);
@@ -362,52 +1101,688 @@ void OTA_MasterStart(void)
     }
 }
 
+void OTA_MasterStart(void)
+{
+    OTA_MsgTypeDef Msg;
+
+    MAC_Poll();
+    OTA_TelemetryTick();
+    if (OTA_MsgQueuePop(&Msg, &MsgQueue)) {
+        OTA_MasterRun(&Msg);
+        //the frame was parsed in place, its rx slot can be received into again
+        MAC_RxRelease(Msg.Data);
+    }
+    else {
+        OTA_MasterRun(NULL);
+    }
+}
+
 #else /*OTA_MASTER_EN*/
 #define OTA_MASTER_FIRST_RX_DURATION    (5*1000*1000) //in us
-#define OTA_MASTER_RESPONSE_RX_DURATION   (1*1000*1000) //in us
+#define OTA_MASTER_RESPONSE_RX_DURATION   OTA_HOP_SILENCE //in us, a hopping slave moves on when it expires
 
 static OTA_CtrlTypeDef SlaveCtrl = {0};
+static OTA_ResumeInfoTypeDef SlaveResume = {0};
+static unsigned char SlaveResumeValid = 0; //the OTA area holds blocks of SlaveResume
+static unsigned short SlaveNewVersion = SLOT_VERSION_UNKNOWN; //announced by START_REQ or MCAST_START, legacy masters do not carry it
+static erase_ahead_t SlaveErase; //the OTA area is erased on demand, right ahead of the writes
+static page_stage_t SlaveStage; //received data waits here for the next idle gap to be programmed
+static unsigned short SlaveMarked = 0; //in-order blocks recorded in the resume bitmap
+static int SlaveNackLen = 0; //a MCAST_NACK waits in TxFrame for its slot, SlaveNackUs after SlaveNackTick
+static unsigned int SlaveNackTick;
+static unsigned int SlaveNackUs;
+static retry_policy_t SlaveRetry;
+static OTA_HopTypeDef SlaveHop;
+#if OTA_LZ_EN
+static OTA_LzDecoderTypeDef SlaveLz;
+#endif
+#if OTA_DELTA_EN
+static OTA_DeltaTypeDef SlaveDelta;
+static unsigned int SlaveRunAddr; //flash address of the running image a patch applies to
+#endif
+#if (OTA_LZ_EN || OTA_DELTA_EN)
+static unsigned char SlaveRebuildError = 0;
 
-static int OTA_BuildAckFrame(OTA_FrameTypeDef *Frame, unsigned short BlockNum)
+/* rebuilt pages of a compressed or delta image, the counterpart of OTA_SlaveWriteBlock() */
+static void OTA_SlaveImageOutput(unsigned int Offset, const unsigned char *Data, int Len)
 {
-	unsigned int fram_length;
-    Frame->Type = OTA_FRAME_TYPE_ACK;
-    fram_length = 2;
-    Frame->Payload[0] = BlockNum & 0xff;
-    Frame->Payload[1] = BlockNum >> 8;
-
+    int CrcLen = Len;
 
-    return (1 + fram_length);
+    if (Offset + Len > SlaveCtrl.RawSize) {
+        SlaveRebuildError = 1;
+        return;
+    }
+    if (Offset + Len > SlaveCtrl.RawSize - OTA_APPEND_INFO_LEN) {
+        CrcLen = SlaveCtrl.RawSize - OTA_APPEND_INFO_LEN - Offset;
+    }
+    if (CrcLen > 0) {
+        SlaveCtrl.PktCRC = crc16_update(SlaveCtrl.PktCRC, (unsigned char *)Data, CrcLen);
+    }
+    erase_ahead_ensure(&SlaveErase, SlaveCtrl.FlashAddr + Offset, Len);
+    if (0 == Offset) {
+        // unfill boot flag in ota procedure
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr, Data, 8);
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr + 12, Data + 12, Len - 12);
+    }
+    else {
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr + Offset, Data, Len);
+    }
 }
 
-static void OTA_FlashErase(void)
+/* feed the stream carried by the blocks to the decoder or the patch applier */
+static void OTA_SlaveRebuild(unsigned char *Data, int DataLen)
 {
-    int SectorAddr = SlaveCtrl.FlashAddr;
-    int i = 0;
-    for (i = 0; i < 15; i++) {
-        flash_erase_sector(SectorAddr);
-        SectorAddr += 0x1000;
+#if OTA_LZ_EN
+    if (SlaveCtrl.Caps & OTA_CAP_COMPRESS) {
+        OTA_LzDecode(&SlaveLz, Data, DataLen);
+    }
+#endif
+#if OTA_DELTA_EN
+    if (SlaveCtrl.Caps & OTA_CAP_DELTA) {
+        OTA_DeltaApply(&SlaveDelta, Data, DataLen);
     }
+#endif
 }
 
-void OTA_SlaveInit(unsigned int OTABinAddr, unsigned short FwVer)
+/* the stream is complete, returns 1 when it rebuilt exactly the announced image */
+static int OTA_SlaveRebuildFinish(void)
 {
-    SlaveCtrl.FlashAddr = OTABinAddr;
-    SlaveCtrl.BlockNum = 0;
-    SlaveCtrl.FwVersion = FwVer;
-    SlaveCtrl.State = OTA_SLAVE_STATE_IDLE;
-    SlaveCtrl.RetryTimes = 0;
-    SlaveCtrl.FinishFlag = 0;
-    SlaveCtrl.FwCRC = SlaveCtrl.PktCRC = 0;
-
-    //erase the OTA write area
-    OTA_FlashErase();
+    unsigned int Size = 0;
+    int Error = 1;
+#if OTA_LZ_EN
+    if (SlaveCtrl.Caps & OTA_CAP_COMPRESS) {
+        Size = OTA_LzFinish(&SlaveLz);
+        Error = SlaveLz.Error;
+    }
+#endif
+#if OTA_DELTA_EN
+    if (SlaveCtrl.Caps & OTA_CAP_DELTA) {
+        Size = OTA_DeltaFinish(&SlaveDelta);
+        Error = SlaveDelta.Error;
+    }
+#endif
+    return (!Error && !SlaveRebuildError && (Size == SlaveCtrl.RawSize));
 }
+#endif
 
-void OTA_SlaveStart(void)
+#if OTA_DELTA_EN
+/* the running image as it was received, i.e. with its boot flag in place */
+static void OTA_SlaveDeltaRead(unsigned int Offset, unsigned char *Buf, int Len)
+{
+    static const unsigned char BootFlag[4] = {0x4b, 0x4e, 0x4c, 0x54};
+    int i;
+
+    flash_read_page(SlaveRunAddr + Offset, Len, Buf);
+    for (i = 0; i < Len; i++) {
+        if ((Offset + i >= OTA_BOOT_FLAG_OFFSET) && (Offset + i < OTA_BOOT_FLAG_OFFSET + 4)) {
+            Buf[i] = BootFlag[Offset + i - OTA_BOOT_FLAG_OFFSET];
+        }
+    }
+}
+
+/* a patch only applies to the image it was made against */
+static int OTA_SlaveDeltaBaseMatch(unsigned int OldSize, unsigned short OldCRC)
+{
+    unsigned int RunSize = 0;
+    unsigned short RunCRC = 0;
+
+    SlaveRunAddr = SlaveCtrl.FlashAddr ? 0 : OTA_SLAVE_BIN_ADDR;
+    flash_read_page(SlaveRunAddr + OTA_BIN_SIZE_OFFSET, 4, (unsigned char *)&RunSize);
+    RunSize += OTA_APPEND_INFO_LEN;
+    if (RunSize != OldSize) {
+        return 0;
+    }
+    flash_read_page(SlaveRunAddr + RunSize - OTA_APPEND_INFO_LEN, 2, (unsigned char *)&RunCRC);
+    return (RunCRC == OldCRC);
+}
+#endif
+
+static int OTA_BuildAckFrame(OTA_FrameTypeDef *Frame, unsigned short BlockNum)
+{
+	unsigned int fram_length;
+    Frame->Type = OTA_FRAME_TYPE_ACK;
+    fram_length = 2;
+    Frame->Payload[0] = BlockNum & 0xff;
+    Frame->Payload[1] = BlockNum >> 8;
+    //selective ACK: cumulative block number followed by the bitmap of blocks received beyond it
+    if (SlaveCtrl.Caps & OTA_CAP_WINDOW) {
+        Frame->Payload[2] = SlaveCtrl.AckBitmap & 0xff;
+        Frame->Payload[3] = SlaveCtrl.AckBitmap >> 8;
+        fram_length += 2;
+    }
+    //flags, see OTA_SlaveRespond()
+    if (SlaveCtrl.Caps & OTA_CAP_BUSY) {
+        Frame->Payload[fram_length++] = 0;
+    }
+
+    return (1 + fram_length);
+}
+
+/*
+ * write received data to flash,
+ * and avoid first block data writing boot flag as head of time.
+ */
+static void OTA_SlaveWriteBlock(unsigned short BlockNum, unsigned char *Data, int DataLen)
+{
+#if (OTA_LZ_EN || OTA_DELTA_EN)
+    //blocks of a compressed or delta image arrive in order and rebuild the image
+    if (SlaveCtrl.Caps & OTA_CAP_REBUILD) {
+        OTA_SlaveRebuild(Data, DataLen);
+        SlaveCtrl.TotalBinSize += DataLen;
+        if (BlockNum == SlaveCtrl.MaxBlockNum) {
+            SlaveCtrl.LastBlockLen = DataLen;
+        }
+        return;
+    }
+#endif
+    erase_ahead_ensure(&SlaveErase, SlaveCtrl.FlashAddr + (BlockNum - 1) * SlaveCtrl.BlockSize, DataLen);
+    SlaveCtrl.TotalBinSize += DataLen;
+    if (BlockNum == SlaveCtrl.MaxBlockNum) {
+        SlaveCtrl.LastBlockLen = DataLen;
+    }
+    //broadcast blocks are recorded one by one as they arrive, nobody waits for an ACK of them
+    if (SlaveCtrl.Caps & OTA_CAP_MCAST) {
+        if (1 == BlockNum) {
+            flash_write_page(SlaveCtrl.FlashAddr, 8, Data);
+            flash_write_page(SlaveCtrl.FlashAddr + 12, DataLen - 12, Data + 12);
+        }
+        else {
+            flash_write_page(SlaveCtrl.FlashAddr + (BlockNum - 1) * SlaveCtrl.BlockSize, DataLen, Data);
+        }
+        OTA_ResumeMarkBlock(BlockNum);
+        return;
+    }
+    //staged until the next idle gap, recorded for resume once it is durable, see OTA_SlaveFlush()
+    if (1 == BlockNum) {
+        // unfill boot flag in ota procedure
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr, Data, 8);
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr + 12, Data + 12, DataLen - 12);
+    }
+    else {
+        page_stage_write(&SlaveStage, SlaveCtrl.FlashAddr + (BlockNum - 1) * SlaveCtrl.BlockSize, Data, DataLen);
+    }
+}
+
+/*
+ * program the staged page while the link is idle anyway, i.e. right after a response
+ * went out, All makes everything durable, then record the in-order blocks now in flash
+ */
+static void OTA_SlaveFlush(int All)
+{
+    unsigned int Low;
+    unsigned short Durable = SlaveCtrl.BlockNum;
+
+    if (All) {
+        page_stage_flush(&SlaveStage);
+    }
+    else {
+        page_stage_flush_pending(&SlaveStage);
+    }
+    if (!SlaveResumeValid) {
+        return;
+    }
+    Low = page_stage_low_addr(&SlaveStage);
+    if ((Low != PAGE_STAGE_NONE) && (Low < SlaveCtrl.FlashAddr + Durable * SlaveCtrl.BlockSize)) {
+        Durable = (Low - SlaveCtrl.FlashAddr) / SlaveCtrl.BlockSize;
+    }
+    while (SlaveMarked < Durable) {
+        SlaveMarked++;
+        OTA_ResumeMarkBlock(SlaveMarked);
+    }
+}
+
+/* read a block back from flash as it was received, i.e. with the boot flag in place */
+static int OTA_SlaveReadBlock(unsigned short BlockNum, unsigned char *Buf)
+{
+    int DataLen = (BlockNum == SlaveCtrl.MaxBlockNum) ? SlaveCtrl.LastBlockLen : SlaveCtrl.BlockSize;
+
+    page_stage_read(&SlaveStage, SlaveCtrl.FlashAddr + (BlockNum - 1) * SlaveCtrl.BlockSize, Buf, DataLen);
+    if (1 == BlockNum) {
+        Buf[8] = 0x4b;
+        Buf[9] = 0x4e;
+        Buf[10] = 0x4c;
+        Buf[11] = 0x54;
+    }
+    return DataLen;
+}
+
+static void OTA_SlaveUpdatePktCRC(unsigned short BlockNum, unsigned char *Data, int DataLen)
+{
+    //PktCRC of a rebuilt image covers the rebuilt data, see OTA_SlaveImageOutput()
+    if (SlaveCtrl.Caps & OTA_CAP_REBUILD) {
+        return;
+    }
+    if (BlockNum == SlaveCtrl.MaxBlockNum) {
+        DataLen -= OTA_APPEND_INFO_LEN;
+    }
+    SlaveCtrl.PktCRC = crc16_update(SlaveCtrl.PktCRC, Data, DataLen);
+}
+
+/*
+ * accept a block of the current window, blocks arriving ahead of a gap are
+ * written straight to flash and folded into PktCRC once the gap is filled
+ */
+static void OTA_SlaveWindowBlock(unsigned short BlockNum, unsigned char *Data, int DataLen)
+{
+    unsigned char BlockBuf[OTA_BLOCK_SIZE_MAX];
+    unsigned short Bit;
+
+    if ((BlockNum <= SlaveCtrl.BlockNum) ||
+        (BlockNum > SlaveCtrl.BlockNum + SlaveCtrl.WindowSize) ||
+        (BlockNum > SlaveCtrl.MaxBlockNum)) {
+        return;
+    }
+    Bit = 1 << (BlockNum - SlaveCtrl.BlockNum - 1);
+    if (SlaveCtrl.AckBitmap & Bit) {
+        return;
+    }
+    //the stream can only be taken in order, the master resends whatever follows a gap
+    if ((SlaveCtrl.Caps & OTA_CAP_REBUILD) && (BlockNum != SlaveCtrl.BlockNum + 1)) {
+        return;
+    }
+
+    OTA_SlaveWriteBlock(BlockNum, Data, DataLen);
+    if (BlockNum != SlaveCtrl.BlockNum + 1) {
+        SlaveCtrl.AckBitmap |= Bit;
+        return;
+    }
+
+    OTA_SlaveUpdatePktCRC(BlockNum, Data, DataLen);
+    SlaveCtrl.BlockNum++;
+    SlaveCtrl.AckBitmap >>= 1;
+    while (SlaveCtrl.AckBitmap & 0x01) {
+        SlaveCtrl.BlockNum++;
+        SlaveCtrl.AckBitmap >>= 1;
+        DataLen = OTA_SlaveReadBlock(SlaveCtrl.BlockNum, BlockBuf);
+        OTA_SlaveUpdatePktCRC(SlaveCtrl.BlockNum, BlockBuf, DataLen);
+    }
+}
+
+static void OTA_SlaveSetBlockSize(unsigned short BlockSize)
+{
+    SlaveCtrl.BlockSize = BlockSize;
+    SlaveCtrl.MaxBlockNum = (SlaveResume.ImageSize + BlockSize - 1) / BlockSize;
+    SlaveCtrl.LastBlockLen = SlaveResume.ImageSize - (SlaveCtrl.MaxBlockNum - 1) * BlockSize;
+}
+
+/* count the in-order blocks again in another block size, the recorded blocks stay in flash */
+static void OTA_SlaveRebaseResume(unsigned short Contiguous)
+{
+    if (SlaveResumeValid) {
+        page_stage_flush(&SlaveStage);
+        SlaveResume.BlockSize = SlaveCtrl.BlockSize;
+        SlaveResume.MaxBlockNum = SlaveCtrl.MaxBlockNum;
+        OTA_ResumeCreate(&SlaveResume);
+        OTA_ResumeMarkBlocks(Contiguous);
+    }
+    SlaveMarked = Contiguous;
+}
+
+/*
+ * the master falls back to a smaller block size: it is a divisor of the current one,
+ * so the in-order part maps onto whole blocks and PktCRC stays valid, blocks received
+ * beyond it are simply programmed again with the same data
+ */
+static void OTA_SlaveShrinkBlockSize(unsigned short BlockSize)
+{
+    unsigned int Received = SlaveCtrl.BlockNum * SlaveCtrl.BlockSize;
+
+    if (SlaveCtrl.BlockNum == SlaveCtrl.MaxBlockNum) {
+        Received = SlaveResume.ImageSize;
+    }
+    OTA_SlaveSetBlockSize(BlockSize);
+    SlaveCtrl.BlockNum = (Received == SlaveResume.ImageSize) ? SlaveCtrl.MaxBlockNum : (Received / BlockSize);
+    SlaveCtrl.TotalBinSize = Received;
+    SlaveCtrl.AckBitmap = 0;
+    OTA_SlaveRebaseResume(SlaveCtrl.BlockNum);
+}
+
+/*
+ * rebuild the session state from the blocks already in flash: the in-order part
+ * goes into PktCRC, blocks ahead of the first gap are only kept in windowed mode,
+ * otherwise they are simply programmed again with the same data
+ */
+static void OTA_SlaveResume(void)
+{
+    unsigned char BlockBuf[OTA_BLOCK_SIZE_MAX];
+    unsigned short Contiguous = OTA_ResumeContiguousBlocks(SlaveResume.MaxBlockNum);
+    unsigned short BlockNum;
+    int DataLen;
+
+    //the interrupted session may have used another block size
+    if (SlaveResume.BlockSize != SlaveCtrl.BlockSize) {
+        unsigned int Received = Contiguous * SlaveResume.BlockSize;
+        Contiguous = (Received >= SlaveResume.ImageSize) ? SlaveCtrl.MaxBlockNum : (Received / SlaveCtrl.BlockSize);
+        OTA_SlaveRebaseResume(Contiguous);
+    }
+
+    for (BlockNum = 1; BlockNum <= Contiguous; BlockNum++) {
+        DataLen = OTA_SlaveReadBlock(BlockNum, BlockBuf);
+        OTA_SlaveUpdatePktCRC(BlockNum, BlockBuf, DataLen);
+        SlaveCtrl.TotalBinSize += DataLen;
+    }
+    SlaveCtrl.BlockNum = Contiguous;
+
+    if (SlaveCtrl.Caps & OTA_CAP_WINDOW) {
+        for (BlockNum = Contiguous + 2; (BlockNum <= SlaveCtrl.MaxBlockNum) && (BlockNum <= Contiguous + OTA_WINDOW_SIZE_MAX); BlockNum++) {
+            if (OTA_ResumeIsBlockReceived(BlockNum)) {
+                SlaveCtrl.AckBitmap |= 1 << (BlockNum - Contiguous - 1);
+                SlaveCtrl.TotalBinSize += (BlockNum == SlaveCtrl.MaxBlockNum) ? SlaveCtrl.LastBlockLen : SlaveCtrl.BlockSize;
+            }
+        }
+    }
+}
+
+/*
+ * the area of the announced image is erased sector by sector ahead of the writes,
+ * the sectors holding recorded blocks were erased by the interrupted session already
+ */
+static void OTA_SlaveEraseInit(unsigned int ImageSize)
+{
+    erase_ahead_init(&SlaveErase, SlaveCtrl.FlashAddr, ImageSize);
+    if (SlaveResumeValid) {
+        erase_ahead_skip(&SlaveErase, SlaveCtrl.FlashAddr + OTA_ResumeLastBlock(SlaveResume.MaxBlockNum) * SlaveResume.BlockSize);
+    }
+}
+
+/* flash address the in-order data reached */
+static unsigned int OTA_SlaveWriteAddr(void)
+{
+    unsigned int Written = SlaveCtrl.BlockNum * SlaveCtrl.BlockSize;
+#if OTA_LZ_EN
+    if (SlaveCtrl.Caps & OTA_CAP_COMPRESS) {
+        Written = SlaveLz.OutLen;
+    }
+#endif
+#if OTA_DELTA_EN
+    if (SlaveCtrl.Caps & OTA_CAP_DELTA) {
+        Written = SlaveDelta.OutLen;
+    }
+#endif
+    return SlaveCtrl.FlashAddr + Written;
+}
+
+/* the next sector is erased by OTA_SlaveEraseIdle() */
+static int OTA_SlaveEraseDue(void)
+{
+    return erase_ahead_due(&SlaveErase, OTA_SlaveWriteAddr());
+}
+
+/* erase the next sector right after a response has been sent, at most one per call */
+static void OTA_SlaveEraseIdle(void)
+{
+    erase_ahead_idle(&SlaveErase, OTA_SlaveWriteAddr());
+}
+
+/*
+ * send the response of Len bytes in TxFrame, then erase ahead and program the staged page while the
+ * link is idle anyway. The receiver is off meanwhile, a single frame waits in the rx buffer but a
+ * stream is lost, so Stream also announces the page. With OTA_CAP_BUSY agreed the flags ending the
+ * response tell the master about the work and the response is sent again without them once it is
+ * done, the master holds its next frame back until then
+ */
+static void OTA_SlaveRespond(int Len, int Stream)
+{
+    int Busy = 0;
+
+    if (SlaveCtrl.Caps & OTA_CAP_BUSY) {
+        Busy = OTA_SlaveEraseDue() || (Stream && SlaveStage.pending);
+        TxFrame.Payload[Len - 2] = Busy ? OTA_RSP_FLAG_BUSY : 0;
+    }
+    MAC_SendData((unsigned char *)&TxFrame, Len);
+    OTA_SlaveEraseIdle();
+    OTA_SlaveFlush(0);
+    if (Busy) {
+        TxFrame.Payload[Len - 2] = 0;
+        MAC_SendData((unsigned char *)&TxFrame, Len);
+    }
+}
+
+/* the received data is not usable, drop it together with its resume record */
+static void OTA_SlaveDiscard(void)
+{
+    if (SlaveResumeValid) {
+        OTA_ResumeDiscard();
+        SlaveResumeValid = 0;
+    }
+}
+
+/* block size of a START_REQ: the proposal rounded down to 48 * 2^n, legacy masters only send 48-byte blocks */
+static unsigned short OTA_SlaveAcceptBlockSize(const unsigned char *Payload, int RxLen)
+{
+    unsigned short BlockSize = OTA_BLOCK_SIZE_MIN;
+
+    if (RxLen >= 13) {
+        while (((BlockSize << 1) <= Payload[11]) && ((BlockSize << 1) <= OTA_BLOCK_SIZE_LINK_MAX)) {
+            BlockSize <<= 1;
+        }
+    }
+    return BlockSize;
+}
+
+static int OTA_BuildStartRspFrame(OTA_FrameTypeDef *Frame, int ReqLen)
+{
+    unsigned char Param[6];
+
+    Param[0] = SlaveCtrl.Caps;
+    Param[1] = SlaveCtrl.WindowSize;
+    Param[2] = SlaveCtrl.BlockNum & 0xff;
+    Param[3] = SlaveCtrl.BlockNum >> 8;
+    Param[4] = SlaveCtrl.BlockSize;
+    Param[5] = 0; //flags, see OTA_SlaveRespond()
+    if (SlaveCtrl.Caps & OTA_CAP_BUSY) {
+        return OTA_BuildCmdFrame(Frame, OTA_CMD_ID_START_RSP, Param, 6);
+    }
+    //a master that did not propose a block size gets the same answer as before
+    return OTA_BuildCmdFrame(Frame, OTA_CMD_ID_START_RSP, Param, (ReqLen >= 13) ? 5 : 4);
+}
+
+/*
+ * START_REQ during the transfer: either the START_RSP got lost or the master asks for
+ * a smaller block size, returns 1 when the START_RSP has to be built again
+ */
+static int OTA_SlaveRestartReq(int RxLen)
+{
+    unsigned short BlockSize;
+
+    if (RxLen < 13) {
+        return 0;
+    }
+    BlockSize = OTA_SlaveAcceptBlockSize(RxFrame->Payload, RxLen);
+    if (BlockSize < SlaveCtrl.BlockSize) {
+        OTA_SlaveShrinkBlockSize(BlockSize);
+    }
+    return 1;
+}
+
+/*
+ * take part in a multicast session announced with MCAST_START, the received-block
+ * bitmap of the resume record tracks the blocks as they arrive in any order
+ */
+static int OTA_SlaveMcastJoin(int RxLen)
+{
+    OTA_ResumeInfoTypeDef Req;
+    unsigned short FwVersion;
+    unsigned short BlockSize;
+
+    if (RxLen < 13) {
+        return 0;
+    }
+    FwVersion = RxFrame->Payload[10] | (RxFrame->Payload[11] << 8);
+    BlockSize = RxFrame->Payload[3];
+    if ((FwVersion <= SlaveCtrl.FwVersion) ||
+        ((BlockSize != OTA_BLOCK_SIZE_MIN) && (BlockSize != OTA_BLOCK_SIZE_MIN * 2) && (BlockSize != OTA_BLOCK_SIZE_MIN * 4)) ||
+        (BlockSize > OTA_BLOCK_SIZE_MAX)) {
+        return 0;
+    }
+    Req.FlashAddr = SlaveCtrl.FlashAddr;
+    Req.ImageCRC = RxFrame->Payload[4] | (RxFrame->Payload[5] << 8);
+    memcpy(&Req.ImageSize, &RxFrame->Payload[6], 4);
+    Req.MaxBlockNum = RxFrame->Payload[1] | (RxFrame->Payload[2] << 8);
+    Req.BlockSize = BlockSize;
+    if (!SlaveResumeValid || !OTA_ResumeIsMatch(&SlaveResume, &Req) || (SlaveResume.BlockSize != BlockSize)) {
+        //the area may hold part of another image
+        SlaveResumeValid = 0;
+        SlaveResume = Req;
+    }
+    //blocks arrive in any order and too fast to erase in between, prepare the whole area
+    //while the master keeps announcing the session
+    OTA_SlaveEraseInit(Req.ImageSize);
+    erase_ahead_ensure(&SlaveErase, SlaveCtrl.FlashAddr, Req.ImageSize);
+    if (!SlaveResumeValid) {
+        OTA_ResumeCreate(&SlaveResume);
+        SlaveResumeValid = 1;
+    }
+    SlaveCtrl.Caps = OTA_CAP_MCAST;
+    SlaveNewVersion = FwVersion;
+    OTA_SlaveSetBlockSize(BlockSize);
+    SlaveCtrl.BlockNum = OTA_ResumeCountBlocks(SlaveCtrl.MaxBlockNum);
+    return 1;
+}
+
+/*
+ * answer a collection round in a random slot, a complete slave stays quiet. The report waits
+ * for its slot in the main loop with the radio idle, see OTA_SlaveMcastNack()
+ */
+static void OTA_SlaveMcastPoll(int RxLen)
+{
+    unsigned char Param[2 + OTA_MCAST_NACK_MAP_LEN];
+    unsigned short BaseNum = 0;
+    unsigned short SlotUs;
+    int MapLen;
+
+    if ((RxLen < 6) || (0 == RxFrame->Payload[2])) {
+        return;
+    }
+    MapLen = OTA_ResumeMissingMap(SlaveCtrl.MaxBlockNum, &BaseNum, &Param[2], OTA_MCAST_NACK_MAP_LEN);
+    if (0 == MapLen) {
+        return;
+    }
+    Param[0] = BaseNum & 0xff;
+    Param[1] = BaseNum >> 8;
+    SlotUs = RxFrame->Payload[3] | (RxFrame->Payload[4] << 8);
+    SlaveNackTick = clock_time();
+    SlaveNackUs = (rand() % RxFrame->Payload[2]) * SlotUs;
+    SlaveNackLen = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_MCAST_NACK, Param, 2 + MapLen);
+}
+
+/* send the pending report once its slot came, then listen on */
+static void OTA_SlaveMcastNack(void)
+{
+    if (SlaveNackLen && clock_time_exceed(SlaveNackTick, SlaveNackUs)) {
+        MAC_SendDataNoAck((unsigned char *)&TxFrame, SlaveNackLen);
+        SlaveNackLen = 0;
+        MAC_RecvData(OTA_MCAST_RX_DURATION);
+    }
+}
+
+/*
+ * from the first request of the master on, failures are paid from the session budget,
+ * the slave only listens so its timeout stays fixed, it also counts corrupted stream
+ * frames and has the larger budget, the master decides when a session is lost
+ */
+static void OTA_SlaveRetryInit(void)
+{
+    retry_policy_init(&SlaveRetry, OTA_MASTER_RESPONSE_RX_DURATION, OTA_MASTER_RESPONSE_RX_DURATION,
+                      OTA_MASTER_RESPONSE_RX_DURATION, OTA_RETRY_BUDGET * 2, OTA_RETRY_BURST_MAX);
+    OTA_TelemetryStart(1);
+}
+
+/* nothing valid arrived in time, returns 0 when the session has to give up */
+static int OTA_SlaveRetry(const OTA_MsgTypeDef *Msg)
+{
+    OTA_TelemetryRetry(SlaveCtrl.State);
+    if (!retry_policy_failure(&SlaveRetry)) {
+        return 0;
+    }
+    //the master went silent for OTA_HOP_SILENCE, it has most likely hopped already, the slave
+    //follows once and then waits for the master to come round the list, hopping on with every
+    //silence it would outrun a master that has not hopped yet
+    if ((SlaveCtrl.Caps & OTA_CAP_HOP) && (OTA_MSG_TYPE_TIMEOUT == Msg->Type) && !SlaveHop.Timeouts) {
+        OTA_Hop(&SlaveHop);
+        SlaveHop.Timeouts = 1;
+    }
+    return 1;
+}
+
+/*
+ * take the hop list trailing a START_REQ, it follows the fields the capabilities of the
+ * master add, returns OTA_CAP_HOP when the list is usable from the current channel on
+ */
+static unsigned char OTA_SlaveAcceptHop(int RxLen)
+{
+    int Offset = 12;
+    int i;
+
+    if (!OTA_HOP_EN || !(RxFrame->Payload[3] & OTA_CAP_HOP)) {
+        return 0;
+    }
+    if (RxFrame->Payload[3] & OTA_CAP_COMPRESS) {
+        Offset = 16;
+    }
+    else if (RxFrame->Payload[3] & OTA_CAP_DELTA) {
+        Offset = 22;
+    }
+    if ((RxLen < Offset + 3) || (RxFrame->Payload[Offset] < 2) || (RxFrame->Payload[Offset] > OTA_HOP_NUM_MAX) ||
+        (RxLen < Offset + 2 + RxFrame->Payload[Offset])) {
+        return 0;
+    }
+    SlaveHop.Num = RxFrame->Payload[Offset];
+    memcpy(SlaveHop.Channel, &RxFrame->Payload[Offset + 1], SlaveHop.Num);
+    for (i = 0; i < SlaveHop.Num; i++) {
+        if (SlaveHop.Channel[i] == MAC_GetChannel()) {
+            SlaveHop.Idx = i;
+            SlaveHop.Tick = clock_time();
+            return OTA_CAP_HOP;
+        }
+    }
+    SlaveHop.Num = 0;
+    return 0;
+}
+
+/* take the image version ending a START_REQ, the slot record of the image gets it */
+static unsigned char OTA_SlaveAcceptVersion(int RxLen)
+{
+    SlaveNewVersion = SLOT_VERSION_UNKNOWN;
+    if (!(RxFrame->Payload[3] & OTA_CAP_VERSION) || (RxLen < 14)) {
+        return 0;
+    }
+    SlaveNewVersion = RxFrame->Payload[RxLen - 3] | (RxFrame->Payload[RxLen - 2] << 8);
+    return OTA_CAP_VERSION;
+}
+
+void OTA_SlaveInit(unsigned int OTABinAddr, unsigned short FwVer)
+{
+    SlaveCtrl.FlashAddr = OTABinAddr;
+    SlaveCtrl.BlockNum = 0;
+    SlaveCtrl.FwVersion = FwVer;
+    SlaveCtrl.State = OTA_SLAVE_STATE_IDLE;
+    SlaveCtrl.RetryTimes = 0;
+    SlaveCtrl.FinishFlag = 0;
+    SlaveCtrl.FwCRC = SlaveCtrl.PktCRC = 0;
+    SlaveCtrl.AckBitmap = 0;
+    SlaveCtrl.Caps = 0;
+    SlaveCtrl.WindowSize = 0;
+    SlaveCtrl.BlockSize = OTA_BLOCK_SIZE_MIN;
+    page_stage_init(&SlaveStage);
+    //the NACK slots of a multicast round are drawn with rand(), seeded so that slaves booted alike differ
+    random_generator_init();
+    SlaveNackLen = 0;
+
+    //keep the OTA write area while an interrupted session may still be resumed,
+    //otherwise it is erased once the START_REQ tells how much of it is needed
+    SlaveResumeValid = OTA_ResumeLoad(&SlaveResume, OTABinAddr);
+}
+
+static void OTA_SlaveRun(const OTA_MsgTypeDef *Msg)
 {
-    OTA_MsgTypeDef *Msg = OTA_MsgQueuePop(&MsgQueue);
     static int Len = 0;
+    static unsigned char LastState = OTA_SLAVE_STATE_IDLE; //the state a failure happened in
+    int RxLen = 0;
+
+    if (OTA_SLAVE_STATE_ERROR != SlaveCtrl.State) {
+        LastState = SlaveCtrl.State;
+    }
     if (OTA_SLAVE_STATE_IDLE == SlaveCtrl.State) {
         SlaveCtrl.State = OTA_SLAVE_STATE_FW_VERSION_READY;
         MAC_RecvData(OTA_MASTER_FIRST_RX_DURATION);
@@ -416,19 +1791,27 @@ void OTA_SlaveStart(void)
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-            	Len = (int)Msg->Data[0];
-            	RxFrame.Type = Msg->Data[1];
-            	memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
                 //if receive the valid FW version request
-                if ((OTA_FRAME_TYPE_CMD == RxFrame.Type) &&
-                (OTA_CMD_ID_VERSION_REQ == RxFrame.Payload[0])) {
+                if ((OTA_FRAME_TYPE_CMD == RxFrame->Type) &&
+                (OTA_CMD_ID_VERSION_REQ == RxFrame->Payload[0])) {
                     SlaveCtrl.RetryTimes = 0;
+                    OTA_SlaveRetryInit();
                     //send the FW version response to master
                     SlaveCtrl.State = OTA_SLAVE_STATE_START_READY;
                     Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_VERSION_RSP, (unsigned char *)&SlaveCtrl.FwVersion, sizeof(SlaveCtrl.FwVersion));
                     MAC_SendData((unsigned char *)&TxFrame, Len);
                     return;
                 }
+                //if receive the announcement of a multicast session
+                if ((OTA_FRAME_TYPE_CMD == RxFrame->Type) &&
+                (OTA_CMD_ID_MCAST_START == RxFrame->Payload[0]) && OTA_SlaveMcastJoin(RxLen)) {
+                    SlaveCtrl.RetryTimes = 0;
+                    OTA_SlaveRetryInit();
+                    SlaveCtrl.State = OTA_SLAVE_STATE_MCAST_DATA;
+                    MAC_RecvData(OTA_MCAST_RX_DURATION);
+                    return;
+                }
             }
 
             if (SlaveCtrl.RetryTimes == OTA_RETRY_MAX) {
@@ -439,40 +1822,171 @@ void OTA_SlaveStart(void)
             MAC_RecvData(OTA_MASTER_RESPONSE_RX_DURATION);
         }
     }
+    else if (OTA_SLAVE_STATE_MCAST_DATA == SlaveCtrl.State) {
+        if (!Msg) {
+            OTA_SlaveMcastNack();
+        }
+        else {
+            //if receive a valid rf packet
+            if (Msg->Type == OTA_MSG_TYPE_DATA) {
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
+                //if receive a broadcast block, keep listening while it is written
+                if (OTA_FRAME_TYPE_STREAM == RxFrame->Type) {
+                    unsigned short BlockNum = RxFrame->Payload[0] | (RxFrame->Payload[1] << 8);
+                    retry_policy_success(&SlaveRetry, 0);
+                    MAC_RecvData(OTA_MCAST_RX_DURATION);
+                    if ((BlockNum >= 1) && (BlockNum <= SlaveCtrl.MaxBlockNum) && !OTA_ResumeIsBlockReceived(BlockNum)) {
+                        OTA_SlaveWriteBlock(BlockNum, &RxFrame->Payload[2], RxLen - 3);
+                        SlaveCtrl.BlockNum++;
+                    }
+                    return;
+                }
+                if (OTA_FRAME_TYPE_CMD == RxFrame->Type) {
+                    retry_policy_success(&SlaveRetry, 0);
+                    if (OTA_CMD_ID_MCAST_POLL == RxFrame->Payload[0]) {
+                        OTA_SlaveMcastPoll(RxLen);
+                        if (SlaveNackLen) {
+                            return;
+                        }
+                    }
+                    //if receive the end of the session, a slave still missing blocks keeps them for the next one
+                    if (OTA_CMD_ID_MCAST_END == RxFrame->Payload[0]) {
+                        if (SlaveCtrl.BlockNum != SlaveCtrl.MaxBlockNum) {
+                            SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
+                            return;
+                        }
+                        SlaveCtrl.TotalBinSize = SlaveResume.ImageSize;
+                        SlaveCtrl.State = OTA_SLAVE_STATE_END;
+                        return;
+                    }
+                    MAC_RecvData(OTA_MCAST_RX_DURATION);
+                    return;
+                }
+            }
+            //the reports of the other slaves collide in the collection rounds, only silence counts
+            else if (Msg->Type == OTA_MSG_TYPE_INVALID_DATA) {
+                MAC_RecvData(OTA_MCAST_RX_DURATION);
+                return;
+            }
+
+            if (!OTA_SlaveRetry(Msg)) {
+                SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
+                return;
+            }
+            MAC_RecvData(OTA_MCAST_RX_DURATION);
+        }
+    }
     else if (OTA_SLAVE_STATE_START_READY == SlaveCtrl.State) {
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-				Len = (int)Msg->Data[0];
-				RxFrame.Type = Msg->Data[1];
-				memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
-                if (OTA_FRAME_TYPE_CMD == RxFrame.Type) {
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
+                if (OTA_FRAME_TYPE_CMD == RxFrame->Type) {
                     //if receive the FW version request again
-                    if (OTA_CMD_ID_VERSION_REQ == RxFrame.Payload[0]) {
-                        SlaveCtrl.RetryTimes = 0;
+                    if (OTA_CMD_ID_VERSION_REQ == RxFrame->Payload[0]) {
+                        retry_policy_success(&SlaveRetry, 0);
                         //send the FW version response again to master
                         MAC_SendData((unsigned char *)&TxFrame, Len);
                         return;
                     }
                     //if receive the OTA start request
-                    if (OTA_CMD_ID_START_REQ == RxFrame.Payload[0]) {
+                    if (OTA_CMD_ID_START_REQ == RxFrame->Payload[0]) {
 
-                        SlaveCtrl.RetryTimes = 0;
-                        memcpy(&SlaveCtrl.MaxBlockNum, &RxFrame.Payload[1], sizeof(SlaveCtrl.MaxBlockNum));
-                        //send the OTA start response to master
+                        retry_policy_success(&SlaveRetry, 0);
+                        memcpy(&SlaveCtrl.MaxBlockNum, &RxFrame->Payload[1], sizeof(SlaveCtrl.MaxBlockNum));
                         SlaveCtrl.State = OTA_SLAVE_STATE_DATA_READY;
-                        Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_START_RSP, 0, 0);
-                        MAC_SendData((unsigned char *)&TxFrame, Len);
+                        //a capable master appends its proposal and the image identity after MaxBlockNum
+                        if (RxLen >= 12) {
+                            OTA_ResumeInfoTypeDef Req;
+                            SlaveCtrl.Caps = RxFrame->Payload[3] & (OTA_CAP_WINDOW | OTA_CAP_RESUME | OTA_CAP_BUSY);
+                            SlaveCtrl.Caps |= OTA_SlaveAcceptHop(RxLen);
+                            SlaveCtrl.Caps |= OTA_SlaveAcceptVersion(RxLen);
+#if OTA_LZ_EN
+                            //the decoder state lives in RAM only, a compressed image cannot be resumed
+                            if ((RxFrame->Payload[3] & OTA_CAP_COMPRESS) && (RxLen >= 17)) {
+                                SlaveCtrl.Caps = (SlaveCtrl.Caps & ~OTA_CAP_RESUME) | OTA_CAP_COMPRESS;
+                                memcpy(&SlaveCtrl.RawSize, &RxFrame->Payload[12], 4);
+                                SlaveRebuildError = 0;
+                                OTA_LzInit(&SlaveLz, OTA_SlaveImageOutput);
+                            }
+#endif
+#if OTA_DELTA_EN
+                            //the patch stream follows the old image identity, it has to match the running image
+                            if ((RxFrame->Payload[3] & OTA_CAP_DELTA) && !(SlaveCtrl.Caps & OTA_CAP_COMPRESS) && (RxLen >= 23)) {
+                                unsigned int OldSize;
+                                memcpy(&OldSize, &RxFrame->Payload[16], 4);
+                                if (OTA_SlaveDeltaBaseMatch(OldSize, RxFrame->Payload[20] | (RxFrame->Payload[21] << 8))) {
+                                    SlaveCtrl.Caps = (SlaveCtrl.Caps & ~OTA_CAP_RESUME) | OTA_CAP_DELTA;
+                                    memcpy(&SlaveCtrl.RawSize, &RxFrame->Payload[12], 4);
+                                    SlaveRebuildError = 0;
+                                    OTA_DeltaInit(&SlaveDelta, OTA_SlaveDeltaRead, OTA_SlaveImageOutput, OldSize);
+                                }
+                            }
+#endif
+                            SlaveCtrl.WindowSize = RxFrame->Payload[4];
+                            if (SlaveCtrl.WindowSize > OTA_WINDOW_SIZE_MAX) {
+                                SlaveCtrl.WindowSize = OTA_WINDOW_SIZE_MAX;
+                            }
+                            if (SlaveCtrl.WindowSize < 2) {
+                                SlaveCtrl.Caps &= ~OTA_CAP_WINDOW;
+                            }
+                            Req.FlashAddr = SlaveCtrl.FlashAddr;
+                            Req.ImageCRC = RxFrame->Payload[5] | (RxFrame->Payload[6] << 8);
+                            memcpy(&Req.ImageSize, &RxFrame->Payload[7], 4);
+                            if (SlaveResumeValid && (SlaveCtrl.Caps & OTA_CAP_RESUME) && OTA_ResumeIsMatch(&SlaveResume, &Req)) {
+                                OTA_SlaveEraseInit(Req.ImageSize);
+                                OTA_SlaveSetBlockSize(OTA_SlaveAcceptBlockSize(RxFrame->Payload, RxLen));
+                                OTA_SlaveResume();
+                            }
+                            else {
+                                //the area may hold part of another image, it is erased again on demand
+                                SlaveResumeValid = 0;
+                                OTA_SlaveEraseInit((SlaveCtrl.Caps & OTA_CAP_REBUILD) ? SlaveCtrl.RawSize : Req.ImageSize);
+                                SlaveResume = Req;
+                                OTA_SlaveSetBlockSize(OTA_SlaveAcceptBlockSize(RxFrame->Payload, RxLen));
+                                SlaveResume.MaxBlockNum = SlaveCtrl.MaxBlockNum;
+                                SlaveResume.BlockSize = SlaveCtrl.BlockSize;
+                                if (SlaveCtrl.Caps & OTA_CAP_RESUME) {
+                                    OTA_ResumeCreate(&SlaveResume);
+                                    SlaveResumeValid = 1;
+                                }
+                                else {
+                                    OTA_ResumeDiscard();
+                                }
+                            }
+                            if (SlaveCtrl.MaxBlockNum == SlaveCtrl.BlockNum) {
+                                SlaveCtrl.State = OTA_SLAVE_STATE_END_READY;
+                            }
+                            SlaveMarked = SlaveCtrl.BlockNum;
+                            Len = OTA_BuildStartRspFrame(&TxFrame, RxLen);
+                        }
+                        else {
+                            if (SlaveResumeValid) {
+                                OTA_ResumeDiscard();
+                                SlaveResumeValid = 0;
+                            }
+                            //a legacy master only tells the number of 48-byte blocks
+                            OTA_SlaveEraseInit(SlaveCtrl.MaxBlockNum * OTA_BLOCK_SIZE_MIN);
+                            Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_START_RSP, 0, 0);
+                        }
+                        //the first sector is needed right away. A windowed master that cannot hold its stream back
+                        //until the erase is done would lose it while the receiver is off, so erase first for it
+                        if ((SlaveCtrl.Caps & OTA_CAP_WINDOW) && !(SlaveCtrl.Caps & OTA_CAP_BUSY)) {
+                            OTA_SlaveEraseIdle();
+                            MAC_SendData((unsigned char *)&TxFrame, Len);
+                            return;
+                        }
+                        //send the OTA start response to master, erase while it is on its way
+                        OTA_SlaveRespond(Len, 0);
                         return;
                     }
                 }
             }
 
-            if (SlaveCtrl.RetryTimes == OTA_RETRY_MAX) {
+            if (!OTA_SlaveRetry(Msg)) {
                 SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
                 return;
             }
-            SlaveCtrl.RetryTimes++;
             MAC_RecvData(OTA_MASTER_RESPONSE_RX_DURATION);
         }
     }
@@ -480,76 +1994,97 @@ void OTA_SlaveStart(void)
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-				Len = (int)Msg->Data[0];
-				RxFrame.Type = Msg->Data[1];
-				memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
                 //if receive the OTA start request again
-                if (OTA_FRAME_TYPE_CMD == RxFrame.Type) {
-                    if (OTA_CMD_ID_START_REQ == RxFrame.Payload[0]) {
-                        SlaveCtrl.RetryTimes = 0;
+                if (OTA_FRAME_TYPE_CMD == RxFrame->Type) {
+                    if (OTA_CMD_ID_START_REQ == RxFrame->Payload[0]) {
+                        retry_policy_success(&SlaveRetry, 0);
+                        if (OTA_SlaveRestartReq(RxLen)) {
+                            Len = OTA_BuildStartRspFrame(&TxFrame, RxLen);
+                        }
                         //send the OTA start response again to master
                         MAC_SendData((unsigned char *)&TxFrame, Len);//need change
                         return;
                     }
                 }
+                //if receive a streamed frame of the window, keep listening for the rest of it
+                if ((SlaveCtrl.Caps & OTA_CAP_WINDOW) && (OTA_FRAME_TYPE_STREAM == RxFrame->Type)) {
+                    unsigned short BlockNum = RxFrame->Payload[0] | (RxFrame->Payload[1] << 8);
+                    retry_policy_success(&SlaveRetry, 0);
+                    MAC_RecvData(OTA_MASTER_RESPONSE_RX_DURATION);
+                    OTA_SlaveWindowBlock(BlockNum, &RxFrame->Payload[2], RxLen - 3);
+                    if (SlaveCtrl.MaxBlockNum == SlaveCtrl.BlockNum) {
+                        SlaveCtrl.State = OTA_SLAVE_STATE_END_READY;
+                    }
+#if (MAC_LINK_ACK)
+                    //the selective ACK goes out in the ACK payload of the next frame, the master streams on
+                    //meanwhile and the link layer holds it back while a page is programmed, only an erase
+                    //outlasts its retries and is announced
+                    Len = OTA_BuildAckFrame(&TxFrame, SlaveCtrl.BlockNum);
+                    OTA_SlaveRespond(Len, 0);
+#else
+                    //a page takes about as long as a frame on air, the next frame waits in the rx buffer
+                    //and the one after it finds the receiver on again, so the stream is programmed as it comes
+                    OTA_SlaveFlush(0);
+#endif
+                    return;
+                }
                 //if receive the OTA data frame
-                if (OTA_FRAME_TYPE_DATA == RxFrame.Type) {
+                if (OTA_FRAME_TYPE_DATA == RxFrame->Type) {
                     //check the block number included in the incoming frame
-                    unsigned short BlockNum = RxFrame.Payload[1];
+                    unsigned short BlockNum = RxFrame->Payload[1];
                     BlockNum <<= 8;
-                    BlockNum += RxFrame.Payload[0];
+                    BlockNum += RxFrame->Payload[0];
+                    //the last frame of a window, report everything received so far
+                    if (SlaveCtrl.Caps & OTA_CAP_WINDOW) {
+                        retry_policy_success(&SlaveRetry, 0);
+                        OTA_SlaveWindowBlock(BlockNum, &RxFrame->Payload[2], RxLen - 3);
+                        if (SlaveCtrl.MaxBlockNum == SlaveCtrl.BlockNum) {
+                            SlaveCtrl.State = OTA_SLAVE_STATE_END_READY;
+                        }
+                        //the next window follows the ACK back to back, a master that cannot hold it back
+                        //until the flash work is done gets the ACK after it
+                        Len = OTA_BuildAckFrame(&TxFrame, SlaveCtrl.BlockNum);
+                        if (!(SlaveCtrl.Caps & OTA_CAP_BUSY)) {
+                            OTA_SlaveEraseIdle();
+                            OTA_SlaveFlush(0);
+                            MAC_SendData((unsigned char *)&TxFrame, Len);
+                            return;
+                        }
+                        OTA_SlaveRespond(Len, 1);
+                        return;
+                    }
                     //if receive the same OTA data frame again, just respond with the same ACK
                     if (BlockNum == SlaveCtrl.BlockNum) {
-                        SlaveCtrl.RetryTimes = 0;
+                        retry_policy_success(&SlaveRetry, 0);
                         //send the OTA data ack again to master
                         MAC_SendData((unsigned char *)&TxFrame, Len);
                         return;
                     }
                     //if receive the next OTA data frame, just respond with an ACK
                     if (BlockNum == SlaveCtrl.BlockNum + 1) {
-                        SlaveCtrl.RetryTimes = 0;
-//                        printf("block_num:%d, len:%d, PktCRC:%2x\r\n", BlockNum, Len - 3, SlaveCtrl.PktCRC);
-                        /*
-                         * write received data to flash,
-                         * and avoid first block data writing boot flag as head of time.
-                         */
-                        if(1 == BlockNum)
-                        {
-                            // unfill boot flag in ota procedure
-                            flash_write_page(SlaveCtrl.FlashAddr, 8, &RxFrame.Payload[2]);
-                            flash_write_page(SlaveCtrl.FlashAddr + 12, Len - 3 - 12, &RxFrame.Payload[2 + 12]);
-                        }
-                        else
-                        {
-                            //write received data to flash
-                            flash_write_page(SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize, Len - 3, &RxFrame.Payload[2]);
-                        }
-
+                        retry_policy_success(&SlaveRetry, 0);
+//                        printf("block_num:%d, len:%d, PktCRC:%2x\r\n", BlockNum, RxLen - 3, SlaveCtrl.PktCRC);
+                        OTA_SlaveWriteBlock(BlockNum, &RxFrame->Payload[2], RxLen - 3);
+                        OTA_SlaveUpdatePktCRC(BlockNum, &RxFrame->Payload[2], RxLen - 3);
                         SlaveCtrl.BlockNum = BlockNum;
-                        SlaveCtrl.TotalBinSize += (Len - 3);
 
                         if (SlaveCtrl.MaxBlockNum == BlockNum) {
-                        	SlaveCtrl.PktCRC = OTA_CRC16_Cal(SlaveCtrl.PktCRC, &RxFrame.Payload[2], Len - 3 - OTA_APPEND_INFO_LEN);
                             SlaveCtrl.State = OTA_SLAVE_STATE_END_READY;
                         }
-                        else
-                        {
-                        	SlaveCtrl.PktCRC = OTA_CRC16_Cal(SlaveCtrl.PktCRC, &RxFrame.Payload[2], Len - 3);
-                        }
-                        //send the OTA data ack to master
-                        unsigned int Length = OTA_BuildAckFrame(&TxFrame, BlockNum);
-                        MAC_SendData((unsigned char *)&TxFrame, Length);
-
+                        //send the OTA data ack to master, erase ahead and program the staged page
+                        //while the next frame is on its way
+                        Len = OTA_BuildAckFrame(&TxFrame, BlockNum);
+                        OTA_SlaveRespond(Len, 0);
                         return;
                     }
                 }
             }
 
-            if (SlaveCtrl.RetryTimes == OTA_RETRY_MAX) {
+            if (!OTA_SlaveRetry(Msg)) {
                 SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
                 return;
             }
-            SlaveCtrl.RetryTimes++;
             MAC_RecvData(OTA_MASTER_RESPONSE_RX_DURATION);
         }
     }
@@ -557,33 +2092,64 @@ void OTA_SlaveStart(void)
         if (Msg) {
             //if receive a valid rf packet
             if (Msg->Type == OTA_MSG_TYPE_DATA) {
-				Len = (int)Msg->Data[0];
-				RxFrame.Type = Msg->Data[1];
-				memcpy(RxFrame.Payload, Msg->Data+2, Len-1);
+                RxLen = OTA_ParseFrame(&RxFrame, Msg->Data);
+                //the final selective ACK got lost and the master resends part of the window
+                if ((SlaveCtrl.Caps & OTA_CAP_WINDOW) && (OTA_FRAME_TYPE_STREAM == RxFrame->Type)) {
+                    retry_policy_success(&SlaveRetry, 0);
+#if (MAC_LINK_ACK)
+                    MAC_SendData((unsigned char *)&TxFrame, Len);
+#else
+                    MAC_RecvData(OTA_MASTER_RESPONSE_RX_DURATION);
+#endif
+                    return;
+                }
                 //if receive the last OTA data frame again
-                if (OTA_FRAME_TYPE_DATA == RxFrame.Type) {
+                if (OTA_FRAME_TYPE_DATA == RxFrame->Type) {
                     //check the block number included in the incoming frame
-                    unsigned short BlockNum = RxFrame.Payload[1];
+                    unsigned short BlockNum = RxFrame->Payload[1];
                     BlockNum <<= 8;
-                    BlockNum += RxFrame.Payload[0];
+                    BlockNum += RxFrame->Payload[0];
                     //if receive the same OTA data frame again, just respond with the same ACK
-                    if (BlockNum == SlaveCtrl.BlockNum) {
-                        SlaveCtrl.RetryTimes = 0;
+                    if ((BlockNum == SlaveCtrl.BlockNum) || (SlaveCtrl.Caps & OTA_CAP_WINDOW)) {
+                        retry_policy_success(&SlaveRetry, 0);
                         //send the OTA data ack again to master
                         MAC_SendData((unsigned char *)&TxFrame, Len);
                         return;
                     }
                 }
                 //if receive the OTA end request
-                if (OTA_FRAME_TYPE_CMD == RxFrame.Type) {
-                    if (OTA_CMD_ID_END_REQ == RxFrame.Payload[0]) {
-                        SlaveCtrl.RetryTimes = 0;
+                if (OTA_FRAME_TYPE_CMD == RxFrame->Type) {
+                    //a resumed session may be complete already when START_RSP gets lost
+                    if (OTA_CMD_ID_START_REQ == RxFrame->Payload[0]) {
+                        retry_policy_success(&SlaveRetry, 0);
+                        if (OTA_SlaveRestartReq(RxLen)) {
+                            Len = OTA_BuildStartRspFrame(&TxFrame, RxLen);
+                        }
+                        //send the OTA start response again to master
+                        MAC_SendData((unsigned char *)&TxFrame, Len);
+                        return;
+                    }
+                    if (OTA_CMD_ID_END_REQ == RxFrame->Payload[0]) {
+                        retry_policy_success(&SlaveRetry, 0);
                         unsigned int BinSize = 0;
-                        memcpy(&BinSize, &RxFrame.Payload[1], sizeof(BinSize));
+                        memcpy(&BinSize, &RxFrame->Payload[1], sizeof(BinSize));
                         if (SlaveCtrl.TotalBinSize != BinSize) {
+                            OTA_SlaveDiscard();
                             SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
                             return;
                         }
+#if (OTA_LZ_EN || OTA_DELTA_EN)
+                        //from here on the rebuilt image is checked like a plain one
+                        if (SlaveCtrl.Caps & OTA_CAP_REBUILD) {
+                            if (!OTA_SlaveRebuildFinish()) {
+                                SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
+                                return;
+                            }
+                            SlaveCtrl.TotalBinSize = SlaveCtrl.RawSize;
+                        }
+#endif
+                        //the END_RSP is only sent once the whole image is durable
+                        OTA_SlaveFlush(1);
                         SlaveCtrl.State = OTA_SLAVE_STATE_END;
                         //send the OTA end response to master
                         Len = OTA_BuildCmdFrame(&TxFrame, OTA_CMD_ID_END_RSP, 0, 0);
@@ -594,73 +2160,35 @@ void OTA_SlaveStart(void)
                 }
             }
 
-            if (SlaveCtrl.RetryTimes == OTA_RETRY_MAX) {
+            if (!OTA_SlaveRetry(Msg)) {
                 SlaveCtrl.State = OTA_SLAVE_STATE_ERROR;
                 return;
             }
-            SlaveCtrl.RetryTimes++;
             MAC_RecvData(OTA_MASTER_RESPONSE_RX_DURATION);
         }
     }
     else if (OTA_SLAVE_STATE_END == SlaveCtrl.State) {
-#if 1
-        // 1. todo FW crc check
-//        int max_block_num = (SlaveCtrl.TotalBinSize + OTA_FRAME_PAYLOAD_MAX -2 - 1) / (OTA_FRAME_PAYLOAD_MAX - 2);
-        unsigned char bin_buf[48] = {0};
-        int block_idx = 0;
-        int len = 0;
+        //the image read back from flash has to match the CRC it carries, the frames received and,
+        //for a rebuilt or multicast one, the image the master announced. A multicast slave received
+        //the blocks out of order and has no PktCRC
         flash_read_page((unsigned long)SlaveCtrl.FlashAddr + SlaveCtrl.TotalBinSize - OTA_APPEND_INFO_LEN,
-                2, &SlaveCtrl.TargetFwCRC);
-        while (1)
-        {
-            if (SlaveCtrl.TotalBinSize - block_idx * (OTA_FRAME_PAYLOAD_MAX - 2) > (OTA_FRAME_PAYLOAD_MAX - 2))
-            {
-                len = OTA_FRAME_PAYLOAD_MAX - 2;
-                flash_read_page((unsigned long)SlaveCtrl.FlashAddr + block_idx * (OTA_FRAME_PAYLOAD_MAX - 2),
-                        len, &bin_buf[0]);
-                if (0 == block_idx)
-                {
-                    // fill the boot flag mannually
-                    bin_buf[8] = 0x4b;
-                    bin_buf[9] = 0x4e;
-                    bin_buf[10] = 0x4c;
-                    bin_buf[11] = 0x54;
-                }
-                SlaveCtrl.FwCRC = OTA_CRC16_Cal(SlaveCtrl.FwCRC, &bin_buf[0], len);
-            }
-            else
-            {
-                len = SlaveCtrl.TotalBinSize - (block_idx * (OTA_FRAME_PAYLOAD_MAX - 2))- OTA_APPEND_INFO_LEN;
-                flash_read_page((unsigned long)SlaveCtrl.FlashAddr + block_idx * (OTA_FRAME_PAYLOAD_MAX - 2),
-                        len, &bin_buf[0]);
-                SlaveCtrl.FwCRC = OTA_CRC16_Cal(SlaveCtrl.FwCRC, &bin_buf[0], len);
-                break;
-            }
-            block_idx++;
-//            printf("fw block idx:%d, len:%d, FwCRC:%2x\r\n", block_idx, len, SlaveCtrl.FwCRC);
-        }
-//        printf("fw block idx:%d, len:%d, FwCRC:%2x  \r\n", block_idx + 1, len, SlaveCtrl.FwCRC);
-//        printf("pkt_crc:%2x, fw_crc:%2x, target_fw_crc:%2x\r\n", SlaveCtrl.PktCRC, SlaveCtrl.FwCRC, SlaveCtrl.TargetFwCRC);
-        if (SlaveCtrl.FwCRC != SlaveCtrl.PktCRC || SlaveCtrl.TargetFwCRC != SlaveCtrl.FwCRC)
+                        OTA_APPEND_INFO_LEN, (unsigned char *)&SlaveCtrl.TargetFwCRC);
+        SlaveCtrl.FwCRC = SlaveCtrl.TargetFwCRC;
+        if (!image_check_full(SlaveCtrl.FlashAddr, SlaveCtrl.TotalBinSize, SlaveCtrl.TargetFwCRC) ||
+            (!(SlaveCtrl.Caps & OTA_CAP_MCAST) && (SlaveCtrl.FwCRC != SlaveCtrl.PktCRC)) ||
+            ((SlaveCtrl.Caps & (OTA_CAP_REBUILD | OTA_CAP_MCAST)) && (SlaveResume.ImageCRC != SlaveCtrl.FwCRC)))
         {
-//            printf("Crc Check Error\r\n");
+            OTA_SlaveDiscard();
             SlaveCtrl.State = OTA_MASTER_STATE_ERROR;
             return;
         }
-#endif
-
-        // set next boot flag
-        unsigned int utmp = 0x544C4E4B;
-        flash_write_page(SlaveCtrl.FlashAddr + 8, 4, (unsigned char *)&utmp);
 
-        //clear current boot flag
-        unsigned char tmp = 0x00;
-#if (OTA_SLAVE_BIN_ADDR == OTA_SLAVE_BIN_ADDR_0x20000)
-        flash_write_page(SlaveCtrl.FlashAddr ? 0x08 : 0x20008, 1, &tmp);
-#else
-		flash_write_page(0x20008, 1, &tmp);
-		flash_write_page(SlaveCtrl.FlashAddr ? 0x08 : 0x40008, 1, &tmp);
-#endif
+        //boot the new image on trial, the current one is booted again if it never confirms itself
+        slot_switch(SlaveCtrl.FlashAddr, SlaveNewVersion, SlaveCtrl.FwCRC, SlaveCtrl.TotalBinSize);
+        //the session is complete, nothing left to resume
+        if (SlaveResumeValid) {
+            OTA_ResumeDiscard();
+        }
         if (SlaveCtrl.FlashAddr == 0x00)
         {
 //            printf("cur_boot_addr:%4x, next_boot_addr:%4x\r\n", OTA_SLAVE_BIN_ADDR, 0x0000);
@@ -674,6 +2202,8 @@ void OTA_SlaveStart(void)
         {
 //        	printf("cur_boot_addr:%4x, next_boot_addr:%4x\r\n", 0x0000, OTA_SLAVE_BIN_ADDR_0x40000);
         }
+        OTA_TelemetryFinish(OTA_SLAVE_STATE_END, SlaveCtrl.TotalBinSize, SlaveCtrl.BlockSize);
+        OTA_TelemetryReport(&OTA_Telemetry);
         //reboot
         irq_disable();
         WaitMs(1000);
@@ -681,8 +2211,15 @@ void OTA_SlaveStart(void)
         while(1);
     }
     else if (OTA_SLAVE_STATE_ERROR == SlaveCtrl.State) {
-        //erase the OTA write area
-        OTA_FlashErase();
+        //a broken link keeps the received blocks for the next session,
+        //anything else left in the OTA area is erased on demand by the next one
+        OTA_SlaveFlush(1);
+        //no master showing up is not worth a record
+        if (OTA_SLAVE_STATE_FW_VERSION_READY != LastState) {
+            OTA_TelemetryFinish(LastState, SlaveCtrl.TotalBinSize, SlaveCtrl.BlockSize);
+            OTA_TelemetrySave();
+            OTA_TelemetryReport(&OTA_Telemetry);
+        }
         irq_disable();
         //cpu_sleep_wakeup(DEEPSLEEP_MODE, PM_WAKEUP_TIMER, ClockTime() + OTA_REBOOT_WAIT * 16);
 
@@ -700,6 +2237,32 @@ void OTA_SlaveStart(void)
     }
 }
 
+void OTA_SlaveStart(void)
+{
+    OTA_MsgTypeDef Msg;
+
+    MAC_Poll();
+    OTA_TelemetryTick();
+    if (OTA_MsgQueuePop(&Msg, &MsgQueue)) {
+        if (OTA_MSG_TYPE_DATA == Msg.Type) {
+            SlaveHop.Timeouts = 0;
+        }
+        OTA_SlaveRun(&Msg);
+        //the frame was parsed in place, its rx slot can be received into again
+        MAC_RxRelease(Msg.Data);
+    }
+    else {
+        OTA_SlaveRun(NULL);
+    }
+}
+
+/* 1 once the slave answered a master, the running image has shown its radio works */
+int OTA_SlaveExchanged(void)
+{
+    return (OTA_SLAVE_STATE_IDLE != SlaveCtrl.State) && (OTA_SLAVE_STATE_FW_VERSION_READY != SlaveCtrl.State) &&
+           (OTA_SLAVE_STATE_ERROR != SlaveCtrl.State);
+}
+
 #endif /*OTA_MASTER_EN*/
 
 
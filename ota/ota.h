@@ -58,6 +58,7 @@
 #define OTA_FRAME_TYPE_CMD        0x01
 #define OTA_FRAME_TYPE_DATA       0x02
 #define OTA_FRAME_TYPE_ACK        0x03
+#define OTA_FRAME_TYPE_STREAM     0x04 //data frame inside a window, no ACK solicited
 
 #define OTA_CMD_ID_START_REQ      0x01
 #define OTA_CMD_ID_START_RSP      0x02
@@ -65,17 +66,65 @@
 #define OTA_CMD_ID_END_RSP        0x04
 #define OTA_CMD_ID_VERSION_REQ    0x05
 #define OTA_CMD_ID_VERSION_RSP    0x06
-
-
-
-
-#define OTA_FRAME_PAYLOAD_MAX     (48+2)
-#define OTA_RETRY_MAX             3
+#define OTA_CMD_ID_MCAST_START    0x07 //multicast session announcement
+#define OTA_CMD_ID_MCAST_POLL     0x08 //opens a collection round of contention slots
+#define OTA_CMD_ID_MCAST_NACK     0x09 //missing-block bitmap of one slave
+#define OTA_CMD_ID_MCAST_END      0x0a
+
+#define OTA_CAP_WINDOW            0x01 //selective-repeat windowed transfer
+#define OTA_CAP_RESUME            0x02 //continue an interrupted session of the same image
+#define OTA_CAP_COMPRESS          0x04 //blocks carry an LZSS stream decoded by the slave, see ota_lz.h
+#define OTA_CAP_DELTA             0x08 //blocks carry a patch against the running image, see ota_delta.h
+#define OTA_CAP_MCAST             0x10 //multicast session, blocks are broadcast and never acknowledged
+#define OTA_CAP_HOP               0x20 //the session hops over a channel list appended to START_REQ
+#define OTA_CAP_BUSY              0x40 //START_RSP and the ACKs end in a flags byte, see OTA_RSP_FLAG_BUSY
+#define OTA_CAP_VERSION           0x80 //START_REQ ends in the version of the image, after the hop list
+#define OTA_CAP_REBUILD           (OTA_CAP_COMPRESS | OTA_CAP_DELTA) //the slave rebuilds the image from a stream
+
+
+
+
+#define OTA_BLOCK_SIZE_MIN        48  //legacy block size, MaxBlockNum of START_REQ is counted in it
+#define OTA_BLOCK_SIZE_MAX        192 //frame plus DMA header has to fit the 240-byte rf rx buffer
+#ifndef OTA_BLOCK_SIZE
+#define OTA_BLOCK_SIZE            OTA_BLOCK_SIZE_MAX //block size proposed by the master, 48 * 2^n
+#endif
+#define OTA_FRAME_PAYLOAD_MAX     (OTA_BLOCK_SIZE_MAX+2)
+#define OTA_RETRY_MAX             3 //consecutive failures before the master falls back to a smaller block
+#ifndef OTA_RETRY_BUDGET
+#define OTA_RETRY_BUDGET          128 //failures a session may take on top of one per block, see retry_policy.h
+#endif
+#define OTA_RETRY_BURST_MAX       8   //consecutive failures that end a session, each doubles the timeout
+#define OTA_RTO_MIN               10000 //in us, the slave answers before its flash work
+#define OTA_RTO_INIT              200000 //in us, response timeout until the round trip time is measured
+#define OTA_BUSY_WAIT             (ERASE_AHEAD_SECTOR_ERASE_MAX_US + 20000) //in us, a sector erase, see erase_ahead.h
+#define OTA_RSP_FLAG_BUSY         0x01 //the slave does flash work after this response and sends it again once done
+#define OTA_RTO_MAX               1000000 //in us
+#define OTA_WINDOW_SIZE_MAX       16 //limited by the 16-bit selective ACK bitmap
+#ifndef OTA_WINDOW_SIZE
+#define OTA_WINDOW_SIZE           0  //window proposed by the master, 0 means stop-and-wait only, see ota_sim.sh loss
+#endif
+#ifndef OTA_LZ_EN
+#define OTA_LZ_EN                 1  //slave accepts compressed images, costs the RAM of a decoding window
+#endif
+#ifndef OTA_DELTA_EN
+#define OTA_DELTA_EN              1  //slave accepts delta images, costs the RAM of a flash page
+#endif
+#ifndef OTA_HOP_EN
+#define OTA_HOP_EN                1  //master proposes a hop list, the session channel comes first
+#endif
+#ifndef OTA_HOP_CHANNELS
+#define OTA_HOP_CHANNELS          {24, 48, 78} //channels in the gaps between Wi-Fi channels 1, 6 and 11
+#endif
+#define OTA_HOP_NUM_MAX           4  //length of the hop list, the session channel included
+#define OTA_HOP_TIMEOUT_MAX       3  //consecutive timeouts that make the master hop
+#define OTA_HOP_CRC_MAX           6  //corrupted responses among the last 16 that make the master hop
 #define OTA_APPEND_INFO_LEN              2 // FW_CRC 2 BYTE
 
 typedef struct {
     unsigned int FlashAddr;
     unsigned int TotalBinSize;
+    unsigned int RawSize; //size of the image rebuilt from a compressed or delta stream, 0 for a plain one
     unsigned short MaxBlockNum;
     unsigned short BlockNum;
     unsigned short PeerAddr;
@@ -83,9 +132,16 @@ typedef struct {
     unsigned short FwCRC;
     unsigned short PktCRC;
     unsigned short TargetFwCRC;
+    unsigned short AckBitmap; //blocks received beyond BlockNum, bit n <=> block BlockNum+1+n
+    unsigned short LastBlockLen;
+    unsigned short BlockSize; //agreed in START_REQ/START_RSP, halved when the link degrades
     unsigned char State;
     unsigned char RetryTimes;
     unsigned char FinishFlag;
+    unsigned char Caps; //OTA_CAP_xxx agreed in START_REQ/START_RSP
+    unsigned char WindowSize;
+    unsigned char TxCnt; //data exchanges in the current link quality period
+    unsigned char ErrCnt; //of which failed with a lost or corrupted frame
 } OTA_CtrlTypeDef;
 
 typedef struct {
@@ -101,6 +157,11 @@ enum {
     OTA_MASTER_STATE_END_RSP_WAIT,
     OTA_MASTER_STATE_END,
     OTA_MASTER_STATE_ERROR,
+    OTA_MASTER_STATE_MCAST_ANNOUNCE,
+    OTA_MASTER_STATE_MCAST_DATA,
+    OTA_MASTER_STATE_MCAST_COLLECT,
+    OTA_MASTER_STATE_MCAST_REPAIR,
+    OTA_MASTER_STATE_MCAST_END,
 };
 
 enum {
@@ -110,7 +171,8 @@ enum {
     OTA_SLAVE_STATE_DATA_READY,
     OTA_SLAVE_STATE_END_READY,
     OTA_SLAVE_STATE_END,
-    OTA_SLAVE_STATE_ERROR
+    OTA_SLAVE_STATE_ERROR,
+    OTA_SLAVE_STATE_MCAST_DATA
 };
 
 enum {
@@ -129,10 +191,12 @@ typedef enum{
 }Gen_Fsk_Mode_Slect;
 
 extern void OTA_MasterInit(unsigned int OTABinAddr, unsigned short FwVer);
+extern void OTA_MasterMulticastInit(unsigned int OTABinAddr, unsigned short FwVer);
 extern void OTA_MasterStart(void);
 
 extern void OTA_SlaveInit(unsigned int OTABinAddr, unsigned short FwVer);
 extern void OTA_SlaveStart(void);
+extern int OTA_SlaveExchanged(void);
 
 extern void OTA_RxIrq(unsigned char *Data);
 extern void OTA_RxTimeoutIrq(unsigned char *Data);
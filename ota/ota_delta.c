@@ -0,0 +1,165 @@
+/********************************************************************************************************
+ * @file	ota_delta.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#include "ota_delta.h"
+
+static unsigned int OTA_DeltaRoom(OTA_DeltaTypeDef *Delta, unsigned int Len)
+{
+    unsigned int Room = OTA_DELTA_PAGE_SIZE - (Delta->OutLen & (OTA_DELTA_PAGE_SIZE - 1));
+    return (Len < Room) ? Len : Room;
+}
+
+static void OTA_DeltaCommit(OTA_DeltaTypeDef *Delta, unsigned int Len)
+{
+    Delta->OutLen += Len;
+    if (0 == (Delta->OutLen & (OTA_DELTA_PAGE_SIZE - 1))) {
+        Delta->Output(Delta->OutLen - OTA_DELTA_PAGE_SIZE, Delta->Page, OTA_DELTA_PAGE_SIZE);
+    }
+}
+
+static void OTA_DeltaInsert(OTA_DeltaTypeDef *Delta, const unsigned char *Data, unsigned int Len)
+{
+    unsigned char *Dst;
+    unsigned int n, i;
+
+    while (Len) {
+        n = OTA_DeltaRoom(Delta, Len);
+        Dst = &Delta->Page[Delta->OutLen & (OTA_DELTA_PAGE_SIZE - 1)];
+        for (i = 0; i < n; i++) {
+            Dst[i] = Data[i];
+        }
+        OTA_DeltaCommit(Delta, n);
+        Data += n;
+        Len -= n;
+    }
+}
+
+static void OTA_DeltaCopy(OTA_DeltaTypeDef *Delta, unsigned int Offset, unsigned int Len)
+{
+    unsigned int n;
+
+    if ((Offset > Delta->OldSize) || (Len > Delta->OldSize - Offset)) {
+        Delta->Error = 1;
+        return;
+    }
+    while (Len) {
+        n = OTA_DeltaRoom(Delta, Len);
+        Delta->Read(Offset, &Delta->Page[Delta->OutLen & (OTA_DELTA_PAGE_SIZE - 1)], n);
+        OTA_DeltaCommit(Delta, n);
+        Offset += n;
+        Len -= n;
+    }
+}
+
+void OTA_DeltaInit(OTA_DeltaTypeDef *Delta, OTA_DeltaReadCb Read, OTA_DeltaOutputCb Output, unsigned int OldSize)
+{
+    Delta->Read = Read;
+    Delta->Output = Output;
+    Delta->OldSize = OldSize;
+    Delta->OutLen = 0;
+    Delta->Remain = 0;
+    Delta->Op = 0;
+    Delta->Stage = 0;
+    Delta->Error = 0;
+}
+
+/*
+ * feed the next chunk of the patch stream, chunks may split an op anywhere,
+ * returns -1 once the stream turned out to be corrupted
+ */
+int OTA_DeltaApply(OTA_DeltaTypeDef *Delta, const unsigned char *Data, int Len)
+{
+    int i = 0;
+    int n;
+
+    while ((i < Len) && !Delta->Error) {
+        if (Delta->Remain) {
+            n = Len - i;
+            if (n > Delta->Remain) {
+                n = Delta->Remain;
+            }
+            OTA_DeltaInsert(Delta, &Data[i], n);
+            Delta->Remain -= n;
+            i += n;
+        }
+        else if (0 == Delta->Op) {
+            Delta->Op = Data[i++];
+            Delta->Stage = 0;
+            if ((OTA_DELTA_OP_COPY != Delta->Op) && (OTA_DELTA_OP_INSERT != Delta->Op)) {
+                Delta->Error = 1;
+            }
+        }
+        else {
+            Delta->Param[Delta->Stage++] = Data[i++];
+            if ((OTA_DELTA_OP_COPY == Delta->Op) && (6 == Delta->Stage)) {
+                OTA_DeltaCopy(Delta,
+                              Delta->Param[0] | (Delta->Param[1] << 8) | (Delta->Param[2] << 16) | ((unsigned int)Delta->Param[3] << 24),
+                              Delta->Param[4] | (Delta->Param[5] << 8));
+                Delta->Op = 0;
+            }
+            else if ((OTA_DELTA_OP_INSERT == Delta->Op) && (2 == Delta->Stage)) {
+                Delta->Remain = Delta->Param[0] | (Delta->Param[1] << 8);
+                Delta->Op = 0;
+            }
+        }
+    }
+    return Delta->Error ? -1 : 0;
+}
+
+/* hand out the last partial page, returns the rebuilt size */
+unsigned int OTA_DeltaFinish(OTA_DeltaTypeDef *Delta)
+{
+    unsigned int Rest = Delta->OutLen & (OTA_DELTA_PAGE_SIZE - 1);
+
+    //the stream ended in the middle of an op
+    if (Delta->Op || Delta->Remain) {
+        Delta->Error = 1;
+    }
+    if (Rest) {
+        Delta->Output(Delta->OutLen - Rest, Delta->Page, Rest);
+    }
+    return Delta->OutLen;
+}
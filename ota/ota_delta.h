@@ -0,0 +1,93 @@
+/********************************************************************************************************
+ * @file	ota_delta.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#ifndef _OTA_DELTA_H_
+#define _OTA_DELTA_H_
+
+/*
+ * delta OTA image: OTA_DeltaHeaderTypeDef followed by a patch stream that rebuilds the
+ * new image from the one the slave is running, made by script/ota_delta. The stream
+ * is a sequence of ops, all fields little endian:
+ *   OTA_DELTA_OP_COPY   Offset(4) Len(2)  copy Len bytes of the running image at Offset
+ *   OTA_DELTA_OP_INSERT Len(2) Data(Len)  append Data
+ */
+#define OTA_DELTA_MAGIC           0x314c4454 //"TDL1"
+#define OTA_DELTA_OP_COPY         0x01
+#define OTA_DELTA_OP_INSERT       0x02
+#define OTA_DELTA_PAGE_SIZE       256 //rebuilt data is handed out in flash pages
+
+typedef struct {
+    unsigned int Magic;
+    unsigned int NewSize; //rebuilt size, including the appended CRC
+    unsigned int PatchSize; //bytes following the header
+    unsigned int OldSize; //the image the patch applies to, including the appended CRC
+    unsigned short NewCRC; //the CRC appended to the rebuilt image
+    unsigned short OldCRC; //the CRC appended to the image the patch applies to
+} OTA_DeltaHeaderTypeDef;
+
+#define OTA_DELTA_HEADER_LEN      sizeof(OTA_DeltaHeaderTypeDef)
+
+typedef void (*OTA_DeltaReadCb)(unsigned int Offset, unsigned char *Buf, int Len);
+typedef void (*OTA_DeltaOutputCb)(unsigned int Offset, const unsigned char *Data, int Len);
+
+typedef struct {
+    unsigned char Page[OTA_DELTA_PAGE_SIZE]; //staging of the next page
+    OTA_DeltaReadCb Read; //reads the running image
+    OTA_DeltaOutputCb Output;
+    unsigned int OldSize;
+    unsigned int OutLen;
+    unsigned short Remain; //data bytes left of the current INSERT
+    unsigned char Op; //op whose parameters are being collected, 0 between ops
+    unsigned char Stage; //parameter bytes collected
+    unsigned char Param[6];
+    unsigned char Error; //unknown op or a COPY beyond the running image
+} OTA_DeltaTypeDef;
+
+extern void OTA_DeltaInit(OTA_DeltaTypeDef *Delta, OTA_DeltaReadCb Read, OTA_DeltaOutputCb Output, unsigned int OldSize);
+extern int OTA_DeltaApply(OTA_DeltaTypeDef *Delta, const unsigned char *Data, int Len);
+extern unsigned int OTA_DeltaFinish(OTA_DeltaTypeDef *Delta);
+
+#endif /* _OTA_DELTA_H_ */
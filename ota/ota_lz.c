@@ -0,0 +1,127 @@
+/********************************************************************************************************
+ * @file	ota_lz.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#include "ota_lz.h"
+
+static void OTA_LzPutByte(OTA_LzDecoderTypeDef *Dec, unsigned char Byte)
+{
+    Dec->Window[Dec->OutLen & (OTA_LZ_WINDOW_SIZE - 1)] = Byte;
+    Dec->OutLen++;
+    //a full page is handed out while it is still inside the window
+    if (0 == (Dec->OutLen & (OTA_LZ_PAGE_SIZE - 1))) {
+        Dec->Output(Dec->OutLen - OTA_LZ_PAGE_SIZE,
+                    &Dec->Window[(Dec->OutLen - OTA_LZ_PAGE_SIZE) & (OTA_LZ_WINDOW_SIZE - 1)], OTA_LZ_PAGE_SIZE);
+    }
+}
+
+static void OTA_LzCopyMatch(OTA_LzDecoderTypeDef *Dec, unsigned short Value)
+{
+    unsigned int Dist = (Value & (OTA_LZ_WINDOW_SIZE - 1)) + 1;
+    unsigned int Len = (Value >> OTA_LZ_WINDOW_BITS) + OTA_LZ_MIN_MATCH;
+
+    if (Dist > Dec->OutLen) {
+        Dec->Error = 1;
+        return;
+    }
+    //byte by byte, the match may overlap the bytes it produces
+    while (Len--) {
+        OTA_LzPutByte(Dec, Dec->Window[(Dec->OutLen - Dist) & (OTA_LZ_WINDOW_SIZE - 1)]);
+    }
+}
+
+void OTA_LzInit(OTA_LzDecoderTypeDef *Dec, OTA_LzOutputCb Output)
+{
+    Dec->Output = Output;
+    Dec->OutLen = 0;
+    Dec->Flags = 0;
+    Dec->FlagCnt = 0;
+    Dec->MatchLow = 0;
+    Dec->Stage = 0;
+    Dec->Error = 0;
+}
+
+/*
+ * feed the next chunk of the stream, chunks may split a group or a match anywhere,
+ * returns -1 once the stream turned out to be corrupted
+ */
+int OTA_LzDecode(OTA_LzDecoderTypeDef *Dec, const unsigned char *Data, int Len)
+{
+    int i;
+
+    for (i = 0; (i < Len) && !Dec->Error; i++) {
+        if (Dec->Stage) {
+            Dec->Stage = 0;
+            OTA_LzCopyMatch(Dec, Dec->MatchLow | (Data[i] << 8));
+            Dec->Flags >>= 1;
+            Dec->FlagCnt--;
+        }
+        else if (0 == Dec->FlagCnt) {
+            Dec->Flags = Data[i];
+            Dec->FlagCnt = 8;
+        }
+        else if (Dec->Flags & 0x01) {
+            OTA_LzPutByte(Dec, Data[i]);
+            Dec->Flags >>= 1;
+            Dec->FlagCnt--;
+        }
+        else {
+            Dec->MatchLow = Data[i];
+            Dec->Stage = 1;
+        }
+    }
+    return Dec->Error ? -1 : 0;
+}
+
+/* hand out the last partial page, returns the decoded size */
+unsigned int OTA_LzFinish(OTA_LzDecoderTypeDef *Dec)
+{
+    unsigned int Rest = Dec->OutLen & (OTA_LZ_PAGE_SIZE - 1);
+
+    if (Rest) {
+        Dec->Output(Dec->OutLen - Rest, &Dec->Window[(Dec->OutLen - Rest) & (OTA_LZ_WINDOW_SIZE - 1)], Rest);
+    }
+    return Dec->OutLen;
+}
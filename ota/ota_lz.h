@@ -0,0 +1,91 @@
+/********************************************************************************************************
+ * @file	ota_lz.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#ifndef _OTA_LZ_H_
+#define _OTA_LZ_H_
+
+/*
+ * compressed OTA image: OTA_LzHeaderTypeDef followed by an LZSS stream. The stream is
+ * a sequence of groups, a flag byte followed by 8 items, flag bit n (LSB first) set
+ * means item n is a literal byte, cleared means a 2-byte match: the little endian
+ * value carries distance-1 in the low OTA_LZ_WINDOW_BITS bits and length-3 above
+ */
+#define OTA_LZ_MAGIC              0x315a4c54 //"TLZ1"
+#define OTA_LZ_WINDOW_BITS        10
+#define OTA_LZ_WINDOW_SIZE        (1 << OTA_LZ_WINDOW_BITS)
+#define OTA_LZ_MIN_MATCH          3
+#define OTA_LZ_MAX_MATCH          (OTA_LZ_MIN_MATCH + (1 << (16 - OTA_LZ_WINDOW_BITS)) - 1)
+#define OTA_LZ_PAGE_SIZE          256 //decoded data is handed out in flash pages
+
+typedef struct {
+    unsigned int Magic;
+    unsigned int RawSize; //decoded size, including the appended CRC
+    unsigned int StreamSize; //bytes following the header
+    unsigned short RawCRC; //the CRC appended to the decoded image
+    unsigned char WindowBits;
+    unsigned char Reserved;
+} OTA_LzHeaderTypeDef;
+
+#define OTA_LZ_HEADER_LEN         sizeof(OTA_LzHeaderTypeDef)
+
+typedef void (*OTA_LzOutputCb)(unsigned int Offset, const unsigned char *Data, int Len);
+
+typedef struct {
+    unsigned char Window[OTA_LZ_WINDOW_SIZE]; //last decoded bytes, also the staging of the next page
+    OTA_LzOutputCb Output;
+    unsigned int OutLen;
+    unsigned char Flags;
+    unsigned char FlagCnt; //items left in the current group, 0 means a flag byte comes next
+    unsigned char MatchLow; //first byte of a match split across two input chunks
+    unsigned char Stage; //1 while MatchLow is pending
+    unsigned char Error; //a match reached beyond the decoded data
+} OTA_LzDecoderTypeDef;
+
+extern void OTA_LzInit(OTA_LzDecoderTypeDef *Dec, OTA_LzOutputCb Output);
+extern int OTA_LzDecode(OTA_LzDecoderTypeDef *Dec, const unsigned char *Data, int Len);
+extern unsigned int OTA_LzFinish(OTA_LzDecoderTypeDef *Dec);
+
+#endif /* _OTA_LZ_H_ */
@@ -0,0 +1,230 @@
+/********************************************************************************************************
+ * @file	ota_resume.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#include "ota_resume.h"
+#include "driver.h"
+#include "common.h"
+
+#define OTA_RESUME_SCAN_LEN       16
+
+int OTA_ResumeLoad(OTA_ResumeInfoTypeDef *Info, unsigned int FlashAddr)
+{
+    flash_read_page(OTA_RESUME_INFO_ADDR, sizeof(OTA_ResumeInfoTypeDef), (unsigned char *)Info);
+    if ((OTA_RESUME_MAGIC != Info->Magic) || (FlashAddr != Info->FlashAddr)) {
+        return 0;
+    }
+    //records written before block sizes were negotiated count 48-byte blocks
+    if (0xffff == Info->BlockSize) {
+        Info->BlockSize = 48;
+    }
+    return 1;
+}
+
+int OTA_ResumeIsMatch(const OTA_ResumeInfoTypeDef *Info, const OTA_ResumeInfoTypeDef *Req)
+{
+    return ((Info->FlashAddr == Req->FlashAddr) &&
+            (Info->ImageSize == Req->ImageSize) &&
+            (Info->ImageCRC == Req->ImageCRC));
+}
+
+void OTA_ResumeCreate(OTA_ResumeInfoTypeDef *Info)
+{
+    flash_erase_sector(OTA_RESUME_INFO_ADDR);
+    Info->Magic = OTA_RESUME_MAGIC;
+    flash_write_page(OTA_RESUME_INFO_ADDR + 4, sizeof(OTA_ResumeInfoTypeDef) - 4, (unsigned char *)Info + 4);
+    flash_write_page(OTA_RESUME_INFO_ADDR, 4, (unsigned char *)&Info->Magic);
+}
+
+void OTA_ResumeDiscard(void)
+{
+    flash_erase_sector(OTA_RESUME_INFO_ADDR);
+}
+
+void OTA_ResumeMarkBlock(unsigned short BlockNum)
+{
+    //programming can only clear bits, so the other blocks of the byte stay untouched
+    unsigned char Mask = ~(1 << ((BlockNum - 1) & 0x07));
+    flash_write_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + ((BlockNum - 1) >> 3), 1, &Mask);
+}
+
+/* mark blocks 1..Count at once, used when the bitmap is rebuilt in another block size */
+void OTA_ResumeMarkBlocks(unsigned short Count)
+{
+    unsigned char Zero[OTA_RESUME_SCAN_LEN] = {0};
+    unsigned int Offset = 0;
+    unsigned int Bytes = Count >> 3;
+    unsigned int Chunk;
+    unsigned char Mask;
+
+    while (Offset < Bytes) {
+        Chunk = Bytes - Offset;
+        if (Chunk > OTA_RESUME_SCAN_LEN) {
+            Chunk = OTA_RESUME_SCAN_LEN;
+        }
+        flash_write_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Offset, Chunk, Zero);
+        Offset += Chunk;
+    }
+    if (Count & 0x07) {
+        Mask = 0xff << (Count & 0x07);
+        flash_write_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Bytes, 1, &Mask);
+    }
+}
+
+int OTA_ResumeIsBlockReceived(unsigned short BlockNum)
+{
+    unsigned char Bits = 0;
+    flash_read_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + ((BlockNum - 1) >> 3), 1, &Bits);
+    return !(Bits & (1 << ((BlockNum - 1) & 0x07)));
+}
+
+/* number of blocks received in order from block 1, i.e. the block to resume after */
+unsigned short OTA_ResumeContiguousBlocks(unsigned short MaxBlockNum)
+{
+    unsigned char Buf[OTA_RESUME_SCAN_LEN];
+    unsigned int Offset = 0;
+    unsigned short BlockNum = 0;
+    int i, j;
+
+    while (BlockNum < MaxBlockNum) {
+        flash_read_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Offset, OTA_RESUME_SCAN_LEN, Buf);
+        for (i = 0; i < OTA_RESUME_SCAN_LEN; i++) {
+            if (Buf[i]) {
+                for (j = 0; !(Buf[i] & (1 << j)); j++) {
+                    BlockNum++;
+                }
+                return (BlockNum < MaxBlockNum) ? BlockNum : MaxBlockNum;
+            }
+            BlockNum += 8;
+            if (BlockNum >= MaxBlockNum) {
+                return MaxBlockNum;
+            }
+        }
+        Offset += OTA_RESUME_SCAN_LEN;
+    }
+    return MaxBlockNum;
+}
+
+/* number of blocks received in any order */
+unsigned short OTA_ResumeCountBlocks(unsigned short MaxBlockNum)
+{
+    unsigned char Buf[OTA_RESUME_SCAN_LEN];
+    unsigned int Offset = 0;
+    unsigned short BlockNum = 0;
+    unsigned short Count = 0;
+    int i, j;
+
+    while (BlockNum < MaxBlockNum) {
+        flash_read_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Offset, OTA_RESUME_SCAN_LEN, Buf);
+        for (i = 0; (i < OTA_RESUME_SCAN_LEN) && (BlockNum < MaxBlockNum); i++) {
+            for (j = 0; (j < 8) && (BlockNum < MaxBlockNum); j++, BlockNum++) {
+                if (!(Buf[i] & (1 << j))) {
+                    Count++;
+                }
+            }
+        }
+        Offset += OTA_RESUME_SCAN_LEN;
+    }
+    return Count;
+}
+
+/* highest block received, 0 if none, the OTA area above its sector was never programmed */
+unsigned short OTA_ResumeLastBlock(unsigned short MaxBlockNum)
+{
+    unsigned char Buf[OTA_RESUME_SCAN_LEN];
+    unsigned int Offset = 0;
+    unsigned short BlockNum = 0;
+    unsigned short Last = 0;
+    int i, j;
+
+    while (BlockNum < MaxBlockNum) {
+        flash_read_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Offset, OTA_RESUME_SCAN_LEN, Buf);
+        for (i = 0; (i < OTA_RESUME_SCAN_LEN) && (BlockNum < MaxBlockNum); i++) {
+            for (j = 0; (j < 8) && (BlockNum < MaxBlockNum); j++, BlockNum++) {
+                if (!(Buf[i] & (1 << j))) {
+                    Last = BlockNum + 1;
+                }
+            }
+        }
+        Offset += OTA_RESUME_SCAN_LEN;
+    }
+    return Last;
+}
+
+/*
+ * bitmap of the blocks still missing, a set bit n <=> block *BaseNum+n, starting at
+ * the byte of the first missing block, returns the bytes filled, 0 when complete
+ */
+int OTA_ResumeMissingMap(unsigned short MaxBlockNum, unsigned short *BaseNum, unsigned char *Map, int MapLen)
+{
+    unsigned int ByteNum = (MaxBlockNum + 7) >> 3;
+    unsigned int Offset;
+    unsigned char Bits = 0;
+    int Len;
+
+    //an erased bit is a missing block, the bitmap can be reported as it is
+    for (Offset = 0; Offset < ByteNum; Offset++) {
+        flash_read_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Offset, 1, &Bits);
+        if ((Offset == ByteNum - 1) && (MaxBlockNum & 0x07)) {
+            Bits &= (1 << (MaxBlockNum & 0x07)) - 1;
+        }
+        if (Bits) {
+            break;
+        }
+    }
+    if (Offset == ByteNum) {
+        return 0;
+    }
+    Len = ByteNum - Offset;
+    if (Len > MapLen) {
+        Len = MapLen;
+    }
+    flash_read_page(OTA_RESUME_INFO_ADDR + OTA_RESUME_BITMAP_OFFSET + Offset, Len, Map);
+    if ((Offset + Len == ByteNum) && (MaxBlockNum & 0x07)) {
+        Map[Len - 1] &= (1 << (MaxBlockNum & 0x07)) - 1;
+    }
+    *BaseNum = (Offset << 3) + 1;
+    return Len;
+}
@@ -0,0 +1,81 @@
+/********************************************************************************************************
+ * @file	ota_resume.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#ifndef _OTA_RESUME_H_
+#define _OTA_RESUME_H_
+
+#ifndef OTA_RESUME_INFO_ADDR
+#define OTA_RESUME_INFO_ADDR      0x7d000 //one reserved sector, must not overlap with either OTA area
+#endif
+#define OTA_RESUME_BITMAP_OFFSET  0x100 //received-block bitmap, a cleared bit marks a durable block
+#define OTA_RESUME_MAGIC          0x4f544152
+
+/*
+ * identity of the image an interrupted session was receiving, a new START_REQ
+ * is only resumed when it announces exactly the same image
+ */
+typedef struct {
+    unsigned int Magic; //written last, the record is invalid until then
+    unsigned int FlashAddr;
+    unsigned int ImageSize;
+    unsigned short ImageCRC;
+    unsigned short MaxBlockNum;
+    unsigned short BlockSize; //unit of the bitmap
+} OTA_ResumeInfoTypeDef;
+
+extern int OTA_ResumeLoad(OTA_ResumeInfoTypeDef *Info, unsigned int FlashAddr);
+extern int OTA_ResumeIsMatch(const OTA_ResumeInfoTypeDef *Info, const OTA_ResumeInfoTypeDef *Req);
+extern void OTA_ResumeCreate(OTA_ResumeInfoTypeDef *Info);
+extern void OTA_ResumeDiscard(void);
+extern void OTA_ResumeMarkBlock(unsigned short BlockNum);
+extern void OTA_ResumeMarkBlocks(unsigned short Count);
+extern int OTA_ResumeIsBlockReceived(unsigned short BlockNum);
+extern unsigned short OTA_ResumeContiguousBlocks(unsigned short MaxBlockNum);
+extern unsigned short OTA_ResumeCountBlocks(unsigned short MaxBlockNum);
+extern unsigned short OTA_ResumeLastBlock(unsigned short MaxBlockNum);
+extern int OTA_ResumeMissingMap(unsigned short MaxBlockNum, unsigned short *BaseNum, unsigned char *Map, int MapLen);
+
+#endif /* _OTA_RESUME_H_ */
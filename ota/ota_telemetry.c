@@ -0,0 +1,138 @@
+/********************************************************************************************************
+ * @file	ota_telemetry.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+#include "ota_telemetry.h"
+#include "driver.h"
+#include "common.h"
+
+OTA_TelemetryTypeDef OTA_Telemetry = {0};
+
+void OTA_TelemetryStart(unsigned char Role)
+{
+    memset(&OTA_Telemetry, 0, sizeof(OTA_Telemetry));
+    OTA_Telemetry.Role = Role;
+    OTA_Telemetry.StartTick = clock_time();
+}
+
+void OTA_TelemetryRetry(unsigned char State)
+{
+    if (State < OTA_TELEMETRY_STATE_NUM) {
+        OTA_Telemetry.Retries[State]++;
+    }
+}
+
+void OTA_TelemetryRtt(unsigned int RttUs)
+{
+    unsigned char Bin = 0;
+
+    while ((RttUs >>= 1) && (Bin < OTA_TELEMETRY_RTT_BINS - 1)) {
+        Bin++;
+    }
+    if (OTA_Telemetry.RttHist[Bin] != 0xffff) {
+        OTA_Telemetry.RttHist[Bin]++;
+    }
+}
+
+/*
+ * move the whole ms passed since the last call into ElapsedMs, called on every run of the
+ * state machine so the 32-bit tick difference never gets near its wrap after about 268s
+ */
+void OTA_TelemetryTick(void)
+{
+    unsigned int Ms = (clock_time() - OTA_Telemetry.StartTick) / (sys_tick_per_us * 1000);
+
+    OTA_Telemetry.StartTick += Ms * sys_tick_per_us * 1000;
+    OTA_Telemetry.ElapsedMs += Ms;
+}
+
+void OTA_TelemetryFinish(unsigned char State, unsigned int Bytes, unsigned short BlockSize)
+{
+    OTA_Telemetry.State = State;
+    OTA_Telemetry.Bytes = Bytes;
+    OTA_Telemetry.BlockSize = BlockSize;
+    OTA_TelemetryTick();
+    //an image fits in 512KB, Bytes * 1000 does not overflow
+    OTA_Telemetry.BytesPerSec = OTA_Telemetry.ElapsedMs ? (Bytes * 1000 / OTA_Telemetry.ElapsedMs) : 0;
+}
+
+/* keep the record of a failed session, it survives the reboot that follows */
+void OTA_TelemetrySave(void)
+{
+    unsigned int Magic = OTA_TELEMETRY_MAGIC;
+
+    flash_erase_sector(OTA_TELEMETRY_ADDR);
+    flash_write_page(OTA_TELEMETRY_ADDR + 4, sizeof(OTA_TelemetryTypeDef) - 4, (unsigned char *)&OTA_Telemetry + 4);
+    flash_write_page(OTA_TELEMETRY_ADDR, 4, (unsigned char *)&Magic);
+}
+
+/* the record of the last failed session, returns 0 when there is none */
+int OTA_TelemetryLoad(OTA_TelemetryTypeDef *Telemetry)
+{
+    flash_read_page(OTA_TELEMETRY_ADDR, sizeof(OTA_TelemetryTypeDef), (unsigned char *)Telemetry);
+    return (OTA_TELEMETRY_MAGIC == Telemetry->Magic);
+}
+
+/* print the block over the debug UART or USB, whichever printf is routed to */
+void OTA_TelemetryReport(const OTA_TelemetryTypeDef *Telemetry)
+{
+    int i;
+
+    printf("ota %s state:%d block:%d bytes:%d ms:%d B/s:%d hops:%d\r\n", Telemetry->Role ? "slave" : "master",
+           Telemetry->State, Telemetry->BlockSize, Telemetry->Bytes, Telemetry->ElapsedMs, Telemetry->BytesPerSec,
+           Telemetry->Hops);
+    printf("tx:%d rx:%d crc_err:%d timeout:%d overrun:%d\r\n", Telemetry->TxFrames, Telemetry->RxFrames,
+           Telemetry->CrcErrors, Telemetry->Timeouts, Telemetry->RxOverruns);
+    printf("retries:");
+    for (i = 0; i < OTA_TELEMETRY_STATE_NUM; i++) {
+        printf(" %d", Telemetry->Retries[i]);
+    }
+    printf("\r\nrtt log2(us):");
+    for (i = 0; i < OTA_TELEMETRY_RTT_BINS; i++) {
+        if (Telemetry->RttHist[i]) {
+            printf(" %d:%d", i, Telemetry->RttHist[i]);
+        }
+    }
+    printf("\r\n");
+}
@@ -0,0 +1,91 @@
+/********************************************************************************************************
+ * @file	ota_telemetry.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+#ifndef _OTA_TELEMETRY_H_
+#define _OTA_TELEMETRY_H_
+
+#ifndef OTA_TELEMETRY_ADDR
+#define OTA_TELEMETRY_ADDR        0x7c000 //one reserved sector keeping the record of the last failed session
+#endif
+#define OTA_TELEMETRY_MAGIC       0x4f54544d
+#define OTA_TELEMETRY_STATE_NUM   12 //retries are counted per state of the master or the slave
+#define OTA_TELEMETRY_RTT_BINS    24 //bin n counts round trips of 2^n..2^(n+1)-1 us
+
+/*
+ * counters of one session, the frame, CRC, timeout and overrun counters are kept by mac.c,
+ * the rest by ota.c, the block is reported at the end of a session and persisted on error
+ */
+typedef struct {
+    unsigned int Magic; //written last, the persisted record is invalid until then
+    unsigned int TxFrames;
+    unsigned int RxFrames; //with a valid CRC
+    unsigned int CrcErrors;
+    unsigned int Timeouts; //rx windows closed without any frame
+    unsigned int RxOverruns; //valid frames dropped because every rx slot was still held
+    unsigned int Bytes; //image bytes delivered
+    unsigned int ElapsedMs;
+    unsigned int BytesPerSec;
+    unsigned int StartTick; //ElapsedMs is counted up to this tick
+    unsigned short Retries[OTA_TELEMETRY_STATE_NUM];
+    unsigned short RttHist[OTA_TELEMETRY_RTT_BINS];
+    unsigned short BlockSize; //in use when the session ended
+    unsigned short Hops; //channel changes of a hopping session
+    unsigned char State; //the session ended in it, the failing state for a persisted record
+    unsigned char Role; //0 master, 1 slave
+} OTA_TelemetryTypeDef;
+
+extern OTA_TelemetryTypeDef OTA_Telemetry;
+
+extern void OTA_TelemetryStart(unsigned char Role);
+extern void OTA_TelemetryRetry(unsigned char State);
+extern void OTA_TelemetryRtt(unsigned int RttUs);
+extern void OTA_TelemetryTick(void);
+extern void OTA_TelemetryFinish(unsigned char State, unsigned int Bytes, unsigned short BlockSize);
+extern void OTA_TelemetrySave(void);
+extern int OTA_TelemetryLoad(OTA_TelemetryTypeDef *Telemetry);
+extern void OTA_TelemetryReport(const OTA_TelemetryTypeDef *Telemetry);
+
+#endif /* _OTA_TELEMETRY_H_ */
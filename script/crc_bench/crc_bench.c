@@ -0,0 +1,168 @@
+/********************************************************************************************************
+ * @file	crc_bench.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host tool, checks common/crc.c against the published check values and the bit loops
+ * OTA and FW_UPDATE used before, then measures its throughput
+ *   build: gcc -O2 -Wall -DCRC_TABLE_MODE=4 -o crc_bench crc_bench.c ../../common/crc.c, crc_bench.sh builds every mode
+ *   usage: crc_bench [megabytes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../common/crc.h"
+
+/* the OTA_CRC16_Cal()/FW_CRC16_Cal() the update paths ran before */
+static unsigned short RefCrc16(unsigned short crc, unsigned char* pd, int len)
+{
+    unsigned short      crc16_poly[2] = { 0, 0x8408 }; //0x1021 <==> 0x8408
+    int i, j;
+
+    for (j = len; j > 0; j--)
+    {
+        unsigned char ds = *pd++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ crc16_poly[(crc ^ ds) & 1];
+            ds = ds >> 1;
+        }
+    }
+
+    return crc;
+}
+
+static int Errors;
+
+static void Expect(const char *Name, unsigned int Got, unsigned int Want)
+{
+    if (Got != Want) {
+        printf("%s: 0x%x, expected 0x%x\n", Name, Got, Want);
+        Errors++;
+    }
+}
+
+static void KnownAnswers(void)
+{
+    static const char Check[] = "123456789";
+    static unsigned char Buf[4096 + 8];
+    unsigned int i, n;
+
+    Expect("crc8 check", crc8_update(CRC8_INIT, Check, 9), 0xf4);
+    Expect("crc16 check", crc16_update(CRC16_INIT, Check, 9), 0x2189);
+    Expect("crc32 check", crc32_update(CRC32_INIT, Check, 9), 0xcbf43926);
+    Expect("crc32 empty", crc32_update(CRC32_INIT, Check, 0), 0);
+
+    //every alignment and length the word loop and the byte tails meet, whole and in two pieces
+    for (i = 0; i < sizeof(Buf); i++) {
+        Buf[i] = rand();
+    }
+    for (n = 0; n < 600; n++) {
+        unsigned int Len = (n < 300) ? n : (unsigned int)(rand() % 4096);
+        unsigned int Align = n & 7;
+        unsigned int Split = Len ? (rand() % Len) : 0;
+        unsigned short Ref = RefCrc16(0x1d0f * (n & 1), &Buf[Align], Len);
+        unsigned short Crc = crc16_update(0x1d0f * (n & 1), &Buf[Align], Split);
+
+        Expect("crc16 reference", crc16_update(0x1d0f * (n & 1), &Buf[Align], Len), Ref);
+        Expect("crc16 in pieces", crc16_update(Crc, &Buf[Align + Split], Len - Split), Ref);
+        Expect("crc32 in pieces", crc32_update(crc32_update(CRC32_INIT, &Buf[Align], Split), &Buf[Align + Split], Len - Split),
+               crc32_update(CRC32_INIT, &Buf[Align], Len));
+        Expect("crc8 in pieces", crc8_update(crc8_update(CRC8_INIT, &Buf[Align], Split), &Buf[Align + Split], Len - Split),
+               crc8_update(CRC8_INIT, &Buf[Align], Len));
+        if (Errors) {
+            printf("length %u, alignment %u, split %u\n", Len, Align, Split);
+            return;
+        }
+    }
+}
+
+static double Seconds(void)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return Ts.tv_sec + Ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int Mb = (argc > 1) ? strtoul(argv[1], NULL, 0) : 16;
+    static unsigned char Buf[64 * 1024];
+    volatile unsigned int Sink = 0;
+    unsigned int i, Rounds = Mb * 1024 * 1024 / sizeof(Buf);
+    double t;
+
+    KnownAnswers();
+    if (Errors) {
+        printf("CRC_TABLE_MODE %d: FAILED\n", CRC_TABLE_MODE);
+        return 1;
+    }
+    for (i = 0; i < sizeof(Buf); i++) {
+        Buf[i] = i * 7;
+    }
+    printf("CRC_TABLE_MODE %d: known answers ok, MB/s over %u MB:", CRC_TABLE_MODE, Mb);
+    t = Seconds();
+    for (i = 0; i < Rounds; i++) {
+        Sink += RefCrc16(Sink, Buf, sizeof(Buf));
+    }
+    printf(" bit loop %.1f", Mb / (Seconds() - t));
+    t = Seconds();
+    for (i = 0; i < Rounds; i++) {
+        Sink += crc8_update(Sink, Buf, sizeof(Buf));
+    }
+    printf(", crc8 %.1f", Mb / (Seconds() - t));
+    t = Seconds();
+    for (i = 0; i < Rounds; i++) {
+        Sink += crc16_update(Sink, Buf, sizeof(Buf));
+    }
+    printf(", crc16 %.1f", Mb / (Seconds() - t));
+    t = Seconds();
+    for (i = 0; i < Rounds; i++) {
+        Sink += crc32_update(Sink, Buf, sizeof(Buf));
+    }
+    printf(", crc32 %.1f\n", Mb / (Seconds() - t));
+    return 0;
+}
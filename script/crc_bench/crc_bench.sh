@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+for MODE in 0 1 4
+do
+    gcc -O2 -Wall -DCRC_TABLE_MODE=$MODE -o crc_bench_$MODE crc_bench.c ../../common/crc.c || exit 1
+    ./crc_bench_$MODE $1 || exit 1
+    rm -f crc_bench_$MODE
+done
+echo "*****************************************************"
@@ -0,0 +1,613 @@
+/********************************************************************************************************
+ * @file	fw_update_host.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host tool, the master side of the UART firmware update of fw_update/fw_update.c,
+ * e.g. for a factory PC that updates boards over a USB serial adapter
+ *   build: see fw_update_loopback.sh, or gcc -O2 -iquote ../../common -c ../../common/retry_policy.c
+ *          gcc -O2 -o fw_update_host fw_update_host.c fw_update_port.c retry_policy.o ../../common/crc.c
+ *   usage: fw_update_host [-b max_bps] [-w window] [-v version] [-t timeout_ms] [-c caps] <tty|pty> <image.bin>
+ *          fw_update_host -g <size> <image.bin>
+ * the image is a CRC appended bin, -g writes one of random data for tests.
+ * the slave is updated when it runs an older version than -v, the default takes any.
+ * -c sets the capabilities offered in VERSION_REQ, -c 0 talks like a legacy master.
+ * the response timeout follows the round trip time as in fw_update.c, -t sets it until the first response
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fw_update_port.h"
+#include "../../common/crc.h"
+#define ERASE_AHEAD_SECTOR_ERASE_MAX_US 500000 //as common/erase_ahead.h, which needs the SDK types
+#include "../../fw_update/fw_update_phy.h"
+#include "../../fw_update/fw_update.h"
+
+#define HOST_BIN_SIZE_OFFSET    0x18 //as FW_UPDATE_BIN_SIZE_OFFSET of fw_update.c
+#define HOST_BLOCK_LEN          (FW_UPDATE_FRAME_PAYLOAD_MAX - 2)
+#define HOST_TYPE               4 //frame offset of Type, the payload follows at FW_UPDATE_FRAME_HEAD_LEN
+#define HOST_PAYLOAD            FW_UPDATE_FRAME_HEAD_LEN
+#define HOST_TEST_TIMEOUT_MS    (2 * FW_UPDATE_BAUD_SETTLE / 1000) //the slave has dropped the trial rate by then
+
+//common/retry_policy.h, which needs the SDK types
+typedef struct {
+    unsigned int srtt;
+    unsigned int rttvar;
+    unsigned int rto;
+    unsigned int rto_min;
+    unsigned int rto_max;
+    unsigned short budget;
+    unsigned char backoff;
+    unsigned char backoff_max;
+} retry_policy_t;
+
+extern void retry_policy_init(retry_policy_t *rp, unsigned int rto_init, unsigned int rto_min, unsigned int rto_max,
+                              unsigned short budget, unsigned char backoff_max);
+extern unsigned int retry_policy_timeout(const retry_policy_t *rp);
+extern void retry_policy_success(retry_policy_t *rp, unsigned int rtt_us);
+extern int retry_policy_failure(retry_policy_t *rp);
+
+static int Port = -1;
+static unsigned char *Image;
+static unsigned int ImageSize; //the bin and the CRC appended to it
+static unsigned short MaxBlockNum;
+static unsigned int Baudrate = FW_UPDATE_PHY_BAUDRATE;
+static unsigned int MaxBaud = FW_UPDATE_BAUD_MAX;
+static unsigned int Window = FW_UPDATE_WINDOW_SIZE;
+static unsigned int TimeoutMs = FW_UPDATE_RTO_INIT / 1000;
+static unsigned int Retries;
+static retry_policy_t Retry;
+static int Busy; //the slave is busy past the next frame, see Send()
+static int Sampled; //the awaited response makes a round trip sample
+static unsigned int SendUs; //when the frame soliciting it was out
+static unsigned int Caps = FW_UPDATE_CAPS;
+static unsigned int SlaveCaps; //agreed in VERSION_REQ/VERSION_RSP
+static int Crc16Framing; //agreed in VERSION_REQ/VERSION_RSP, legacy slaves only take the XOR checksum header
+
+/* the CRC-16 of Len, Type and the payload, as fw_update.c checks it */
+static unsigned short CheckSum(const unsigned char *Frame, unsigned int Len)
+{
+    return crc16_update(CRC16_INIT, &Frame[2], 3 + Len);
+}
+
+/* the 8-bit checksum of the legacy framing, of Type, Len and the payload */
+static unsigned char XorSum(const unsigned char *Frame, unsigned int Len)
+{
+    unsigned char Sum = 0;
+    unsigned int i;
+
+    for (i = 1; i < FW_UPDATE_LEGACY_HEAD_LEN + Len; i++) {
+        Sum ^= Frame[i];
+    }
+    return Sum;
+}
+
+static int BuildFrame(unsigned char *Frame, unsigned char Type, const unsigned char *Payload, unsigned int Len)
+{
+    unsigned short Sum;
+
+    if (!Crc16Framing) {
+        Frame[1] = Type;
+        Frame[2] = Len & 0xff;
+        Frame[3] = Len >> 8;
+        memcpy(&Frame[FW_UPDATE_LEGACY_HEAD_LEN], Payload, Len);
+        Frame[0] = XorSum(Frame, Len);
+        return FW_UPDATE_LEGACY_HEAD_LEN + Len;
+    }
+    Frame[2] = Len & 0xff;
+    Frame[3] = Len >> 8;
+    Frame[HOST_TYPE] = Type;
+    memcpy(&Frame[HOST_PAYLOAD], Payload, Len);
+    Sum = CheckSum(Frame, Len);
+    Frame[0] = Sum & 0xff;
+    Frame[1] = Sum >> 8;
+    return HOST_PAYLOAD + Len;
+}
+
+static int BuildCmdFrame(unsigned char *Frame, unsigned char CmdId, const void *Value, unsigned int Len)
+{
+    unsigned char Payload[FW_UPDATE_FRAME_PAYLOAD_MAX];
+
+    Payload[0] = CmdId;
+    memcpy(&Payload[1], Value, Len);
+    return BuildFrame(Frame, FW_UPDATE_FRAME_TYPE_CMD, Payload, 1 + Len);
+}
+
+static int BuildDataFrame(unsigned char *Frame, unsigned short BlockNum)
+{
+    unsigned char Payload[FW_UPDATE_FRAME_PAYLOAD_MAX];
+    unsigned int Offset = (BlockNum - 1) * HOST_BLOCK_LEN;
+    unsigned int Len = (ImageSize - Offset > HOST_BLOCK_LEN) ? HOST_BLOCK_LEN : (ImageSize - Offset);
+
+    Payload[0] = BlockNum & 0xff;
+    Payload[1] = BlockNum >> 8;
+    memcpy(&Payload[2], &Image[Offset], Len);
+    return BuildFrame(Frame, FW_UPDATE_FRAME_TYPE_DATA, Payload, 2 + Len);
+}
+
+static unsigned int GetU32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void PutU32(unsigned char *p, unsigned int Value)
+{
+    p[0] = Value & 0xff;
+    p[1] = (Value >> 8) & 0xff;
+    p[2] = (Value >> 16) & 0xff;
+    p[3] = Value >> 24;
+}
+
+/* the FW_UPDATE_BaudPattern() of fw_update.c */
+static void BaudPattern(unsigned char *Buf)
+{
+    int i;
+
+    for (i = 0; i < FW_UPDATE_BAUD_PATTERN_LEN; i++) {
+        switch (i & 3) {
+        case 0:
+            Buf[i] = 0x55;
+            break;
+        case 1:
+            Buf[i] = 0xaa;
+            break;
+        case 2:
+            Buf[i] = (i & 4) ? 0xff : 0x00;
+            break;
+        default:
+            Buf[i] = 1 << ((i >> 2) & 7);
+            break;
+        }
+    }
+}
+
+/*
+ * the next frame with a right checksum within Ms, its length or 0.
+ * the slave answers with single frames, garbage ahead of one is skipped byte by byte.
+ * A legacy frame is handed over with the CRC-16 header layout, it is only taken until that header is agreed
+ */
+static int RecvFrame(unsigned char *Frame, unsigned int Ms)
+{
+    static unsigned char Buf[4 * FW_UPDATE_FRAME_LEN_MAX];
+    static unsigned int BufLen;
+    unsigned int Start = PORT_NowUs();
+
+    while (1) {
+        while (BufLen >= FW_UPDATE_LEGACY_HEAD_LEN) {
+            unsigned int Len = Buf[2] | (Buf[3] << 8);
+            if ((Len <= FW_UPDATE_FRAME_PAYLOAD_MAX) && (BufLen >= HOST_PAYLOAD + Len) &&
+                ((Buf[0] | (Buf[1] << 8)) == CheckSum(Buf, Len))) {
+                memcpy(Frame, Buf, HOST_PAYLOAD + Len);
+                BufLen -= HOST_PAYLOAD + Len;
+                memmove(Buf, &Buf[HOST_PAYLOAD + Len], BufLen);
+                return HOST_PAYLOAD + Len;
+            }
+            if (!Crc16Framing && (Len <= FW_UPDATE_FRAME_PAYLOAD_MAX) && (BufLen >= FW_UPDATE_LEGACY_HEAD_LEN + Len) &&
+                (Buf[0] == XorSum(Buf, Len))) {
+                memcpy(&Frame[2], &Buf[2], 2);
+                Frame[HOST_TYPE] = Buf[1];
+                memcpy(&Frame[HOST_PAYLOAD], &Buf[FW_UPDATE_LEGACY_HEAD_LEN], Len);
+                BufLen -= FW_UPDATE_LEGACY_HEAD_LEN + Len;
+                memmove(Buf, &Buf[FW_UPDATE_LEGACY_HEAD_LEN + Len], BufLen);
+                return HOST_PAYLOAD + Len;
+            }
+            if ((Len <= FW_UPDATE_FRAME_PAYLOAD_MAX) && (BufLen < HOST_PAYLOAD + Len)) {
+                break;
+            }
+            BufLen--;
+            memmove(Buf, &Buf[1], BufLen);
+        }
+
+        unsigned int Spent = (PORT_NowUs() - Start) / 1000;
+        if (Spent >= Ms) {
+            return 0;
+        }
+        int n = PORT_Read(Port, &Buf[BufLen], sizeof(Buf) - BufLen, Ms - Spent);
+        if (n < 0) {
+            fprintf(stderr, "port read failed\n");
+            exit(1);
+        }
+        BufLen += n;
+    }
+}
+
+/*
+ * sends Len bytes and returns how long to wait for the response in ms, the round trip timeout once they
+ * are out, with FW_UPDATE_BUSY_WAIT on top for a slave that announced an erase or has the image to check
+ * and for a slave that cannot announce its erases
+ */
+static unsigned int Send(const unsigned char *Buf, int Len)
+{
+    unsigned int TxUs = Len * 10 * 1000 / (Baudrate / 1000);
+    unsigned int WaitUs = TxUs + retry_policy_timeout(&Retry);
+
+    if (PORT_Write(Port, Buf, Len) != Len) {
+        fprintf(stderr, "port write failed\n");
+        exit(1);
+    }
+    SendUs = PORT_NowUs() + TxUs;
+    Sampled = !Busy;
+    if (Busy || !(SlaveCaps & FW_UPDATE_CAP_BUSY)) {
+        WaitUs += FW_UPDATE_BUSY_WAIT;
+        Busy = 0;
+    }
+    return (WaitUs + 999) / 1000;
+}
+
+/* the awaited response came, an announced erase or a response sent before the frame was out is no sample */
+static void Success(void)
+{
+    int Rtt = PORT_NowUs() - SendUs;
+
+    retry_policy_success(&Retry, (Sampled && (Rtt > 0)) ? Rtt : 0);
+}
+
+/* the slave ends its START_RSP and ACKs in a flags byte once FW_UPDATE_CAP_BUSY is agreed */
+static int BusyFlag(const unsigned char *Rx, int Len)
+{
+    return (SlaveCaps & FW_UPDATE_CAP_BUSY) && (Rx[Len - 1] & FW_UPDATE_FLAG_BUSY);
+}
+
+/* sends the frame until the command response comes, RETRY_MAX times at most, each wait doubling the last */
+static int Request(const unsigned char *Tx, int TxLen, unsigned char RspId, unsigned char *Rx)
+{
+    int i;
+
+    for (i = 0; i <= FW_UPDATE_RETRY_MAX; i++) {
+        unsigned int Start = PORT_NowUs();
+        unsigned int Spent;
+        unsigned int Ms = Send(Tx, TxLen);
+
+        while ((Spent = (PORT_NowUs() - Start) / 1000) < Ms) {
+            int Len = RecvFrame(Rx, Ms - Spent);
+            if ((Len > HOST_PAYLOAD) && (FW_UPDATE_FRAME_TYPE_CMD == Rx[HOST_TYPE]) && (RspId == Rx[HOST_PAYLOAD])) {
+                Success();
+                return Len;
+            }
+        }
+        Retries++;
+        if (!retry_policy_failure(&Retry)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/* steps down the rate ladder as fw_update.c does, the slave refuses what it does not generate closely enough */
+static void NegotiateBaud(unsigned int PeerSysClk, unsigned int PeerMaxBaud)
+{
+    static const unsigned int Ladder[] = FW_UPDATE_BAUD_LADDER;
+    unsigned char Tx[FW_UPDATE_FRAME_LEN_MAX], Rx[FW_UPDATE_FRAME_LEN_MAX];
+    unsigned char Pattern[FW_UPDATE_BAUD_PATTERN_LEN];
+    unsigned char Param[4];
+    unsigned int i;
+    int Len;
+
+    BaudPattern(Pattern);
+    for (i = 0; PeerSysClk && (i < sizeof(Ladder) / sizeof(Ladder[0])); i++) {
+        unsigned int Baud = Ladder[i];
+        if ((Baud > MaxBaud) || (Baud > PeerMaxBaud) || (Baud > PeerSysClk / 8) || !PORT_HasBaudrate(Baud)) {
+            continue;
+        }
+        PutU32(Param, Baud);
+        Len = BuildCmdFrame(Tx, FW_UPDATE_CMD_ID_BAUD_REQ, Param, sizeof(Param));
+        Len = Request(Tx, Len, FW_UPDATE_CMD_ID_BAUD_RSP, Rx);
+        if (!Len) {
+            return;
+        }
+        if ((Len < HOST_PAYLOAD + 5) || (GetU32(&Rx[HOST_PAYLOAD + 1]) != Baud)) {
+            continue;
+        }
+        //the response came at the old rate, the test pattern goes out at the new one
+        PORT_Drain(Port);
+        PORT_SetBaudrate(Port, Baud);
+        Len = BuildCmdFrame(Tx, FW_UPDATE_CMD_ID_BAUD_TEST_REQ, Pattern, sizeof(Pattern));
+        Send(Tx, Len);
+        unsigned int Start = PORT_NowUs();
+        unsigned int Spent;
+        while ((Spent = (PORT_NowUs() - Start) / 1000) < HOST_TEST_TIMEOUT_MS) {
+            Len = RecvFrame(Rx, HOST_TEST_TIMEOUT_MS - Spent);
+            if ((Len == HOST_PAYLOAD + 1 + (int)sizeof(Pattern)) && (FW_UPDATE_FRAME_TYPE_CMD == Rx[HOST_TYPE]) &&
+                (FW_UPDATE_CMD_ID_BAUD_TEST_RSP == Rx[HOST_PAYLOAD]) && !memcmp(&Rx[HOST_PAYLOAD + 1], Pattern, sizeof(Pattern))) {
+                Baudrate = Baud;
+                return;
+            }
+        }
+        //the slave is back at the start rate once the trial passes no pattern for FW_UPDATE_BAUD_SETTLE
+        Retries++;
+        PORT_SetBaudrate(Port, Baudrate);
+    }
+}
+
+/*
+ * the blocks after the acknowledged ones go out as one burst, the slave answers with a cumulative ACK
+ * and with FW_UPDATE_CAP_SACK the blocks it holds past it. Those are left out of the next burst and
+ * the missing ones fill the window, as FW_UPDATE_SendBurst() does
+ */
+static int SendImage(void)
+{
+    static unsigned char Burst[FW_UPDATE_WINDOW_SIZE_MAX * FW_UPDATE_FRAME_LEN_MAX];
+    unsigned char Rx[FW_UPDATE_FRAME_LEN_MAX];
+    unsigned short Acked = 0;
+    unsigned char Sacked = 0; //bit 0 is block Acked + 2
+
+    while (Acked < MaxBlockNum) {
+        unsigned short Sent = (Acked + Window < MaxBlockNum) ? (Acked + Window) : MaxBlockNum;
+        unsigned short Before = Acked;
+        unsigned char SackedBefore = Sacked;
+        unsigned short BlockNum;
+        unsigned int Start, Spent, Ms;
+        unsigned int Frames = 0;
+        int BurstLen = 0;
+        int Len;
+
+        do {
+            for (BlockNum = Acked + 1; (BlockNum <= Sent) && (Frames < Window); BlockNum++) {
+                if ((BlockNum == Acked + 1) || !(Sacked & (1 << (BlockNum - Acked - 2)))) {
+                    BurstLen += BuildDataFrame(&Burst[BurstLen], BlockNum);
+                    Frames++;
+                }
+            }
+        } while ((SlaveCaps & FW_UPDATE_CAP_SACK) && (Frames < Window));
+        Start = PORT_NowUs();
+        Ms = Send(Burst, BurstLen);
+        while ((Spent = (PORT_NowUs() - Start) / 1000) < Ms) {
+            Len = RecvFrame(Rx, Ms - Spent);
+            if ((Len >= HOST_PAYLOAD + 2) && (FW_UPDATE_FRAME_TYPE_ACK == Rx[HOST_TYPE])) {
+                //an ACK that does not move tells a damaged burst, it goes out again without waiting for the timeout
+                unsigned short AckNum = Rx[HOST_PAYLOAD] | (Rx[HOST_PAYLOAD + 1] << 8);
+                if ((AckNum >= Acked) && (AckNum <= Sent)) {
+                    Acked = AckNum;
+                    Sacked = ((SlaveCaps & FW_UPDATE_CAP_SACK) && (Len >= HOST_PAYLOAD + 3)) ? Rx[HOST_PAYLOAD + 2] : 0;
+                    Busy = BusyFlag(Rx, Len);
+                    break;
+                }
+            }
+        }
+        if ((Acked > Before) || (Sacked & ~SackedBefore)) {
+            Success();
+        }
+        else {
+            Retries++;
+            if (!retry_policy_failure(&Retry)) {
+                return 0;
+            }
+        }
+        if (isatty(STDOUT_FILENO)) {
+            printf("\rblock %u/%u", Acked, MaxBlockNum);
+            fflush(stdout);
+        }
+    }
+    if (isatty(STDOUT_FILENO)) {
+        printf("\n");
+    }
+    return 1;
+}
+
+static int Update(unsigned short Version)
+{
+    unsigned char Tx[FW_UPDATE_FRAME_LEN_MAX], Rx[FW_UPDATE_FRAME_LEN_MAX];
+    unsigned char Param[8 + 1];
+    unsigned int Start;
+    double Secs;
+    int Len;
+
+    //a system clock of 0 tells the slave to check the rates against its own divider only
+    PutU32(&Param[0], 0);
+    PutU32(&Param[4], MaxBaud);
+    Param[8] = Caps;
+    Len = BuildCmdFrame(Tx, FW_UPDATE_CMD_ID_VERSION_REQ, Param, 9);
+    Len = Request(Tx, Len, FW_UPDATE_CMD_ID_VERSION_RSP, Rx);
+    if (Len < HOST_PAYLOAD + 3) {
+        fprintf(stderr, "no slave answers\n");
+        return 0;
+    }
+    unsigned short SlaveVersion = Rx[HOST_PAYLOAD + 1] | (Rx[HOST_PAYLOAD + 2] << 8);
+    SlaveCaps = (Len >= HOST_PAYLOAD + 12) ? (Rx[HOST_PAYLOAD + 11] & Caps) : 0;
+    Crc16Framing = SlaveCaps & FW_UPDATE_CAP_CRC16;
+    printf("slave runs version 0x%04x%s\n", SlaveVersion, Crc16Framing ? "" : ", legacy framing");
+    if (SlaveVersion >= Version) {
+        fprintf(stderr, "the slave is not older than version 0x%04x\n", Version);
+        return 0;
+    }
+    //a slave that sends no rate capabilities stays at the start rate
+    if (Len >= HOST_PAYLOAD + 11) {
+        NegotiateBaud(GetU32(&Rx[HOST_PAYLOAD + 3]), GetU32(&Rx[HOST_PAYLOAD + 7]));
+    }
+
+    Param[0] = MaxBlockNum & 0xff;
+    Param[1] = MaxBlockNum >> 8;
+    Param[2] = Window;
+    Param[3] = Version & 0xff;
+    Param[4] = Version >> 8;
+    Len = BuildCmdFrame(Tx, FW_UPDATE_CMD_ID_START_REQ, Param, 5);
+    Start = PORT_NowUs();
+    Len = Request(Tx, Len, FW_UPDATE_CMD_ID_START_RSP, Rx);
+    if (!Len && (Baudrate != FW_UPDATE_PHY_BAUDRATE)) {
+        //the slave dropped the agreed rate, it waits at the start rate again
+        Baudrate = FW_UPDATE_PHY_BAUDRATE;
+        PORT_SetBaudrate(Port, Baudrate);
+        Len = BuildCmdFrame(Tx, FW_UPDATE_CMD_ID_START_REQ, Param, 5);
+        Len = Request(Tx, Len, FW_UPDATE_CMD_ID_START_RSP, Rx);
+    }
+    if (!Len) {
+        fprintf(stderr, "the slave takes no START_REQ\n");
+        return 0;
+    }
+    //a legacy slave sends no window and runs stop-and-wait
+    Window = ((Len >= HOST_PAYLOAD + 2) && Rx[HOST_PAYLOAD + 1]) ? Rx[HOST_PAYLOAD + 1] : 1;
+    Busy = BusyFlag(Rx, Len);
+    printf("%u bps, window %u\n", Baudrate, Window);
+
+    if (!SendImage()) {
+        fprintf(stderr, "the slave acknowledges no more data\n");
+        return 0;
+    }
+    PutU32(Param, ImageSize);
+    Len = BuildCmdFrame(Tx, FW_UPDATE_CMD_ID_END_REQ, Param, 4);
+    //the slave programs what it staged and reads the whole image back before it answers
+    Busy = 1;
+    if (!Request(Tx, Len, FW_UPDATE_CMD_ID_END_RSP, Rx)) {
+        fprintf(stderr, "the slave does not confirm the image, it is damaged or the END_RSP got lost\n");
+        return 0;
+    }
+    Secs = (PORT_NowUs() - Start) / 1e6;
+    printf("%u bytes in %.2f s, %.0f bytes/s, %u retries\n", ImageSize, Secs, ImageSize / Secs, Retries);
+    return 1;
+}
+
+static int LoadImage(const char *Name)
+{
+    FILE *fp = fopen(Name, "rb");
+    long Size;
+
+    if (!fp) {
+        perror(Name);
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    Size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    Image = malloc(Size > 0 ? Size : 1);
+    if ((Size < HOST_BIN_SIZE_OFFSET + 4) || !Image || (fread(Image, 1, Size, fp) != (size_t)Size)) {
+        fprintf(stderr, "%s: cannot read a bin\n", Name);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    ImageSize = GetU32(&Image[HOST_BIN_SIZE_OFFSET]) + FW_APPEND_INFO_LEN;
+    if ((ImageSize > (unsigned long)Size) || (ImageSize <= HOST_BIN_SIZE_OFFSET + 4) ||
+        (crc16_update(CRC16_INIT, Image, ImageSize - FW_APPEND_INFO_LEN) != (Image[ImageSize - 2] | (Image[ImageSize - 1] << 8)))) {
+        fprintf(stderr, "%s: not a CRC appended bin\n", Name);
+        return 0;
+    }
+    if ((ImageSize + HOST_BLOCK_LEN - 1) / HOST_BLOCK_LEN > 0xffff) {
+        fprintf(stderr, "%s: too large\n", Name);
+        return 0;
+    }
+    MaxBlockNum = (ImageSize + HOST_BLOCK_LEN - 1) / HOST_BLOCK_LEN;
+    return 1;
+}
+
+/* random data with the boot flag and the size field where a real bin has them, and the CRC appended */
+static int WriteTestImage(unsigned int Size, const char *Name)
+{
+    static const unsigned char Flag[4] = {0x4b, 0x4e, 0x4c, 0x54};
+    unsigned char *Buf = malloc(Size + FW_APPEND_INFO_LEN);
+    unsigned short Crc;
+    unsigned int i;
+    FILE *fp;
+
+    if (!Buf || (Size <= HOST_BIN_SIZE_OFFSET + 4)) {
+        fprintf(stderr, "the image takes more than %u bytes\n", HOST_BIN_SIZE_OFFSET + 4);
+        return 0;
+    }
+    srand(time(NULL) ^ getpid());
+    for (i = 0; i < Size; i++) {
+        Buf[i] = rand() >> 7;
+    }
+    memcpy(&Buf[8], Flag, sizeof(Flag));
+    PutU32(&Buf[HOST_BIN_SIZE_OFFSET], Size);
+    Crc = crc16_update(CRC16_INIT, Buf, Size);
+    Buf[Size] = Crc & 0xff;
+    Buf[Size + 1] = Crc >> 8;
+    fp = fopen(Name, "wb");
+    if (!fp || (fwrite(Buf, 1, Size + FW_APPEND_INFO_LEN, fp) != Size + FW_APPEND_INFO_LEN)) {
+        perror(Name);
+        return 0;
+    }
+    fclose(fp);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned short Version = 0xffff;
+    int i;
+
+    if ((4 == argc) && (0 == strcmp(argv[1], "-g"))) {
+        return WriteTestImage(strtoul(argv[2], NULL, 0), argv[3]) ? 0 : 1;
+    }
+    for (i = 1; (i + 2 < argc) && ('-' == argv[i][0]); i += 2) {
+        unsigned int Value = strtoul(argv[i + 1], NULL, 0);
+        if (0 == strcmp(argv[i], "-b")) {
+            MaxBaud = Value;
+        }
+        else if (0 == strcmp(argv[i], "-w")) {
+            Window = Value;
+        }
+        else if (0 == strcmp(argv[i], "-v")) {
+            Version = Value;
+        }
+        else if (0 == strcmp(argv[i], "-t")) {
+            TimeoutMs = Value;
+        }
+        else if (0 == strcmp(argv[i], "-c")) {
+            Caps = Value;
+        }
+        else {
+            break;
+        }
+    }
+    if ((i + 2 != argc) || (Window < 1) || (Window > FW_UPDATE_WINDOW_SIZE_MAX) || !TimeoutMs) {
+        printf("usage: %s [-b max_bps] [-w window 1..%d] [-v version] [-t timeout_ms] [-c caps] <tty|pty> <image.bin>\n"
+               "       %s -g <size> <image.bin>\n", argv[0], FW_UPDATE_WINDOW_SIZE_MAX, argv[0]);
+        return 2;
+    }
+    if (!LoadImage(argv[i + 1])) {
+        return 1;
+    }
+    retry_policy_init(&Retry, TimeoutMs * 1000, FW_UPDATE_RTO_MIN, FW_UPDATE_RTO_MAX, FW_UPDATE_RETRY_BUDGET + MaxBlockNum, FW_UPDATE_RETRY_BURST_MAX);
+    Port = PORT_Open(argv[i], Baudrate);
+    if (Port < 0) {
+        return 1;
+    }
+    if (!Update(Version)) {
+        return 1;
+    }
+    printf("%s update finish !\n", argv[i + 1]);
+    return 0;
+}
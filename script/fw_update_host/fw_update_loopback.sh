@@ -0,0 +1,73 @@
+#!/bin/bash 
+# builds fw_update_host and the host build of the fw_update slave, then runs update sessions between them
+# over a pseudo terminal, each into the slot the previous one left idle, and compares the flash with the image
+#   usage: fw_update_loopback.sh [rounds] [image_size] [window] [error_permille] [caps]
+#          fw_update_loopback.sh lossy [image_size]
+# caps are those the host offers in VERSION_REQ, 0 runs the legacy framing.
+# lossy runs a round at 5, 10 and 20 of every 1000 bytes damaged on their way to the slave
+cd "$(dirname "$0")"
+if [ "$1" == "lossy" ]
+then
+    for ERRORS in 5 10 20
+    do
+        echo "$ERRORS of 1000 bytes damaged"
+        ./fw_update_loopback.sh 1 ${2:-65536} 8 $ERRORS || exit 1
+    done
+    exit 0
+fi
+ROUNDS=${1:-2}
+SIZE=${2:-65536}
+WINDOW=${3:-8}
+ERRORS=${4:-0}
+CAPS=${5:+-c $5}
+SDK=../..
+OUT=build
+# the SDK is written for a 32-bit core: register addresses are integers cast to pointers, DMA addresses
+# pointers cast to u32 and common/string.h declares the C library with 32-bit sizes, drivers/uart.c
+# also indents a busy wait like a loop body
+SDK_WARN="-Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -Wno-misleading-indentation"
+SDK_CFLAGS="-O2 $SDK_WARN -DTIMER_EVENT_CB_CHECK=0 -ffunction-sections -fdata-sections -iquote sim -iquote $SDK/drivers -iquote $SDK/common -iquote $SDK/fw_update"
+
+echo "*****************************************************"
+mkdir -p $OUT
+OBJS=""
+for SRC in $SDK/fw_update/fw_update.c $SDK/common/erase_ahead.c $SDK/common/page_stage.c $SDK/common/retry_policy.c \
+           $SDK/common/slot.c $SDK/common/image_check.c $SDK/common/crc.c $SDK/common/timer_event.c $SDK/drivers/uart.c sim/sim_sdk.c
+do
+    gcc $SDK_CFLAGS -c -o $OUT/$(basename $SRC .c).o $SRC || exit 1
+    OBJS="$OBJS $OUT/$(basename $SRC .c).o"
+done
+gcc -O2 -Wall -o $OUT/fw_update_host fw_update_host.c fw_update_port.c $OUT/retry_policy.o $SDK/common/crc.c || exit 1
+gcc -O2 -Wall -o $OUT/fw_update_slave_sim -Wl,--gc-sections sim/fw_update_slave_sim.c fw_update_port.c $OBJS || exit 1
+
+rm -f $OUT/flash.bin
+for ((ROUND = 1; ROUND <= ROUNDS; ROUND++))
+do
+    $OUT/fw_update_host -g $SIZE $OUT/image.bin || exit 1
+    $OUT/fw_update_slave_sim -f $OUT/flash.bin -e $ERRORS pty > $OUT/slave.log 2>&1 &
+    SLAVE=$!
+    until grep -q "receiving into" $OUT/slave.log 2>/dev/null
+    do
+        kill -0 $SLAVE 2>/dev/null || { cat $OUT/slave.log; exit 1; }
+        sleep 0.1
+    done
+    PTY=$(sed -n 's/^pty: //p' $OUT/slave.log)
+    ADDR=$(sed -n 's/.*receiving into //p' $OUT/slave.log)
+    $OUT/fw_update_host -w $WINDOW $CAPS $PTY $OUT/image.bin
+    HOST=$?
+    wait $SLAVE
+    SLAVE=$?
+    cat $OUT/slave.log | grep "^slave: update"
+    if [ $HOST != 0 ] || [ $SLAVE != 0 ]
+    then
+        echo "round $ROUND failed"
+        exit 1
+    fi
+    if ! cmp -n $((SIZE + 2)) <(tail -c +$((ADDR + 1)) $OUT/flash.bin) $OUT/image.bin
+    then
+        echo "round $ROUND: the image at $ADDR differs"
+        exit 1
+    fi
+    echo "round $ROUND: image at $ADDR ok"
+done
+echo "*****************************************************"
@@ -0,0 +1,217 @@
+/********************************************************************************************************
+ * @file	fw_update_port.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "fw_update_port.h"
+
+typedef struct {
+    unsigned int Baudrate;
+    speed_t Speed;
+} PORT_SpeedTypeDef;
+
+static const PORT_SpeedTypeDef PORT_Speeds[] = {
+    {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+    {230400, B230400}, {460800, B460800}, {921600, B921600},
+#ifdef B1000000
+    {1000000, B1000000},
+#endif
+#ifdef B1500000
+    {1500000, B1500000},
+#endif
+#ifdef B2000000
+    {2000000, B2000000},
+#endif
+};
+
+static int PORT_IsPty; //the fd is the master side of a pseudo terminal
+static int PORT_PtyPeer = -1; //the other end stays open, the master side reads EIO once no one holds it
+
+static int PORT_MakeRaw(int Fd)
+{
+    struct termios Tio;
+
+    if (tcgetattr(Fd, &Tio) < 0) {
+        return 0;
+    }
+    cfmakeraw(&Tio);
+    Tio.c_cflag |= CLOCAL | CREAD;
+    Tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    Tio.c_cc[VMIN] = 0;
+    Tio.c_cc[VTIME] = 0;
+    return tcsetattr(Fd, TCSANOW, &Tio) == 0;
+}
+
+static int PORT_OpenPty(void)
+{
+    int Fd = posix_openpt(O_RDWR | O_NOCTTY);
+    const char *Name;
+
+    if ((Fd < 0) || grantpt(Fd) || unlockpt(Fd) || !(Name = ptsname(Fd))) {
+        perror("pty");
+        return -1;
+    }
+    PORT_PtyPeer = open(Name, O_RDWR | O_NOCTTY);
+    if ((PORT_PtyPeer < 0) || !PORT_MakeRaw(PORT_PtyPeer)) {
+        perror(Name);
+        return -1;
+    }
+    PORT_IsPty = 1;
+    printf("pty: %s\n", Name);
+    fflush(stdout);
+    return Fd;
+}
+
+int PORT_Open(const char *Name, unsigned int Baudrate)
+{
+    int Fd;
+
+    if (0 == strcmp(Name, "pty")) {
+        return PORT_OpenPty();
+    }
+    Fd = open(Name, O_RDWR | O_NOCTTY);
+    if (Fd < 0) {
+        perror(Name);
+        return -1;
+    }
+    if (!PORT_MakeRaw(Fd) || !PORT_SetBaudrate(Fd, Baudrate)) {
+        fprintf(stderr, "%s: cannot set up %u bps 8N1\n", Name, Baudrate);
+        close(Fd);
+        return -1;
+    }
+    tcflush(Fd, TCIOFLUSH);
+    return Fd;
+}
+
+static const PORT_SpeedTypeDef *PORT_FindSpeed(unsigned int Baudrate)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(PORT_Speeds) / sizeof(PORT_Speeds[0]); i++) {
+        if (PORT_Speeds[i].Baudrate == Baudrate) {
+            return &PORT_Speeds[i];
+        }
+    }
+    return NULL;
+}
+
+int PORT_HasBaudrate(unsigned int Baudrate)
+{
+    return PORT_IsPty || PORT_FindSpeed(Baudrate);
+}
+
+int PORT_SetBaudrate(int Fd, unsigned int Baudrate)
+{
+    const PORT_SpeedTypeDef *Speed = PORT_FindSpeed(Baudrate);
+    struct termios Tio;
+
+    if (PORT_IsPty) {
+        return 1;
+    }
+    if (!Speed || (tcgetattr(Fd, &Tio) < 0)) {
+        return 0;
+    }
+    cfsetispeed(&Tio, Speed->Speed);
+    cfsetospeed(&Tio, Speed->Speed);
+    return tcsetattr(Fd, TCSANOW, &Tio) == 0;
+}
+
+void PORT_Drain(int Fd)
+{
+    if (!PORT_IsPty) {
+        tcdrain(Fd);
+    }
+}
+
+int PORT_Write(int Fd, const unsigned char *Buf, int Len)
+{
+    int Done = 0;
+
+    while (Done < Len) {
+        int n = write(Fd, Buf + Done, Len - Done);
+        if (n < 0) {
+            if (EINTR == errno || EAGAIN == errno) {
+                continue;
+            }
+            return -1;
+        }
+        Done += n;
+    }
+    return Done;
+}
+
+int PORT_Read(int Fd, unsigned char *Buf, int Len, int TimeoutMs)
+{
+    struct pollfd Pfd = {Fd, POLLIN, 0};
+    int n = poll(&Pfd, 1, TimeoutMs);
+
+    if (n <= 0) {
+        return (n < 0 && EINTR != errno) ? -1 : 0;
+    }
+    if (!(Pfd.revents & POLLIN)) {
+        return -1;
+    }
+    n = read(Fd, Buf, Len);
+    if (n < 0) {
+        return (EINTR == errno || EAGAIN == errno) ? 0 : -1;
+    }
+    return n;
+}
+
+unsigned int PORT_NowUs(void)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return (unsigned int)(Ts.tv_sec * 1000000ULL + Ts.tv_nsec / 1000);
+}
@@ -0,0 +1,70 @@
+/********************************************************************************************************
+ * @file	fw_update_port.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * the serial line of the host tools in this directory: a real port, e.g. /dev/ttyUSB0,
+ * or "pty", which opens a pseudo terminal pair and prints the name of the end the peer opens
+ */
+#ifndef _FW_UPDATE_PORT_H_
+#define _FW_UPDATE_PORT_H_
+
+extern int PORT_Open(const char *Name, unsigned int Baudrate);
+
+//0 if the port cannot run that rate, a pseudo terminal runs any
+extern int PORT_HasBaudrate(unsigned int Baudrate);
+
+extern int PORT_SetBaudrate(int Fd, unsigned int Baudrate);
+
+//returns once every byte written so far left the port
+extern void PORT_Drain(int Fd);
+
+extern int PORT_Write(int Fd, const unsigned char *Buf, int Len);
+
+//the bytes read, 0 once TimeoutMs passed without any, -1 if the port is gone
+extern int PORT_Read(int Fd, unsigned char *Buf, int Len, int TimeoutMs);
+
+extern unsigned int PORT_NowUs(void);
+
+#endif /* _FW_UPDATE_PORT_H_ */
@@ -0,0 +1,71 @@
+/********************************************************************************************************
+ * @file	driver.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * stands in for the SDK driver.h when the fw_update slave is built for the host, see fw_update_slave_sim.c:
+ * the declarations are the real ones, what touches registers is routed to sim_sdk.c
+ */
+#ifndef _SIM_DRIVER_H_
+#define _SIM_DRIVER_H_
+
+#include "../../../drivers/flash.h"
+#include "../../../drivers/timer.h"
+#include "../../../drivers/uart.h"
+#include "../../../drivers/lib/include/pm.h"
+
+extern unsigned int SIM_ClockTick(void);
+extern unsigned char SIM_IrqDisable(void);
+extern void SIM_Gpio(unsigned int Pin, int Op, unsigned int Value);
+
+#undef clock_time
+#define clock_time()                    SIM_ClockTick()
+#define irq_disable()                   SIM_IrqDisable()
+#define irq_restore(r)                  ((void)(r))
+#define gpio_set_output_en(pin, v)      SIM_Gpio(pin, 0, v)
+#define gpio_set_input_en(pin, v)       SIM_Gpio(pin, 1, v)
+#define gpio_write(pin, v)              SIM_Gpio(pin, 2, v)
+#define gpio_toggle(pin)                SIM_Gpio(pin, 3, 0)
+
+#endif /* _SIM_DRIVER_H_ */
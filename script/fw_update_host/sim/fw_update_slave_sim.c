@@ -0,0 +1,269 @@
+/********************************************************************************************************
+ * @file	fw_update_slave_sim.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * the fw_update slave of fw_update/fw_update.c, built for the host: the protocol and flash code is the one
+ * the chip runs, the UART is a serial port or a pseudo terminal and the flash is a file
+ *   build: see ../fw_update_loopback.sh
+ *   usage: fw_update_slave_sim [-f flash.bin] [-v version] [-e error_permille] [-E erase_us] <tty|pty>
+ * like vendor/uart_fw_update_slave it receives into the slot it does not run from,
+ * the exit status tells whether the session ended in the reboot into the new image.
+ * -e flips a bit in that many of every 1000 bytes received, a noisy line for the retry paths,
+ * -E sets how long a sector erase takes, a typical part by default
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../fw_update_port.h"
+#include "../../../fw_update/fw_update_phy.h"
+#include "../../../fw_update/fw_update.h"
+#include "sim_host.h"
+
+//common/slot.h takes the SDK types along, which clash with the C library ones
+extern unsigned int slot_boot(void);
+extern void slot_confirm(void);
+extern int image_check_boot(void);
+extern void ev_process_timer(void);
+
+#define SIM_SYS_CLOCK_HZ        24000000 //as CLOCK_SYS_CLOCK_HZ of fw_update_phy.c
+#define SIM_RX_BUF_NUM          3
+#define SIM_RX_BUF_LEN          ((4 + FW_UPDATE_WINDOW_SIZE_MAX * FW_UPDATE_FRAME_LEN_MAX + 15) / 16 * 16)
+#define SIM_RX_IDLE_US          2000 //a pause that long ends a reception, the UART DMA of the chip ends it on the RX timeout
+#define SIM_ERASE_US            30000 //typical Sector Erase Time of the parts in flash.c
+
+typedef struct {
+    unsigned int dma_len;
+    unsigned char data[SIM_RX_BUF_LEN - 4];
+} SIM_RxBufTypeDef;
+
+static const char *SIM_FlashFile;
+static int SIM_Port = -1;
+static PHY_Cb_t SIM_RxCb;
+static SIM_RxBufTypeDef SIM_RxBuf[SIM_RX_BUF_NUM];
+static unsigned char SIM_RxPtr;
+static unsigned int SIM_RxTick; //when the last byte of the reception in progress came
+static unsigned int SIM_Baudrate = FW_UPDATE_PHY_BAUDRATE;
+static unsigned int SIM_ErrorRate; //in permille of the bytes received
+unsigned int SIM_EraseUs = SIM_ERASE_US;
+
+unsigned int SIM_NowUs(void)
+{
+    return PORT_NowUs();
+}
+
+void SIM_SleepUs(unsigned int Us)
+{
+    struct timespec Ts = {Us / 1000000, (Us % 1000000) * 1000};
+    nanosleep(&Ts, NULL);
+}
+
+static void SIM_SaveFlash(void)
+{
+    FILE *fp;
+
+    if (!SIM_FlashFile) {
+        return;
+    }
+    fp = fopen(SIM_FlashFile, "wb");
+    if (!fp || (fwrite(SIM_Flash, 1, SIM_FLASH_SIZE, fp) != SIM_FLASH_SIZE)) {
+        perror(SIM_FlashFile);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+}
+
+void SIM_Reboot(int Ok)
+{
+    SIM_SaveFlash();
+    printf("slave: %s, reboot at %u bps\n", Ok ? "update done" : "update failed", SIM_Baudrate);
+    exit(Ok ? 0 : 1);
+}
+
+void SIM_Fatal(const char *Msg, unsigned int Value)
+{
+    fprintf(stderr, "slave: %s (0x%x)\n", Msg, Value);
+    exit(2);
+}
+
+void FW_UPDATE_PHY_Init(const PHY_Cb_t RxCb)
+{
+    SIM_RxCb = RxCb;
+}
+
+int FW_UPDATE_PHY_SendData(const unsigned char *Payload, const int PayloadLen)
+{
+    if (PayloadLen > (int)sizeof(SIM_RxBuf[0].data)) {
+        return 0;
+    }
+    if (PORT_Write(SIM_Port, Payload, PayloadLen) != PayloadLen) {
+        SIM_Fatal("port write failed", PayloadLen);
+    }
+    return PayloadLen;
+}
+
+unsigned int FW_UPDATE_PHY_RxLen(const unsigned char *Data)
+{
+    unsigned int Len = ((const SIM_RxBufTypeDef *)(Data - 4))->dma_len;
+
+    return (Len < sizeof(SIM_RxBuf[0].data)) ? Len : sizeof(SIM_RxBuf[0].data);
+}
+
+void FW_UPDATE_PHY_SetBaudrate(unsigned int Baudrate)
+{
+    PORT_Drain(SIM_Port);
+    if (!PORT_SetBaudrate(SIM_Port, Baudrate)) {
+        SIM_Fatal("port cannot run the rate", Baudrate);
+    }
+    SIM_Baudrate = Baudrate;
+}
+
+unsigned int FW_UPDATE_PHY_SysClock(void)
+{
+    return SIM_SYS_CLOCK_HZ;
+}
+
+void FW_UPDATE_PHY_RxIrqHandler(void)
+{
+}
+
+void FW_UPDATE_PHY_TxIrqHandler(void)
+{
+}
+
+/* collects what the port delivers into the current buffer, which is handed over as the DMA would after a pause */
+static void SIM_RxPoll(void)
+{
+    SIM_RxBufTypeDef *Buf = &SIM_RxBuf[SIM_RxPtr];
+    int n = PORT_Read(SIM_Port, &Buf->data[Buf->dma_len], sizeof(Buf->data) - Buf->dma_len, 1);
+    int i;
+
+    if (n < 0) {
+        SIM_Fatal("port read failed", 0);
+    }
+    if (n > 0) {
+        for (i = 0; SIM_ErrorRate && (i < n); i++) {
+            if ((unsigned int)(rand() % 1000) < SIM_ErrorRate) {
+                Buf->data[Buf->dma_len + i] ^= 1 << (rand() & 7);
+            }
+        }
+        Buf->dma_len += n;
+        SIM_RxTick = SIM_NowUs();
+    }
+    if (Buf->dma_len && ((Buf->dma_len == sizeof(Buf->data)) || (SIM_NowUs() - SIM_RxTick >= SIM_RX_IDLE_US))) {
+        SIM_RxPtr = (SIM_RxPtr + 1) % SIM_RX_BUF_NUM;
+        SIM_RxBuf[SIM_RxPtr].dma_len = 0;
+        if (SIM_RxCb) {
+            SIM_RxCb(Buf->data);
+        }
+    }
+}
+
+static void SIM_LoadFlash(void)
+{
+    FILE *fp;
+
+    memset(SIM_Flash, 0xff, SIM_FLASH_SIZE);
+    fp = SIM_FlashFile ? fopen(SIM_FlashFile, "rb") : NULL;
+    if (fp) {
+        if (fread(SIM_Flash, 1, SIM_FLASH_SIZE, fp) != SIM_FLASH_SIZE) {
+            fprintf(stderr, "slave: %s is shorter than the flash, the rest reads erased\n", SIM_FlashFile);
+        }
+        fclose(fp);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned short Version = 0;
+    unsigned int BinAddr;
+    int i;
+
+    for (i = 1; (i + 1 < argc) && ('-' == argv[i][0]); i += 2) {
+        if (0 == strcmp(argv[i], "-f")) {
+            SIM_FlashFile = argv[i + 1];
+        }
+        else if (0 == strcmp(argv[i], "-v")) {
+            Version = strtoul(argv[i + 1], NULL, 0);
+        }
+        else if (0 == strcmp(argv[i], "-e")) {
+            SIM_ErrorRate = strtoul(argv[i + 1], NULL, 0);
+        }
+        else if (0 == strcmp(argv[i], "-E")) {
+            SIM_EraseUs = strtoul(argv[i + 1], NULL, 0);
+        }
+        else {
+            break;
+        }
+    }
+    if (i + 1 != argc) {
+        printf("usage: %s [-f flash.bin] [-v version] [-e error_permille] [-E erase_us] <tty|pty>\n", argv[0]);
+        return 2;
+    }
+    srand(time(NULL));
+    SIM_LoadFlash();
+    SIM_Port = PORT_Open(argv[i], FW_UPDATE_PHY_BAUDRATE);
+    if (SIM_Port < 0) {
+        return 2;
+    }
+
+    slot_boot();
+    image_check_boot();
+    slot_confirm();
+
+    FW_UPDATE_PHY_Init(FW_UPDATE_RxIrq);
+    BinAddr = (0x4b == SIM_Flash[8]) ? FW_UPDATE_SLAVE_BIN_ADDR : 0;
+    printf("slave: version 0x%04x, receiving into 0x%05x\n", Version, BinAddr);
+    fflush(stdout);
+    FW_UPDATE_SlaveInit(BinAddr, Version);
+
+    while (1) {
+        SIM_RxPoll();
+        FW_UPDATE_SlaveStart();
+        ev_process_timer();
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/********************************************************************************************************
+ * @file	sim_sdk.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * the SDK services the fw_update slave uses, on the host:
+ * flash is an array that is programmed like NOR flash, the system timer follows the host clock
+ * and a reboot hands over to fw_update_slave_sim.c
+ */
+#include "driver.h"
+#include "common.h"
+#include "sim_host.h"
+
+#define SIM_GREEN_LED_PIN       GPIO_PA5 //the slave blinks it before the reboot into a good image
+
+unsigned char SIM_Flash[SIM_FLASH_SIZE];
+static unsigned int SIM_LedPin; //pin toggled last
+
+static void SIM_FlashCheck(unsigned long Addr, unsigned long Len)
+{
+    if ((Addr >= SIM_FLASH_SIZE) || (Len > SIM_FLASH_SIZE - Addr)) {
+        SIM_Fatal("flash access out of range", Addr);
+    }
+}
+
+static void SIM_FlashRead(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    SIM_FlashCheck(Addr, Len);
+    memcpy(Buf, &SIM_Flash[Addr], Len);
+}
+
+//programming only clears bits, a write to an area not erased before shows up as corrupted data
+static void SIM_FlashWrite(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    unsigned long i;
+
+    SIM_FlashCheck(Addr, Len);
+    if ((Addr & 0xff) + Len > 0x100) {
+        SIM_Fatal("page program crosses a page boundary", Addr);
+    }
+    for (i = 0; i < Len; i++) {
+        SIM_Flash[Addr + i] &= Buf[i];
+    }
+}
+
+flash_hander_t flash_read_page = SIM_FlashRead;
+flash_hander_t flash_write_page = SIM_FlashWrite;
+
+void flash_erase_sector(unsigned long addr)
+{
+    addr &= ~0xfffUL;
+    SIM_FlashCheck(addr, 0x1000);
+    memset(&SIM_Flash[addr], 0xff, 0x1000);
+    //the CPU stalls, what comes meanwhile waits in the port like in the UART DMA buffer
+    SIM_SleepUs(SIM_EraseUs);
+}
+
+unsigned int SIM_ClockTick(void)
+{
+    return SIM_NowUs() * sys_tick_per_us;
+}
+
+void sleep_us(unsigned long us)
+{
+    SIM_SleepUs(us);
+}
+
+unsigned char SIM_IrqDisable(void)
+{
+    return 1;
+}
+
+void SIM_Gpio(unsigned int Pin, int Op, unsigned int Value)
+{
+    if (3 == Op) {
+        SIM_LedPin = Pin;
+    }
+}
+
+void start_reboot(void)
+{
+    SIM_Reboot(SIM_GREEN_LED_PIN == SIM_LedPin);
+}
+
+//the slave only sleeps deep to reboot
+static int SIM_SleepWakeup(SleepMode_TypeDef sleep_mode, SleepWakeupSrc_TypeDef wakeup_src, pm_wakeup_tick_type_e wakeup_tick_type, unsigned int wakeup_tick)
+{
+    SIM_Reboot(SIM_GREEN_LED_PIN == SIM_LedPin);
+    return 0;
+}
+
+cpu_pm_handler_t cpu_sleep_wakeup_and_longsleep = SIM_SleepWakeup;
@@ -0,0 +1,226 @@
+/********************************************************************************************************
+ * @file	mempool_test.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host checks of the size classes of common/mempool.c: the smallest class that holds a request
+ * serves it, a larger one once it is empty, the counters of every class, and with
+ * MEMPOOL_GUARD_ENABLE the double frees and overruns the guards have to catch
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DMEMPOOL_GUARD_ENABLE=1 -c mempool_test_sdk.c ../../common/mempool.c
+ *          gcc -O2 -Wall -no-pie -o mempool_test mempool_test.c mempool_test_sdk.o mempool.o, mempool_test.sh does both with and without the guards
+ *   usage: mempool_test
+ * mempool.c keeps addresses in u32 as on the chip, a position dependent build keeps the pools below 4GB.
+ * irq_disable()/irq_restore() store to the IRQ enable register as on the chip, the register page is
+ * mapped where the SDK addresses it
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define TEST_REG_BASE           0x800000 //REG_BASE_ADDR of drivers/bsp.h
+#define TEST_REG_SIZE           0x10000
+#define TEST_REG_IRQ_EN         0x643    //reg_irq_en of drivers/register.h
+#define TEST_BLOCKS_MAX         8        //blocks of all classes together
+
+//MEMPOOL_OK and MEMPOOL_ERR_ of common/mempool.h, which needs the SDK types
+#define TEST_OK                 0
+#define TEST_ERR_FOREIGN        -1
+#define TEST_ERR_GUARD          -2
+#define TEST_ERR_OVERRUN        -3
+
+#define CHECK(c)    do { if (!(c)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); Failures++; } } while (0)
+
+extern int TEST_GuardEnabled(void);
+extern int TEST_ClassCnt(void);
+extern int TEST_Init(void);
+extern void *TEST_Alloc(int Size);
+extern int TEST_Free(void *Ptr);
+extern int TEST_ClassOf(const void *Ptr);
+extern void TEST_Stats(int Class, unsigned int *ItemSize, unsigned int *ItemCount, unsigned int *InUse,
+                       unsigned int *Peak, unsigned int *Fail, unsigned int *GuardErr);
+
+typedef struct {
+    unsigned int ItemSize;
+    unsigned int ItemCount;
+    unsigned int InUse;
+    unsigned int Peak;
+    unsigned int Fail;
+    unsigned int GuardErr;
+} TEST_Class_t;
+
+static int Failures = 0;
+static volatile unsigned char *IrqEn = (volatile unsigned char *)(TEST_REG_BASE + TEST_REG_IRQ_EN);
+
+static TEST_Class_t Stats(int Class)
+{
+    TEST_Class_t c;
+
+    TEST_Stats(Class, &c.ItemSize, &c.ItemCount, &c.InUse, &c.Peak, &c.Fail, &c.GuardErr);
+    return c;
+}
+
+/* the caller gets all of the item size, and only the items of different blocks may not overlap */
+static void *Alloc(int Size, int Class)
+{
+    void *Ptr = TEST_Alloc(Size);
+
+    CHECK(Ptr && (TEST_ClassOf(Ptr) == Class) && (1 == *IrqEn));
+    if (Ptr) {
+        memset(Ptr, 0x5a, Stats(Class).ItemSize);
+    }
+    return Ptr;
+}
+
+/* every request goes to the smallest class holding it, the item sizes are rounded to the alignment */
+static void TestSelect(void)
+{
+    void *Ptr[4];
+
+    CHECK(TEST_Init());
+    CHECK((8 == Stats(0).ItemSize) && (24 == Stats(1).ItemSize) && (64 == Stats(2).ItemSize));
+    CHECK((4 == Stats(0).ItemCount) && (2 == Stats(1).ItemCount) && (2 == Stats(2).ItemCount));
+    Ptr[0] = Alloc(1, 0);
+    Ptr[1] = Alloc(8, 0);
+    Ptr[2] = Alloc(9, 1);
+    Ptr[3] = Alloc(64, 2);
+    CHECK(Ptr[0] != Ptr[1]);
+    //too large for any class, counted against the largest one
+    CHECK(!TEST_Alloc(65) && (1 == Stats(2).Fail) && (0 == Stats(0).Fail) && (0 == Stats(1).Fail));
+    CHECK((2 == Stats(0).InUse) && (1 == Stats(1).InUse) && (1 == Stats(2).InUse));
+    CHECK((TEST_OK == TEST_Free(Ptr[1])) && (1 == *IrqEn));
+    //the block freed last is handed out first
+    CHECK(TEST_Alloc(4) == Ptr[1]);
+}
+
+/* an empty class passes its requests on to the next larger one, a failure is counted where it fitted */
+static void TestFallback(void)
+{
+    void *Ptr[TEST_BLOCKS_MAX];
+    int i;
+
+    CHECK(TEST_Init());
+    for (i = 0; i < 4; i++) {
+        Ptr[i] = Alloc(8, 0);
+    }
+    Ptr[4] = Alloc(8, 1);
+    Ptr[5] = Alloc(8, 1);
+    Ptr[6] = Alloc(8, 2);
+    Ptr[7] = Alloc(8, 2);
+    CHECK(!TEST_Alloc(8) && (1 == Stats(0).Fail) && (0 == Stats(2).Fail));
+    CHECK(!TEST_Alloc(24) && (1 == Stats(1).Fail));
+    //the blocks never overlap
+    for (i = 0; i < TEST_BLOCKS_MAX; i++) {
+        memset(Ptr[i], i, Stats(TEST_ClassOf(Ptr[i])).ItemSize);
+    }
+    for (i = 0; i < TEST_BLOCKS_MAX; i++) {
+        CHECK(i == ((unsigned char *)Ptr[i])[Stats(TEST_ClassOf(Ptr[i])).ItemSize - 1]);
+    }
+    //a free in the smallest class serves the small requests there again
+    CHECK(TEST_OK == TEST_Free(Ptr[2]));
+    CHECK(TEST_Alloc(1) == Ptr[2]);
+    for (i = 0; i < TEST_BLOCKS_MAX; i++) {
+        CHECK(TEST_OK == TEST_Free(Ptr[i]));
+    }
+    CHECK((0 == Stats(0).InUse) && (0 == Stats(1).InUse) && (0 == Stats(2).InUse));
+    CHECK((4 == Stats(0).Peak) && (2 == Stats(1).Peak) && (2 == Stats(2).Peak));
+    CHECK((0 == Stats(0).GuardErr) && (0 == Stats(1).GuardErr) && (0 == Stats(2).GuardErr));
+}
+
+/* a pointer that no class handed out is refused and changes nothing */
+static void TestForeign(void)
+{
+    static unsigned char Other[64];
+    unsigned char *Ptr;
+
+    CHECK(TEST_Init());
+    Ptr = Alloc(8, 0);
+    CHECK(TEST_ERR_FOREIGN == TEST_Free(&Other[32]));
+    CHECK(TEST_ERR_FOREIGN == TEST_Free(Ptr + 4));
+    CHECK((1 == Stats(0).InUse) && (0 == Stats(0).GuardErr));
+    CHECK(TEST_OK == TEST_Free(Ptr));
+}
+
+/* a double free keeps the block out of the pool, an overrun is reported and the block freed */
+static void TestGuards(void)
+{
+    unsigned char *Ptr, *Next;
+
+    CHECK(TEST_Init());
+    Ptr = Alloc(22, 1);
+    Next = Alloc(22, 1);
+    CHECK(TEST_OK == TEST_Free(Ptr));
+    CHECK((TEST_ERR_GUARD == TEST_Free(Ptr)) && (1 == *IrqEn));
+    CHECK((1 == Stats(1).GuardErr) && (1 == Stats(1).InUse));
+    //the block is in the free list once, not twice
+    CHECK(Alloc(22, 1) == Ptr);
+    CHECK(Alloc(22, 2) != Ptr);
+
+    Next[Stats(1).ItemSize] ^= 0xff;
+    CHECK(TEST_ERR_OVERRUN == TEST_Free(Next));
+    CHECK((2 == Stats(1).GuardErr) && (1 == Stats(1).InUse));
+    CHECK(Alloc(22, 1) == Next);
+    CHECK(TEST_OK == TEST_Free(Next));
+    CHECK(2 == Stats(1).GuardErr);
+}
+
+int main(void)
+{
+    if (MAP_FAILED == mmap((void *)TEST_REG_BASE, TEST_REG_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0)) {
+        perror("register page");
+        return 1;
+    }
+    //interrupts are on, every call has to leave them so
+    *IrqEn = 1;
+    TestSelect();
+    TestFallback();
+    TestForeign();
+    if (TEST_GuardEnabled()) {
+        TestGuards();
+    }
+    printf("%d size classes%s: %s\n", TEST_ClassCnt(), TEST_GuardEnabled() ? " with guards" : "",
+           Failures ? "checks failed" : "ok");
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+RESULT=0
+for GUARD in 0 1
+do
+    gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -DMEMPOOL_GUARD_ENABLE=$GUARD \
+        -c mempool_test_sdk.c ../../common/mempool.c || exit 1
+    gcc -O2 -Wall -no-pie -o mempool_test mempool_test.c mempool_test_sdk.o mempool.o || exit 1
+    ./mempool_test || RESULT=1
+done
+rm -f mempool_test mempool_test_sdk.o mempool.o
+echo "*****************************************************"
+exit $RESULT
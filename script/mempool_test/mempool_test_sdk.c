@@ -0,0 +1,112 @@
+/********************************************************************************************************
+ * @file	mempool_test_sdk.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * the part of mempool_test built against the SDK headers, which clash with the C library ones,
+ * so only plain C types cross to mempool_test.c
+ */
+#include "../../common/mempool.h"
+#include "../../common/types.h"
+
+#define TEST_CLASS_CNT          3
+
+//sorted by item size as mempool_class_alloc() wants them, the last two hold 2 blocks each
+static u8 Mem8[MEMPOOL_CLASS_BLOCKSIZE(8) * 4] __attribute__((aligned(MEMPOOL_ALIGNMENT)));
+static u8 Mem24[MEMPOOL_CLASS_BLOCKSIZE(22) * 2] __attribute__((aligned(MEMPOOL_ALIGNMENT)));
+static u8 Mem64[MEMPOOL_CLASS_BLOCKSIZE(64) * 2] __attribute__((aligned(MEMPOOL_ALIGNMENT)));
+static mem_class_t Classes[TEST_CLASS_CNT];
+
+int TEST_GuardEnabled(void)
+{
+    return MEMPOOL_GUARD_ENABLE;
+}
+
+int TEST_ClassCnt(void)
+{
+    return TEST_CLASS_CNT;
+}
+
+/* returns 0 if a class refuses its memory */
+int TEST_Init(void)
+{
+    return mempool_class_init(&Classes[0], Mem8, 8, sizeof(Mem8) / MEMPOOL_CLASS_BLOCKSIZE(8)) &&
+           mempool_class_init(&Classes[1], Mem24, 22, sizeof(Mem24) / MEMPOOL_CLASS_BLOCKSIZE(22)) &&
+           mempool_class_init(&Classes[2], Mem64, 64, sizeof(Mem64) / MEMPOOL_CLASS_BLOCKSIZE(64)) &&
+           !mempool_class_init(&Classes[0], 0, 8, 1) && !mempool_class_init(&Classes[0], Mem8, 0, 1);
+}
+
+void *TEST_Alloc(int Size)
+{
+    return mempool_class_alloc(Classes, TEST_CLASS_CNT, Size);
+}
+
+int TEST_Free(void *Ptr)
+{
+    return mempool_class_free(Classes, TEST_CLASS_CNT, Ptr);
+}
+
+/* class the block at Ptr was taken from, -1 for none */
+int TEST_ClassOf(const void *Ptr)
+{
+    int i;
+
+    for (i = 0; i < TEST_CLASS_CNT; i++) {
+        if (((const u8 *)Ptr >= Classes[i].mem_start) && ((const u8 *)Ptr < Classes[i].mem_end)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void TEST_Stats(int Class, unsigned int *ItemSize, unsigned int *ItemCount, unsigned int *InUse,
+                unsigned int *Peak, unsigned int *Fail, unsigned int *GuardErr)
+{
+    *ItemSize = Classes[Class].item_size;
+    *ItemCount = Classes[Class].item_count;
+    *InUse = Classes[Class].in_use;
+    *Peak = Classes[Class].peak;
+    *Fail = Classes[Class].fail;
+    *GuardErr = Classes[Class].guard_err;
+}
@@ -0,0 +1,225 @@
+/********************************************************************************************************
+ * @file	mmem_bench.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host tool, checks the incremental compaction of common/mmem.c and times mmem_compact_step()
+ * per call for a range of budgets under random allocations and frees
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -c ../../common/mmem.c ../../common/list.c && gcc -O2 -Wall -o mmem_bench mmem_bench.c mmem.o list.o
+ *   usage: mmem_bench [operations per budget]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../common/mmem.h"
+
+#define BENCH_HELD_MAX          24 //handles, about half of them hold a block at a time
+#define BENCH_SIZE_MAX          256  //most allocations, one in 16 takes up to BENCH_SIZE_LARGE
+#define BENCH_SIZE_LARGE        768
+
+#define CHECK(c)    do { if (!(c)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); Failures++; } } while (0)
+
+static int Failures = 0;
+static struct mmem Held[BENCH_HELD_MAX];
+static unsigned char HeldTag[BENCH_HELD_MAX];
+static unsigned char HeldUsed[BENCH_HELD_MAX];
+static unsigned int Seed;
+
+static unsigned int Random(void)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return Seed >> 8;
+}
+
+static double Nanoseconds(void)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return Ts.tv_sec * 1e9 + Ts.tv_nsec;
+}
+
+static int Alloc(struct mmem *m, unsigned char *Tag, unsigned int Size)
+{
+    if (!mmem_alloc(m, Size)) {
+        return 0;
+    }
+    *Tag = Random();
+    memset(m->ptr, *Tag, Size);
+    return 1;
+}
+
+/* every block still holds what it was filled with, wherever compaction moved it */
+static int Intact(const struct mmem *m, unsigned char Tag)
+{
+    unsigned int i;
+
+    for (i = 0; i < m->size; i++) {
+        if (((unsigned char *)m->ptr)[i] != Tag) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* a block over the budget stays in place, the ones above it still move down to it */
+static void TestSkip(void)
+{
+    struct mmem a, b, big, c, d;
+    unsigned char ta, tb, tbig, tc, td;
+    struct mmem_stats s;
+    char *BigAt;
+
+    mmem_init();
+    CHECK(Alloc(&a, &ta, 32) && Alloc(&b, &tb, 32) && Alloc(&big, &tbig, 512) && Alloc(&c, &tc, 32) && Alloc(&d, &td, 64));
+    mmem_free(&a);
+    mmem_free(&c);
+    BigAt = big.ptr;
+    mmem_stats(&s);
+    CHECK(2 == s.holes);
+    //b fits the budget, big does not, d does once b was moved
+    CHECK(96 == mmem_compact_step(128));
+    CHECK(big.ptr == BigAt);
+    CHECK((char *)d.ptr == (char *)big.ptr + big.size);
+    CHECK(Intact(&b, tb) && Intact(&big, tbig) && Intact(&d, td));
+    mmem_stats(&s);
+    CHECK(1 == s.holes);
+    CHECK(32 == s.hole_bytes);
+    //an unlimited call closes the last hole and the free space is in one piece again
+    CHECK(576 == mmem_compact_step(0));
+    mmem_stats(&s);
+    CHECK((0 == s.holes) && (0 == s.hole_bytes) && (s.largest_free == s.free_bytes));
+    CHECK(Intact(&b, tb) && Intact(&big, tbig) && Intact(&d, td));
+    CHECK(0 == mmem_compact_step(0));
+}
+
+/* holes are not compacted behind the back of the caller, the allocation waits for the idle loop */
+static void TestNoCompactOnAlloc(void)
+{
+    struct mmem a, b, c;
+    unsigned char ta, tb, tc;
+
+    mmem_init();
+    CHECK(Alloc(&a, &ta, MMEM_SIZE / 2) && Alloc(&b, &tb, MMEM_SIZE / 4));
+    mmem_free(&a);
+    CHECK(!Alloc(&c, &tc, MMEM_SIZE / 2 + 16));
+    CHECK(MMEM_SIZE / 4 == mmem_compact_step(0));
+    CHECK(Alloc(&c, &tc, MMEM_SIZE / 2 + 16));
+    CHECK(Intact(&b, tb) && Intact(&c, tc));
+}
+
+/*
+ * Ops random allocations and frees over BENCH_HELD_MAX handles, every op followed by one
+ * mmem_compact_step(Budget) as the idle loop would run it, returns the mean ns per call and
+ * the allocations that failed with enough memory free in total
+ */
+static void Run(unsigned int Budget, unsigned int Ops, double *MeanNs, unsigned int *Fails)
+{
+    struct mmem_stats s;
+    double Total = 0, t;
+    unsigned int Op, i, Size;
+
+    mmem_init();
+    memset(HeldUsed, 0, sizeof(HeldUsed));
+    Seed = 1;
+    *Fails = 0;
+    for (Op = 0; Op < Ops; Op++) {
+        i = Random() % BENCH_HELD_MAX;
+        if (HeldUsed[i]) {
+            CHECK(Intact(&Held[i], HeldTag[i]));
+            mmem_free(&Held[i]);
+            HeldUsed[i] = 0;
+        }
+        else {
+            Size = (Random() & 15) ? (1 + Random() % BENCH_SIZE_MAX) : (1 + Random() % BENCH_SIZE_LARGE);
+            mmem_stats(&s);
+            if (Alloc(&Held[i], &HeldTag[i], Size)) {
+                HeldUsed[i] = 1;
+            }
+            else if (s.free_bytes >= Size) {
+                (*Fails)++;
+            }
+        }
+        t = Nanoseconds();
+        mmem_compact_step(Budget);
+        Total += Nanoseconds() - t;
+    }
+    for (i = 0; i < BENCH_HELD_MAX; i++) {
+        CHECK(!HeldUsed[i] || Intact(&Held[i], HeldTag[i]));
+    }
+    *MeanNs = Total / Ops;
+}
+
+int main(int argc, char **argv)
+{
+    static const unsigned int Budgets[] = {64, 128, MMEM_COMPACT_STEP_BYTES, 512, 0};
+    unsigned int Ops = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+    struct mmem_stats s;
+    double Mean;
+    unsigned int Fails;
+    unsigned int i;
+
+    TestSkip();
+    TestNoCompactOnAlloc();
+
+    printf("a %u byte heap, %u ops of up to %u bytes, one compaction call per op\n", MMEM_SIZE, Ops, BENCH_SIZE_LARGE);
+    printf(" budget   ns/call   worst bytes/call   failed allocs\n");
+    for (i = 0; i < sizeof(Budgets) / sizeof(Budgets[0]); i++) {
+        Run(Budgets[i], Ops, &Mean, &Fails);
+        mmem_stats(&s);
+        if (Budgets[i]) {
+            CHECK(s.max_step_bytes <= Budgets[i]);
+            printf("%7u %9.1f %18u %15u\n", Budgets[i], Mean, s.max_step_bytes, Fails);
+        }
+        else {
+            printf("   none %9.1f %18u %15u\n", Mean, s.max_step_bytes, Fails);
+        }
+    }
+    if (Failures) {
+        printf("%d checks failed\n", Failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -Wno-builtin-declaration-mismatch -c ../../common/mmem.c ../../common/list.c || exit 1
+gcc -O2 -Wall -o mmem_bench mmem_bench.c mmem.o list.o || exit 1
+./mmem_bench $1
+RESULT=$?
+rm -f mmem_bench mmem.o list.o
+echo "*****************************************************"
+exit $RESULT
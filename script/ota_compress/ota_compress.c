@@ -0,0 +1,193 @@
+/********************************************************************************************************
+ * @file	ota_compress.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+/*
+ * host tool, turns a CRC appended OTA bin into the compressed image format of ota/ota_lz.h
+ *   build: gcc -O2 -o ota_compress ota_compress.c ../../ota/ota_lz.c
+ *   usage: ota_compress <in.bin> <out.bin>
+ * the result is decoded again with the slave decoder before it is written
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ota/ota_lz.h"
+
+static unsigned char *VerifyBuf;
+static unsigned int VerifyLen;
+
+static void VerifyOutput(unsigned int Offset, const unsigned char *Data, int Len)
+{
+    if (Offset + Len <= VerifyLen) {
+        memcpy(VerifyBuf + Offset, Data, Len);
+    }
+}
+
+static unsigned int FindMatch(const unsigned char *In, unsigned int Size, unsigned int Pos, unsigned int *Dist)
+{
+    unsigned int Best = 0;
+    unsigned int Start = (Pos > OTA_LZ_WINDOW_SIZE) ? (Pos - OTA_LZ_WINDOW_SIZE) : 0;
+    unsigned int Max = Size - Pos;
+    unsigned int i, n;
+
+    if (Max > OTA_LZ_MAX_MATCH) {
+        Max = OTA_LZ_MAX_MATCH;
+    }
+    for (i = Start; i < Pos; i++) {
+        for (n = 0; (n < Max) && (In[i + n] == In[Pos + n]); n++) {
+        }
+        if (n > Best) {
+            Best = n;
+            *Dist = Pos - i;
+            if (Best == Max) {
+                break;
+            }
+        }
+    }
+    return (Best >= OTA_LZ_MIN_MATCH) ? Best : 0;
+}
+
+static unsigned int Compress(const unsigned char *In, unsigned int Size, unsigned char *Out)
+{
+    unsigned int Pos = 0;
+    unsigned int OutLen = 0;
+    unsigned int FlagPos = 0;
+    int Item = 8;
+
+    while (Pos < Size) {
+        unsigned int Dist = 0, NextDist = 0;
+        unsigned int Len, NextLen;
+
+        if (8 == Item) {
+            FlagPos = OutLen++;
+            Out[FlagPos] = 0;
+            Item = 0;
+        }
+        Len = FindMatch(In, Size, Pos, &Dist);
+        //lazy matching: a literal pays off when the next position has a longer match
+        if (Len && (Pos + 1 < Size)) {
+            NextLen = FindMatch(In, Size, Pos + 1, &NextDist);
+            if (NextLen > Len) {
+                Len = 0;
+            }
+        }
+        if (Len) {
+            unsigned int Value = (Dist - 1) | ((Len - OTA_LZ_MIN_MATCH) << OTA_LZ_WINDOW_BITS);
+            Out[OutLen++] = Value & 0xff;
+            Out[OutLen++] = Value >> 8;
+            Pos += Len;
+        }
+        else {
+            Out[FlagPos] |= 1 << Item;
+            Out[OutLen++] = In[Pos++];
+        }
+        Item++;
+    }
+    return OutLen;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *fp;
+    unsigned char *In, *Out;
+    unsigned int Size, StreamSize;
+    OTA_LzHeaderTypeDef Header;
+    OTA_LzDecoderTypeDef Dec;
+
+    if (argc != 3) {
+        printf("usage: %s <in.bin> <out.bin>\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(argv[1], "rb");
+    if (!fp) {
+        printf("can not open %s\n", argv[1]);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    Size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (Size < 16) {
+        printf("%s is too small\n", argv[1]);
+        fclose(fp);
+        return 1;
+    }
+    In = malloc(Size);
+    //worst case one flag byte per 8 literals
+    Out = malloc(Size + Size / 8 + 1);
+    VerifyBuf = malloc(Size);
+    if (!In || !Out || !VerifyBuf || (fread(In, 1, Size, fp) != Size)) {
+        printf("can not read %s\n", argv[1]);
+        fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+
+    StreamSize = Compress(In, Size, Out);
+
+    VerifyLen = Size;
+    OTA_LzInit(&Dec, VerifyOutput);
+    if ((OTA_LzDecode(&Dec, Out, StreamSize) < 0) || (OTA_LzFinish(&Dec) != Size) || memcmp(In, VerifyBuf, Size)) {
+        printf("verification of the compressed stream failed\n");
+        return 1;
+    }
+
+    Header.Magic = OTA_LZ_MAGIC;
+    Header.RawSize = Size;
+    Header.StreamSize = StreamSize;
+    Header.RawCRC = In[Size - 2] | (In[Size - 1] << 8); //appended by bin_append
+    Header.WindowBits = OTA_LZ_WINDOW_BITS;
+    Header.Reserved = 0xff;
+
+    fp = fopen(argv[2], "wb");
+    if (!fp || (fwrite(&Header, 1, sizeof(Header), fp) != sizeof(Header)) ||
+        (fwrite(Out, 1, StreamSize, fp) != StreamSize)) {
+        printf("can not write %s\n", argv[2]);
+        return 1;
+    }
+    fclose(fp);
+    printf("%s: %u -> %u bytes (%u%%)\n", argv[2], Size, (unsigned int)(StreamSize + sizeof(Header)),
+           (unsigned int)((StreamSize + sizeof(Header)) * 100 / Size));
+    return 0;
+}
@@ -0,0 +1,8 @@
+#!/bin/bash 
+echo "*****************************************************"
+../script/ota_compress/ota_compress $1_NEW.bin $1_LZ.bin
+if [ $? == 0 ]
+then
+echo "$1_LZ.bin compressed OTA image finish !"
+fi
+echo "*****************************************************"
@@ -0,0 +1,177 @@
+/********************************************************************************************************
+ * @file	ota_compress_bench.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host tool, measures ota/ota_lz.c on an image and the result of ota_compress for it: the ratio,
+ * the OTA blocks saved and the decode speed when the stream arrives block by block as on the slave
+ *   build: gcc -O2 -Wall -o ota_compress_bench ota_compress_bench.c ../../ota/ota_lz.c
+ *   usage: ota_compress_bench <in.bin> <compressed.bin> [block_size], ota_compress_bench.sh runs it on SDK code
+ * the speed is the host's, what matters on the slave is its share against the radio time of a block
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../ota/ota_lz.h"
+
+#define BENCH_BLOCK_SIZE        192 //OTA_BLOCK_SIZE_MAX, the payload of a DATA frame
+#define BENCH_MIN_SECONDS       0.5
+
+static unsigned char *Decoded;
+static unsigned int DecodedMax;
+static unsigned int Pages;
+
+//stands in for the page write of the slave, also used to check the result
+static void BenchOutput(unsigned int Offset, const unsigned char *Data, int Len)
+{
+    if (Offset + Len <= DecodedMax) {
+        memcpy(Decoded + Offset, Data, Len);
+    }
+    Pages++;
+}
+
+static unsigned char *ReadFile(const char *Name, unsigned int *Size)
+{
+    FILE *fp = fopen(Name, "rb");
+    unsigned char *Buf;
+
+    if (!fp) {
+        printf("can not open %s\n", Name);
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    *Size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    Buf = malloc(*Size + 1);
+    if (!Buf || (fread(Buf, 1, *Size, fp) != *Size)) {
+        printf("can not read %s\n", Name);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    return Buf;
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//one pass as the slave runs it, the stream arrives in blocks
+static int Decode(const unsigned char *Stream, unsigned int StreamSize, unsigned int BlockSize, unsigned int RawSize)
+{
+    static OTA_LzDecoderTypeDef Dec;
+    unsigned int Pos, Len;
+
+    OTA_LzInit(&Dec, BenchOutput);
+    for (Pos = 0; Pos < StreamSize; Pos += Len) {
+        Len = (StreamSize - Pos < BlockSize) ? (StreamSize - Pos) : BlockSize;
+        if (OTA_LzDecode(&Dec, Stream + Pos, Len) < 0) {
+            return -1;
+        }
+    }
+    return (OTA_LzFinish(&Dec) == RawSize) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char *Raw, *Lz;
+    unsigned int RawSize, LzSize, StreamSize;
+    unsigned int BlockSize = (argc > 3) ? atoi(argv[3]) : BENCH_BLOCK_SIZE;
+    OTA_LzHeaderTypeDef Header;
+    unsigned int RawBlocks, LzBlocks, Runs;
+    double Start, Seconds;
+
+    if ((argc < 3) || !BlockSize) {
+        printf("usage: %s <in.bin> <compressed.bin> [block_size]\n", argv[0]);
+        return 2;
+    }
+    Raw = ReadFile(argv[1], &RawSize);
+    Lz = ReadFile(argv[2], &LzSize);
+    if (!Raw || !Lz) {
+        return 2;
+    }
+    if (LzSize < OTA_LZ_HEADER_LEN) {
+        printf("%s is not a compressed image\n", argv[2]);
+        return 1;
+    }
+    memcpy(&Header, Lz, OTA_LZ_HEADER_LEN);
+    StreamSize = LzSize - OTA_LZ_HEADER_LEN;
+    if ((OTA_LZ_MAGIC != Header.Magic) || (Header.RawSize != RawSize) || (Header.StreamSize != StreamSize)) {
+        printf("%s is not the compressed image of %s\n", argv[2], argv[1]);
+        return 1;
+    }
+
+    Decoded = malloc(RawSize);
+    DecodedMax = RawSize;
+    if (!Decoded) {
+        return 2;
+    }
+    memset(Decoded, 0, RawSize);
+    Pages = 0;
+    if (Decode(Lz + OTA_LZ_HEADER_LEN, StreamSize, BlockSize, RawSize) || memcmp(Decoded, Raw, RawSize)) {
+        printf("%s: the stream does not decode to %s\n", argv[2], argv[1]);
+        return 1;
+    }
+
+    Runs = 0;
+    Start = Now();
+    do {
+        Decode(Lz + OTA_LZ_HEADER_LEN, StreamSize, BlockSize, RawSize);
+        Runs++;
+        Seconds = Now() - Start;
+    } while (Seconds < BENCH_MIN_SECONDS);
+
+    RawBlocks = (RawSize + BlockSize - 1) / BlockSize;
+    LzBlocks = (LzSize + BlockSize - 1) / BlockSize;
+    printf("%-24s %7u -> %7u bytes %3u%%, %5u -> %5u blocks of %u, decode %6.1f MB/s %6.2f us/block, %u bytes of RAM\n",
+           argv[1], RawSize, LzSize, (unsigned int)((unsigned long long)LzSize * 100 / RawSize), RawBlocks, LzBlocks,
+           BlockSize, (double)RawSize * Runs / Seconds / 1e6, Seconds * 1e6 / Runs / LzBlocks,
+           (unsigned int)sizeof(OTA_LzDecoderTypeDef));
+    return 0;
+}
@@ -0,0 +1,52 @@
+#!/bin/bash 
+# ratio and decode speed of the compressed OTA image format of ota/ota_lz.h on the given images or, without
+# any, on the tc32 code and constants of the SDK libraries, the part of an application image that is SDK code
+#   usage: ota_compress_bench.sh [image.bin ...]
+IMAGES=""
+for IMAGE in "$@"
+do
+    IMAGES="$IMAGES $(realpath "$IMAGE")"
+done
+cd "$(dirname "$0")"
+SDK=../..
+OUT=build
+
+# lib_image <lib.a> <out.bin>: the allocated sections of every member, relocations left as they are
+lib_image()
+{
+    rm -rf $OUT/ar && mkdir -p $OUT/ar
+    (cd $OUT/ar && ar x ../../$1) || exit 1
+    : > $2
+    for OBJ in $OUT/ar/*.o
+    do
+        for SEC in $(readelf -SW $OBJ | awk '{ sub(/^.*\]/, "") } $2 == "PROGBITS" && $7 ~ /A/ && $5 != "000000" { print $1 }')
+        do
+            objcopy -I elf32-little --dump-section $SEC=$OUT/sec.bin $OBJ $OUT/sec.o && cat $OUT/sec.bin >> $2
+        done
+    done
+}
+
+echo "*****************************************************"
+mkdir -p $OUT
+gcc -O2 -Wall -o $OUT/ota_compress $SDK/script/ota_compress/ota_compress.c $SDK/ota/ota_lz.c || exit 1
+gcc -O2 -Wall -o $OUT/ota_compress_bench ota_compress_bench.c $SDK/ota/ota_lz.c || exit 1
+if [ -z "$IMAGES" ]
+then
+    for LIB in drivers/lib/8208_core_drv_lib genfsk_ll/genfsk_ll tpll/tpll tpsll/tpsll tl_tpll/tl_tpll
+    do
+        lib_image $SDK/$LIB.a $OUT/$(basename $LIB).bin
+        IMAGES="$IMAGES $OUT/$(basename $LIB).bin"
+    done
+    cat $OUT/8208_core_drv_lib.bin $OUT/genfsk_ll.bin > $OUT/drv_genfsk_ll.bin
+    IMAGES="$IMAGES $OUT/drv_genfsk_ll.bin"
+fi
+
+RESULT=0
+for IMAGE in $IMAGES
+do
+    $OUT/ota_compress $IMAGE $OUT/lz.bin > /dev/null || { RESULT=1; continue; }
+    (cd $(dirname $IMAGE) && $OLDPWD/$OUT/ota_compress_bench $(basename $IMAGE) $OLDPWD/$OUT/lz.bin) || RESULT=1
+done
+rm -rf $OUT
+echo "*****************************************************"
+exit $RESULT
@@ -0,0 +1,232 @@
+/********************************************************************************************************
+ * @file	ota_delta.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+
+/*
+ * host tool, makes the delta image of ota/ota_delta.h that rebuilds new.bin on a slave
+ * running old.bin, both CRC appended
+ *   build: gcc -O2 -o ota_delta ota_delta.c ../../ota/ota_delta.c
+ *   usage: ota_delta <old.bin> <new.bin> <out.bin>
+ * the patch is applied again with the slave code before it is written
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ota/ota_delta.h"
+
+#define HASH_LEN        8 //bytes a match has to share, shorter copies cost more than inserting
+#define HASH_SIZE       (1 << 16)
+#define CHAIN_MAX       256
+#define OP_LEN_MAX      0xffff
+
+static unsigned char *OldBuf, *NewBuf, *VerifyBuf;
+static unsigned int OldSize, NewSize;
+
+static void VerifyRead(unsigned int Offset, unsigned char *Buf, int Len)
+{
+    memcpy(Buf, OldBuf + Offset, Len);
+}
+
+static void VerifyOutput(unsigned int Offset, const unsigned char *Data, int Len)
+{
+    if (Offset + Len <= NewSize) {
+        memcpy(VerifyBuf + Offset, Data, Len);
+    }
+}
+
+static unsigned int Hash(const unsigned char *p)
+{
+    unsigned int h = 0;
+    int i;
+    for (i = 0; i < HASH_LEN; i++) {
+        h = h * 31 + p[i];
+    }
+    return h & (HASH_SIZE - 1);
+}
+
+static unsigned char *ReadFile(const char *Name, unsigned int *Size)
+{
+    FILE *fp = fopen(Name, "rb");
+    unsigned char *Buf;
+
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *Size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    Buf = malloc(*Size + 1);
+    if (Buf && (fread(Buf, 1, *Size, fp) != *Size)) {
+        free(Buf);
+        Buf = NULL;
+    }
+    fclose(fp);
+    return Buf;
+}
+
+static unsigned int EmitInsert(unsigned char *Out, const unsigned char *Data, unsigned int Len)
+{
+    unsigned int OutLen = 0;
+    unsigned int n;
+
+    while (Len) {
+        n = (Len > OP_LEN_MAX) ? OP_LEN_MAX : Len;
+        Out[OutLen++] = OTA_DELTA_OP_INSERT;
+        Out[OutLen++] = n & 0xff;
+        Out[OutLen++] = n >> 8;
+        memcpy(Out + OutLen, Data, n);
+        OutLen += n;
+        Data += n;
+        Len -= n;
+    }
+    return OutLen;
+}
+
+static unsigned int Diff(unsigned char *Out)
+{
+    int *Head = malloc(HASH_SIZE * sizeof(int));
+    int *Next = malloc((OldSize + 1) * sizeof(int));
+    unsigned int Pos = 0, Pending = 0, OutLen = 0;
+    unsigned int i;
+
+    memset(Head, 0xff, HASH_SIZE * sizeof(int));
+    for (i = 0; i + HASH_LEN <= OldSize; i++) {
+        unsigned int h = Hash(OldBuf + i);
+        Next[i] = Head[h];
+        Head[h] = i;
+    }
+
+    while (Pos < NewSize) {
+        unsigned int BestLen = 0, BestOff = 0;
+        if (Pos + HASH_LEN <= NewSize) {
+            int Cand = Head[Hash(NewBuf + Pos)];
+            int Chain = 0;
+            while ((Cand >= 0) && (Chain++ < CHAIN_MAX)) {
+                unsigned int n = 0;
+                while ((Pos + n < NewSize) && (Cand + n < OldSize) && (n < OP_LEN_MAX) &&
+                       (NewBuf[Pos + n] == OldBuf[Cand + n])) {
+                    n++;
+                }
+                if (n > BestLen) {
+                    BestLen = n;
+                    BestOff = Cand;
+                }
+                Cand = Next[Cand];
+            }
+        }
+        if (BestLen < HASH_LEN) {
+            Pending++;
+            Pos++;
+            continue;
+        }
+        OutLen += EmitInsert(Out + OutLen, NewBuf + Pos - Pending, Pending);
+        Pending = 0;
+        Out[OutLen++] = OTA_DELTA_OP_COPY;
+        Out[OutLen++] = BestOff & 0xff;
+        Out[OutLen++] = (BestOff >> 8) & 0xff;
+        Out[OutLen++] = (BestOff >> 16) & 0xff;
+        Out[OutLen++] = BestOff >> 24;
+        Out[OutLen++] = BestLen & 0xff;
+        Out[OutLen++] = BestLen >> 8;
+        Pos += BestLen;
+    }
+    OutLen += EmitInsert(Out + OutLen, NewBuf + Pos - Pending, Pending);
+    free(Head);
+    free(Next);
+    return OutLen;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *fp;
+    unsigned char *Out;
+    unsigned int PatchSize;
+    OTA_DeltaHeaderTypeDef Header;
+    OTA_DeltaTypeDef Delta;
+
+    if (argc != 4) {
+        printf("usage: %s <old.bin> <new.bin> <out.bin>\n", argv[0]);
+        return 1;
+    }
+    OldBuf = ReadFile(argv[1], &OldSize);
+    NewBuf = ReadFile(argv[2], &NewSize);
+    if (!OldBuf || !NewBuf || (OldSize < 16) || (NewSize < 16)) {
+        printf("can not read %s or %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    //worst case the whole image as inserts
+    Out = malloc(NewSize + (NewSize / OP_LEN_MAX + 1) * 3);
+    VerifyBuf = malloc(NewSize);
+    if (!Out || !VerifyBuf) {
+        return 1;
+    }
+
+    PatchSize = Diff(Out);
+
+    OTA_DeltaInit(&Delta, VerifyRead, VerifyOutput, OldSize);
+    if ((OTA_DeltaApply(&Delta, Out, PatchSize) < 0) || (OTA_DeltaFinish(&Delta) != NewSize) ||
+        Delta.Error || memcmp(NewBuf, VerifyBuf, NewSize)) {
+        printf("verification of the patch failed\n");
+        return 1;
+    }
+
+    Header.Magic = OTA_DELTA_MAGIC;
+    Header.NewSize = NewSize;
+    Header.PatchSize = PatchSize;
+    Header.OldSize = OldSize;
+    Header.NewCRC = NewBuf[NewSize - 2] | (NewBuf[NewSize - 1] << 8); //appended by bin_append
+    Header.OldCRC = OldBuf[OldSize - 2] | (OldBuf[OldSize - 1] << 8);
+
+    fp = fopen(argv[3], "wb");
+    if (!fp || (fwrite(&Header, 1, sizeof(Header), fp) != sizeof(Header)) ||
+        (fwrite(Out, 1, PatchSize, fp) != PatchSize)) {
+        printf("can not write %s\n", argv[3]);
+        return 1;
+    }
+    fclose(fp);
+    printf("%s: %u bytes rebuild %u bytes (%u%%)\n", argv[3], (unsigned int)(PatchSize + sizeof(Header)), NewSize,
+           (unsigned int)((PatchSize + sizeof(Header)) * 100 / NewSize));
+    return 0;
+}
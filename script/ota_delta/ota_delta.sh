@@ -0,0 +1,8 @@
+#!/bin/bash 
+echo "*****************************************************"
+../script/ota_delta/ota_delta $2 $1_NEW.bin $1_DELTA.bin
+if [ $? == 0 ]
+then
+echo "$1_DELTA.bin delta OTA image against $2 finish !"
+fi
+echo "*****************************************************"
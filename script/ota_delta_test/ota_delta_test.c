@@ -0,0 +1,328 @@
+/********************************************************************************************************
+ * @file	ota_delta_test.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host checks of the delta images of script/ota_delta and ota/ota_delta.c, the patch applier of the slave
+ *   build: gcc -O2 -Wall -o ota_delta_test ota_delta_test.c ../../ota/ota_delta.c
+ *   usage: ota_delta_test gen <dir>                      writes <case>_old.bin/<case>_new.bin pairs, prints the cases
+ *          ota_delta_test check <old> <new> <delta> [seed] applies the delta as the slave receives it
+ *          ota_delta_test errors                         corrupted patch streams are refused
+ *   ota_delta_test.sh runs them all with ota_delta in between
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ota/ota_delta.h"
+
+#define TEST_IMAGE_SIZE         61440 //a typical application
+#define TEST_BIG_SIZE           (200 * 1024) //copies longer than one op
+#define TEST_BLOCK_SIZE         192 //OTA_BLOCK_SIZE_MAX, the payload of a DATA frame
+#define TEST_ROUNDS             8
+
+static unsigned char *OldBuf, *NewBuf, *Rebuilt;
+static unsigned int OldSize, NewSize;
+static unsigned int NextOffset; //where the next page must start
+static int Failures;
+
+#define CHECK(c)    do { if (!(c)) { printf("line %d: %s\n", __LINE__, #c); Failures++; } } while (0)
+
+static void TestRead(unsigned int Offset, unsigned char *Buf, int Len)
+{
+    CHECK((Len > 0) && (Offset + Len <= OldSize));
+    if ((Len > 0) && (Offset + Len <= OldSize)) {
+        memcpy(Buf, OldBuf + Offset, Len);
+    }
+}
+
+//pages come in order and whole but for the last one, as the slave programs them, a NewSize of 0 is not known
+static void TestOutput(unsigned int Offset, const unsigned char *Data, int Len)
+{
+    CHECK(Offset == NextOffset);
+    CHECK((Len == OTA_DELTA_PAGE_SIZE) || ((Len > 0) && (Len < OTA_DELTA_PAGE_SIZE) && (!NewSize || (Offset + Len == NewSize))));
+    if (Offset + Len <= NewSize) {
+        memcpy(Rebuilt + Offset, Data, Len);
+    }
+    NextOffset = Offset + Len;
+}
+
+static unsigned char *ReadFile(const char *Name, unsigned int *Size)
+{
+    FILE *fp = fopen(Name, "rb");
+    unsigned char *Buf;
+
+    if (!fp) {
+        printf("can not open %s\n", Name);
+        exit(2);
+    }
+    fseek(fp, 0, SEEK_END);
+    *Size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    Buf = malloc(*Size + 1);
+    if (!Buf || (fread(Buf, 1, *Size, fp) != *Size)) {
+        printf("can not read %s\n", Name);
+        exit(2);
+    }
+    fclose(fp);
+    return Buf;
+}
+
+static void WriteFile(const char *Dir, const char *Case, const char *Which, const unsigned char *Buf, unsigned int Size)
+{
+    char Name[256];
+    FILE *fp;
+
+    snprintf(Name, sizeof(Name), "%s/%s_%s.bin", Dir, Case, Which);
+    fp = fopen(Name, "wb");
+    if (!fp || (fwrite(Buf, 1, Size, fp) != Size)) {
+        printf("can not write %s\n", Name);
+        exit(2);
+    }
+    fclose(fp);
+}
+
+//code-like filler: short random runs with repeats of recent ones, as instruction sequences repeat
+static void Fill(unsigned char *Buf, unsigned int Size)
+{
+    unsigned int Pos = 0, Len, From, i;
+
+    while (Pos < Size) {
+        Len = 4 + rand() % 28;
+        if (Len > Size - Pos) {
+            Len = Size - Pos;
+        }
+        if ((Pos > 1024) && (rand() % 3)) {
+            From = Pos - 1 - rand() % 1024;
+            for (i = 0; i < Len; i++) {
+                Buf[Pos + i] = Buf[From + i];
+            }
+        }
+        else {
+            for (i = 0; i < Len; i++) {
+                Buf[Pos + i] = rand();
+            }
+        }
+        Pos += Len;
+    }
+}
+
+/*
+ * New gets Old with Cut bytes at At replaced by Ins bytes, then Patches single bytes changed, which is what
+ * a changed constant, a function grown or removed, or a moved string does to an image
+ */
+static void Case(const char *Dir, const char *Name, unsigned int Size, unsigned int At, unsigned int Cut,
+                 unsigned int Ins, int Patches)
+{
+    unsigned char *Old = malloc(Size);
+    unsigned char *New = malloc(Size + Ins);
+    unsigned int Len = Size - Cut + Ins;
+    int i;
+
+    Fill(Old, Size);
+    memcpy(New, Old, At);
+    Fill(New + At, Ins);
+    memcpy(New + At + Ins, Old + At + Cut, Size - At - Cut);
+    for (i = 0; i < Patches; i++) {
+        New[rand() % Len] ^= 1 + rand() % 255;
+    }
+    WriteFile(Dir, Name, "old", Old, Size);
+    WriteFile(Dir, Name, "new", New, Len);
+    printf("%s\n", Name);
+    free(Old);
+    free(New);
+}
+
+static int Generate(const char *Dir)
+{
+    srand(1);
+    Case(Dir, "same", TEST_IMAGE_SIZE, 0, 0, 0, 0);
+    Case(Dir, "bytes", TEST_IMAGE_SIZE, 0, 0, 0, 16);
+    Case(Dir, "table", TEST_IMAGE_SIZE, 40000, 64, 64, 0);
+    Case(Dir, "insert", TEST_IMAGE_SIZE, 20000, 0, 200, 4);
+    Case(Dir, "remove", TEST_IMAGE_SIZE, 30000, 300, 0, 4);
+    Case(Dir, "grow", TEST_IMAGE_SIZE, TEST_IMAGE_SIZE, 0, 4096, 0);
+    Case(Dir, "shrink", TEST_IMAGE_SIZE, TEST_IMAGE_SIZE - 4096, 4096, 0, 0);
+    Case(Dir, "rewrite", TEST_IMAGE_SIZE, 0, TEST_IMAGE_SIZE, TEST_IMAGE_SIZE, 0);
+    Case(Dir, "big", TEST_BIG_SIZE, 150000, 10, 20, 2);
+    return 0;
+}
+
+//the delta is applied in the chunks the slave gets it in, a DATA frame does not end where an op ends
+static int Check(const char *OldName, const char *NewName, const char *DeltaName, unsigned int Seed)
+{
+    unsigned char *Delta;
+    unsigned int DeltaSize, PatchSize, Pos, Len, Changed, i;
+    OTA_DeltaHeaderTypeDef Header;
+    OTA_DeltaTypeDef Dec;
+    int Round;
+
+    OldBuf = ReadFile(OldName, &OldSize);
+    NewBuf = ReadFile(NewName, &NewSize);
+    Delta = ReadFile(DeltaName, &DeltaSize);
+    Rebuilt = malloc(NewSize);
+    CHECK(DeltaSize >= OTA_DELTA_HEADER_LEN);
+    if (DeltaSize < OTA_DELTA_HEADER_LEN) {
+        return 1;
+    }
+    memcpy(&Header, Delta, OTA_DELTA_HEADER_LEN);
+    PatchSize = DeltaSize - OTA_DELTA_HEADER_LEN;
+    CHECK(OTA_DELTA_MAGIC == Header.Magic);
+    CHECK(Header.NewSize == NewSize);
+    CHECK(Header.OldSize == OldSize);
+    CHECK(Header.PatchSize == PatchSize);
+    CHECK(Header.NewCRC == (NewBuf[NewSize - 2] | (NewBuf[NewSize - 1] << 8)));
+    CHECK(Header.OldCRC == (OldBuf[OldSize - 2] | (OldBuf[OldSize - 1] << 8)));
+
+    srand(Seed);
+    for (Round = 0; Round < TEST_ROUNDS; Round++) {
+        memset(Rebuilt, 0, NewSize);
+        NextOffset = 0;
+        OTA_DeltaInit(&Dec, TestRead, TestOutput, OldSize);
+        for (Pos = 0; Pos < PatchSize; Pos += Len) {
+            //the first round in whole blocks, the others in random pieces down to single bytes
+            Len = Round ? (1 + rand() % TEST_BLOCK_SIZE) : TEST_BLOCK_SIZE;
+            if (Len > PatchSize - Pos) {
+                Len = PatchSize - Pos;
+            }
+            CHECK(0 == OTA_DeltaApply(&Dec, Delta + OTA_DELTA_HEADER_LEN + Pos, Len));
+        }
+        CHECK(OTA_DeltaFinish(&Dec) == NewSize);
+        CHECK(!Dec.Error);
+        CHECK(NextOffset == NewSize);
+        CHECK(0 == memcmp(Rebuilt, NewBuf, NewSize));
+    }
+
+    for (i = 0, Changed = 0; i < NewSize; i++) {
+        Changed += (i >= OldSize) || (OldBuf[i] != NewBuf[i]);
+    }
+    printf("%-24s %6u bytes, %6u differ in place, delta %6u bytes %3u%%, %4u of %4u blocks: %s\n", NewName, NewSize,
+           Changed, DeltaSize, (unsigned int)((unsigned long long)DeltaSize * 100 / NewSize),
+           (DeltaSize + TEST_BLOCK_SIZE - 1) / TEST_BLOCK_SIZE, (NewSize + TEST_BLOCK_SIZE - 1) / TEST_BLOCK_SIZE,
+           Failures ? "FAILED" : "rebuilt");
+    return Failures ? 1 : 0;
+}
+
+//returns the rebuilt size, -1 for a refused patch
+static int Apply(const unsigned char *Patch, int Len, int Split)
+{
+    OTA_DeltaTypeDef Dec;
+    int Ret = 0;
+
+    NextOffset = 0;
+    OTA_DeltaInit(&Dec, TestRead, TestOutput, OldSize);
+    if ((Split > 0) && (Split < Len)) {
+        Ret = OTA_DeltaApply(&Dec, Patch, Split);
+        Patch += Split;
+        Len -= Split;
+    }
+    if (Ret >= 0) {
+        Ret = OTA_DeltaApply(&Dec, Patch, Len);
+    }
+    if (Ret >= 0) {
+        Ret = OTA_DeltaFinish(&Dec);
+    }
+    return Dec.Error ? -1 : Ret;
+}
+
+//a patch that does not fit the running image or ends early must be refused, wherever the chunks split it
+static int Errors(void)
+{
+    static unsigned char Old[1000], New[1000];
+    //COPY 0+500, INSERT 2 bytes, COPY 998+2 : exactly the end of the running image
+    const unsigned char Good[] = { 1, 0, 0, 0, 0, 0xf4, 0x01, 2, 2, 0, 0xaa, 0xbb, 1, 0xe6, 0x03, 0, 0, 2, 0 };
+    //COPY 999+2 reaches past the running image
+    const unsigned char Beyond[] = { 1, 0xe7, 0x03, 0, 0, 2, 0 };
+    //COPY 0xffffffff+2 wraps around
+    const unsigned char Wrap[] = { 1, 0xff, 0xff, 0xff, 0xff, 2, 0 };
+    const unsigned char Unknown[] = { 2, 1, 0, 0x55, 3, 0, 0 };
+    //INSERT of 4 with 3 data bytes
+    const unsigned char Short[] = { 2, 4, 0, 1, 2, 3 };
+    //COPY without its length
+    const unsigned char Cut[] = { 1, 0, 0, 0, 0, 0xf4 };
+    int Split, i;
+
+    for (i = 0; i < sizeof(Old); i++) {
+        Old[i] = i * 7;
+    }
+    memcpy(New, Old, 500);
+    New[500] = 0xaa;
+    New[501] = 0xbb;
+    memcpy(New + 502, Old + 998, 2);
+    OldBuf = Old;
+    OldSize = sizeof(Old);
+    NewBuf = New;
+    NewSize = 504;
+    Rebuilt = malloc(sizeof(New));
+
+    for (Split = 0; Split <= sizeof(Good); Split++) {
+        memset(Rebuilt, 0, sizeof(New));
+        CHECK(504 == Apply(Good, sizeof(Good), Split));
+        CHECK(0 == memcmp(Rebuilt, New, NewSize));
+    }
+    NewSize = 0;
+    for (Split = 0; Split < 8; Split++) {
+        CHECK(Apply(Beyond, sizeof(Beyond), Split) < 0);
+        CHECK(Apply(Wrap, sizeof(Wrap), Split) < 0);
+        CHECK(Apply(Unknown, sizeof(Unknown), Split) < 0);
+        CHECK(Apply(Short, sizeof(Short), Split) < 0);
+        CHECK(Apply(Cut, sizeof(Cut), Split) < 0);
+    }
+    printf("corrupted patches: %s\n", Failures ? "FAILED" : "refused");
+    return Failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if ((3 == argc) && !strcmp(argv[1], "gen")) {
+        return Generate(argv[2]);
+    }
+    if ((argc >= 5) && !strcmp(argv[1], "check")) {
+        return Check(argv[2], argv[3], argv[4], (argc > 5) ? strtoul(argv[5], 0, 0) : 1);
+    }
+    if ((2 == argc) && !strcmp(argv[1], "errors")) {
+        return Errors();
+    }
+    printf("usage: %s gen <dir> | check <old.bin> <new.bin> <delta.bin> [seed] | errors\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,20 @@
+#!/bin/bash 
+# makes delta images with script/ota_delta for typical changes of an image and rebuilds them with ota/ota_delta.c
+#   usage: ota_delta_test.sh [seed]
+cd "$(dirname "$0")"
+SDK=../..
+OUT=build
+echo "*****************************************************"
+mkdir -p $OUT
+gcc -O2 -Wall -o $OUT/ota_delta $SDK/script/ota_delta/ota_delta.c $SDK/ota/ota_delta.c || exit 1
+gcc -O2 -Wall -o $OUT/ota_delta_test ota_delta_test.c $SDK/ota/ota_delta.c || exit 1
+RESULT=0
+$OUT/ota_delta_test errors || RESULT=1
+for CASE in $($OUT/ota_delta_test gen $OUT)
+do
+    $OUT/ota_delta $OUT/${CASE}_old.bin $OUT/${CASE}_new.bin $OUT/${CASE}_delta.bin > /dev/null || { echo "$CASE: ota_delta failed"; RESULT=1; continue; }
+    (cd $OUT && ./ota_delta_test check ${CASE}_old.bin ${CASE}_new.bin ${CASE}_delta.bin ${1:-1}) || RESULT=1
+done
+rm -rf $OUT
+echo "*****************************************************"
+exit $RESULT
@@ -0,0 +1,407 @@
+/********************************************************************************************************
+ * @file	ota_resume_test.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host checks of ota/ota_resume.c against a simulated NOR flash: the bitmap queries against a
+ * reference set, then a session cut by a power loss at every flash operation in turn, torn a few
+ * different ways. An erase cut short leaves a random part of the sector erased, a program cut
+ * short a random part of the bits cleared, after the "reboot" the record must either be rejected
+ * or tell no lies
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -iquote . -iquote ../../common -iquote ../../drivers -c ../../ota/ota_resume.c
+ *          gcc -O2 -Wall -o ota_resume_test ota_resume_test.c ota_resume.o, ota_resume_test.sh does both
+ *   usage: ota_resume_test [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "../../ota/ota_resume.h"
+
+#define TEST_FLASH_SIZE         0x80000
+#define TEST_SECTOR_SIZE        0x1000
+#define TEST_PAGE_SIZE          0x100
+#define TEST_BIN_ADDR           0x20000 //OTA_SLAVE_BIN_ADDR
+#define TEST_MAX_BLOCKS         4096
+#define TEST_CUT_ROUNDS         8 //different tears of the same operation
+
+typedef void (*TEST_FlashHandler_t)(unsigned long, unsigned long, unsigned char *);
+
+static unsigned char Flash[TEST_FLASH_SIZE];
+static unsigned int Ops;        //flash erase and program operations so far
+static unsigned int CutAt;      //operation the power is lost in, ~0 for never
+static jmp_buf CutJmp;
+static int Failures;
+static unsigned int Checks;
+static unsigned char Marked[TEST_MAX_BLOCKS + 1]; //blocks whose OTA_ResumeMarkBlock() returned
+
+#define CHECK(c)    do { Checks++; if (!(c)) { printf("line %d: %s\n", __LINE__, #c); Failures++; } } while (0)
+
+static void TestFlashRange(unsigned long Addr, unsigned long Len)
+{
+    if ((Addr >= TEST_FLASH_SIZE) || (Len > TEST_FLASH_SIZE - Addr)) {
+        printf("flash access out of range: 0x%lx, %lu bytes\n", Addr, Len);
+        exit(2);
+    }
+}
+
+static void TestFlashRead(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    TestFlashRange(Addr, Len);
+    memcpy(Buf, &Flash[Addr], Len);
+}
+
+//programming only clears bits, one program per page touched as flash_page_program() does it. A cut
+//leaves the bytes before the cut programmed and a random part of the bits of that byte
+static void TestFlashWrite(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    unsigned long i, n;
+    unsigned long Cut;
+
+    TestFlashRange(Addr, Len);
+    while (Len) {
+        n = TEST_PAGE_SIZE - (Addr & (TEST_PAGE_SIZE - 1));
+        if (n > Len) {
+            n = Len;
+        }
+        Cut = (Ops++ == CutAt) ? (rand() % (n + 1)) : n;
+        for (i = 0; i < Cut; i++) {
+            Flash[Addr + i] &= Buf[i];
+        }
+        if (Cut < n) {
+            Flash[Addr + Cut] &= Buf[Cut] | rand();
+            longjmp(CutJmp, 1);
+        }
+        Addr += n;
+        Buf += n;
+        Len -= n;
+    }
+}
+
+TEST_FlashHandler_t flash_read_page = TestFlashRead;
+TEST_FlashHandler_t flash_write_page = TestFlashWrite;
+
+//a cut erase leaves a random part of the sector erased
+void flash_erase_sector(unsigned long addr)
+{
+    unsigned long i;
+
+    addr &= ~(unsigned long)(TEST_SECTOR_SIZE - 1);
+    TestFlashRange(addr, TEST_SECTOR_SIZE);
+    if (Ops++ == CutAt) {
+        for (i = 0; i < TEST_SECTOR_SIZE; i++) {
+            if (rand() & 1) {
+                Flash[addr + i] = 0xff;
+            }
+        }
+        longjmp(CutJmp, 1);
+    }
+    memset(&Flash[addr], 0xff, TEST_SECTOR_SIZE);
+}
+
+static void NewInfo(OTA_ResumeInfoTypeDef *Info, unsigned int ImageSize, unsigned short ImageCRC, unsigned short BlockSize)
+{
+    memset(Info, 0, sizeof(*Info));
+    Info->FlashAddr = TEST_BIN_ADDR;
+    Info->ImageSize = ImageSize;
+    Info->ImageCRC = ImageCRC;
+    Info->BlockSize = BlockSize;
+    Info->MaxBlockNum = (ImageSize + BlockSize - 1) / BlockSize;
+}
+
+static int SameInfo(const OTA_ResumeInfoTypeDef *A, const OTA_ResumeInfoTypeDef *B)
+{
+    return (A->FlashAddr == B->FlashAddr) && (A->ImageSize == B->ImageSize) && (A->ImageCRC == B->ImageCRC) &&
+           (A->MaxBlockNum == B->MaxBlockNum) && (A->BlockSize == B->BlockSize);
+}
+
+//the record is found again, for its own image only, and is gone once discarded
+static void TestRecord(void)
+{
+    OTA_ResumeInfoTypeDef Info, Got, Other;
+
+    memset(Flash, 0xff, sizeof(Flash));
+    CutAt = ~0U;
+    CHECK(!OTA_ResumeLoad(&Got, TEST_BIN_ADDR));
+
+    NewInfo(&Info, 61000, 0x1234, 192);
+    OTA_ResumeCreate(&Info);
+    CHECK(OTA_ResumeLoad(&Got, TEST_BIN_ADDR));
+    CHECK(SameInfo(&Got, &Info));
+    CHECK(OTA_ResumeIsMatch(&Got, &Info));
+    CHECK(!OTA_ResumeLoad(&Got, TEST_BIN_ADDR + 0x20000));
+
+    Other = Info;
+    Other.ImageCRC ^= 1;
+    CHECK(!OTA_ResumeIsMatch(&Info, &Other));
+    Other = Info;
+    Other.ImageSize++;
+    CHECK(!OTA_ResumeIsMatch(&Info, &Other));
+    //the block size is not part of the identity, the bitmap is rebuilt in the new one
+    Other = Info;
+    Other.BlockSize = 48;
+    CHECK(OTA_ResumeIsMatch(&Info, &Other));
+
+    OTA_ResumeDiscard();
+    CHECK(!OTA_ResumeLoad(&Got, TEST_BIN_ADDR));
+
+    //a record written before block sizes were negotiated left the field erased
+    NewInfo(&Info, 4800, 0x4321, 48);
+    Info.BlockSize = 0xffff;
+    OTA_ResumeCreate(&Info);
+    CHECK(OTA_ResumeLoad(&Got, TEST_BIN_ADDR));
+    CHECK(48 == Got.BlockSize);
+}
+
+//every query against the set of blocks marked so far
+static void CheckBitmap(unsigned short MaxBlockNum)
+{
+    unsigned char Map[64];
+    unsigned short BaseNum = 0;
+    unsigned short Contiguous = 0, Count = 0, Last = 0;
+    unsigned int First = 0; //byte of the first missing block
+    int MapLen, Len, Want, i;
+
+    while ((Contiguous < MaxBlockNum) && Marked[Contiguous + 1]) {
+        Contiguous++;
+    }
+    for (i = 1; i <= MaxBlockNum; i++) {
+        CHECK(OTA_ResumeIsBlockReceived(i) == Marked[i]);
+        if (Marked[i]) {
+            Count++;
+            Last = i;
+        }
+    }
+    CHECK(OTA_ResumeContiguousBlocks(MaxBlockNum) == Contiguous);
+    CHECK(OTA_ResumeCountBlocks(MaxBlockNum) == Count);
+    CHECK(OTA_ResumeLastBlock(MaxBlockNum) == Last);
+
+    First = Contiguous >> 3;
+    for (MapLen = 1; MapLen <= sizeof(Map); MapLen *= 4) {
+        memset(Map, 0xa5, sizeof(Map));
+        Len = OTA_ResumeMissingMap(MaxBlockNum, &BaseNum, Map, MapLen);
+        if (Contiguous == MaxBlockNum) {
+            CHECK(0 == Len);
+            continue;
+        }
+        Want = ((MaxBlockNum + 7) >> 3) - First;
+        if (Want > MapLen) {
+            Want = MapLen;
+        }
+        CHECK(Len == Want);
+        CHECK(BaseNum == (First << 3) + 1);
+        for (i = 0; (i < Len * 8) && (i < sizeof(Map) * 8); i++) {
+            int Block = BaseNum + i;
+            int Missing = (Block <= MaxBlockNum) && !Marked[Block];
+            CHECK(!!(Map[i >> 3] & (1 << (i & 0x07))) == Missing);
+        }
+    }
+}
+
+//blocks marked in a random order, some of them twice
+static void TestBitmap(unsigned short MaxBlockNum)
+{
+    OTA_ResumeInfoTypeDef Info;
+    int Left = MaxBlockNum;
+    int Step = 0;
+    int Block;
+
+    memset(Flash, 0xff, sizeof(Flash));
+    memset(Marked, 0, sizeof(Marked));
+    CutAt = ~0U;
+    NewInfo(&Info, MaxBlockNum * 48, 0x5aa5, 48);
+    OTA_ResumeCreate(&Info);
+    CheckBitmap(MaxBlockNum);
+    while (Left) {
+        Block = 1 + rand() % MaxBlockNum;
+        while (Marked[Block]) {
+            Block = (Block % MaxBlockNum) + 1;
+        }
+        OTA_ResumeMarkBlock(Block);
+        Marked[Block] = 1;
+        Left--;
+        //a block received again is marked again, which changes nothing
+        if (0 == rand() % 8) {
+            OTA_ResumeMarkBlock(Block);
+        }
+        if ((Left < 4) || (0 == Step++ % (1 + MaxBlockNum / 16))) {
+            CheckBitmap(MaxBlockNum);
+        }
+    }
+    CheckBitmap(MaxBlockNum);
+}
+
+//the bitmap rebuilt in another block size marks a prefix at once
+static void TestMarkBlocks(unsigned short MaxBlockNum, unsigned short Count)
+{
+    OTA_ResumeInfoTypeDef Info;
+    int i;
+
+    memset(Flash, 0xff, sizeof(Flash));
+    CutAt = ~0U;
+    NewInfo(&Info, MaxBlockNum * 192, 0x0f0f, 192);
+    OTA_ResumeCreate(&Info);
+    OTA_ResumeMarkBlocks(Count);
+    for (i = 1; i <= MaxBlockNum; i++) {
+        Marked[i] = (i <= Count);
+    }
+    CheckBitmap(MaxBlockNum);
+}
+
+/*
+ * the slave side of a session: a record of an older image is replaced by one for the new image,
+ * then the blocks are marked as they arrive. The power is lost in operation Cut, *Created tells
+ * whether the new record was complete and *InFlight the block being marked
+ */
+static void Session(unsigned int Seed, unsigned int Cut, const OTA_ResumeInfoTypeDef *Old, const OTA_ResumeInfoTypeDef *New,
+                    int *Created, int *InFlight)
+{
+    OTA_ResumeInfoTypeDef Info;
+    unsigned short Order[TEST_MAX_BLOCKS];
+    unsigned short Tmp;
+    int i, j;
+
+    srand(Seed);
+    memset(Flash, 0xff, sizeof(Flash));
+    memset(Marked, 0, sizeof(Marked));
+    *Created = 0;
+    *InFlight = 0;
+    CutAt = ~0U;
+    Info = *Old;
+    OTA_ResumeCreate(&Info);
+    for (i = 1; i < Old->MaxBlockNum; i += 3) {
+        OTA_ResumeMarkBlock(i);
+    }
+    for (i = 0; i < New->MaxBlockNum; i++) {
+        Order[i] = i + 1;
+    }
+    for (i = New->MaxBlockNum - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        Tmp = Order[i];
+        Order[i] = Order[j];
+        Order[j] = Tmp;
+    }
+    Ops = 0;
+    CutAt = Cut;
+    Info = *New;
+    OTA_ResumeCreate(&Info);
+    *Created = 1;
+    for (i = 0; i < New->MaxBlockNum; i++) {
+        *InFlight = Order[i];
+        OTA_ResumeMarkBlock(Order[i]);
+        Marked[Order[i]] = 1;
+    }
+    *InFlight = 0;
+}
+
+/*
+ * after the reboot, a record accepted for the new image must be the one written, hold every block
+ * marked before the cut and none else but the one in flight. The session then resumes to the end
+ */
+static void TestPowerCut(unsigned int Seed, int *Resumed, int *Restarted)
+{
+    OTA_ResumeInfoTypeDef Old, New, Got;
+    unsigned int Total, Cut;
+    int Created, InFlight, Round, i;
+
+    NewInfo(&Old, 50000, 0x1111, 48);
+    NewInfo(&New, 60000, 0x2222, 192);
+    Session(Seed, ~0U, &Old, &New, &Created, &InFlight);
+    Total = Ops;
+
+    for (Cut = 0; Cut < Total * TEST_CUT_ROUNDS; Cut++) {
+        Round = Cut % TEST_CUT_ROUNDS;
+        if (!setjmp(CutJmp)) {
+            Session(Seed + Round, Cut / TEST_CUT_ROUNDS, &Old, &New, &Created, &InFlight);
+        }
+        CutAt = ~0U;
+        if (!OTA_ResumeLoad(&Got, TEST_BIN_ADDR) || !OTA_ResumeIsMatch(&Got, &New)) {
+            CHECK(!Created);
+            (*Restarted)++;
+            continue;
+        }
+        CHECK(SameInfo(&Got, &New));
+        for (i = 1; i <= New.MaxBlockNum; i++) {
+            if (OTA_ResumeIsBlockReceived(i)) {
+                CHECK(Marked[i] || (i == InFlight));
+            }
+            else {
+                CHECK(!Marked[i]);
+            }
+        }
+        //the missing blocks are received again
+        for (i = 1; i <= New.MaxBlockNum; i++) {
+            if (!OTA_ResumeIsBlockReceived(i)) {
+                OTA_ResumeMarkBlock(i);
+            }
+            Marked[i] = 1;
+        }
+        CheckBitmap(New.MaxBlockNum);
+        (*Resumed)++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int Seed = (argc > 1) ? strtoul(argv[1], 0, 0) : 1;
+    unsigned short Sizes[] = { 1, 7, 8, 9, 127, 128, 129, 1272, TEST_MAX_BLOCKS };
+    int Resumed = 0, Restarted = 0;
+    int i;
+
+    srand(Seed);
+    TestRecord();
+    for (i = 0; i < sizeof(Sizes) / sizeof(Sizes[0]); i++) {
+        TestBitmap(Sizes[i]);
+        TestMarkBlocks(Sizes[i], 0);
+        TestMarkBlocks(Sizes[i], Sizes[i] / 2);
+        TestMarkBlocks(Sizes[i], Sizes[i] - 1);
+        TestMarkBlocks(Sizes[i], Sizes[i]);
+    }
+    TestPowerCut(Seed, &Resumed, &Restarted);
+
+    printf("seed %u, %u checks, power cut in every flash operation: %d sessions resumed, %d started over\n",
+           Seed, Checks, Resumed, Restarted);
+    printf("%s: %d failures\n", Failures ? "FAILED" : "passed", Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -iquote . -iquote ../../common -iquote ../../drivers -c ../../ota/ota_resume.c || exit 1
+gcc -O2 -Wall -o ota_resume_test ota_resume_test.c ota_resume.o || exit 1
+./ota_resume_test $1
+RESULT=$?
+rm -f ota_resume_test ota_resume.o
+echo "*****************************************************"
+exit $RESULT
@@ -0,0 +1,884 @@
+/********************************************************************************************************
+ * @file	ota_sim.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * simulation of OTA sessions over the air: every device runs ota/ota.c and ota/mac.c, built
+ * for the host into a node of sim/sim_node.c, on a virtual clock. The nodes are coroutines,
+ * one runs at a time until it waits, the radio medium carries the frames between them
+ *   build: see ota_sim.sh
+ *   usage: ota_sim [-s image_size] [-l loss_permille] [-c channel:loss_permille,...] [-n slaves] [-m] [-v slave_loss_permille]
+ *                  [-E erase_us] [-P program_us] [-r seed] [-t limit_s] <master.so> <slave.so>
+ * the medium is 2Mbps gen_fsk with half duplex radios, frames that overlap on a channel collide,
+ * nodes built for the TPLL transport get its link layer on top: a PTX repeats a frame until the
+ * PRX acknowledges it, the PRX does so from its rx fifo while its interrupts are masked,
+ * -l hits that many of every 1000 frames at a receiver, half of the hits corrupt the frame and the
+ * other half lose it, -c sets the loss of single channels over it as interference would, the
+ * session starts on channel 70. -n slaves listen to one master, -m runs it as a multicast master
+ * and -v adds a loss of its own to every slave, drawn evenly up to the value. -E times a sector
+ * erase and -P the program of a whole page, the interrupts are masked meanwhile as on the chip.
+ * one line per device is printed, for a slave with the time from the START_REQ or MCAST_START it
+ * got to its first block, then the session time until the last of them was done, the exit status
+ * tells whether every session verified
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <setjmp.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "../../common/crc.h"
+#include "../../ota/ota.h"
+#include "../../ota/ota_telemetry.h"
+#include "sim/sim_host.h"
+
+#define SIM_NODE_MAX            65
+#define SIM_STACK_SIZE          (256 * 1024)
+#define SIM_PENDING_MAX         4 //irqs raised while masked, one reception, its timeout and a tx done at most
+#define SIM_CHANNEL             70 //OTA_MASTER_CHANNEL of vendor/ota_master
+#define SIM_US_PER_BYTE         4 //2Mbps
+#define SIM_AIR_OVERHEAD        12 //preamble, sync word, header and CRC bytes
+#define SIM_SYNC_US             ((4 + 4) * SIM_US_PER_BYTE) //preamble and sync word, a receiver has to be listening by then
+#define SIM_MASTER_START_US     20000 //the slaves listen before the master starts
+#define SIM_LINGER_US           (5 * 1000 * 1000) //the slaves may still be busy when the master ends
+#define SIM_FOREVER             (~0ULL)
+#define SIM_BIN_SIZE_OFFSET     0x18
+#define SIM_PAGE_SIZE           256
+#define SIM_PROGRAM_SETUP_US    10 //command and the first byte of a page program
+#define SIM_TPLL_RX_FIFO        2 //frames the baseband of a PRX holds for the core, one more is not acknowledged
+#define SIM_TPLL_PAYLOAD_MAX    63
+
+//what a frame on air is
+enum {
+    SIM_FRAME_GEN_FSK = 0,
+    SIM_FRAME_TPLL_DATA,
+    SIM_FRAME_TPLL_ACK,
+};
+
+enum {
+    SIM_RADIO_IDLE = 0,
+    SIM_RADIO_TX,
+    SIM_RADIO_RX,
+};
+
+//what happens next, at equal times in this order
+enum {
+    SIM_EV_FRAME_END = 0,
+    SIM_EV_TX_START,
+    SIM_EV_RX_TIMEOUT,
+    SIM_EV_CPU,
+};
+
+typedef struct {
+    int Src;
+    int Len;
+    int CrcOk;
+    unsigned char Payload[256];
+} SIM_IrqTypeDef;
+
+typedef struct {
+    int Used;
+    int From;
+    int Channel;
+    int Cut; //the transmitter moved on before the end
+    int Kind;
+    int Pid; //TPLL, tells a repeated frame from a new one
+    unsigned long long EndUs;
+    int Len;
+    unsigned char Payload[256];
+} SIM_FrameTypeDef;
+
+typedef struct {
+    void *Lib;
+    void (*Main)(int Role, unsigned int Channel);
+    void (*Irq)(int Src, const unsigned char *Payload, int Len, int CrcOk);
+    unsigned char *Flash;
+    OTA_TelemetryTypeDef *Telemetry;
+    ucontext_t Ctx; //first entry
+    jmp_buf Jmp; //where it waits
+    int Started;
+    void *Stack;
+    int Role;
+    unsigned int Loss; //permille, on top of the loss of the channel
+    unsigned long long WakeUs; //the core runs again
+    int Rebooted;
+    int Ok;
+    unsigned long long RebootUs;
+    unsigned long long StartUs; //a slave got the START_REQ or MCAST_START that began its session, 0 for not yet
+    unsigned long long FirstBlockUs; //and its first block, 0 for not yet
+    int IrqOff;
+    SIM_IrqTypeDef Pending[SIM_PENDING_MAX];
+    int PendingNum;
+    //radio
+    int Mode;
+    int Channel;
+    int TxPending;
+    unsigned long long TxStartUs;
+    const unsigned char *TxBuf;
+    int RxWaitUs; //rx window after the frame on air, -1 for none
+    int OnAir; //frame sent, -1 for none
+    unsigned long long RxStartUs;
+    unsigned long long RxEndUs;
+    int RxTimeoutSrc;
+    int Lock; //frame received, -1 for none
+    int LockBad;
+    int TxKind;
+    int TxPid;
+    //TPLL link layer, see SIM_TpllMode()
+    int Tpll;
+    int TpllRetries;
+    unsigned int TpllRetryDelayUs;
+    unsigned int TpllAckWaitUs;
+    unsigned int TpllSettleUs;
+    int TpllListen; //PRX: between TPLL_PRXTrig() and TPLL_ModeStop()
+    int TpllTries; //PTX: transmissions of the frame so far
+    int TpllPid; //PTX: of the frame sent, PRX: of the last frame taken
+    unsigned char TpllTxBuf[SIM_TPLL_PAYLOAD_MAX + 5]; //the frame on air in the layout of a gen_fsk tx buffer
+    unsigned char TpllData[SIM_TPLL_PAYLOAD_MAX]; //PTX: the frame to send, PRX: the ACK payload
+    int TpllDataLen;
+    int TpllAckSent; //PRX: the ACK payload went out, a new frame means the PTX got it
+    unsigned char TpllFifo[SIM_TPLL_RX_FIFO][SIM_TPLL_PAYLOAD_MAX];
+    int TpllFifoLen[SIM_TPLL_RX_FIFO];
+    int TpllFifoNum;
+} SIM_NodeTypeDef;
+
+static SIM_NodeTypeDef Nodes[SIM_NODE_MAX];
+static int NodeNum;
+static SIM_FrameTypeDef Frames[SIM_NODE_MAX];
+static SIM_NodeTypeDef *Cur; //node whose code runs
+static int InIrq;
+static ucontext_t SchedCtx;
+static jmp_buf SchedJmp;
+static unsigned long long Now; //in us
+static unsigned int LossPermille[256]; //per channel
+static unsigned int EraseUs = 30000;
+static unsigned int ProgramUs = 1000;
+static unsigned char *Image;
+static unsigned int ImageSize; //the bin and the CRC appended to it
+
+unsigned int SIM_NowUs(void)
+{
+    return (unsigned int)Now;
+}
+
+/* the node waits, the others and the medium go on meanwhile, an irq handler does not wait */
+void SIM_SleepUs(unsigned int Us)
+{
+    SIM_NodeTypeDef *n = Cur;
+
+    if (InIrq) {
+        return;
+    }
+    n->WakeUs = Now + Us;
+    if (!_setjmp(n->Jmp)) {
+        _longjmp(SchedJmp, 1);
+    }
+}
+
+static void SIM_Deliver(SIM_NodeTypeDef *n, const SIM_IrqTypeDef *Irq)
+{
+    SIM_NodeTypeDef *Prev = Cur;
+
+    Cur = n;
+    InIrq = 1;
+    n->Irq(Irq->Src, Irq->Payload, Irq->Len, Irq->CrcOk);
+    InIrq = 0;
+    Cur = Prev;
+}
+
+/* the rf irq of a node, held back while its interrupts are masked */
+static void SIM_Raise(SIM_NodeTypeDef *n, int Src, const unsigned char *Payload, int Len, int CrcOk)
+{
+    SIM_IrqTypeDef Irq = {Src, Len, CrcOk};
+
+    if (n->Rebooted) {
+        return;
+    }
+    if (Payload) {
+        memcpy(Irq.Payload, Payload, Len);
+    }
+    if (!n->IrqOff) {
+        SIM_Deliver(n, &Irq);
+        return;
+    }
+    if (n->PendingNum >= SIM_PENDING_MAX) {
+        SIM_Fatal("too many irqs pending", Src);
+    }
+    n->Pending[n->PendingNum++] = Irq;
+}
+
+unsigned char SIM_IrqDisable(void)
+{
+    unsigned char r = !Cur->IrqOff;
+
+    Cur->IrqOff = 1;
+    return r;
+}
+
+void SIM_IrqRestore(unsigned char Enable)
+{
+    SIM_NodeTypeDef *n = Cur;
+    SIM_IrqTypeDef Irq;
+
+    n->IrqOff = !Enable;
+    while (!n->IrqOff && !InIrq && n->PendingNum) {
+        Irq = n->Pending[0];
+        memmove(&n->Pending[0], &n->Pending[1], --n->PendingNum * sizeof(n->Pending[0]));
+        SIM_Deliver(n, &Irq);
+    }
+}
+
+/* flash.c runs erase and program with the interrupts masked, programming takes its time per byte as NOR does */
+void SIM_FlashBusy(int Op, unsigned int Len)
+{
+    unsigned char r = SIM_IrqDisable();
+
+    SIM_SleepUs((SIM_FLASH_ERASE == Op) ? EraseUs : (SIM_PROGRAM_SETUP_US + ProgramUs * Len / SIM_PAGE_SIZE));
+    SIM_IrqRestore(r);
+}
+
+/* a new radio command ends the one in progress */
+static void SIM_RadioStop(SIM_NodeTypeDef *n)
+{
+    n->TxPending = 0;
+    if (n->OnAir >= 0) {
+        Frames[n->OnAir].Cut = 1;
+        Frames[n->OnAir].EndUs = Now;
+        n->OnAir = -1;
+    }
+    n->Lock = -1;
+    n->Mode = SIM_RADIO_IDLE;
+}
+
+void SIM_RadioTx(const unsigned char *TxBuf, unsigned int DelayUs, int RxWaitUs)
+{
+    SIM_NodeTypeDef *n = Cur;
+
+    SIM_RadioStop(n);
+    n->Mode = SIM_RADIO_TX;
+    n->TxPending = 1;
+    n->TxStartUs = Now + DelayUs;
+    n->TxBuf = TxBuf;
+    n->RxWaitUs = RxWaitUs;
+    n->TxKind = SIM_FRAME_GEN_FSK;
+}
+
+/* a timeout of 0 listens until a packet comes */
+void SIM_RadioRx(unsigned int DelayUs, unsigned int TimeoutUs)
+{
+    SIM_NodeTypeDef *n = Cur;
+
+    SIM_RadioStop(n);
+    n->Mode = SIM_RADIO_RX;
+    n->RxStartUs = Now + DelayUs;
+    n->RxEndUs = TimeoutUs ? (n->RxStartUs + TimeoutUs) : SIM_FOREVER;
+    n->RxTimeoutSrc = SIM_IRQ_FIRST_TIMEOUT;
+}
+
+void SIM_RadioChannel(int Channel)
+{
+    Cur->Channel = Channel & 0xff;
+}
+
+/* a TPLL frame of n goes on air after DelayUs, RxWaitUs as for SIM_RadioTx() */
+static void SIM_TpllTx(SIM_NodeTypeDef *n, int Kind, const unsigned char *Payload, int Len, int Pid, unsigned int DelayUs, int RxWaitUs)
+{
+    SIM_RadioStop(n);
+    n->TpllTxBuf[4] = Len;
+    memcpy(&n->TpllTxBuf[5], Payload, Len);
+    n->Mode = SIM_RADIO_TX;
+    n->TxPending = 1;
+    n->TxStartUs = Now + DelayUs;
+    n->TxBuf = n->TpllTxBuf;
+    n->RxWaitUs = RxWaitUs;
+    n->TxKind = Kind;
+    n->TxPid = Pid;
+}
+
+/* the node runs the TPLL link layer from now on, SIM_TPLL_PTX or SIM_TPLL_PRX */
+void SIM_TpllMode(int Mode)
+{
+    Cur->Tpll = Mode;
+    Cur->TpllFifoNum = 0;
+    Cur->TpllDataLen = 0;
+}
+
+void SIM_TpllConfig(int Retries, unsigned int RetryDelayUs, unsigned int AckWaitUs, unsigned int SettleUs)
+{
+    Cur->TpllRetries = Retries;
+    Cur->TpllRetryDelayUs = RetryDelayUs;
+    Cur->TpllAckWaitUs = AckWaitUs;
+    Cur->TpllSettleUs = SettleUs;
+}
+
+/* PTX: send a new frame, TX_DS or RETRY_HIT tell how it went */
+void SIM_TpllSend(const unsigned char *Payload, int Len)
+{
+    SIM_NodeTypeDef *n = Cur;
+
+    memcpy(n->TpllData, Payload, Len);
+    n->TpllDataLen = Len;
+    n->TpllPid++;
+    n->TpllTries = 1;
+    SIM_TpllTx(n, SIM_FRAME_TPLL_DATA, n->TpllData, Len, n->TpllPid, n->TpllSettleUs, n->TpllAckWaitUs);
+}
+
+/* PRX: start or stop receiving and acknowledging */
+void SIM_TpllListen(int On)
+{
+    SIM_NodeTypeDef *n = Cur;
+
+    n->TpllListen = On;
+    SIM_RadioStop(n);
+    if (On) {
+        n->Mode = SIM_RADIO_RX;
+        n->RxStartUs = Now;
+        n->RxEndUs = SIM_FOREVER;
+    }
+}
+
+/* PRX: what goes out with the next ACK, a Len of 0 flushes it */
+void SIM_TpllAckPayload(const unsigned char *Payload, int Len)
+{
+    if (Len) {
+        memcpy(Cur->TpllData, Payload, Len);
+    }
+    Cur->TpllDataLen = Len;
+    Cur->TpllAckSent = 0;
+}
+
+/* PTX: transmissions of the last frame, the first one included */
+int SIM_TpllTries(void)
+{
+    return Cur->TpllTries;
+}
+
+/* the oldest frame of the rx fifo, its length or 0 for none */
+int SIM_TpllRead(unsigned char *Buf)
+{
+    SIM_NodeTypeDef *n = Cur;
+    int Len;
+
+    if (!n->TpllFifoNum) {
+        return 0;
+    }
+    Len = n->TpllFifoLen[0];
+    memcpy(Buf, n->TpllFifo[0], Len);
+    n->TpllFifoNum--;
+    memmove(n->TpllFifo[0], n->TpllFifo[1], n->TpllFifoNum * sizeof(n->TpllFifo[0]));
+    memmove(&n->TpllFifoLen[0], &n->TpllFifoLen[1], n->TpllFifoNum * sizeof(n->TpllFifoLen[0]));
+    return Len;
+}
+
+static int SIM_TpllFifoPush(SIM_NodeTypeDef *n, const unsigned char *Payload, int Len)
+{
+    if (n->TpllFifoNum >= SIM_TPLL_RX_FIFO) {
+        return 0;
+    }
+    memcpy(n->TpllFifo[n->TpllFifoNum], Payload, Len);
+    n->TpllFifoLen[n->TpllFifoNum++] = Len;
+    return 1;
+}
+
+/* PTX: no valid ACK came, send the frame again after the retry delay or give it up */
+static void SIM_TpllRetry(SIM_NodeTypeDef *n)
+{
+    n->Mode = SIM_RADIO_IDLE;
+    if (n->TpllTries > n->TpllRetries) {
+        SIM_Raise(n, SIM_IRQ_RETRY_HIT, NULL, 0, 0);
+        return;
+    }
+    n->TpllTries++;
+    SIM_TpllTx(n, SIM_FRAME_TPLL_DATA, n->TpllData, n->TpllDataLen, n->TpllPid, n->TpllRetryDelayUs + n->TpllSettleUs, n->TpllAckWaitUs);
+}
+
+/* the baseband of a TPLL node got a frame, without the core */
+static void SIM_TpllRx(SIM_NodeTypeDef *m, const SIM_FrameTypeDef *f, int Ok)
+{
+    if (SIM_TPLL_PTX == m->Tpll) {
+        if (!Ok || (SIM_FRAME_TPLL_ACK != f->Kind) || (f->Pid != m->TpllPid)) {
+            SIM_TpllRetry(m);
+            return;
+        }
+        m->Mode = SIM_RADIO_IDLE;
+        if (f->Len && SIM_TpllFifoPush(m, f->Payload, f->Len)) {
+            SIM_Raise(m, SIM_IRQ_ACK_PAYLOAD, NULL, 0, 0);
+            return;
+        }
+        SIM_Raise(m, SIM_IRQ_TX_DS, NULL, 0, 0);
+        return;
+    }
+    //PRX, a repeated frame is acknowledged again but taken once
+    m->Mode = SIM_RADIO_RX;
+    m->RxStartUs = Now;
+    m->RxEndUs = SIM_FOREVER;
+    if (!Ok || (SIM_FRAME_TPLL_DATA != f->Kind)) {
+        return;
+    }
+    if (f->Pid != m->TpllPid) {
+        if (!SIM_TpllFifoPush(m, f->Payload, f->Len)) {
+            return;
+        }
+        m->TpllPid = f->Pid;
+        if (m->TpllAckSent) {
+            m->TpllDataLen = 0;
+            m->TpllAckSent = 0;
+        }
+        SIM_Raise(m, SIM_IRQ_RX_DR, NULL, 0, 0);
+    }
+    m->TpllAckSent |= (m->TpllDataLen > 0);
+    SIM_TpllTx(m, SIM_FRAME_TPLL_ACK, m->TpllData, m->TpllDataLen, f->Pid, m->TpllSettleUs, 0);
+}
+
+void SIM_Reboot(int Ok)
+{
+    SIM_NodeTypeDef *n = Cur;
+
+    SIM_RadioStop(n);
+    n->Rebooted = 1;
+    n->Ok = Ok;
+    n->RebootUs = Now;
+    _longjmp(SchedJmp, 1);
+}
+
+void SIM_Fatal(const char *Msg, unsigned int Value)
+{
+    fprintf(stderr, "node %d at %llu us: %s (0x%x)\n", Cur ? (int)(Cur - Nodes) : -1, Now, Msg, Value);
+    exit(2);
+}
+
+/* the frame of a node starts, every node listening on the channel locks onto it */
+static void SIM_TxStart(SIM_NodeTypeDef *n)
+{
+    SIM_FrameTypeDef *f;
+    int Idx, i, j;
+
+    for (Idx = 0; Frames[Idx].Used; Idx++);
+    f = &Frames[Idx];
+    f->Used = 1;
+    f->From = n - Nodes;
+    f->Channel = n->Channel;
+    f->Cut = 0;
+    f->Kind = n->TxKind;
+    f->Pid = n->TxPid;
+    f->Len = n->TxBuf[4];
+    memcpy(f->Payload, &n->TxBuf[5], f->Len);
+    f->EndUs = Now + (f->Len + SIM_AIR_OVERHEAD) * SIM_US_PER_BYTE;
+    n->TxPending = 0;
+    n->OnAir = Idx;
+
+    for (i = 0; i < NodeNum; i++) {
+        SIM_NodeTypeDef *m = &Nodes[i];
+
+        if ((m == n) || m->Rebooted || (SIM_RADIO_RX != m->Mode) || (m->Channel != f->Channel) ||
+            (Now < m->RxStartUs) || (Now + SIM_SYNC_US > m->RxEndUs)) {
+            continue;
+        }
+        //a frame overlapping the one being received spoils it
+        if (m->Lock >= 0) {
+            m->LockBad = 1;
+            continue;
+        }
+        m->Lock = Idx;
+        m->LockBad = 0;
+        for (j = 0; j < SIM_NODE_MAX; j++) {
+            if ((j != Idx) && Frames[j].Used && !Frames[j].Cut && (Frames[j].Channel == f->Channel)) {
+                m->LockBad = 1;
+            }
+        }
+        if (((unsigned int)(rand() % 1000) < LossPermille[f->Channel]) ||
+            (m->Loss && ((unsigned int)(rand() % 1000) < m->Loss))) {
+            if (rand() & 1) {
+                m->Lock = -1;
+            }
+            else {
+                m->LockBad = 1;
+            }
+        }
+    }
+}
+
+/* when the session of a slave began and when its first block came, from the frames it received intact */
+static void SIM_Observe(SIM_NodeTypeDef *n, const SIM_FrameTypeDef *f)
+{
+    if ((f->Len >= 2) && (OTA_FRAME_TYPE_CMD == f->Payload[0]) && !n->StartUs &&
+        ((OTA_CMD_ID_START_REQ == f->Payload[1]) || (OTA_CMD_ID_MCAST_START == f->Payload[1]))) {
+        n->StartUs = Now;
+    }
+    if ((f->Len >= 1) && ((OTA_FRAME_TYPE_DATA == f->Payload[0]) || (OTA_FRAME_TYPE_STREAM == f->Payload[0])) &&
+        n->StartUs && !n->FirstBlockUs) {
+        n->FirstBlockUs = Now;
+    }
+}
+
+static void SIM_FrameEnd(SIM_FrameTypeDef *f)
+{
+    SIM_NodeTypeDef *n = &Nodes[f->From];
+    int i;
+
+    f->Used = 0;
+    if (!f->Cut) {
+        n->OnAir = -1;
+        if (n->RxWaitUs >= 0) {
+            n->Mode = SIM_RADIO_RX;
+            n->RxStartUs = Now;
+            n->RxEndUs = n->RxWaitUs ? (Now + n->RxWaitUs) : SIM_FOREVER;
+            n->RxTimeoutSrc = SIM_IRQ_RX_TIMEOUT;
+        }
+        else {
+            n->Mode = SIM_RADIO_IDLE;
+        }
+        //a PRX that was stopped meanwhile does not listen again
+        if ((SIM_TPLL_PRX == n->Tpll) && !n->TpllListen) {
+            n->Mode = SIM_RADIO_IDLE;
+        }
+        if (!n->Tpll) {
+            SIM_Raise(n, SIM_IRQ_TX, NULL, 0, 0);
+        }
+    }
+    for (i = 0; i < NodeNum; i++) {
+        SIM_NodeTypeDef *m = &Nodes[i];
+
+        if ((m->Lock >= 0) && (&Frames[m->Lock] == f)) {
+            m->Lock = -1;
+            m->Mode = SIM_RADIO_IDLE;
+            if (!m->LockBad && !f->Cut && (SIM_ROLE_SLAVE == m->Role) && (SIM_FRAME_TPLL_ACK != f->Kind)) {
+                SIM_Observe(m, f);
+            }
+            if (m->Tpll) {
+                SIM_TpllRx(m, f, !m->LockBad && !f->Cut);
+                continue;
+            }
+            SIM_Raise(m, SIM_IRQ_RX, f->Payload, f->Len, !m->LockBad && !f->Cut);
+        }
+    }
+}
+
+static void SIM_NodeEntry(void)
+{
+    Cur->Main(Cur->Role, SIM_CHANNEL);
+    SIM_Fatal("main returned", 0);
+}
+
+static int SIM_NodeLoad(SIM_NodeTypeDef *n, const char *Path, int Role, unsigned long long StartUs)
+{
+    char Copy[4096];
+    char Cmd[8300];
+
+    //a shared object is loaded once per path, every node gets a copy of its own, dlopen() searches a bare name
+    snprintf(Copy, sizeof(Copy), "%s%s.%d", strchr(Path, '/') ? "" : "./", Path, (int)(n - Nodes));
+    snprintf(Cmd, sizeof(Cmd), "cp '%s' '%s'", Path, Copy);
+    if (system(Cmd)) {
+        return 0;
+    }
+    n->Lib = dlopen(Copy, RTLD_NOW | RTLD_LOCAL);
+    unlink(Copy);
+    if (!n->Lib) {
+        fprintf(stderr, "%s\n", dlerror());
+        return 0;
+    }
+    n->Main = (void (*)(int, unsigned int))dlsym(n->Lib, "SIM_NodeMain");
+    n->Irq = (void (*)(int, const unsigned char *, int, int))dlsym(n->Lib, "SIM_NodeIrq");
+    n->Flash = (unsigned char *)dlsym(n->Lib, "SIM_Flash");
+    n->Telemetry = (OTA_TelemetryTypeDef *)dlsym(n->Lib, "OTA_Telemetry");
+    n->Stack = malloc(SIM_STACK_SIZE);
+    if (!n->Main || !n->Irq || !n->Flash || !n->Telemetry || !n->Stack) {
+        fprintf(stderr, "%s is not a node\n", Path);
+        return 0;
+    }
+    memset(n->Flash, 0xff, SIM_FLASH_SIZE);
+    n->Role = Role;
+    n->WakeUs = StartUs;
+    n->OnAir = -1;
+    n->Lock = -1;
+    n->Channel = SIM_CHANNEL;
+    getcontext(&n->Ctx);
+    n->Ctx.uc_stack.ss_sp = n->Stack;
+    n->Ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    n->Ctx.uc_link = NULL;
+    makecontext(&n->Ctx, SIM_NodeEntry, 0);
+    return 1;
+}
+
+/* random data with the boot flag and the size field where a real bin has them, and the CRC appended */
+static unsigned char *SIM_MakeImage(unsigned int Size)
+{
+    static const unsigned char Flag[4] = {0x4b, 0x4e, 0x4c, 0x54};
+    unsigned char *Buf = malloc(Size + OTA_APPEND_INFO_LEN);
+    unsigned short Crc;
+    unsigned int i;
+
+    for (i = 0; i < Size; i++) {
+        Buf[i] = rand() >> 7;
+    }
+    memcpy(&Buf[8], Flag, sizeof(Flag));
+    memcpy(&Buf[SIM_BIN_SIZE_OFFSET], &Size, 4);
+    Crc = crc16_update(CRC16_INIT, Buf, Size);
+    Buf[Size] = Crc & 0xff;
+    Buf[Size + 1] = Crc >> 8;
+    return Buf;
+}
+
+/* advance to the next thing that happens, returns 0 once the sessions are over or the time is up */
+static int SIM_Step(unsigned long long LimitUs)
+{
+    unsigned long long Best = SIM_FOREVER;
+    int Kind = SIM_EV_CPU;
+    int Idx = -1;
+    int i;
+
+#define SIM_CANDIDATE(t, k, x)  if (((t) < Best) || (((t) == Best) && ((k) < Kind))) { Best = (t); Kind = (k); Idx = (x); }
+    for (i = 0; i < SIM_NODE_MAX; i++) {
+        if (Frames[i].Used) {
+            SIM_CANDIDATE(Frames[i].EndUs, SIM_EV_FRAME_END, i);
+        }
+    }
+    for (i = 0; i < NodeNum; i++) {
+        SIM_NodeTypeDef *n = &Nodes[i];
+
+        if (n->Rebooted) {
+            continue;
+        }
+        if (n->TxPending) {
+            SIM_CANDIDATE(n->TxStartUs, SIM_EV_TX_START, i);
+        }
+        if ((SIM_RADIO_RX == n->Mode) && (n->Lock < 0)) {
+            SIM_CANDIDATE(n->RxEndUs, SIM_EV_RX_TIMEOUT, i);
+        }
+        SIM_CANDIDATE(n->WakeUs, SIM_EV_CPU, i);
+    }
+#undef SIM_CANDIDATE
+    if ((Idx < 0) || (Best > LimitUs)) {
+        return 0;
+    }
+    Now = Best;
+    Cur = NULL;
+    if (SIM_EV_FRAME_END == Kind) {
+        SIM_FrameEnd(&Frames[Idx]);
+    }
+    else if (SIM_EV_TX_START == Kind) {
+        SIM_TxStart(&Nodes[Idx]);
+    }
+    else if ((SIM_EV_RX_TIMEOUT == Kind) && (SIM_TPLL_PTX == Nodes[Idx].Tpll)) {
+        SIM_TpllRetry(&Nodes[Idx]);
+    }
+    else if (SIM_EV_RX_TIMEOUT == Kind) {
+        Nodes[Idx].Mode = SIM_RADIO_IDLE;
+        SIM_Raise(&Nodes[Idx], Nodes[Idx].RxTimeoutSrc, NULL, 0, 0);
+    }
+    else {
+        //a coroutine is entered once through its context, the switches after that skip the signal mask
+        Cur = &Nodes[Idx];
+        if (!_setjmp(SchedJmp)) {
+            if (Cur->Started) {
+                _longjmp(Cur->Jmp, 1);
+            }
+            Cur->Started = 1;
+            swapcontext(&SchedCtx, &Cur->Ctx);
+        }
+        Cur = NULL;
+    }
+    return 1;
+}
+
+/* us from From to To, 0 when either never happened */
+static unsigned int SIM_SinceUs(unsigned long long From, unsigned long long To)
+{
+    return (From && (To > From)) ? (unsigned int)(To - From) : 0;
+}
+
+/* -c 70:800,24:300 gives channels a loss of their own */
+static int SIM_ChannelLoss(const char *List)
+{
+    unsigned long Channel, Loss;
+    char *End;
+
+    while (*List) {
+        Channel = strtoul(List, &End, 0);
+        if ((End == List) || (':' != *End) || (Channel > 255)) {
+            return 0;
+        }
+        List = End + 1;
+        Loss = strtoul(List, &End, 0);
+        if ((End == List) || (Loss > 1000) || ((',' != *End) && *End)) {
+            return 0;
+        }
+        LossPermille[Channel] = Loss;
+        List = (',' == *End) ? End + 1 : End;
+    }
+    return 1;
+}
+
+/* the slave took the image into the slot it does not run from */
+static int SIM_SlaveVerify(const SIM_NodeTypeDef *n)
+{
+    return n->Ok && (0 == memcmp(&n->Flash[OTA_SLAVE_BIN_ADDR], Image, ImageSize));
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int Size = 64 * 1024;
+    unsigned int Loss = 0;
+    unsigned int Seed = 1;
+    unsigned int LimitS = 600;
+    unsigned int Slaves = 1;
+    unsigned int SlaveLoss = 0;
+    const char *Channels = "";
+    int MasterRole = SIM_ROLE_MASTER;
+    unsigned char *Running;
+    const OTA_TelemetryTypeDef *t;
+    unsigned int Blocks;
+    unsigned long long EndUs;
+    int Verified = 0;
+    int Failed = 0;
+    int Arg;
+    int i;
+
+    for (i = 1; (i + 1 < argc) && ('-' == argv[i][0]); i += 2) {
+        unsigned int Value = strtoul(argv[i + 1], NULL, 0);
+        if (0 == strcmp(argv[i], "-m")) {
+            MasterRole = SIM_ROLE_MASTER_MCAST;
+            i--;
+        }
+        else if (0 == strcmp(argv[i], "-n")) {
+            Slaves = Value;
+        }
+        else if (0 == strcmp(argv[i], "-v")) {
+            SlaveLoss = Value;
+        }
+        else if (0 == strcmp(argv[i], "-s")) {
+            Size = Value;
+        }
+        else if (0 == strcmp(argv[i], "-l")) {
+            Loss = Value;
+        }
+        else if (0 == strcmp(argv[i], "-c")) {
+            Channels = argv[i + 1];
+        }
+        else if (0 == strcmp(argv[i], "-E")) {
+            EraseUs = Value;
+        }
+        else if (0 == strcmp(argv[i], "-P")) {
+            ProgramUs = Value;
+        }
+        else if (0 == strcmp(argv[i], "-r")) {
+            Seed = Value;
+        }
+        else if (0 == strcmp(argv[i], "-t")) {
+            LimitS = Value;
+        }
+        else {
+            break;
+        }
+    }
+    if ((i + 2 != argc) || (Size <= SIM_BIN_SIZE_OFFSET + 4) || (Size + OTA_APPEND_INFO_LEN > 0x20000) || (Loss > 1000) ||
+        !Slaves || (Slaves >= SIM_NODE_MAX) || (SlaveLoss > 1000)) {
+        printf("usage: %s [-s image_size] [-l loss_permille] [-c channel:loss_permille,...] [-n slaves] [-m] [-v slave_loss_permille] "
+               "[-E erase_us] [-P program_us] [-r seed] [-t limit_s] <master.so> <slave.so>\n", argv[0]);
+        return 2;
+    }
+    Arg = i;
+    for (i = 0; i < 256; i++) {
+        LossPermille[i] = Loss;
+    }
+    if (!SIM_ChannelLoss(Channels)) {
+        printf("-c wants channel:loss_permille pairs separated by commas, channels below 256 and losses up to 1000\n");
+        return 2;
+    }
+    srand(Seed);
+    Image = SIM_MakeImage(Size);
+    ImageSize = Size + OTA_APPEND_INFO_LEN;
+    Running = SIM_MakeImage(Size);
+
+    NodeNum = 1 + Slaves;
+    if (!SIM_NodeLoad(&Nodes[0], argv[Arg], MasterRole, SIM_MASTER_START_US)) {
+        return 2;
+    }
+    memcpy(&Nodes[0].Flash[SIM_MASTER_BIN_ADDR], Image, ImageSize);
+    for (i = 1; i < NodeNum; i++) {
+        if (!SIM_NodeLoad(&Nodes[i], argv[Arg + 1], SIM_ROLE_SLAVE, 0)) {
+            return 2;
+        }
+        memcpy(&Nodes[i].Flash[0], Running, ImageSize);
+        Nodes[i].Loss = SlaveLoss ? (unsigned int)(rand() % (SlaveLoss + 1)) : 0;
+    }
+
+    while (SIM_Step(LimitS * 1000000ULL)) {
+        if (Nodes[0].Rebooted) {
+            for (i = 1; (i < NodeNum) && Nodes[i].Rebooted; i++);
+            if ((i == NodeNum) || (Now > Nodes[0].RebootUs + SIM_LINGER_US)) {
+                break;
+            }
+        }
+    }
+
+    t = Nodes[0].Telemetry;
+    Blocks = t->BlockSize ? (t->Bytes + t->BlockSize - 1) / t->BlockSize : 0;
+    printf("master: %s, %u bytes in %u.%03u s, %u B/s, %u blocks of %u, %.1f blocks/s, tx %u rx %u crc %u timeout %u hops %u\n",
+           !Nodes[0].Rebooted ? "unfinished" : (Nodes[0].Ok ? "done" : "failed"), t->Bytes, t->ElapsedMs / 1000, t->ElapsedMs % 1000,
+           t->BytesPerSec, Blocks, t->BlockSize, t->ElapsedMs ? Blocks * 1000.0 / t->ElapsedMs : 0.0,
+           t->TxFrames, t->RxFrames, t->CrcErrors, t->Timeouts, t->Hops);
+    Failed = !Nodes[0].Ok;
+    EndUs = Nodes[0].Rebooted ? Nodes[0].RebootUs : Now;
+    for (i = 1; i < NodeNum; i++) {
+        t = Nodes[i].Telemetry;
+        printf("slave %d: %s, loss %u+%u, tx %u rx %u crc %u timeout %u overrun %u, first block %u.%03u ms after the start, done at %u ms\n",
+               i, SIM_SlaveVerify(&Nodes[i]) ? "verified" : (Nodes[i].Rebooted ? "failed" : "unfinished"),
+               LossPermille[SIM_CHANNEL], Nodes[i].Loss, t->TxFrames, t->RxFrames, t->CrcErrors, t->Timeouts, t->RxOverruns,
+               SIM_SinceUs(Nodes[i].StartUs, Nodes[i].FirstBlockUs) / 1000, SIM_SinceUs(Nodes[i].StartUs, Nodes[i].FirstBlockUs) % 1000,
+               SIM_SinceUs(SIM_MASTER_START_US, Nodes[i].Rebooted ? Nodes[i].RebootUs : 0) / 1000);
+        Failed |= !SIM_SlaveVerify(&Nodes[i]);
+        Verified += SIM_SlaveVerify(&Nodes[i]);
+        if (!Nodes[i].Rebooted) {
+            EndUs = Now;
+        }
+        else if (Nodes[i].RebootUs > EndUs) {
+            EndUs = Nodes[i].RebootUs;
+        }
+    }
+    EndUs -= SIM_MASTER_START_US;
+    printf("session: %d of %d slaves verified in %llu.%03llu s\n", Verified, NodeNum - 1, EndUs / 1000000, EndUs / 1000 % 1000);
+    return Failed;
+}
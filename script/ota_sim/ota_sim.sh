@@ -0,0 +1,135 @@
+#!/bin/bash 
+# builds the OTA master and slave of ota/ota.c into nodes of ota_sim.c and runs sessions between them
+#   usage: ota_sim.sh loss [image_size]     blocks/s against the loss rate, windowed and stop-and-wait
+#          ota_sim.sh fleet [image_size]    session time against the number of slaves, multicast and one by one
+#          ota_sim.sh erase                 time to the first block and session time against the image size
+#          ota_sim.sh hop [image_size]      throughput under interference on single channels, hopping and not
+#          ota_sim.sh tpll [image_size]     blocks/s against the loss rate over the TPLL transport, next to gen_fsk
+cd "$(dirname "$0")"
+SDK=../..
+OUT=build
+ERASE_US=30000 # a typical sector erase, the nodes are built for the worst case of common/erase_ahead.h
+# the SDK is written for a 32-bit core: register addresses are integers cast to pointers, DMA addresses
+# pointers cast to u32 and common/string.h declares the C library with 32-bit sizes
+SDK_WARN="-Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast"
+SDK_CFLAGS="-O2 -fPIC $SDK_WARN -iquote sim -iquote $SDK/drivers -iquote $SDK/common -iquote $SDK/ota -iquote $SDK/genfsk_ll -iquote $SDK/tpll"
+NODE_SRCS="$SDK/ota/ota.c $SDK/ota/mac.c $SDK/ota/mac_tpll.c $SDK/ota/ota_resume.c $SDK/ota/ota_lz.c $SDK/ota/ota_delta.c $SDK/ota/ota_telemetry.c
+           $SDK/common/erase_ahead.c $SDK/common/page_stage.c $SDK/common/retry_policy.c $SDK/common/crc.c $SDK/common/slot.c $SDK/common/image_check.c sim/sim_node.c"
+
+# node <name> <cflags>: one device build, its globals are the RAM of every device loaded from it
+node()
+{
+    mkdir -p $OUT/$1
+    OBJS=""
+    for SRC in $NODE_SRCS
+    do
+        gcc $SDK_CFLAGS $2 -c -o $OUT/$1/$(basename $SRC .c).o $SRC || exit 1
+        OBJS="$OBJS $OUT/$1/$(basename $SRC .c).o"
+    done
+    gcc -shared -Wl,-Bsymbolic -o $OUT/$1.so $OBJS || exit 1
+}
+
+echo "*****************************************************"
+node master "-DOTA_MASTER_EN"
+node master_win "-DOTA_MASTER_EN -DOTA_WINDOW_SIZE=8"
+node master_nohop "-DOTA_MASTER_EN -DOTA_HOP_EN=0"
+node slave ""
+node master_tpll "-DOTA_MASTER_EN -DMAC_TRANSPORT=MAC_TRANSPORT_TPLL"
+node slave_tpll "-DMAC_TRANSPORT=MAC_TRANSPORT_TPLL"
+gcc -O2 -Wall -rdynamic -o $OUT/ota_sim ota_sim.c $SDK/common/crc.c -ldl || exit 1
+
+RESULT=0
+case "$1" in
+loss)
+    SIZE=${2:-65536}
+    echo "a $SIZE byte image, blocks of the size the session ended with, a session that gave up shows its rate up to then"
+    printf "%10s   %-44s %-44s\n" "loss/1000" "window of 8" "stop-and-wait"
+    for LOSS in 0 5 10 20 50 100 200
+    do
+        LINE=$(printf "%10s" $LOSS)
+        for MASTER in master_win master
+        do
+            $OUT/ota_sim -s $SIZE -l $LOSS $OUT/$MASTER.so $OUT/slave.so > $OUT/run.log
+            [ $? -gt 1 ] && RESULT=1
+            LINE="$LINE   $(awk '/^master:/ { sub(",", "", $2); for (i = 1; i <= NF; i++) if ($i == "blocks/s,") r = $(i - 1);
+                                              printf "%6d B/s %6.1f blocks/s of %3d %-10s", $8, r, $13, ($2 == "done") ? "" : $2 }' $OUT/run.log)"
+        done
+        echo "$LINE"
+    done
+    ;;
+fleet)
+    SIZE=${2:-65536}
+    echo "a $SIZE byte image, every slave loses up to 5% of the frames, one multicast session against a unicast one per slave"
+    printf "%8s   %-34s %-34s\n" "slaves" "multicast" "one by one"
+    for SLAVES in 1 2 4 8 16 32 64
+    do
+        $OUT/ota_sim -s $SIZE -n $SLAVES -m -v 50 $OUT/master.so $OUT/slave.so > $OUT/run.log
+        [ $? -gt 1 ] && RESULT=1
+        LINE=$(printf "%8s   %s" $SLAVES "$(awk '/^session:/ { printf "%8.3f s, %2d of %2d verified   ", $8, $2, $4 }' $OUT/run.log)")
+        # the same slaves updated one after the other by the unicast master
+        : > $OUT/one.log
+        for LOSS in $(awk '/^slave/ { split($5, l, "+"); print l[1] + l[2] }' $OUT/run.log)
+        do
+            $OUT/ota_sim -s $SIZE -l $LOSS $OUT/master.so $OUT/slave.so >> $OUT/one.log
+            [ $? -gt 1 ] && RESULT=1
+        done
+        echo "$LINE $(awk '/^session:/ { t += $8; v += $2; n += $4 } END { printf "%8.3f s, %2d of %2d verified", t, v, n }' $OUT/one.log)"
+    done
+    ;;
+erase)
+    echo "sectors are erased as the image fills them, one takes $((ERASE_US / 1000)) ms, erasing the 15 sectors of the OTA area up front took $((15 * ERASE_US / 1000)) ms"
+    printf "%10s   %-40s %-40s\n" "image" "window of 8" "stop-and-wait"
+    for SIZE in 4096 16384 65536 122880
+    do
+        LINE=$(printf "%10s" $SIZE)
+        for MASTER in master_win master
+        do
+            $OUT/ota_sim -s $SIZE -E $ERASE_US $OUT/$MASTER.so $OUT/slave.so > $OUT/run.log
+            [ $? -gt 1 ] && RESULT=1
+            LINE="$LINE   $(awk '/^slave 1:/ { for (i = 1; i <= NF; i++) if ($i == "block") f = $(i + 1); s = $3 }
+                                 /^session:/ { printf "first block %7.1f ms, session %6.3f s %-9s", f, $8, (s == "verified,") ? "" : s }' $OUT/run.log)"
+        done
+        echo "$LINE"
+    done
+    ;;
+hop)
+    SIZE=${2:-65536}
+    echo "a $SIZE byte image, the session starts on channel 70, the hop list adds 24, 48 and 78 between the Wi-Fi channels"
+    printf "%-28s   %-36s %-36s\n" "loss/1000 by channel" "hopping" "no hopping"
+    for PROFILE in none 70:300 70:500 70:600 70:500,24:500 70:300,24:300,48:300,78:300
+    do
+        LINE=$(printf "%-28s" $PROFILE)
+        for MASTER in master master_nohop
+        do
+            $OUT/ota_sim -s $SIZE -c "${PROFILE#none}" $OUT/$MASTER.so $OUT/slave.so > $OUT/run.log
+            [ $? -gt 1 ] && RESULT=1
+            LINE="$LINE   $(awk '/^master:/ { sub(",", "", $2); printf "%6d B/s, %2d hops %-10s", $8, $NF, ($2 == "done") ? "" : $2 }' $OUT/run.log)"
+        done
+        echo "$LINE"
+    done
+    ;;
+tpll)
+    SIZE=${2:-65536}
+    echo "a $SIZE byte image, the link layer repeats a TPLL frame up to 15 times, sectors take $((ERASE_US / 1000)) ms to erase"
+    printf "%10s   %-44s %-44s\n" "loss/1000" "tpll" "gen_fsk, window of 8"
+    for LOSS in 0 5 10 20 50 100 200
+    do
+        LINE=$(printf "%10s" $LOSS)
+        for PAIR in master_tpll:slave_tpll master_win:slave
+        do
+            $OUT/ota_sim -s $SIZE -l $LOSS -E $ERASE_US $OUT/${PAIR%:*}.so $OUT/${PAIR#*:}.so > $OUT/run.log
+            [ $? -gt 1 ] && RESULT=1
+            LINE="$LINE   $(awk '/^master:/ { sub(",", "", $2); for (i = 1; i <= NF; i++) if ($i == "blocks/s,") r = $(i - 1);
+                                              printf "%6d B/s %6.1f blocks/s of %3d %-10s", $8, r, $13, ($2 == "done") ? "" : $2 }' $OUT/run.log)"
+        done
+        echo "$LINE"
+    done
+    ;;
+*)
+    echo "usage: ota_sim.sh loss|fleet|hop|tpll [image_size] or ota_sim.sh erase"
+    RESULT=2
+    ;;
+esac
+rm -rf $OUT
+echo "*****************************************************"
+exit $RESULT
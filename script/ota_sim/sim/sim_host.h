@@ -0,0 +1,107 @@
+/********************************************************************************************************
+ * @file	sim_host.h
+ *
+ * @brief	This is the header file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * what the nodes and the simulator of ota_sim.c share: sim_node.c is compiled against the
+ * SDK headers into every node, ota_sim.c against the C library, so only plain C types cross
+ * between them. A node is a shared object loaded once per device, its globals are its RAM
+ */
+#ifndef _SIM_HOST_H_
+#define _SIM_HOST_H_
+
+#define SIM_FLASH_SIZE          0x80000 //512KB, the whole flash map of the chip
+#define SIM_MASTER_BIN_ADDR     0x20000 //OTA_MASTER_BIN_ADDR of vendor/ota_master
+#define SIM_MASTER_FW_VERSION   0x0001
+#define SIM_SLAVE_FW_VERSION    0x0000
+
+//what SIM_NodeMain() runs
+#define SIM_ROLE_MASTER         0
+#define SIM_ROLE_MASTER_MCAST   1
+#define SIM_ROLE_SLAVE          2
+
+//rf irq sources handed to SIM_NodeIrq()
+#define SIM_IRQ_TX              0
+#define SIM_IRQ_RX              1
+#define SIM_IRQ_RX_TIMEOUT      2 //the rx window of a stx2rx closed empty
+#define SIM_IRQ_FIRST_TIMEOUT   3 //the rx window of a srx closed empty
+#define SIM_IRQ_TX_DS           4 //TPLL: the frame was acknowledged
+#define SIM_IRQ_RX_DR           5 //TPLL: a frame is in the rx fifo
+#define SIM_IRQ_ACK_PAYLOAD     6 //TPLL: the frame was acknowledged and the ACK payload is in the rx fifo
+#define SIM_IRQ_RETRY_HIT       7 //TPLL: the frame was given up
+
+//link layer of a TPLL node, see SIM_TpllMode()
+#define SIM_TPLL_OFF            0 //gen_fsk
+#define SIM_TPLL_PTX            1
+#define SIM_TPLL_PRX            2
+
+//flash operations timed by SIM_FlashBusy()
+#define SIM_FLASH_ERASE         0
+#define SIM_FLASH_PROGRAM       1
+
+//sim_node.c, looked up in every node
+extern unsigned char SIM_Flash[SIM_FLASH_SIZE];
+extern void SIM_NodeMain(int Role, unsigned int Channel);
+extern void SIM_NodeIrq(int Src, const unsigned char *Payload, int Len, int CrcOk);
+
+//ota_sim.c, acting on the node running
+extern unsigned int SIM_NowUs(void);
+extern void SIM_SleepUs(unsigned int Us);
+extern unsigned char SIM_IrqDisable(void);
+extern void SIM_IrqRestore(unsigned char Enable);
+extern void SIM_FlashBusy(int Op, unsigned int Len);
+extern void SIM_RadioTx(const unsigned char *TxBuf, unsigned int DelayUs, int RxWaitUs);
+extern void SIM_RadioRx(unsigned int DelayUs, unsigned int TimeoutUs);
+extern void SIM_RadioChannel(int Channel);
+extern void SIM_TpllMode(int Mode);
+extern void SIM_TpllConfig(int Retries, unsigned int RetryDelayUs, unsigned int AckWaitUs, unsigned int SettleUs);
+extern void SIM_TpllSend(const unsigned char *Payload, int Len);
+extern void SIM_TpllListen(int On);
+extern void SIM_TpllAckPayload(const unsigned char *Payload, int Len);
+extern int SIM_TpllRead(unsigned char *Buf);
+extern int SIM_TpllTries(void);
+extern void SIM_Reboot(int Ok);
+extern void SIM_Fatal(const char *Msg, unsigned int Value);
+
+#endif /* _SIM_HOST_H_ */
@@ -0,0 +1,427 @@
+/********************************************************************************************************
+ * @file	sim_node.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * one device of ota_sim.c: ota/ota.c over the gen_fsk transport of ota/mac.c or the TPLL one
+ * of ota/mac_tpll.c, on the host. The radio calls of either reach the radio medium of ota_sim.c,
+ * the rf irqs it raises come back through SIM_NodeIrq(), flash is an array that is programmed
+ * like NOR flash and takes the time ota_sim.c gives it, with the interrupts masked as flash.c
+ * masks them
+ */
+#include "driver.h"
+#include "common.h"
+#include "mac.h"
+#if (MAC_TRANSPORT == MAC_TRANSPORT_TPLL)
+#include "tpll.h"
+#else
+#include "genfsk_ll.h"
+#endif
+#include "ota.h"
+#include "ota_telemetry.h"
+#include "slot.h"
+#include "sim_host.h"
+
+#define SIM_LOOP_US             10 //one pass of the main loop
+#define SIM_RX_STATUS_OK        0x10 //the status byte MAC_RX_PACKET_CRC_OK() checks
+
+unsigned char SIM_Flash[SIM_FLASH_SIZE];
+unsigned short SIM_RfIrqSrc; //reg_rf_irq_status
+static unsigned char *SIM_RxBuf; //where the radio receives into, gen_fsk_rx_buffer_set()
+static unsigned int SIM_RxBufLen;
+static unsigned int SIM_TxSettleUs;
+#if (MAC_TRANSPORT == MAC_TRANSPORT_TPLL)
+static unsigned char SIM_TpllTx[64]; //TPLL_WriteTxPayload() until TPLL_PTXTrig()
+static int SIM_TpllTxLen;
+static int SIM_TpllRetries;
+static unsigned int SIM_TpllRetryDelayUs;
+static unsigned int SIM_TpllAckWaitUs;
+#endif
+
+static void SIM_FlashCheck(unsigned long Addr, unsigned long Len)
+{
+    if ((Addr >= SIM_FLASH_SIZE) || (Len > SIM_FLASH_SIZE - Addr)) {
+        SIM_Fatal("flash access out of range", Addr);
+    }
+}
+
+static void SIM_FlashRead(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    SIM_FlashCheck(Addr, Len);
+    memcpy(Buf, &SIM_Flash[Addr], Len);
+}
+
+//programming only clears bits, a write to an area not erased before shows up as corrupted data,
+//one program per page touched as flash_page_program() does it
+static void SIM_FlashWrite(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    unsigned long n, i;
+
+    SIM_FlashCheck(Addr, Len);
+    while (Len) {
+        n = PAGE_SIZE - (Addr & (PAGE_SIZE - 1));
+        if (n > Len) {
+            n = Len;
+        }
+        SIM_FlashBusy(SIM_FLASH_PROGRAM, n);
+        for (i = 0; i < n; i++) {
+            SIM_Flash[Addr + i] &= Buf[i];
+        }
+        Addr += n;
+        Buf += n;
+        Len -= n;
+    }
+}
+
+flash_hander_t flash_read_page = SIM_FlashRead;
+flash_hander_t flash_write_page = SIM_FlashWrite;
+
+void flash_erase_sector(unsigned long addr)
+{
+    addr &= ~0xfffUL;
+    SIM_FlashCheck(addr, 0x1000);
+    SIM_FlashBusy(SIM_FLASH_ERASE, 0x1000);
+    memset(&SIM_Flash[addr], 0xff, 0x1000);
+}
+
+//reading the system timer costs the core time as well, a loop polling it lets the time move on
+unsigned int SIM_ClockTick(void)
+{
+    SIM_SleepUs(1);
+    return SIM_NowUs() * sys_tick_per_us;
+}
+
+void sleep_us(unsigned long us)
+{
+    SIM_SleepUs(us);
+}
+
+void SIM_Gpio(unsigned int Pin, int Op, unsigned int Value)
+{
+}
+
+//ota_sim.c prints the counters itself
+void tl_printf(const char *format, ...)
+{
+}
+
+//rand() is the one of the C library, ota_sim.c seeds it for every node at once
+void random_generator_init(void)
+{
+}
+
+void start_reboot(void)
+{
+#ifdef OTA_MASTER_EN
+    SIM_Reboot(OTA_MASTER_STATE_END == OTA_Telemetry.State);
+#else
+    SIM_Reboot(OTA_SLAVE_STATE_END == OTA_Telemetry.State);
+#endif
+}
+
+static int SIM_SleepWakeup(SleepMode_TypeDef sleep_mode, SleepWakeupSrc_TypeDef wakeup_src, pm_wakeup_tick_type_e wakeup_tick_type, unsigned int wakeup_tick)
+{
+    start_reboot();
+    return 0;
+}
+
+cpu_pm_handler_t cpu_sleep_wakeup_and_longsleep = SIM_SleepWakeup;
+
+#if (MAC_TRANSPORT == MAC_TRANSPORT_TPLL)
+/* the air interface is fixed by ota_sim.c, the link layer runs there as it runs in the baseband */
+void TPLL_Init(TPLL_BitrateTypeDef bitrate)
+{
+}
+
+void TPLL_SetOutputPower(TPLL_OutputPowerTypeDef power)
+{
+}
+
+void TPLL_SetAddressWidth(TPLL_AddressWidthTypeDef address_width)
+{
+}
+
+void TPLL_ClosePipe(TPLL_PipeIDTypeDef pipe_id)
+{
+}
+
+void TPLL_OpenPipe(TPLL_PipeIDTypeDef pipe_id)
+{
+}
+
+void TPLL_SetAddress(TPLL_PipeIDTypeDef pipe_id, const unsigned char *addr)
+{
+}
+
+void TPLL_SetTXPipe(TPLL_PipeIDTypeDef pipe_id)
+{
+}
+
+void TPLL_UpdateTXFifoRptr(TPLL_PipeIDTypeDef pipe_id)
+{
+}
+
+void TPLL_SetRFChannel(signed short channel)
+{
+    SIM_RadioChannel(channel);
+}
+
+void TPLL_SetNewRFChannel(signed short channel)
+{
+    SIM_RadioChannel(channel);
+}
+
+void TPLL_ModeSet(TPLL_ModeTypeDef mode)
+{
+    SIM_TpllMode((TPLL_MODE_PTX == mode) ? SIM_TPLL_PTX : SIM_TPLL_PRX);
+}
+
+void TPLL_SetAutoRetry(unsigned char retry_times, unsigned short retry_delay)
+{
+    SIM_TpllRetries = retry_times;
+    SIM_TpllRetryDelayUs = retry_delay;
+    SIM_TpllConfig(SIM_TpllRetries, SIM_TpllRetryDelayUs, SIM_TpllAckWaitUs, SIM_TxSettleUs);
+}
+
+int TPLL_RxTimeoutSet(unsigned short period_us)
+{
+    SIM_TpllAckWaitUs = period_us;
+    SIM_TpllConfig(SIM_TpllRetries, SIM_TpllRetryDelayUs, SIM_TpllAckWaitUs, SIM_TxSettleUs);
+    return TLSR_SUCCESS;
+}
+
+int TPLL_RxSettleSet(unsigned short period_us)
+{
+    return TLSR_SUCCESS;
+}
+
+int TPLL_TxSettleSet(unsigned short period_us)
+{
+    SIM_TxSettleUs = period_us;
+    SIM_TpllConfig(SIM_TpllRetries, SIM_TpllRetryDelayUs, SIM_TpllAckWaitUs, SIM_TxSettleUs);
+    return TLSR_SUCCESS;
+}
+
+unsigned char TPLL_WriteTxPayload(TPLL_PipeIDTypeDef pipe_id, const unsigned char *tx_pload, unsigned char length)
+{
+    memcpy(SIM_TpllTx, tx_pload, length);
+    SIM_TpllTxLen = length;
+    return length;
+}
+
+int TPLL_PTXTrig(void)
+{
+    SIM_TpllSend(SIM_TpllTx, SIM_TpllTxLen);
+    return TLSR_SUCCESS;
+}
+
+int TPLL_PRXTrig(void)
+{
+    SIM_TpllListen(1);
+    return TLSR_SUCCESS;
+}
+
+void TPLL_ModeStop(void)
+{
+    SIM_TpllListen(0);
+}
+
+void TPLL_WriteAckPayload(TPLL_PipeIDTypeDef pipe_id, const unsigned char *payload, unsigned char length)
+{
+    SIM_TpllAckPayload(payload, length);
+}
+
+/* a PTX sends what TPLL_WriteTxPayload() left, the ACK payload is flushed on a PRX */
+void TPLL_FlushTx(TPLL_PipeIDTypeDef pipe_id)
+{
+    SIM_TpllTxLen = 0;
+    SIM_TpllAckPayload(NULL, 0);
+}
+
+void TPLL_FlushRx(void)
+{
+    unsigned char Buf[64];
+
+    while (SIM_TpllRead(Buf));
+}
+
+unsigned short TPLL_ReadRxPayload(unsigned char *rx_pload)
+{
+    return SIM_TpllRead(rx_pload);
+}
+
+unsigned char TPLL_GetTransmitAttempts(void)
+{
+    return SIM_TpllTries() - 1;
+}
+#else
+/* the air interface is fixed by ota_sim.c, the settings mac.c makes only matter to the chip */
+void gen_fsk_datarate_set(gen_fsk_datarate_t datarate)
+{
+}
+
+void gen_fsk_preamble_len_set(unsigned char preamble_len)
+{
+}
+
+void gen_fsk_sync_word_len_set(gen_fsk_sync_word_len_t length)
+{
+}
+
+void gen_fsk_sync_word_set(gen_fsk_pipe_id_t pipe, unsigned char *sync_word)
+{
+}
+
+void gen_fsk_pipe_open(gen_fsk_pipe_id_t pipe)
+{
+}
+
+void gen_fsk_tx_pipe_set(gen_fsk_pipe_id_t pipe)
+{
+}
+
+void gen_fsk_packet_format_set(gen_fsk_packet_format_t format, unsigned char payload_len)
+{
+}
+
+void gen_fsk_radio_power_set(gen_fsk_radio_power_t level)
+{
+}
+
+void gen_fsk_radio_state_set(gen_fsk_state_t state)
+{
+}
+
+void gen_fsk_tx_settle_set(unsigned short period_us)
+{
+    SIM_TxSettleUs = period_us;
+}
+
+void gen_fsk_rx_buffer_set(unsigned char *rx_buffer, unsigned char rx_buffer_len)
+{
+    SIM_RxBuf = rx_buffer;
+    SIM_RxBufLen = rx_buffer_len;
+}
+
+void gen_fsk_channel_set(signed short channel_num)
+{
+    SIM_RadioChannel(channel_num);
+}
+
+/* microseconds from now until the system timer reaches start_point */
+static unsigned int SIM_StartDelay(unsigned int start_point)
+{
+    int Ticks = (int)(start_point - SIM_NowUs() * sys_tick_per_us);
+
+    return (Ticks > 0) ? Ticks / sys_tick_per_us : 0;
+}
+
+void gen_fsk_stx_start(unsigned char *tx_buffer, unsigned int start_point)
+{
+    SIM_RadioTx(tx_buffer, SIM_StartDelay(start_point) + SIM_TxSettleUs, -1);
+}
+
+void gen_fsk_stx2rx_start(unsigned char *tx_buffer, unsigned int start_point, unsigned int timeout_us)
+{
+    SIM_RadioTx(tx_buffer, SIM_StartDelay(start_point) + SIM_TxSettleUs, timeout_us);
+}
+
+void gen_fsk_srx_start(unsigned int start_point, unsigned int timeout_us)
+{
+    SIM_RadioRx(SIM_StartDelay(start_point), timeout_us);
+}
+#endif
+
+/*
+ * raise an rf irq, a received packet is put into the rx buffer as the DMA of the chip puts it:
+ * the DMA length first, the length byte at 4, the payload and then the status byte
+ */
+void SIM_NodeIrq(int Src, const unsigned char *Payload, int Len, int CrcOk)
+{
+    static const unsigned short IrqFlag[] = {FLD_RF_IRQ_TX, FLD_RF_IRQ_RX, FLD_RF_IRQ_RX_TIMEOUT, FLD_RF_IRQ_FIRST_TIMEOUT,
+                                             FLD_RF_IRQ_TX_DS, FLD_RF_IRQ_RX_DR, FLD_RF_IRQ_RX_DR | FLD_RF_IRQ_TX_DS,
+                                             FLD_RF_IRQ_RETRY_HIT};
+
+    if (SIM_IRQ_RX == Src) {
+        if (!SIM_RxBuf || (Len + 6 > SIM_RxBufLen)) {
+            SIM_Fatal("packet does not fit the rx buffer", Len);
+        }
+        SIM_RxBuf[0] = Len + 2;
+        SIM_RxBuf[1] = 0;
+        SIM_RxBuf[2] = 0;
+        SIM_RxBuf[3] = 0;
+        SIM_RxBuf[4] = Len;
+        memcpy(&SIM_RxBuf[5], Payload, Len);
+        SIM_RxBuf[Len + 5] = CrcOk ? SIM_RX_STATUS_OK : 0;
+    }
+    SIM_RfIrqSrc = IrqFlag[Src];
+    MAC_IrqHandler();
+}
+
+/* what main() of vendor/ota_master or vendor/ota_slave does once triggered, without the LEDs */
+void SIM_NodeMain(int Role, unsigned int Channel)
+{
+#ifdef OTA_MASTER_EN
+    MAC_Init(Channel, OTA_RxIrq, OTA_RxTimeoutIrq, OTA_RxTimeoutIrq);
+    if (SIM_ROLE_MASTER_MCAST == Role) {
+        OTA_MasterMulticastInit(SIM_MASTER_BIN_ADDR, SIM_MASTER_FW_VERSION);
+    }
+    else {
+        OTA_MasterInit(SIM_MASTER_BIN_ADDR, SIM_MASTER_FW_VERSION);
+    }
+    while (1) {
+        OTA_MasterStart();
+        SIM_SleepUs(SIM_LOOP_US);
+    }
+#else
+    slot_boot();
+    slot_confirm();
+    MAC_Init(Channel, OTA_RxIrq, OTA_RxTimeoutIrq, OTA_RxTimeoutIrq);
+    OTA_SlaveInit((0x4b == SIM_Flash[8]) ? OTA_SLAVE_BIN_ADDR : 0, SIM_SLAVE_FW_VERSION);
+    while (1) {
+        OTA_SlaveStart();
+        SIM_SleepUs(SIM_LOOP_US);
+    }
+#endif
+}
@@ -0,0 +1,373 @@
+/********************************************************************************************************
+ * @file	retry_policy_test.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host checks of common/retry_policy.c, the retry budget, the doubling backoff and the round
+ * trip estimate, then loss traces are replayed against the settings of ota.h and fw_update.h
+ * and against the fixed timeout and three retries the SDK used before
+ *   build: gcc -O2 -Wall -iquote ../../common -c ../../common/retry_policy.c
+ *          gcc -O2 -Wall -o retry_policy_test retry_policy_test.c retry_policy.o, retry_policy_test.sh does both
+ *   usage: retry_policy_test [trace...]
+ *   a trace has one line per frame that solicits a response, the round trip time in us or '-'
+ *   when no response came, an optional count repeats the line, "busy" ahead of the time marks a frame
+ *   after a response that announced flash work, "repeat <n>" ... "end" repeats a group, '#' starts a comment and "# expect <policy> <done|failed> [late <n>]" states the
+ *   outcome a policy has to reach, late bounds the responses that came after the timeout
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(c) do { if (!(c)) { printf("line %d: %s\n", __LINE__, #c); Failures++; } } while (0)
+
+#define TEST_ERASE_MAX_US       500000 //ERASE_AHEAD_SECTOR_ERASE_MAX_US of common/erase_ahead.h
+#define TEST_TRACE_MAX          (1 << 20) //frames
+#define TEST_REPEAT_DEPTH       8
+#define TEST_LOST               0 //no response to the frame
+#define TEST_BUSY               0x80000000 //the response before announced flash work
+#define TEST_EXPECT_MAX         8
+
+//common/retry_policy.h, which needs the SDK types
+typedef struct {
+    unsigned int srtt;
+    unsigned int rttvar;
+    unsigned int rto;
+    unsigned int rto_min;
+    unsigned int rto_max;
+    unsigned short budget;
+    unsigned char backoff;
+    unsigned char backoff_max;
+} retry_policy_t;
+
+extern void retry_policy_init(retry_policy_t *rp, unsigned int rto_init, unsigned int rto_min, unsigned int rto_max,
+                              unsigned short budget, unsigned char backoff_max);
+extern unsigned int retry_policy_timeout(const retry_policy_t *rp);
+extern void retry_policy_success(retry_policy_t *rp, unsigned int rtt_us);
+extern int retry_policy_failure(retry_policy_t *rp);
+
+typedef struct {
+    const char *Name;
+    unsigned int RtoInit;
+    unsigned int RtoMin;
+    unsigned int RtoMax;
+    unsigned short Budget;
+    unsigned char BackoffMax;
+    unsigned int BusyWait; //on top of the timeout after a response that announced flash work, 0 for none
+} TEST_Policy_t;
+
+static const TEST_Policy_t Policies[] = {
+    //OTA_RTO_INIT, OTA_RTO_MIN, OTA_RTO_MAX, OTA_RETRY_BUDGET, OTA_RETRY_BURST_MAX and OTA_BUSY_WAIT of ota/ota.h
+    {"ota", 200000, 10000, 1000000, 128, 8, TEST_ERASE_MAX_US + 20000},
+    //FW_UPDATE_RTO_INIT ... FW_UPDATE_BUSY_WAIT of fw_update/fw_update.h
+    {"fw_update", 1000000, 20000, 2000000, 128, 8, TEST_ERASE_MAX_US + 20000},
+    //MAC_RX_WAIT and OTA_RETRY_MAX, a fixed timeout and at most three retries of an exchange
+    {"fixed", 200000, 200000, 200000, 0xffff, 3, 0},
+};
+#define TEST_POLICY_NUM         (sizeof(Policies) / sizeof(Policies[0]))
+
+typedef struct {
+    int Policy;
+    int Done;
+    int Late;           //-1 when not bounded
+} TEST_Expect_t;
+
+typedef struct {
+    unsigned int Exchanges;
+    unsigned int Retries;
+    unsigned int Late;
+    unsigned long long Us;
+    int Done;
+} TEST_Result_t;
+
+static int Failures;
+static unsigned int Trace[TEST_TRACE_MAX];
+static unsigned int TraceLen;
+static TEST_Expect_t Expect[TEST_EXPECT_MAX];
+static int ExpectNum;
+
+static void Init(retry_policy_t *rp, const TEST_Policy_t *P)
+{
+    retry_policy_init(rp, P->RtoInit, P->RtoMin, P->RtoMax, P->Budget, P->BackoffMax);
+}
+
+//every failure doubles the timeout up to rto_max, a success ends the backoff
+static void TestBackoff(void)
+{
+    retry_policy_t rp;
+    unsigned int Prev;
+    int i;
+
+    retry_policy_init(&rp, 10000, 5000, 300000, 100, 10);
+    CHECK(retry_policy_timeout(&rp) == 10000);
+    for (i = 1; i <= 10; i++) {
+        Prev = retry_policy_timeout(&rp);
+        CHECK(retry_policy_failure(&rp));
+        CHECK(retry_policy_timeout(&rp) == ((Prev * 2 > 300000) ? 300000 : Prev * 2));
+    }
+    CHECK(retry_policy_timeout(&rp) == 300000);
+    CHECK(!retry_policy_failure(&rp)); //the burst limit
+    CHECK(rp.budget == 90);
+    retry_policy_success(&rp, 0);
+    CHECK(retry_policy_timeout(&rp) == 10000);
+    CHECK(retry_policy_failure(&rp));
+}
+
+//the budget counts the failures of the whole session, successes do not refill it
+static void TestBudget(void)
+{
+    retry_policy_t rp;
+    int i;
+
+    retry_policy_init(&rp, 10000, 5000, 300000, 20, 3);
+    for (i = 0; i < 20; i++) {
+        CHECK(retry_policy_failure(&rp));
+        retry_policy_success(&rp, 0);
+    }
+    CHECK(rp.budget == 0);
+    CHECK(!retry_policy_failure(&rp));
+    retry_policy_success(&rp, 1000);
+    CHECK(!retry_policy_failure(&rp));
+}
+
+//the timeout follows the round trip time, never below rto_min, retried exchanges are not sampled
+static void TestEstimate(void)
+{
+    retry_policy_t rp;
+    int i;
+
+    retry_policy_init(&rp, 100000, 2000, 1000000, 100, 8);
+    retry_policy_success(&rp, 4000);
+    CHECK(rp.srtt == 4000 && rp.rttvar == 2000 && retry_policy_timeout(&rp) == 12000);
+    for (i = 0; i < 100; i++) {
+        retry_policy_success(&rp, 4000);
+    }
+    CHECK(rp.srtt == 4000 && retry_policy_timeout(&rp) == 4000 + 4 * rp.rttvar);
+    CHECK(retry_policy_timeout(&rp) < 4200);
+    for (i = 0; i < 200; i++) {
+        retry_policy_success(&rp, 400);
+    }
+    CHECK(retry_policy_timeout(&rp) == 2000);
+    for (i = 0; i < 50; i++) {
+        retry_policy_success(&rp, 40000);
+    }
+    CHECK(rp.srtt > 39000 && rp.srtt <= 40000);
+    CHECK(retry_policy_timeout(&rp) >= rp.srtt);
+    retry_policy_failure(&rp);
+    retry_policy_success(&rp, 900000); //Karn, the response may answer the first transmission
+    CHECK(rp.srtt > 39000 && rp.srtt <= 40000);
+    for (i = 0; i < 10; i++) {
+        retry_policy_success(&rp, 5000000);
+    }
+    CHECK(retry_policy_timeout(&rp) == 1000000);
+}
+
+static int Load(const char *Path)
+{
+    FILE *f = fopen(Path, "r");
+    char Line[256];
+    char Word[64];
+    char Outcome[16];
+    unsigned int Start[TEST_REPEAT_DEPTH];
+    unsigned int Times[TEST_REPEAT_DEPTH];
+    unsigned int Count, Rtt, Busy, Len, i, j;
+    unsigned int Depth = 0;
+    int n;
+    int LineNum = 0;
+    char *p;
+
+    if (NULL == f) {
+        printf("%s: cannot open\n", Path);
+        return -1;
+    }
+    TraceLen = 0;
+    ExpectNum = 0;
+    while (fgets(Line, sizeof(Line), f)) {
+        LineNum++;
+        p = strchr(Line, '#');
+        if (p) {
+            Expect[ExpectNum].Late = -1;
+            n = sscanf(p, "# expect %63s %15s late %d", Word, Outcome, &Expect[ExpectNum].Late);
+            if (n >= 2) {
+                for (i = 0; (i < TEST_POLICY_NUM) && strcmp(Word, Policies[i].Name); i++) {
+                }
+                if ((i == TEST_POLICY_NUM) || (ExpectNum == TEST_EXPECT_MAX) ||
+                    (strcmp(Outcome, "done") && strcmp(Outcome, "failed"))) {
+                    printf("%s:%d: bad expectation\n", Path, LineNum);
+                    fclose(f);
+                    return -1;
+                }
+                Expect[ExpectNum].Policy = i;
+                Expect[ExpectNum].Done = !strcmp(Outcome, "done");
+                ExpectNum++;
+            }
+            *p = 0;
+        }
+        Count = 1;
+        n = sscanf(Line, "%63s %u", Word, &Count);
+        if (n < 1) {
+            continue;
+        }
+        if (!strcmp(Word, "repeat") && (2 == n) && (Depth < TEST_REPEAT_DEPTH)) {
+            Start[Depth] = TraceLen;
+            Times[Depth++] = Count;
+            continue;
+        }
+        if (!strcmp(Word, "end") && (1 == n) && Depth) {
+            Depth--;
+            Len = TraceLen - Start[Depth];
+            for (i = 1; i < Times[Depth]; i++) {
+                for (j = 0; (j < Len) && (TraceLen < TEST_TRACE_MAX); j++) {
+                    Trace[TraceLen++] = Trace[Start[Depth] + j];
+                }
+            }
+            continue;
+        }
+        Busy = 0;
+        if (!strcmp(Word, "busy")) {
+            Busy = TEST_BUSY;
+            Count = 1;
+            n = sscanf(Line, "%*s %63s %u", Word, &Count);
+        }
+        if ((n >= 1) && !strcmp(Word, "-")) {
+            Rtt = TEST_LOST;
+        }
+        else if ((n < 1) || (1 != sscanf(Word, "%u", &Rtt)) || (TEST_LOST == Rtt) || (Rtt & TEST_BUSY)) {
+            printf("%s:%d: bad line\n", Path, LineNum);
+            fclose(f);
+            return -1;
+        }
+        for (i = 0; (i < Count) && (TraceLen < TEST_TRACE_MAX); i++) {
+            Trace[TraceLen++] = Rtt | Busy;
+        }
+    }
+    fclose(f);
+    if (Depth || (TraceLen == TEST_TRACE_MAX)) {
+        printf("%s: unterminated repeat or too long\n", Path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * runs a session until the trace ends or the policy gives up, a response after the timeout
+ * is as good as lost, the next frame of the trace is the retry. A policy that takes the
+ * announcement of flash work waits BusyWait longer for the frame after it, without a sample
+ */
+static void Replay(const TEST_Policy_t *P, TEST_Result_t *R)
+{
+    retry_policy_t rp;
+    unsigned int Timeout, Rtt, Busy, i;
+
+    Init(&rp, P);
+    memset(R, 0, sizeof(*R));
+    R->Done = 1;
+    for (i = 0; i < TraceLen; i++) {
+        Timeout = retry_policy_timeout(&rp);
+        CHECK(Timeout >= P->RtoMin && Timeout <= P->RtoMax);
+        Rtt = Trace[i] & ~TEST_BUSY;
+        Busy = (Trace[i] & TEST_BUSY) && P->BusyWait;
+        if (Busy) {
+            Timeout += P->BusyWait;
+        }
+        if ((TEST_LOST != Rtt) && (Rtt <= Timeout)) {
+            R->Us += Rtt;
+            R->Exchanges++;
+            retry_policy_success(&rp, Busy ? 0 : Rtt);
+            continue;
+        }
+        if (TEST_LOST != Rtt) {
+            R->Late++;
+        }
+        R->Us += Timeout;
+        if (!retry_policy_failure(&rp)) {
+            R->Done = 0;
+            return;
+        }
+        R->Retries++;
+    }
+    R->Done = (0 == rp.backoff);
+}
+
+static void RunTrace(const char *Path)
+{
+    TEST_Result_t R[TEST_POLICY_NUM];
+    const char *Name = strrchr(Path, '/') ? strrchr(Path, '/') + 1 : Path;
+    unsigned int i;
+    int e;
+
+    if (Load(Path)) {
+        Failures++;
+        return;
+    }
+    for (i = 0; i < TEST_POLICY_NUM; i++) {
+        Replay(&Policies[i], &R[i]);
+        printf("%s: %s %s, %u exchanges, %u retries, %u late, %.3f s\n", Name, Policies[i].Name,
+               R[i].Done ? "done" : "failed", R[i].Exchanges, R[i].Retries, R[i].Late, R[i].Us / 1e6);
+    }
+    for (e = 0; e < ExpectNum; e++) {
+        i = Expect[e].Policy;
+        if ((R[i].Done != Expect[e].Done) || ((Expect[e].Late >= 0) && (R[i].Late > (unsigned int)Expect[e].Late))) {
+            printf("%s: %s expected %s", Name, Policies[i].Name, Expect[e].Done ? "done" : "failed");
+            if (Expect[e].Late >= 0) {
+                printf(" with at most %d late", Expect[e].Late);
+            }
+            printf("\n");
+            Failures++;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    TestBackoff();
+    TestBudget();
+    TestEstimate();
+    for (i = 1; i < argc; i++) {
+        RunTrace(argv[i]);
+    }
+    printf("%s\n", Failures ? "FAILED" : "PASSED");
+    return Failures ? 1 : 0;
+}
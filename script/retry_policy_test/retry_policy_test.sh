@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -iquote ../../common -c ../../common/retry_policy.c || exit 1
+gcc -O2 -Wall -o retry_policy_test retry_policy_test.c retry_policy.o || exit 1
+./retry_policy_test traces/*.txt "$@"
+RESULT=$?
+rm -f retry_policy_test retry_policy.o
+echo "*****************************************************"
+exit $RESULT
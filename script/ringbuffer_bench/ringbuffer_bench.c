@@ -0,0 +1,172 @@
+/********************************************************************************************************
+ * @file	ringbuffer_bench.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host tool, compares the IRQ masking ringbuffer_t of common/ringbuffer.h with its lock-free SPSC mode,
+ * then checks the SPSC mode between a producer and a consumer thread
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -c ringbuffer_bench_sdk.c && gcc -O2 -Wall -pthread -o ringbuffer_bench ringbuffer_bench.c ringbuffer_bench_sdk.o
+ *   usage: ringbuffer_bench [megabytes]
+ * irq_disable()/irq_restore() store to the IRQ enable register as on the chip,
+ * the register page is mapped where the SDK addresses it
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#define BENCH_REG_BASE          0x800000 //REG_BASE_ADDR of drivers/bsp.h
+#define BENCH_REG_SIZE          0x10000
+#define BENCH_CHUNK             64 //bytes per UART DMA burst of the bridge
+
+extern void BENCH_Init(void);
+extern unsigned int BENCH_Legacy(const unsigned char *Src, unsigned char *Dst, unsigned int Len, unsigned int Chunk);
+extern unsigned int BENCH_SpscBytes(const unsigned char *Src, unsigned char *Dst, unsigned int Len, unsigned int Chunk);
+extern unsigned int BENCH_SpscBulk(const unsigned char *Src, unsigned char *Dst, unsigned int Len, unsigned int Chunk);
+extern unsigned int BENCH_Produce(const unsigned char *Src, unsigned int Len, int UseSpan);
+extern unsigned int BENCH_Consume(unsigned char *Dst, unsigned int Len, int UseSpan);
+
+typedef unsigned int (*BENCH_Fn)(const unsigned char *, unsigned char *, unsigned int, unsigned int);
+
+static unsigned char *Src, *Dst;
+static unsigned int Len;
+
+static double Seconds(void)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return Ts.tv_sec + Ts.tv_nsec / 1e9;
+}
+
+static int Run(const char *Name, BENCH_Fn Fn)
+{
+    double t;
+
+    memset(Dst, 0, Len);
+    BENCH_Init();
+    t = Seconds();
+    Fn(Src, Dst, Len, BENCH_CHUNK);
+    t = Seconds() - t;
+    printf("%-24s %8.1f MB/s\n", Name, Len / t / 1e6);
+    if (memcmp(Src, Dst, Len)) {
+        printf("%s: data differs\n", Name);
+        return 0;
+    }
+    return 1;
+}
+
+static void *Producer(void *Arg)
+{
+    unsigned int Done = 0, Seed = 1;
+
+    while (Done < Len) {
+        unsigned int n = 1 + rand_r(&Seed) % 300;
+        n = (n < Len - Done) ? n : (Len - Done);
+        n = BENCH_Produce(&Src[Done], n, Seed & 1);
+        if (!n) {
+            sched_yield(); //the consumer may share the CPU
+        }
+        Done += n;
+    }
+    return Arg;
+}
+
+static int Threaded(void)
+{
+    unsigned int Done = 0, Seed = 2;
+    pthread_t Thread;
+    double t;
+
+    memset(Dst, 0, Len);
+    BENCH_Init();
+    t = Seconds();
+    pthread_create(&Thread, NULL, Producer, NULL);
+    while (Done < Len) {
+        unsigned int n = 1 + rand_r(&Seed) % 300;
+        n = BENCH_Consume(&Dst[Done], (n < Len - Done) ? n : (Len - Done), Seed & 1);
+        if (!n) {
+            sched_yield();
+        }
+        Done += n;
+    }
+    pthread_join(Thread, NULL);
+    t = Seconds() - t;
+    printf("%-24s %8.1f MB/s\n", "spsc, two threads", Len / t / 1e6);
+    if (memcmp(Src, Dst, Len)) {
+        printf("spsc, two threads: data differs\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int i;
+    int Ok;
+
+    Len = ((argc > 1) ? strtoul(argv[1], NULL, 0) : 64) << 20;
+    if (MAP_FAILED == mmap((void *)BENCH_REG_BASE, BENCH_REG_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0)) {
+        perror("register page");
+        return 1;
+    }
+    Src = malloc(Len);
+    Dst = malloc(Len);
+    if (!Src || !Dst) {
+        return 1;
+    }
+    for (i = 0; i < Len; i++) {
+        Src[i] = i * 131 + (i >> 11);
+    }
+    printf("%u MB in %u byte chunks\n", Len >> 20, BENCH_CHUNK);
+    Ok = Run("ringbuffer_t", BENCH_Legacy);
+    Ok &= Run("spsc, one byte per call", BENCH_SpscBytes);
+    Ok &= Run("spsc, bulk", BENCH_SpscBulk);
+    Ok &= Threaded();
+    return Ok ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -Wno-builtin-declaration-mismatch -c -o ringbuffer_bench_sdk.o ringbuffer_bench_sdk.c || exit 1
+gcc -O2 -Wall -pthread -o ringbuffer_bench ringbuffer_bench.c ringbuffer_bench_sdk.o || exit 1
+./ringbuffer_bench $1
+RESULT=$?
+rm -f ringbuffer_bench ringbuffer_bench_sdk.o
+echo "*****************************************************"
+exit $RESULT
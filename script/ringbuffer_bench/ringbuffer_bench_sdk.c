@@ -0,0 +1,138 @@
+/********************************************************************************************************
+ * @file	ringbuffer_bench_sdk.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * the part of ringbuffer_bench built against the SDK headers, which clash with the C library ones,
+ * so only plain C types cross to ringbuffer_bench.c
+ */
+#include "../../common/ringbuffer.h"
+
+#define BENCH_RING_SIZE         1024
+
+static u8 LegacyData[BENCH_RING_SIZE];
+static u8 SpscData[BENCH_RING_SIZE];
+static ringbuffer_t Legacy;
+static ringbuffer_spsc_t Spsc;
+
+void BENCH_Init(void)
+{
+    ringbuffer_init(&Legacy, LegacyData, sizeof(LegacyData));
+    ringbuffer_spsc_init(&Spsc, SpscData, sizeof(SpscData));
+}
+
+/* Len bytes through the buffer, Chunk at a time, one call per byte as the UART bridge does it */
+unsigned int BENCH_Legacy(const unsigned char *Src, unsigned char *Dst, unsigned int Len, unsigned int Chunk)
+{
+    unsigned int Done, i, n;
+
+    for (Done = 0; Done < Len; Done += n) {
+        n = (Len - Done < Chunk) ? (Len - Done) : Chunk;
+        for (i = 0; i < n; i++) {
+            ringbuffer_insert(&Legacy, Src[Done + i]);
+        }
+        for (i = ringbuffer_get_count(&Legacy); i; i--) {
+            *Dst++ = ringbuffer_remove(&Legacy);
+        }
+    }
+    return Done;
+}
+
+unsigned int BENCH_SpscBytes(const unsigned char *Src, unsigned char *Dst, unsigned int Len, unsigned int Chunk)
+{
+    unsigned int Done, i, n;
+
+    for (Done = 0; Done < Len; Done += n) {
+        n = (Len - Done < Chunk) ? (Len - Done) : Chunk;
+        for (i = 0; i < n; i++) {
+            ringbuffer_spsc_insert(&Spsc, Src[Done + i]);
+        }
+        for (i = ringbuffer_spsc_get_count(&Spsc); i; i--) {
+            *Dst++ = ringbuffer_spsc_remove(&Spsc);
+        }
+    }
+    return Done;
+}
+
+unsigned int BENCH_SpscBulk(const unsigned char *Src, unsigned char *Dst, unsigned int Len, unsigned int Chunk)
+{
+    unsigned int Done, n;
+
+    for (Done = 0; Done < Len; Done += n) {
+        n = ringbuffer_spsc_write(&Spsc, &Src[Done], (Len - Done < Chunk) ? (Len - Done) : Chunk);
+        Dst += ringbuffer_spsc_read(&Spsc, Dst, n);
+    }
+    return Done;
+}
+
+/* the two sides of the threaded check, bulk calls and spans in turn */
+unsigned int BENCH_Produce(const unsigned char *Src, unsigned int Len, int UseSpan)
+{
+    unsigned char *Ptr;
+    unsigned int n;
+
+    if (!UseSpan) {
+        return ringbuffer_spsc_write(&Spsc, Src, Len);
+    }
+    n = ringbuffer_spsc_write_span(&Spsc, &Ptr);
+    n = (n < Len) ? n : Len;
+    memcpy(Ptr, Src, n);
+    ringbuffer_spsc_commit(&Spsc, n);
+    return n;
+}
+
+unsigned int BENCH_Consume(unsigned char *Dst, unsigned int Len, int UseSpan)
+{
+    unsigned char *Ptr;
+    unsigned int n;
+
+    if (!UseSpan) {
+        return ringbuffer_spsc_read(&Spsc, Dst, Len);
+    }
+    n = ringbuffer_spsc_read_span(&Spsc, &Ptr);
+    n = (n < Len) ? n : Len;
+    memcpy(Dst, Ptr, n);
+    ringbuffer_spsc_consume(&Spsc, n);
+    return n;
+}
@@ -0,0 +1,582 @@
+/********************************************************************************************************
+ * @file	slot_test.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host checks of common/slot.c against a simulated NOR flash: a switch to a new image, the boot
+ * attempts it gets on trial, the rollback once they are used up or the image rejects itself and the
+ * carry over of the records when their sector is full. Then the power is lost in every flash
+ * operation of each of them in turn, torn a few different ways, after the reboots exactly one slot
+ * has to boot and hold its image intact, and an image that is never confirmed has to be left
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -iquote ../../common -iquote ../../drivers -c ../../common/slot.c
+ *          gcc -O2 -Wall -o slot_test slot_test.c slot.o, slot_test.sh does both
+ *   usage: slot_test [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define TEST_FLASH_SIZE         0x80000
+#define TEST_SECTOR_SIZE        0x1000
+#define TEST_PAGE_SIZE          0x100
+#define TEST_SLOT_A             0x00000 //SLOT_A_ADDR
+#define TEST_SLOT_B             0x20000 //SLOT_B_ADDR
+#define TEST_META_ADDR          0x7b000 //SLOT_META_ADDR
+#define TEST_RECORD_SIZE        32      //sizeof(slot_record_t)
+#define TEST_ATTEMPTS_MAX       3       //SLOT_BOOT_ATTEMPTS_MAX
+#define TEST_FLAG_OFFSET        8       //SLOT_FLAG_OFFSET
+#define TEST_IMAGE_SIZE         (2 * TEST_SECTOR_SIZE + 300)
+#define TEST_BOOT_MAX           8       //reboots slot_boot() may ask for in a row
+#define TEST_CUT_ROUNDS         8       //different tears of the same operation
+
+#define TEST_STATE_TRIAL        0xffffffff //SLOT_STATE_*
+#define TEST_STATE_CONFIRMED    0x0000ffff
+#define TEST_STATE_BAD          0x00000000
+
+typedef void (*TEST_FlashHandler_t)(unsigned long, unsigned long, unsigned char *);
+
+//common/slot.h, which needs the SDK types
+typedef struct {
+    unsigned int magic;
+    unsigned int addr;
+    unsigned int size;
+    unsigned short version;
+    unsigned short crc;
+    unsigned int state;
+    unsigned int attempts;
+    unsigned int progress;
+    unsigned int verified;
+} slot_record_t;
+
+extern int slot_load(slot_record_t *rec, unsigned int addr);
+extern unsigned int slot_running(void);
+extern void slot_switch(unsigned int addr, unsigned short version, unsigned short crc, unsigned int size);
+extern unsigned int slot_boot(void);
+extern void slot_confirm(void);
+extern void slot_reject(void);
+extern int slot_verified(unsigned int addr, unsigned int size, unsigned short crc);
+extern void slot_set_verified(unsigned int addr, unsigned int size, unsigned short crc);
+
+static const unsigned char Flag[4] = {0x4b, 0x4e, 0x4c, 0x54};
+static unsigned char Flash[TEST_FLASH_SIZE];
+static unsigned char Saved[TEST_FLASH_SIZE];
+static unsigned int Ops;        //flash erase and program operations so far
+static unsigned int CutAt;      //operation the power is lost in, ~0 for never
+static jmp_buf ResetJmp;        //power loss or start_reboot()
+static unsigned int Reboots;
+static int Failures;
+static unsigned int Checks;
+
+#define CHECK(c)    do { Checks++; if (!(c)) { printf("line %d: %s\n", __LINE__, #c); Failures++; } } while (0)
+
+static void TestFlashRange(unsigned long Addr, unsigned long Len)
+{
+    if ((Addr >= TEST_FLASH_SIZE) || (Len > TEST_FLASH_SIZE - Addr)) {
+        printf("flash access out of range: 0x%lx, %lu bytes\n", Addr, Len);
+        exit(2);
+    }
+}
+
+static void TestFlashRead(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    TestFlashRange(Addr, Len);
+    memcpy(Buf, &Flash[Addr], Len);
+}
+
+//programming only clears bits, one program per page touched as flash_page_program() does it. A cut
+//leaves the bytes before the cut programmed and a random part of the bits of that byte, or the
+//whole page programmed with the power lost right after
+static void TestFlashWrite(unsigned long Addr, unsigned long Len, unsigned char *Buf)
+{
+    unsigned long i, n;
+    unsigned long Cut;
+    int Armed;
+
+    TestFlashRange(Addr, Len);
+    while (Len) {
+        n = TEST_PAGE_SIZE - (Addr & (TEST_PAGE_SIZE - 1));
+        if (n > Len) {
+            n = Len;
+        }
+        Armed = (Ops++ == CutAt);
+        Cut = Armed ? (rand() % (n + 1)) : n;
+        for (i = 0; i < Cut; i++) {
+            Flash[Addr + i] &= Buf[i];
+        }
+        if (Armed) {
+            if (Cut < n) {
+                Flash[Addr + Cut] &= Buf[Cut] | rand();
+            }
+            CutAt = ~0U;
+            longjmp(ResetJmp, 1);
+        }
+        Addr += n;
+        Buf += n;
+        Len -= n;
+    }
+}
+
+TEST_FlashHandler_t flash_read_page = TestFlashRead;
+TEST_FlashHandler_t flash_write_page = TestFlashWrite;
+
+//a cut erase leaves a random part of the sector erased
+void flash_erase_sector(unsigned long addr)
+{
+    unsigned long i;
+
+    addr &= ~(unsigned long)(TEST_SECTOR_SIZE - 1);
+    TestFlashRange(addr, TEST_SECTOR_SIZE);
+    if (Ops++ == CutAt) {
+        for (i = 0; i < TEST_SECTOR_SIZE; i++) {
+            if (rand() & 1) {
+                Flash[addr + i] = 0xff;
+            }
+        }
+        CutAt = ~0U;
+        longjmp(ResetJmp, 1);
+    }
+    memset(&Flash[addr], 0xff, TEST_SECTOR_SIZE);
+}
+
+void start_reboot(void)
+{
+    longjmp(ResetJmp, 1);
+}
+
+static unsigned char ImageByte(int Id, unsigned int i)
+{
+    if ((i >= TEST_FLAG_OFFSET) && (i < TEST_FLAG_OFFSET + 4)) {
+        return Flag[i - TEST_FLAG_OFFSET];
+    }
+    return (unsigned char)(i * 7 + Id * 31 + (i >> 8));
+}
+
+//the factory image in slot A, the other slot and the records erased
+static void Factory(int Id)
+{
+    unsigned int i;
+
+    memset(Flash, 0xff, sizeof(Flash));
+    for (i = 0; i < TEST_IMAGE_SIZE; i++) {
+        Flash[TEST_SLOT_A + i] = ImageByte(Id, i);
+    }
+}
+
+//an image received into the slot at Addr as OTA does it, with its boot flag left erased
+static void Receive(unsigned int Addr, int Id)
+{
+    unsigned char Buf[TEST_PAGE_SIZE];
+    unsigned int i, j;
+
+    for (i = 0; i < TEST_IMAGE_SIZE; i += TEST_SECTOR_SIZE) {
+        flash_erase_sector(Addr + i);
+    }
+    for (i = 0; i < TEST_IMAGE_SIZE; i += TEST_PAGE_SIZE) {
+        for (j = 0; j < TEST_PAGE_SIZE; j++) {
+            Buf[j] = ((i + j >= TEST_FLAG_OFFSET) && (i + j < TEST_FLAG_OFFSET + 4)) ? 0xff : ImageByte(Id, i + j);
+        }
+        flash_write_page(Addr + i, (TEST_IMAGE_SIZE - i < TEST_PAGE_SIZE) ? TEST_IMAGE_SIZE - i : TEST_PAGE_SIZE, Buf);
+    }
+}
+
+static int FlagValid(unsigned int Addr)
+{
+    return 0 == memcmp(&Flash[Addr + TEST_FLAG_OFFSET], Flag, 4);
+}
+
+//the slot holds the image, whatever its boot flag says
+static int ImageIntact(unsigned int Addr, int Id)
+{
+    unsigned int i;
+
+    for (i = 0; i < TEST_IMAGE_SIZE; i++) {
+        if ((i >= TEST_FLAG_OFFSET) && (i < TEST_FLAG_OFFSET + 4)) {
+            continue;
+        }
+        if (Flash[Addr + i] != ImageByte(Id, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//power on until slot_boot() lets the image run, returns its slot
+static unsigned int Boot(void)
+{
+    volatile int n = 0;
+
+    if (setjmp(ResetJmp)) {
+        Reboots++;
+        if (++n > TEST_BOOT_MAX) {
+            printf("slot_boot() keeps rebooting\n");
+            Failures++;
+            return slot_running();
+        }
+    }
+    return slot_boot();
+}
+
+//runs Action until it returns or the device reboots, returns 1 on a reboot
+static int Run(void (*Action)(void))
+{
+    if (setjmp(ResetJmp)) {
+        return 1;
+    }
+    Action();
+    return 0;
+}
+
+static int Records(void)
+{
+    unsigned int Addr;
+    int n = 0;
+
+    for (n = 0; n < TEST_SECTOR_SIZE / TEST_RECORD_SIZE; n++) {
+        memcpy(&Addr, &Flash[TEST_META_ADDR + n * TEST_RECORD_SIZE + 4], 4);
+        if (0xffffffff == Addr) {
+            break;
+        }
+    }
+    return n;
+}
+
+static unsigned int Other(unsigned int Addr)
+{
+    return (TEST_SLOT_A == Addr) ? TEST_SLOT_B : TEST_SLOT_A;
+}
+
+static void Switch(unsigned int Addr, int Id)
+{
+    slot_switch(Addr, Id, 0x1000 + Id, TEST_IMAGE_SIZE);
+}
+
+static void SwitchB(void)
+{
+    Switch(TEST_SLOT_B, 2);
+}
+
+static void SwitchA(void)
+{
+    Switch(TEST_SLOT_A, 3);
+}
+
+static void Confirm(void)
+{
+    slot_confirm();
+}
+
+static void Reject(void)
+{
+    slot_reject();
+}
+
+static void Nothing(void)
+{
+}
+
+//a new image boots on trial, once confirmed it stays, the previous slot keeps its image
+static void TestSwitch(void)
+{
+    slot_record_t Rec;
+    int i;
+
+    Factory(1);
+    CutAt = ~0U;
+    CHECK(TEST_SLOT_A == Boot());
+    CHECK(!slot_load(&Rec, TEST_SLOT_A) && !slot_load(&Rec, TEST_SLOT_B));
+    Receive(TEST_SLOT_B, 2);
+    CHECK(TEST_SLOT_A == Boot());
+    SwitchB();
+    CHECK(FlagValid(TEST_SLOT_B) && !FlagValid(TEST_SLOT_A));
+    CHECK(slot_load(&Rec, TEST_SLOT_B) && (TEST_STATE_TRIAL == Rec.state) && (2 == Rec.version));
+    CHECK(TEST_SLOT_B == Boot());
+    CHECK(!Run(Confirm));
+    CHECK(slot_load(&Rec, TEST_SLOT_B) && (TEST_STATE_CONFIRMED == Rec.state));
+    for (i = 0; i < 2 * TEST_ATTEMPTS_MAX; i++) {
+        CHECK(TEST_SLOT_B == Boot());
+    }
+    CHECK(ImageIntact(TEST_SLOT_A, 1) && ImageIntact(TEST_SLOT_B, 2));
+
+    //and back into slot A
+    Receive(TEST_SLOT_A, 3);
+    SwitchA();
+    CHECK(TEST_SLOT_A == Boot());
+    CHECK(!Run(Confirm));
+    CHECK(TEST_SLOT_A == Boot());
+    CHECK(ImageIntact(TEST_SLOT_A, 3) && ImageIntact(TEST_SLOT_B, 2));
+    CHECK(FlagValid(TEST_SLOT_A) && !FlagValid(TEST_SLOT_B));
+}
+
+//an image that never confirms gets TEST_ATTEMPTS_MAX boots, then the previous one boots for good
+static void TestAttempts(void)
+{
+    slot_record_t Rec;
+    unsigned int Before;
+    int i;
+
+    Factory(1);
+    CutAt = ~0U;
+    Receive(TEST_SLOT_B, 2);
+    SwitchB();
+    for (i = 0; i < TEST_ATTEMPTS_MAX; i++) {
+        CHECK(TEST_SLOT_B == Boot());
+    }
+    Before = Reboots;
+    CHECK(TEST_SLOT_A == Boot());
+    CHECK(Reboots == Before + 1);
+    CHECK(slot_load(&Rec, TEST_SLOT_B) && (TEST_STATE_BAD == Rec.state));
+    CHECK(FlagValid(TEST_SLOT_A) && !FlagValid(TEST_SLOT_B));
+    CHECK(ImageIntact(TEST_SLOT_A, 1) && ImageIntact(TEST_SLOT_B, 2));
+    for (i = 0; i < 2 * TEST_ATTEMPTS_MAX; i++) {
+        CHECK(TEST_SLOT_A == Boot());
+    }
+    //a rejected image is not gone back to either
+    CHECK(!Run(Reject));
+    CHECK(TEST_SLOT_A == Boot());
+
+    //with nothing to roll back to, the image keeps running on trial
+    Factory(1);
+    Receive(TEST_SLOT_B, 2);
+    SwitchB();
+    memset(&Flash[TEST_SLOT_A], 0xff, TEST_SECTOR_SIZE);
+    for (i = 0; i < 2 * TEST_ATTEMPTS_MAX; i++) {
+        CHECK(TEST_SLOT_B == Boot());
+    }
+    CHECK(!Run(Reject));
+    CHECK(TEST_SLOT_B == Boot());
+}
+
+//an image rejecting itself is left at once, the factory image gets a record of its own
+static void TestReject(void)
+{
+    slot_record_t Rec;
+
+    Factory(1);
+    CutAt = ~0U;
+    Receive(TEST_SLOT_B, 2);
+    SwitchB();
+    CHECK(TEST_SLOT_B == Boot());
+    CHECK(Run(Reject));
+    CHECK(TEST_SLOT_A == Boot());
+    CHECK(slot_load(&Rec, TEST_SLOT_B) && (TEST_STATE_BAD == Rec.state));
+    CHECK(ImageIntact(TEST_SLOT_A, 1));
+
+    //the factory image rejects itself in favour of a confirmed image in slot B
+    Factory(1);
+    Receive(TEST_SLOT_B, 2);
+    SwitchB();
+    CHECK(TEST_SLOT_B == Boot());
+    CHECK(!Run(Confirm));
+    Receive(TEST_SLOT_A, 3);
+    SwitchA();
+    CHECK(TEST_SLOT_A == Boot());
+    CHECK(Run(Reject));
+    CHECK(TEST_SLOT_B == Boot());
+    CHECK(slot_load(&Rec, TEST_SLOT_A) && (TEST_STATE_BAD == Rec.state));
+    CHECK(ImageIntact(TEST_SLOT_B, 2));
+}
+
+static void TestVerified(void)
+{
+    slot_record_t Rec;
+
+    Factory(1);
+    CutAt = ~0U;
+    CHECK(!slot_verified(TEST_SLOT_A, TEST_IMAGE_SIZE, 0x1001));
+    slot_set_verified(TEST_SLOT_A, TEST_IMAGE_SIZE, 0x1001);
+    CHECK(slot_verified(TEST_SLOT_A, TEST_IMAGE_SIZE, 0x1001));
+    CHECK(!slot_verified(TEST_SLOT_A, TEST_IMAGE_SIZE, 0x1002));
+    CHECK(slot_load(&Rec, TEST_SLOT_A) && (TEST_STATE_CONFIRMED == Rec.state));
+    Receive(TEST_SLOT_B, 2);
+    SwitchB();
+    CHECK(!slot_verified(TEST_SLOT_B, TEST_IMAGE_SIZE, 0x1002));
+    slot_set_verified(TEST_SLOT_B, TEST_IMAGE_SIZE, 0x1002);
+    CHECK(slot_verified(TEST_SLOT_B, TEST_IMAGE_SIZE, 0x1002));
+    CHECK(slot_load(&Rec, TEST_SLOT_B) && (TEST_STATE_TRIAL == Rec.state));
+    CHECK(slot_verified(TEST_SLOT_A, TEST_IMAGE_SIZE, 0x1001));
+}
+
+//more switches than the record sector holds, the latest records are carried over
+static void TestFullSector(void)
+{
+    slot_record_t Rec;
+    unsigned int Addr = TEST_SLOT_A;
+    int Wrapped = 0, Last = 0;
+    int i;
+
+    Factory(1);
+    CutAt = ~0U;
+    for (i = 0; i < 3 * TEST_SECTOR_SIZE / TEST_RECORD_SIZE; i++) {
+        Addr = Other(Addr);
+        Receive(Addr, 2 + (i & 1));
+        Switch(Addr, 2 + (i & 1));
+        CHECK(Addr == Boot());
+        CHECK(!Run(Confirm));
+        CHECK(Addr == Boot());
+        CHECK(slot_load(&Rec, Addr) && (TEST_STATE_CONFIRMED == Rec.state) && (2 + (i & 1) == Rec.version));
+        CHECK(ImageIntact(Addr, 2 + (i & 1)));
+        Wrapped += (Records() < Last);
+        Last = Records();
+    }
+    CHECK(Wrapped >= 2);
+}
+
+/*
+ * the power is lost in every flash operation of Action and of the boots after it in turn: Setup
+ * brings the device to where Action starts, the device boots until an image runs, which has to
+ * be one of Expect, then boots on without a confirmation, which has to end in one of Final
+ */
+static void PowerCut(unsigned int Seed, const char *Name, void (*Setup)(void), void (*Action)(void), unsigned int Expect0, unsigned int Expect1,
+                     unsigned int Final0, unsigned int Final1, int *Cuts)
+{
+    unsigned int Total, Cut, Running;
+    int Ids[2];
+    int i;
+
+    CutAt = ~0U;
+    Setup();
+    memcpy(Saved, Flash, sizeof(Flash));
+    Ids[0] = ImageIntact(TEST_SLOT_A, 1) ? 1 : 3;
+    Ids[1] = 2;
+    Ops = 0;
+    Run(Action);
+    Boot();
+    Total = Ops;
+
+    for (Cut = 0; Cut < Total * TEST_CUT_ROUNDS; Cut++) {
+        srand(Seed + Cut);
+        memcpy(Flash, Saved, sizeof(Flash));
+        Ops = 0;
+        CutAt = Cut / TEST_CUT_ROUNDS;
+        Run(Action);
+        Running = Boot();
+        if (CutAt != ~0U) {
+            printf("%s: no operation %u to cut\n", Name, CutAt);
+            Failures++;
+        }
+        CutAt = ~0U;
+        if (((Running != Expect0) && (Running != Expect1)) || !FlagValid(Running) || FlagValid(Other(Running)) ||
+            !ImageIntact(Running, Ids[TEST_SLOT_B == Running])) {
+            printf("%s, cut in operation %u: slot 0x%x boots, %s\n", Name, Cut / TEST_CUT_ROUNDS, Running,
+                   ImageIntact(Running, Ids[TEST_SLOT_B == Running]) ? "intact" : "damaged");
+            Failures++;
+        }
+        for (i = 0; i <= TEST_ATTEMPTS_MAX; i++) {
+            Running = Boot();
+        }
+        if (((Running != Final0) && (Running != Final1)) || !ImageIntact(TEST_SLOT_A, Ids[0]) || !ImageIntact(TEST_SLOT_B, Ids[1])) {
+            printf("%s, cut in operation %u: slot 0x%x boots in the end, slot A %s, slot B %s\n", Name, Cut / TEST_CUT_ROUNDS, Running,
+                   ImageIntact(TEST_SLOT_A, Ids[0]) ? "intact" : "damaged", ImageIntact(TEST_SLOT_B, Ids[1]) ? "intact" : "damaged");
+            Failures++;
+        }
+        (*Cuts)++;
+    }
+}
+
+static void SetupReceived(void)
+{
+    Factory(1);
+    Receive(TEST_SLOT_B, 2);
+}
+
+static void SetupTrial(void)
+{
+    SetupReceived();
+    SwitchB();
+    Boot();
+}
+
+static void SetupExhausted(void)
+{
+    int i;
+
+    SetupReceived();
+    SwitchB();
+    for (i = 0; i < TEST_ATTEMPTS_MAX; i++) {
+        Boot();
+    }
+}
+
+//the next record written needs the sector erased first
+static void SetupFull(void)
+{
+    unsigned int Addr = TEST_SLOT_A;
+
+    Factory(1);
+    while (Records() < TEST_SECTOR_SIZE / TEST_RECORD_SIZE) {
+        Addr = Other(Addr);
+        Receive(Addr, (TEST_SLOT_B == Addr) ? 2 : 1);
+        Switch(Addr, (TEST_SLOT_B == Addr) ? 2 : 1);
+        Boot();
+        slot_confirm();
+    }
+    if (TEST_SLOT_A == Addr) {
+        Receive(TEST_SLOT_B, 2);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int Seed = (argc > 1) ? strtoul(argv[1], 0, 0) : 1;
+    int Cuts = 0;
+
+    srand(Seed);
+    TestSwitch();
+    TestAttempts();
+    TestReject();
+    TestVerified();
+    TestFullSector();
+    //the trial image is never confirmed below, so the factory image has to run in the end
+    PowerCut(Seed, "switch", SetupReceived, SwitchB, TEST_SLOT_A, TEST_SLOT_B, TEST_SLOT_A, TEST_SLOT_A, &Cuts);
+    PowerCut(Seed, "rollback", SetupExhausted, Nothing, TEST_SLOT_A, TEST_SLOT_A, TEST_SLOT_A, TEST_SLOT_A, &Cuts);
+    PowerCut(Seed, "reject", SetupTrial, Reject, TEST_SLOT_A, TEST_SLOT_B, TEST_SLOT_A, TEST_SLOT_A, &Cuts);
+    PowerCut(Seed, "full sector", SetupFull, SwitchB, TEST_SLOT_A, TEST_SLOT_B, TEST_SLOT_A, TEST_SLOT_A, &Cuts);
+    //a confirmation cut short may be lost, the image is then left as if it was never confirmed
+    PowerCut(Seed, "confirm", SetupTrial, Confirm, TEST_SLOT_B, TEST_SLOT_B, TEST_SLOT_A, TEST_SLOT_B, &Cuts);
+
+    printf("seed %u, %u checks, %u reboots, power cut in every flash operation of %d sequences\n", Seed, Checks, Reboots, Cuts);
+    printf("%s: %d failures\n", Failures ? "FAILED" : "passed", Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -iquote ../../common -iquote ../../drivers -c ../../common/slot.c || exit 1
+gcc -O2 -Wall -o slot_test slot_test.c slot.o || exit 1
+./slot_test $1
+RESULT=$?
+rm -f slot_test slot.o
+echo "*****************************************************"
+exit $RESULT
@@ -0,0 +1,223 @@
+/********************************************************************************************************
+ * @file	timer_event_test.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host checks of common/timer_event.c against a simulated system timer, deadlines are placed
+ * on both sides of the 32 bit tick wraparound
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -DTIMER_EVENT_CB_CHECK=0 -iquote . -iquote ../../common -iquote ../../drivers -c ../../common/timer_event.c
+ *          gcc -O2 -Wall -o timer_event_test timer_event_test.c timer_event.o, timer_event_test.sh does both
+ *   usage: timer_event_test
+ */
+#include <stdio.h>
+
+#define TEST_TICK_PER_US        16 //sys_tick_per_us of drivers/timer.h
+#define TEST_TIMER_NUM          10 //TIMER_EVENT_NUM
+#define TEST_MAX_US             (0x40000000 / TEST_TICK_PER_US) //TIMER_EVENT_MAX_US
+
+typedef int (*TEST_Callback_t)(void *Data);
+
+//common/timer_event.h, which needs the SDK types
+extern void *ev_on_timer(TEST_Callback_t cb, void *data, unsigned int t_us);
+extern void ev_unon_timer(void **e);
+extern void ev_process_timer(void);
+extern int is_timer_expired(void *e);
+extern int ev_next_timer(unsigned int *t);
+extern unsigned int ev_timer_overflows(void);
+
+typedef struct {
+    int Ret;            //what the callback returns
+    int Fired;
+    unsigned int At;    //tick of the last call
+    void **Cancel;      //timer the callback cancels
+} TEST_Timer_t;
+
+unsigned int TEST_Tick;
+static int Failures;
+static int Order[64];
+static int OrderCnt;
+
+#define CHECK(c)    do { if (!(c)) { printf("line %d: %s\n", __LINE__, #c); Failures++; } } while (0)
+
+static int Callback(void *Data)
+{
+    TEST_Timer_t *T = Data;
+
+    T->Fired++;
+    T->At = TEST_Tick;
+    if (OrderCnt < 64) {
+        Order[OrderCnt++] = T->Ret;
+    }
+    if (T->Cancel) {
+        ev_unon_timer(T->Cancel);
+    }
+    return T->Ret;
+}
+
+//moves the clock in steps of Step us and processes the timers after each step
+static void Run(unsigned int Us, unsigned int Step)
+{
+    unsigned int Done;
+
+    for (Done = 0; Done < Us; Done += Step) {
+        TEST_Tick += Step * TEST_TICK_PER_US;
+        ev_process_timer();
+    }
+}
+
+static void Clear(void **Timers, int Cnt)
+{
+    int i;
+
+    for (i = 0; i < Cnt; i++) {
+        ev_unon_timer(&Timers[i]);
+    }
+}
+
+//one-shot timers fire in deadline order, once, never early, also across the wraparound
+static void TestOrder(unsigned int Start)
+{
+    static const unsigned int Us[5] = {500, 100, 300, 200, 400};
+    TEST_Timer_t T[5];
+    void *Timers[5];
+    unsigned int Next;
+    int i;
+
+    TEST_Tick = Start;
+    OrderCnt = 0;
+    for (i = 0; i < 5; i++) {
+        T[i] = (TEST_Timer_t){-(i + 1), 0, 0, NULL};
+        Timers[i] = ev_on_timer(Callback, &T[i], Us[i]);
+        CHECK(Timers[i] != NULL);
+    }
+    CHECK(ev_next_timer(&Next) && Next == Start + 100 * TEST_TICK_PER_US);
+    Run(600, 1);
+    for (i = 0; i < 5; i++) {
+        CHECK(T[i].Fired == 1);
+        CHECK(T[i].At == Start + Us[i] * TEST_TICK_PER_US);
+        CHECK(is_timer_expired(Timers[i]));
+    }
+    CHECK(OrderCnt == 5 && Order[0] == -2 && Order[1] == -4 && Order[2] == -3 && Order[3] == -5 && Order[4] == -1);
+    CHECK(!ev_next_timer(&Next));
+}
+
+//a periodic timer processed late keeps its deadlines on the grid and skips periods missed entirely
+static void TestPeriodic(unsigned int Start)
+{
+    TEST_Timer_t T = {0, 0, 0, NULL};
+    void *Timer;
+    unsigned int Next;
+
+    TEST_Tick = Start;
+    Timer = ev_on_timer(Callback, &T, 1000);
+    Run(100000, 7); //every call 0..6 us late
+    CHECK(T.Fired == 100);
+    CHECK(ev_next_timer(&Next) && Next == Start + 101000 * TEST_TICK_PER_US);
+    TEST_Tick += 5500 * TEST_TICK_PER_US;
+    ev_process_timer();
+    CHECK(T.Fired == 101);
+    CHECK(ev_next_timer(&Next) && Next == Start + 106000 * TEST_TICK_PER_US);
+    T.Ret = 250; //a positive return sets a new interval from the last deadline
+    Run(500, 1); //to just past the 106000 us deadline
+    CHECK(T.Fired == 102);
+    CHECK(ev_next_timer(&Next) && Next == Start + 106250 * TEST_TICK_PER_US);
+    ev_unon_timer(&Timer);
+    CHECK(Timer == NULL && !ev_next_timer(&Next));
+}
+
+//a full pool and intervals out of range are refused instead of halting
+static void TestOverflow(void)
+{
+    TEST_Timer_t T = {-1, 0, 0, NULL};
+    void *Timers[TEST_TIMER_NUM + 1];
+    unsigned int Before = ev_timer_overflows();
+    int i;
+
+    for (i = 0; i < TEST_TIMER_NUM; i++) {
+        Timers[i] = ev_on_timer(Callback, &T, 1000 + i);
+        CHECK(Timers[i] != NULL);
+    }
+    Timers[TEST_TIMER_NUM] = ev_on_timer(Callback, &T, 1000);
+    CHECK(Timers[TEST_TIMER_NUM] == NULL);
+    CHECK(ev_timer_overflows() == Before + 1);
+    Clear(Timers, TEST_TIMER_NUM + 1);
+    Timers[0] = ev_on_timer(Callback, &T, TEST_MAX_US + 1);
+    CHECK(Timers[0] == NULL && ev_timer_overflows() == Before + 2);
+    Timers[0] = ev_on_timer(Callback, &T, TEST_MAX_US);
+    CHECK(Timers[0] != NULL);
+    Clear(Timers, 1);
+}
+
+//cancelled timers do not fire, a callback may cancel itself or another timer
+static void TestCancel(void)
+{
+    TEST_Timer_t T[3] = {{-1, 0, 0, NULL}, {0, 0, 0, NULL}, {0, 0, 0, NULL}};
+    void *Timers[3];
+    unsigned int Next;
+
+    TEST_Tick = 0xfffff000;
+    Timers[0] = ev_on_timer(Callback, &T[0], 100);
+    Timers[1] = ev_on_timer(Callback, &T[1], 200);
+    Timers[2] = ev_on_timer(Callback, &T[2], 300);
+    ev_unon_timer(&Timers[0]);
+    T[1].Cancel = &Timers[1]; //periodic, but cancels itself
+    T[2].Cancel = &Timers[0]; //already cancelled, a no-op
+    Run(1000, 10);
+    CHECK(T[0].Fired == 0 && T[1].Fired == 1 && T[2].Fired == 3);
+    CHECK(Timers[1] == NULL);
+    CHECK(ev_next_timer(&Next) && Next == 0xfffff000 + 1200 * TEST_TICK_PER_US);
+    Clear(Timers, 3);
+}
+
+int main(void)
+{
+    TestOrder(0x1000);
+    TestOrder(0xffffffff - 250 * TEST_TICK_PER_US);
+    TestPeriodic(0x1000);
+    TestPeriodic(0xffffffff - 50500 * TEST_TICK_PER_US);
+    TestOverflow();
+    TestCancel();
+    printf("timer_event: %s\n", Failures ? "FAILED" : "ok");
+    return Failures ? 1 : 0;
+}
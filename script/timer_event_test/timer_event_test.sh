@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -Wno-builtin-declaration-mismatch -Wno-int-to-pointer-cast -DTIMER_EVENT_CB_CHECK=0 -iquote . -iquote ../../common -iquote ../../drivers -c ../../common/timer_event.c || exit 1
+gcc -O2 -Wall -o timer_event_test timer_event_test.c timer_event.o || exit 1
+./timer_event_test
+RESULT=$?
+rm -f timer_event_test timer_event.o
+echo "*****************************************************"
+exit $RESULT
@@ -0,0 +1,108 @@
+/********************************************************************************************************
+ * @file	tn_mm_bench.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * host tool, compares the free-list tn_mm allocator of common/tn_mm.c with the linear scan it replaced
+ *   build: gcc -O2 -Wall -Wno-builtin-declaration-mismatch -c tn_mm_bench_sdk.c ../../common/tn_mm.c && gcc -O2 -Wall -o tn_mm_bench tn_mm_bench.c tn_mm_bench_sdk.o tn_mm.o
+ *   usage: tn_mm_bench [operations per pool]
+ * irq_disable()/irq_restore() store to the IRQ enable register as on the chip,
+ * the register page is mapped where the SDK addresses it
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define BENCH_REG_BASE          0x800000 //REG_BASE_ADDR of drivers/bsp.h
+#define BENCH_REG_SIZE          0x10000
+
+extern unsigned int BENCH_PoolSize(unsigned int Pool);
+extern int BENCH_Run(unsigned int Pool, int Scan, unsigned int Ops);
+extern int BENCH_NoInit(void);
+
+static double Seconds(void)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return Ts.tv_sec + Ts.tv_nsec / 1e9;
+}
+
+static int Run(unsigned int Pool, int Scan, unsigned int Ops, double *Ns)
+{
+    double t = Seconds();
+    int Ok = BENCH_Run(Pool, Scan, Ops);
+
+    *Ns = (Seconds() - t) * 1e9 / Ops;
+    return Ok;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int Ops = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+    unsigned int Pool;
+    double Scan, List;
+    int Ok = 1;
+
+    if (MAP_FAILED == mmap((void *)BENCH_REG_BASE, BENCH_REG_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0)) {
+        perror("register page");
+        return 1;
+    }
+    if (!BENCH_NoInit()) {
+        printf("a pool used before tn_mem_init(): allocator check failed\n");
+        Ok = 0;
+    }
+    printf("blocks   scan ns/op   free list ns/op\n");
+    for (Pool = 0; BENCH_PoolSize(Pool); Pool++) {
+        if (!Run(Pool, 1, Ops, &Scan) || !Run(Pool, 0, Ops, &List)) {
+            printf("%u blocks: allocator check failed\n", BENCH_PoolSize(Pool));
+            Ok = 0;
+            continue;
+        }
+        printf("%6u %12.1f %17.1f\n", BENCH_PoolSize(Pool), Scan, List);
+    }
+    return Ok ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash 
+echo "*****************************************************"
+cd "$(dirname "$0")"
+gcc -O2 -Wall -Wno-builtin-declaration-mismatch -c tn_mm_bench_sdk.c ../../common/tn_mm.c || exit 1
+gcc -O2 -Wall -o tn_mm_bench tn_mm_bench.c tn_mm_bench_sdk.o tn_mm.o || exit 1
+./tn_mm_bench $1
+RESULT=$?
+rm -f tn_mm_bench tn_mm_bench_sdk.o tn_mm.o
+echo "*****************************************************"
+exit $RESULT
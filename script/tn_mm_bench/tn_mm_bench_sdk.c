@@ -0,0 +1,195 @@
+/********************************************************************************************************
+ * @file	tn_mm_bench_sdk.c
+ *
+ * @brief	This is the source file for b80
+ *
+ * @author	2.4G Group
+ * @date	2019
+ *
+ * @par     Copyright (c) 2019, Telink Semiconductor (Shanghai) Co., Ltd. ("TELINK")
+ *          All rights reserved.
+ *
+ *          Redistribution and use in source and binary forms, with or without
+ *          modification, are permitted provided that the following conditions are met:
+ *
+ *              1. Redistributions of source code must retain the above copyright
+ *              notice, this list of conditions and the following disclaimer.
+ *
+ *              2. Unless for usage inside a TELINK integrated circuit, redistributions
+ *              in binary form must reproduce the above copyright notice, this list of
+ *              conditions and the following disclaimer in the documentation and/or other
+ *              materials provided with the distribution.
+ *
+ *              3. Neither the name of TELINK, nor the names of its contributors may be
+ *              used to endorse or promote products derived from this software without
+ *              specific prior written permission.
+ *
+ *              4. This software, with or without modification, must only be used with a
+ *              TELINK integrated circuit. All other usages are subject to written permission
+ *              from TELINK and different commercial license may apply.
+ *
+ *              5. Licensee shall be solely responsible for any claim to the extent arising out of or
+ *              relating to such deletion(s), modification(s) or alteration(s).
+ *
+ *          THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *          ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *          WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *          DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *          DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *          (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *          LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *          ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *          (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *          SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *******************************************************************************************************/
+/*
+ * the part of tn_mm_bench built against the SDK headers, which clash with the C library ones,
+ * so only plain C types cross to tn_mm_bench.c
+ */
+#include "../../common/tn_mm.h"
+#include "../../common/types.h"
+
+#define BENCH_POOL_CNT          8
+
+typedef struct {
+    u8 Data[16];
+} BENCH_Block_t;
+
+TN_MEM_DEF(Pool8, BENCH_Block_t, 8);
+TN_MEM_DEF(Pool16, BENCH_Block_t, 16);
+TN_MEM_DEF(Pool32, BENCH_Block_t, 32);
+TN_MEM_DEF(Pool64, BENCH_Block_t, 64);
+TN_MEM_DEF(Pool128, BENCH_Block_t, 128);
+TN_MEM_DEF(Pool256, BENCH_Block_t, 256);
+TN_MEM_DEF(Pool512, BENCH_Block_t, 512);
+TN_MEM_DEF(Pool1024, BENCH_Block_t, 1024);
+TN_MEM_DEF(PoolNoInit, BENCH_Block_t, 4); //left as TN_MEM_DEF made it, tn_mem_init() is never called
+
+static struct mem_desc *const Pools[BENCH_POOL_CNT] = {
+    &Pool8, &Pool16, &Pool32, &Pool64, &Pool128, &Pool256, &Pool512, &Pool1024,
+};
+static void *Held[1024];
+static u32 Seed;
+
+// the linear-scan allocator tn_mm.c had before, kept for comparison
+static void *SCAN_Alloc(struct mem_desc *m)
+{
+    int i;
+
+    for(i = 0; i < m->num; ++i) {
+        if(m->count[i] == 0) {
+            ++(m->count[i]);
+            return (void *)((char *)m->mem + (i * m->size));
+        }
+    }
+
+    return 0;
+}
+
+static char SCAN_Free(struct mem_desc *m, void *ptr)
+{
+    int i;
+    char *ptr2;
+
+    ptr2 = (char *)m->mem;
+    for (i = 0; i < m->num; ++i) {
+        if (ptr2 == (char *)ptr) {
+            if (m->count[i] > 0) {
+                --(m->count[i]);
+            }
+            return m->count[i];
+        }
+        ptr2 += m->size;
+    }
+    return -1;
+}
+
+static int SCAN_NumFree(struct mem_desc *m)
+{
+    int i;
+    int num_free = 0;
+
+    for(i = 0; i < m->num; ++i) {
+        if(m->count[i] == 0) {
+            ++num_free;
+        }
+    }
+
+    return num_free;
+}
+
+static u32 Random(void)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return Seed >> 8;
+}
+
+unsigned int BENCH_PoolSize(unsigned int Pool)
+{
+    return (Pool < BENCH_POOL_CNT) ? Pools[Pool]->num : 0;
+}
+
+/*
+ * a pool that was never initialised hands out each of its blocks once and then refuses,
+ * returns 0 if it does not
+ */
+int BENCH_NoInit(void)
+{
+    struct mem_desc *m = &PoolNoInit;
+    void *Ptr[4];
+    int i, j;
+
+    for (i = 0; i < 4; i++) {
+        if (tn_mem_numfree(m) != 4 - i) {
+            return 0;
+        }
+        Ptr[i] = tn_mem_alloc(m);
+        for (j = 0; j < i; j++) {
+            if (!Ptr[i] || (Ptr[i] == Ptr[j])) {
+                return 0;
+            }
+        }
+    }
+    if (tn_mem_alloc(m) || (tn_mem_free(m, Ptr[2]) != 0) || (tn_mem_alloc(m) != Ptr[2])) {
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Ops random allocations and frees keeping the pool about half full, the number of free blocks
+ * is read on every op as a queue would, returns 0 if an allocator handed out a block twice
+ * or lost one
+ */
+int BENCH_Run(unsigned int Pool, int Scan, unsigned int Ops)
+{
+    struct mem_desc *m = Pools[Pool];
+    unsigned int HeldCnt = 0, i;
+    void *Ptr;
+
+    tn_mem_init(m);
+    Seed = 1;
+    while (Ops--) {
+        if ((Scan ? SCAN_NumFree(m) : tn_mem_numfree(m)) != m->num - HeldCnt) {
+            return 0;
+        }
+        if (HeldCnt && ((HeldCnt >= m->num) || ((HeldCnt > m->num / 2) && (Random() & 1)) || !(Random() & 3))) {
+            i = Random() % HeldCnt;
+            ((BENCH_Block_t *)Held[i])->Data[0] = 0; //a block handed out twice shows up marked
+            if ((Scan ? SCAN_Free(m, Held[i]) : tn_mem_free(m, Held[i])) != 0) {
+                return 0;
+            }
+            Held[i] = Held[--HeldCnt];
+        }
+        else {
+            Ptr = Scan ? SCAN_Alloc(m) : tn_mem_alloc(m);
+            if (!Ptr || ((BENCH_Block_t *)Ptr)->Data[0]) {
+                return 0;
+            }
+            ((BENCH_Block_t *)Ptr)->Data[0] = 1;
+            Held[HeldCnt++] = Ptr;
+        }
+    }
+    return 1;
+}